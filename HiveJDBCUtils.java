@@ -11,10 +11,29 @@
 import java.sql.*;
 import java.text.*;
 import java.io.*;
+import java.math.BigDecimal;
 import java.net.URL;
 import java.net.URLClassLoader;
 import java.net.MalformedURLException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.CharBuffer;
+import java.nio.charset.CharsetEncoder;
+import java.nio.charset.CodingErrorAction;
+import java.nio.charset.StandardCharsets;
+import java.time.LocalDateTime;
+import java.time.ZoneOffset;
 import java.util.*;
+import java.util.concurrent.Callable;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.concurrent.ThreadFactory;
+import java.util.regex.Matcher;
+import java.util.regex.Pattern;
 
 
 public class HiveJDBCUtils
@@ -22,14 +41,85 @@ public class HiveJDBCUtils
 	private ResultSet result_set;
 	private ResultSet result_set1;
 	private Connection conn;
+	private Driver ConnDriver;		/* to open more connections like conn */
+	private String ConnUrl;
+	private Properties ConnProperties;
 	private int NumberOfColumns;
 	private int NumberOfRows;
-	private Statement sql;
+	private long UpdateCount;
+	private volatile Statement sql;
 	private		String[] Iterate;
 	private static HiveJDBCLoader Hive_Driver_Loader;
 	private StringWriter exception_stack_trace_string_writer;
 	private PrintWriter exception_stack_trace_print_writer;
-	private		ArrayList < String > mylist;
+	private		String[][] ImportedTables;
+	private		String[][] ImportedPartitions;
+	private ByteBuffer BatchBuffer;
+	private int BatchLength;
+	private ByteBuffer RowBuffer;
+	private boolean RowPending;
+	private		byte[] ColumnKinds;
+	private CharsetEncoder TextEncoder;
+	private int QueryTimeout;
+	private ByteBuffer CancelFlag;
+	private volatile long QueryDeadline;
+	private volatile boolean CancelSent;
+	private volatile boolean TimedOut;
+	private volatile String CancelFailure;	/* why stmt.cancel() failed */
+	private Future<String> PendingQuery;
+	private String LastProgress;
+	private String LatestProgress;
+	private		LinkedHashSet < String > JobIds = new LinkedHashSet < String > ();
+
+	/* Objects with a statement the cancel watcher has to keep an eye on */
+	private static final Set<HiveJDBCUtils> ActiveQueries =
+		Collections.newSetFromMap(new ConcurrentHashMap<HiveJDBCUtils, Boolean>());
+	private static Thread CancelWatcher;
+
+	/* How often the cancel watcher looks at the active statements */
+	private static final int CANCEL_POLL_MS = 100;
+
+	/* Threads that run submitted queries while the C side polls */
+	private static ExecutorService QueryExecutor;
+
+	/* Submitted work finished since the last Await_Completion */
+	private static final Object CompletionLock = new Object();
+	private static int Completions;
+
+	/* Hive log lines worth reporting as progress */
+	private static final Pattern PROGRESS_PATTERN = Pattern.compile(
+		"(Stage-\\d+ map = \\d+%,\\s*reduce = \\d+%|Map \\d+: .*|Launching Job .*|Total jobs = \\d+)");
+
+	/* MapReduce job and YARN application IDs in the Hive query log */
+	private static final Pattern JOB_ID_PATTERN = Pattern.compile(
+		"\\b((?:job|application)_\\d+_\\d+)\\b");
+
+	/* Upper bound on the number of rows shipped to C in one batch */
+	private static final int BATCH_ROWS = 1000;
+
+	/* Initial size of the direct buffer batches are encoded into */
+	private static final int BATCH_BUFFER_SIZE = 256 * 1024;
+
+	/* Initial size of the buffer a single row is encoded into */
+	private static final int ROW_BUFFER_SIZE = 4 * 1024;
+
+	/* Cell kinds of a row batch, see HIVE_CELL_* in hive_fdw.h */
+	private static final byte CELL_TEXT = 0;
+	private static final byte CELL_INT4 = 1;
+	private static final byte CELL_INT8 = 2;
+	private static final byte CELL_FLOAT4 = 3;
+	private static final byte CELL_FLOAT8 = 4;
+	private static final byte CELL_BOOL = 5;
+	private static final byte CELL_DATE = 6;
+	private static final byte CELL_TIMESTAMP = 7;
+	private static final byte CELL_DECIMAL = 8;
+	private static final byte CELL_BYTES = 9;
+	private static final byte CELL_JSON = 10;
+
+	/* IMPORT FOREIGN SCHEMA list types, as in ImportForeignSchemaType */
+	private static final int IMPORT_ALL = 0;
+	private static final int IMPORT_LIMIT_TO = 1;
+	private static final int IMPORT_EXCEPT = 2;
 
 
 /*
@@ -50,6 +140,8 @@ public class HiveJDBCUtils
 		String				userName = options_array[2];
 		String				password = options_array[3];
 
+		QueryTimeout = Integer.parseInt(options_array[5]);
+
 		exception_stack_trace_string_writer = new StringWriter();
 		exception_stack_trace_print_writer = new PrintWriter(exception_stack_trace_string_writer);
 
@@ -80,6 +172,9 @@ public class HiveJDBCUtils
 			HiveProperties.put("password", password);
 
 			conn = HiveDriver.connect(url, HiveProperties);
+			ConnDriver = HiveDriver;
+			ConnUrl = url;
+			ConnProperties = HiveProperties;
 
 		}
 		catch (Exception initialize_exception)
@@ -112,18 +207,69 @@ public class HiveJDBCUtils
 		exception_stack_trace_string_writer = new StringWriter();
 		exception_stack_trace_print_writer = new PrintWriter(exception_stack_trace_string_writer);
 		NumberOfColumns = 0;
+		NumberOfRows = 0;
+		UpdateCount = -1;
+		RowPending = false;
+		ColumnKinds = null;
 
 		try
 		{
 			db_metadata = conn.getMetaData();
 
+			/* Statements run one after the other on a connection, as the
+			 * batches of an INSERT do; drop the previous one first. */
+			if (result_set != null)
+				result_set.close();
+			if (sql != null)
+				sql.close();
+			result_set = null;
+
 			sql = conn.createStatement(ResultSet.TYPE_FORWARD_ONLY, ResultSet.CONCUR_READ_ONLY);
 
-			result_set = sql.executeQuery(query);
+			CancelSent = false;
+			TimedOut = false;
+			CancelFailure = null;
+			QueryDeadline = 0;
+			if (QueryTimeout > 0)
+			{
+				try
+				{
+					sql.setQueryTimeout(QueryTimeout);
+				}
+				catch (SQLException timeout_exception)
+				{
+					/* Older Hive drivers do not support it; the
+					 * cancel watcher enforces the deadline. */
+				}
+				QueryDeadline = System.currentTimeMillis() + QueryTimeout * 1000L;
+			}
+
+			/* The caller clears CancelFlag before submitting the query,
+			 * so a cancel that raced with the submission still counts. */
+			ActiveQueries.add(this);
+			StartCancelWatcher();
+
+			/* INSERT and other statements without a result set leave
+			 * NumberOfColumns at zero. UpdateCount stays -1 unless the
+			 * driver reports the rows a statement changed, which Hive
+			 * does from version 3.0 on. */
+			if (!sql.execute(query))
+			{
+				QueryDeadline = 0;
+				result_set = null;
+				UpdateCount = sql.getUpdateCount();
+				return null;
+			}
+			result_set = sql.getResultSet();
+			QueryDeadline = 0;
 
 			result_set_metadata = result_set.getMetaData();
 			NumberOfColumns = result_set_metadata.getColumnCount();
 			Iterate = new String[NumberOfColumns];
+
+			ColumnKinds = new byte[NumberOfColumns];
+			for (int i = 0; i < NumberOfColumns; i++)
+				ColumnKinds[i] = CellKind(result_set_metadata, i + 1);
 		}
 		catch (Exception initialize_exception)
 		{
@@ -132,279 +278,1501 @@ public class HiveJDBCUtils
 			 * that has the exception's stack trace.
 			 * If all goes well,a null String is returned. */
 
+			QueryDeadline = 0;
+			if (TimedOut)
+				return ("Hive query exceeded querytimeout of " + QueryTimeout + " seconds" +
+						(CancelFailure != null ? "\n" + CancelFailure : ""));
+
 			initialize_exception.printStackTrace(exception_stack_trace_print_writer);
+			if (CancelFailure != null)
+				exception_stack_trace_print_writer.print(CancelFailure);
 			return (new String(exception_stack_trace_string_writer.toString()));
 		}
 		return null;
 	}
 
 /*
- * ReturnResultSet
- *		Returns the result set that is returned from the foreign database
- *		after execution of the query to C code.
+ * Submit_Query
+ *		Starts Execute_Query on a query thread and returns at once, so
+ *		that the C side can wait on its latch instead of being stuck in
+ *		one JNI call while Hive compiles and runs the query.
  */
-	public String[]
-	ReturnResultSet()
+	public String
+	Submit_Query(final String query)
 	{
-		int	i = 0;
+		exception_stack_trace_string_writer = new StringWriter();
+		exception_stack_trace_print_writer = new PrintWriter(exception_stack_trace_string_writer);
+		LastProgress = null;
+		LatestProgress = null;
+		JobIds.clear();
 
 		try
 		{
-			/* Row-by-row processing is done in hive_fdw.One row
-			 * at a time is returned to the C code. */
-			if (result_set.next())
+			PendingQuery = GetQueryExecutor().submit(new Callable<String>()
 			{
-				for (i = 0; i < NumberOfColumns; i++)
+				public String call() throws Exception
 				{
-					Iterate[i] = result_set.getString(i+1);
+					try
+					{
+						return Execute_Query(query);
+					}
+					finally
+					{
+						NoteCompletion();
+					}
 				}
-
-				++NumberOfRows;
-
-				/* The current row in result_set is returned
-				 * to the C code in a Java String array that
-				 * has the value of the fields of the current
-				 * row as it values. */
-
-				return (Iterate);
-			}
-
+			});
 		}
-		catch (Exception returnresultset_exception)
+		catch (Exception submit_exception)
 		{
-			returnresultset_exception.printStackTrace();
+			submit_exception.printStackTrace(exception_stack_trace_print_writer);
+			return (new String(exception_stack_trace_string_writer.toString()));
 		}
-
-		/* All of result_set's rows have been returned to the C code. */
 		return null;
 	}
 
 /*
- * Close
- *		Releases the resources used.
+ * Submit_Fetch
+ *		Starts FetchBatch on a query thread and returns at once, so that
+ *		the gateway worker serves other backends while HiveServer2 sends
+ *		the rows. Poll_Query and Finish_Query tell when and how it ended;
+ *		the batch is then in BatchBuffer.
  */
 	public String
-	Close()
+	Submit_Fetch()
 	{
+		exception_stack_trace_string_writer = new StringWriter();
+		exception_stack_trace_print_writer = new PrintWriter(exception_stack_trace_string_writer);
 
 		try
 		{
-			result_set.close();
-			conn.close();
-			result_set = null;
-			conn = null;
-			Iterate = null;
+			PendingQuery = GetQueryExecutor().submit(new Callable<String>()
+			{
+				public String call() throws Exception
+				{
+					try
+					{
+						return FetchBatch();
+					}
+					finally
+					{
+						NoteCompletion();
+					}
+				}
+			});
 		}
-		catch (Exception close_exception)
+		catch (Exception submit_exception)
 		{
-			/* If an exception occurs,it is returned back to the
-			 * calling C code by returning a Java String object
-			 * that has the exception's stack trace.
-			 * If all goes well,a null String is returned. */
-
-			close_exception.printStackTrace(exception_stack_trace_print_writer);
+			submit_exception.printStackTrace(exception_stack_trace_print_writer);
 			return (new String(exception_stack_trace_string_writer.toString()));
 		}
-
 		return null;
 	}
 
 /*
- * Cancel
- *		Cancels the query and releases the resources in case query
- *		cancellation is requested by the user.
+ * NoteCompletion
+ *		Wakes up Await_Completion once a submitted query or fetch is done.
+ */
+	private static void
+	NoteCompletion()
+	{
+		synchronized (CompletionLock)
+		{
+			Completions++;
+			CompletionLock.notifyAll();
+		}
+	}
+
+/*
+ * Await_Completion
+ *		Waits up to millis ms for a submitted query or fetch to finish,
+ *		and returns at once if one finished since the last call. The
+ *		gateway worker waits here rather than on its latch while fetches
+ *		run, as a Java thread cannot set the latch.
+ */
+	public static void
+	Await_Completion(long millis)
+	{
+		synchronized (CompletionLock)
+		{
+			try
+			{
+				if (Completions == 0)
+					CompletionLock.wait(millis);
+			}
+			catch (InterruptedException await_exception)
+			{
+				/* Let the caller look at what it was waiting for */
+			}
+			Completions = 0;
+		}
+	}
+
+/*
+ * Poll_Query
+ *		Returns true once the submitted query has finished, successfully
+ *		or not.
+ */
+	public boolean
+	Poll_Query()
+	{
+		return (PendingQuery == null || PendingQuery.isDone());
+	}
+
+/*
+ * Finish_Query
+ *		Collects the outcome of the submitted query: null on success,
+ *		or the error as a String.
  */
 	public String
-	Cancel()
+	Finish_Query()
 	{
+		Future<String>	query = PendingQuery;
+
+		PendingQuery = null;
+		if (query == null)
+			return null;
 
 		try
 		{
-			result_set.close();
-			conn.close();
+			return query.get();
 		}
-		catch(Exception cancel_exception)
+		catch (ExecutionException finish_exception)
 		{
-			/* If an exception occurs,it is returned back to the
-			 * calling C code by returning a Java String object
-			 * that has the exception's stack trace.
-			 * If all goes well,a null String is returned. */
+			StringWriter	writer = new StringWriter();
 
-			cancel_exception.printStackTrace(exception_stack_trace_print_writer);
-			return (new String(exception_stack_trace_string_writer.toString()));
+			finish_exception.getCause().printStackTrace(new PrintWriter(writer));
+			return writer.toString();
+		}
+		catch (InterruptedException finish_exception)
+		{
+			return ("interrupted while waiting for the Hive query");
 		}
-
-		return null;
 	}
+
 /*
- **   Generates CREATE FOREIGN TABLE statements for each of the tables
- **   in the source schema and returns the list of these statements
- **   to the caller.
-**/
+ * Query_Progress
+ *		Returns the latest progress line from the Hive query log, or null
+ *		if there is nothing new.
+ */
 	public String
-	    PrepareDDLStmtList(String schema, String servername) throws IOException
+	Query_Progress()
 	{
-		DatabaseMetaData	db_metadata;
-		ResultSetMetaData	result_set_metadata;
-		ResultSetMetaData	result_set_metadata1;
-		Properties		HiveProperties;
-		Class			HiveDriverClass = null;
-		Driver			HiveDriver = null;
-		String[]		column_name;
-		String[]		column_type;
-		int[]			column_size;
-		int[]			column_length;
-		int			total_col = 0;
-		int			col = 0;
-		int			i = 0;
+		String		progress;
 
-		exception_stack_trace_string_writer = new StringWriter();
-		exception_stack_trace_print_writer = new PrintWriter(exception_stack_trace_string_writer);
+		ScanQueryLog();
 
-		NumberOfColumns = 0;
+		progress = LatestProgress;
+		if (progress == null || progress.equals(LastProgress))
+			return null;
 
-		try
+		LastProgress = progress;
+		return progress;
+	}
+
+/*
+ * Query_Ids
+ *		Returns the Hive query ID and the comma separated IDs of the jobs
+ *		Hive launched for the last query. Either may be null when the
+ *		driver does not tell.
+ */
+	public String[]
+	Query_Ids()
+	{
+		String[]	ids = new String[2];
+		Statement	stmt = sql;
+
+		ScanQueryLog();
+
+		if (stmt != null)
 		{
-			db_metadata = conn.getMetaData();
+			try
+			{
+				java.lang.reflect.Method	get_query_id = stmt.getClass().getMethod("getQueryId");
+				Object		query_id = get_query_id.invoke(stmt);
+
+				if (query_id != null)
+					ids[0] = query_id.toString();
+			}
+			catch (Exception query_id_exception)
+			{
+				/* Only recent HiveStatements know their query ID */
+			}
+		}
 
-			result_set = db_metadata.getTables(null, schema , "%", null);
+		if (!JobIds.isEmpty())
+		{
+			StringBuilder	job_ids = new StringBuilder();
 
-			result_set_metadata = result_set.getMetaData();
-			NumberOfColumns = result_set_metadata.getColumnCount();
+			for (String job_id : JobIds)
+			{
+				if (job_ids.length() > 0)
+					job_ids.append(", ");
+				job_ids.append(job_id);
+			}
+			ids[1] = job_ids.toString();
+		}
+
+		return ids;
+	}
+
+/*
+ * ScanQueryLog
+ *		Reads the query log lines Hive produced since the last call and
+ *		picks progress messages and job IDs out of them. getQueryLog is
+ *		specific to HiveStatement, so it is looked up by reflection and
+ *		other drivers report nothing.
+ */
+	private void
+	ScanQueryLog()
+	{
+		Statement	stmt = sql;
 
-			Iterate = new String[100];
-			column_name = new String[200];
-			column_type = new String[200];
-			column_size = new int[200];
-			column_length = new int[200];
+		if (stmt == null)
+			return;
 
-			mylist = new ArrayList<String>();
-		 try
+		try
 		{
-			while (result_set.next())
+			java.lang.reflect.Method	get_query_log = stmt.getClass().getMethod("getQueryLog");
+			Object		log = get_query_log.invoke(stmt);
+
+			if (!(log instanceof List))
+				return;
+
+			for (Object line : (List<?>) log)
 			{
-					 String table_name = result_set.getString("TABLE_NAME");
+				String		text = String.valueOf(line);
+				Matcher		matcher = PROGRESS_PATTERN.matcher(text);
 
-				      result_set1 = db_metadata.getColumns(null,
-						  schema,
-						  table_name ,
-						  null);
+				if (matcher.find())
+					LatestProgress = matcher.group(1).trim();
 
-					result_set_metadata1 = result_set1.getMetaData();
-					NumberOfColumns = result_set_metadata1.getColumnCount();
+				matcher = JOB_ID_PATTERN.matcher(text);
+				while (matcher.find())
+					JobIds.add(matcher.group(1));
+			}
+		}
+		catch (Exception progress_exception)
+		{
+			/* Not a HiveStatement, or the log is not available */
+		}
+	}
 
-					while (result_set1.next())
-					{
-						column_name[total_col] =  result_set1.getString("COLUMN_NAME");
-						column_type[total_col] = result_set1.getString("TYPE_NAME");
-						column_size[total_col] = result_set1.getInt("COLUMN_SIZE");
-						column_length[total_col] = result_set1.getInt("CHAR_OCTET_LENGTH");
-
-					String field = column_type[total_col];
-
-					if (field.compareTo( "TINYINT") == 0)
-						column_type[total_col]	= "smallint";
-					else if (field.compareTo("INT") == 0)
-						column_type[total_col] = "int";
-					else if (field.compareTo("BIGINT") == 0)
-						column_type[total_col] = "bigint";
-					else if (field.compareTo("BOOLEAN") == 0)
-						column_type[total_col] = "boolean";
-					else if (field.compareTo("FLOAT") == 0)
-						column_type[total_col] = "float";
-					else if (field.compareTo("DOUBLE") == 0)
-						column_type[total_col] = "double precision";
-					else if (field.compareTo("STRING") == 0)
-						column_type[total_col] = "varchar";
-					else if (field.compareTo("BINARY") == 0)
-						column_type[total_col] = "bytea";
-					else if (field.compareTo("TIMESTAMP") == 0)
-						column_type[total_col] = "timestamp";
-					else if (field.compareTo("DECIMAL") == 0)
-						column_type[total_col] = "decimal";
-					else if (field.compareTo("DATE") == 0)
-						column_type[total_col] = "date";
-					else if (field.compareTo("CHAR") == 0)
-						column_type[total_col] = "char";
-					else if (field.compareTo("VARCHAR") == 0)
-                                                column_type[total_col] = "varchar";
-					else	/* We need to error out for unsupported data types */
-					{
-						System.out.println("Unsupported Hive Data Type "+ field);
-					}
+/*
+ * GetQueryExecutor
+ *		Creates the pool of query threads on first use. The threads are
+ *		daemons so that they never keep the JVM alive.
+ */
+	private static synchronized ExecutorService
+	GetQueryExecutor()
+	{
+		if (QueryExecutor == null)
+		{
+			QueryExecutor = Executors.newCachedThreadPool(new ThreadFactory()
+			{
+				public Thread newThread(Runnable runnable)
+				{
+					Thread	thread = new Thread(runnable, "hive_fdw query");
 
-					total_col++;
-					}
-					String stmt_str = "CREATE FOREIGN TABLE "+table_name+"(";
-					for(col = 0;col<total_col;col++)
-					{
-						if(column_type[col].compareTo("CHAR") == 0)
-						{
-						  stmt_str = stmt_str+column_name[col]+" "+column_type[col]+"("+column_size[col]+")";
-						}
-						else if(column_type[col].compareTo("VARCHAR") == 0)
-						{
-						  stmt_str = stmt_str+column_name[col]+" "+column_type[col]+"("+column_size[col]+")";
-						}
-						else
-						{
-						  stmt_str = stmt_str+column_name[col]+" "+column_type[col];
-						}
+					thread.setDaemon(true);
+					return thread;
+				}
+			});
+		}
+		return QueryExecutor;
+	}
 
-						 if( col == total_col-1 )
-						{
-						   stmt_str = stmt_str+")";
-						}
-						else
-						{
-						  stmt_str = stmt_str+",";
-						}
+/*
+ * SetCancelFlag
+ *		Registers the buffer the C code raises when PostgreSQL wants the
+ *		running query cancelled, be it a user cancel or statement_timeout.
+ */
+	public void
+	SetCancelFlag(ByteBuffer flag)
+	{
+		CancelFlag = flag;
+	}
 
-					}
-					stmt_str = stmt_str+" SERVER " + servername +  " OPTIONS (table '"+table_name+"',schema '"+schema+"');";
-					mylist.add(stmt_str);
-					String s = mylist.get(i);
-					System.out.println("STATEMENT "+s);
-					i++;
-					total_col = 0;
-			 }
-			int sz = mylist.size();
-			Iterate = new String[sz];
-			for (int j = 0; j < sz; j++)
+/*
+ * StartCancelWatcher
+ *		Starts the daemon thread that cancels statements on request. The
+ *		C thread is stuck inside executeQuery or a fetch while Hive works,
+ *		so the cancel has to be issued from another thread.
+ */
+	private static synchronized void
+	StartCancelWatcher()
+	{
+		if (CancelWatcher != null)
+			return;
+
+		CancelWatcher = new Thread(new Runnable()
+		{
+			public void run()
+			{
+				WatchForCancel();
+			}
+		}, "hive_fdw cancel watcher");
+		CancelWatcher.setDaemon(true);
+		CancelWatcher.start();
+	}
+
+/*
+ * WatchForCancel
+ *		Body of the cancel watcher thread.
+ */
+	private static void
+	WatchForCancel()
+	{
+		while (true)
+		{
+			try
 			{
-				Iterate[j] = mylist.get(j);
+				Thread.sleep(CANCEL_POLL_MS);
 			}
-			NumberOfRows = sz;
+			catch (InterruptedException watcher_exception)
+			{
+				return;
+			}
+
+			long	now = System.currentTimeMillis();
+
+			for (HiveJDBCUtils query : ActiveQueries)
+				query.CheckCancel(now);
 		}
-		catch (Exception returnresultset_exception)
+	}
+
+/*
+ * CheckCancel
+ *		Cancels the running statement if PostgreSQL asked for it or the
+ *		query ran past its querytimeout.
+ */
+	private void
+	CheckCancel(long now)
+	{
+		Statement	stmt = sql;
+		boolean		requested;
+		long		deadline = QueryDeadline;
+
+		if (stmt == null || CancelSent)
+			return;
+
+		requested = (CancelFlag != null && CancelFlag.getInt(0) != 0);
+		if (deadline > 0 && now > deadline)
+			TimedOut = true;
+		else if (!requested)
+			return;
+
+		CancelSent = true;
+		try
 		{
-			returnresultset_exception.printStackTrace();
+			stmt.cancel();
 		}
+		catch (Exception cancel_exception)
+		{
+			/* Reported with the query's own error, not on the JVM's
+			 * stderr, which ends up in the server log */
+			StringWriter	writer = new StringWriter();
 
+			writer.write("cancelling the Hive query failed: ");
+			cancel_exception.printStackTrace(new PrintWriter(writer));
+			CancelFailure = writer.toString();
+		}
 	}
-	catch (Exception initialize_exception)
+
+/*
+ * FetchBatch
+ *		Encodes up to BATCH_ROWS rows of the result set into BatchBuffer,
+ *		a direct buffer the C code reads in place. The layout, in native
+ *		byte order, is an int row count, an int column count and the
+ *		ColumnKinds byte of every column, padded to a multiple of four
+ *		bytes. Then, for every column of every row, an int length (-1 for
+ *		NULL) and that many bytes of cell data, as written by EncodeRow.
+ *		The number of bytes used is left in BatchLength; a batch with no
+ *		rows marks the end of the result set.
+ */
+	public String
+	FetchBatch() throws IOException
+	{
+		int	rows = 0;
+
+		exception_stack_trace_string_writer = new StringWriter();
+		exception_stack_trace_print_writer = new PrintWriter(exception_stack_trace_string_writer);
+
+		try
+		{
+			if (BatchBuffer == null)
+			{
+				BatchBuffer = ByteBuffer.allocateDirect(BATCH_BUFFER_SIZE);
+				BatchBuffer.order(ByteOrder.nativeOrder());
+			}
+			if (RowBuffer == null)
+			{
+				RowBuffer = ByteBuffer.allocate(ROW_BUFFER_SIZE);
+				RowBuffer.order(ByteOrder.nativeOrder());
+			}
+
+			BatchBuffer.clear();
+			PutBatchHeader();
+
+			while (rows < BATCH_ROWS)
+			{
+				if (!RowPending)
+				{
+					if (result_set == null || !result_set.next())
+						break;
+					EncodeRow();
+				}
+				RowPending = false;
+
+				if (RowBuffer.position() > BatchBuffer.remaining())
+				{
+					if (rows > 0)
+					{
+						/* Ship what we have, this row opens the next batch. */
+						RowPending = true;
+						break;
+					}
+					GrowBatchBuffer(RowBuffer.position() + BatchBuffer.position());
+				}
+
+				RowBuffer.flip();
+				BatchBuffer.put(RowBuffer);
+				RowBuffer.clear();
+
+				++rows;
+				++NumberOfRows;
+			}
+
+			BatchBuffer.putInt(0, rows);
+			BatchLength = BatchBuffer.position();
+		}
+		catch (Exception fetchbatch_exception)
 		{
 			/* If an exception occurs,it is returned back to the
 			 * calling C code by returning a Java String object
 			 * that has the exception's stack trace.
 			 * If all goes well,a null String is returned. */
 
-			initialize_exception.printStackTrace(exception_stack_trace_print_writer);
+			fetchbatch_exception.printStackTrace(exception_stack_trace_print_writer);
 			return (new String(exception_stack_trace_string_writer.toString()));
 		}
+		return null;
+	}
 
-	return null;
-}
+/*
+ * PutBatchHeader
+ *		Writes the row count placeholder, the column count and the column
+ *		kinds at the start of BatchBuffer.
+ */
+	private void
+	PutBatchHeader()
+	{
+		BatchBuffer.putInt(0);
+		BatchBuffer.putInt(NumberOfColumns);
+		BatchBuffer.put(ColumnKinds);
+		while (BatchBuffer.position() % 4 != 0)
+			BatchBuffer.put((byte) 0);
+	}
 
-/*  Retruns the foreign table DDL statements string array
- *
+/*
+ * CellKind
+ *		Picks how the values of a result set column are shipped to C.
+ *		Hive reports its 4-byte float as FLOAT, which JDBC otherwise uses
+ *		for doubles, so the type name decides between the two.
  */
+	private static byte
+	CellKind(ResultSetMetaData metadata, int column) throws SQLException
+	{
+		switch (metadata.getColumnType(column))
+		{
+			case Types.TINYINT:
+			case Types.SMALLINT:
+			case Types.INTEGER:
+				return CELL_INT4;
+			case Types.BIGINT:
+				return CELL_INT8;
+			case Types.REAL:
+				return CELL_FLOAT4;
+			case Types.FLOAT:
+				if ("float".equalsIgnoreCase(metadata.getColumnTypeName(column)))
+					return CELL_FLOAT4;
+				return CELL_FLOAT8;
+			case Types.DOUBLE:
+				return CELL_FLOAT8;
+			case Types.BOOLEAN:
+			case Types.BIT:
+				return CELL_BOOL;
+			case Types.DATE:
+				return CELL_DATE;
+			case Types.TIMESTAMP:
+				return CELL_TIMESTAMP;
+			case Types.DECIMAL:
+			case Types.NUMERIC:
+				return CELL_DECIMAL;
+			case Types.BINARY:
+			case Types.VARBINARY:
+			case Types.LONGVARBINARY:
+				return CELL_BYTES;
+			case Types.ARRAY:
+			case Types.STRUCT:
+				return CELL_JSON;
+			default:
+				/* Hive reports MAP columns as JAVA_OBJECT or OTHER */
+				if (IsComplexHiveType(metadata.getColumnTypeName(column)))
+					return CELL_JSON;
+				return CELL_TEXT;
+		}
+	}
 
+/*
+ * EncodeRow
+ *		Encodes the current row of the result set into RowBuffer, using
+ *		the typed getter that matches the kind of every column.
+ */
+	private void
+	EncodeRow() throws SQLException
+	{
+		for (int i = 0; i < NumberOfColumns; i++)
+		{
+			int		column = i + 1;
+
+			/* Room for the largest binary cell, a decimal */
+			EnsureRowBuffer(4 + 12);
+
+			switch (ColumnKinds[i])
+			{
+				case CELL_INT4:
+					{
+						int		value = result_set.getInt(column);
+
+						if (result_set.wasNull())
+							RowBuffer.putInt(-1);
+						else
+							RowBuffer.putInt(4).putInt(value);
+					}
+					break;
+				case CELL_INT8:
+					{
+						long	value = result_set.getLong(column);
+
+						if (result_set.wasNull())
+							RowBuffer.putInt(-1);
+						else
+							RowBuffer.putInt(8).putLong(value);
+					}
+					break;
+				case CELL_FLOAT4:
+					{
+						float	value = result_set.getFloat(column);
+
+						if (result_set.wasNull())
+							RowBuffer.putInt(-1);
+						else
+							RowBuffer.putInt(4).putFloat(value);
+					}
+					break;
+				case CELL_FLOAT8:
+					{
+						double	value = result_set.getDouble(column);
+
+						if (result_set.wasNull())
+							RowBuffer.putInt(-1);
+						else
+							RowBuffer.putInt(8).putDouble(value);
+					}
+					break;
+				case CELL_BOOL:
+					{
+						boolean	value = result_set.getBoolean(column);
+
+						if (result_set.wasNull())
+							RowBuffer.putInt(-1);
+						else
+							RowBuffer.putInt(1).put((byte) (value ? 1 : 0));
+					}
+					break;
+				case CELL_DATE:
+					{
+						java.sql.Date	value = result_set.getDate(column);
+
+						if (value == null)
+							RowBuffer.putInt(-1);
+						else
+							RowBuffer.putInt(4).putInt((int) value.toLocalDate().toEpochDay());
+					}
+					break;
+				case CELL_TIMESTAMP:
+					{
+						Timestamp	value = result_set.getTimestamp(column);
+
+						if (value == null)
+							RowBuffer.putInt(-1);
+						else
+							RowBuffer.putInt(8).putLong(EpochMicros(value));
+					}
+					break;
+				case CELL_DECIMAL:
+					{
+						BigDecimal	value = result_set.getBigDecimal(column);
+
+						if (value == null)
+							RowBuffer.putInt(-1);
+						else
+						{
+							if (value.scale() < 0)
+								value = value.setScale(0);
+
+							if (value.unscaledValue().bitLength() < 64)
+								RowBuffer.putInt(12).putInt(value.scale())
+									.putLong(value.unscaledValue().longValue());
+							else
+							{
+								byte[]	bytes = value.toPlainString().getBytes(StandardCharsets.US_ASCII);
+
+								EnsureRowBuffer(4 + bytes.length);
+								RowBuffer.putInt(bytes.length).put(bytes);
+							}
+						}
+					}
+					break;
+				case CELL_BYTES:
+					{
+						byte[]	value = result_set.getBytes(column);
+
+						if (value == null)
+							RowBuffer.putInt(-1);
+						else
+						{
+							EnsureRowBuffer(4 + value.length);
+							RowBuffer.putInt(value.length).put(value);
+						}
+					}
+					break;
+				case CELL_JSON:
+					{
+						String	value = result_set.getString(column);
+
+						if (value == null)
+							RowBuffer.putInt(-1);
+						else
+							EncodeText(QuoteJsonKeys(value));
+					}
+					break;
+				default:
+					{
+						String	value = result_set.getString(column);
+
+						if (value == null)
+							RowBuffer.putInt(-1);
+						else
+							EncodeText(value);
+					}
+					break;
+			}
+		}
+	}
+
+/*
+ * EncodeText
+ *		Writes a length-prefixed string to RowBuffer as UTF-8, encoding it
+ *		straight into the buffer instead of going through a byte[].
+ */
+	private void
+	EncodeText(String value)
+	{
+		CharBuffer	chars = CharBuffer.wrap(value);
+		int			start;
 
-public String[]
+		if (TextEncoder == null)
+			TextEncoder = StandardCharsets.UTF_8.newEncoder()
+				.onMalformedInput(CodingErrorAction.REPLACE)
+				.onUnmappableCharacter(CodingErrorAction.REPLACE);
+
+		/* Enough for ASCII; anything longer grows the buffer as it goes */
+		EnsureRowBuffer(4 + value.length());
+		start = RowBuffer.position();
+		RowBuffer.putInt(0);
+
+		TextEncoder.reset();
+		while (TextEncoder.encode(chars, RowBuffer, true).isOverflow())
+			EnsureRowBuffer(RowBuffer.capacity());
+		while (TextEncoder.flush(RowBuffer).isOverflow())
+			EnsureRowBuffer(RowBuffer.capacity());
+
+		RowBuffer.putInt(start, RowBuffer.position() - start - 4);
+	}
+
+/*
+ * HiveTypeToPg
+ *		PostgreSQL type for a column of the given Hive type. ARRAYs of
+ *		primitives become arrays, other complex types jsonb, and types
+ *		without an equivalent text.
+ */
+	private static String
+	HiveTypeToPg(String hive_type)
+	{
+		String	field = hive_type.trim().toUpperCase();
+		int		bracket = field.indexOf('<');
+
+		if (IsComplexHiveType(field))
+		{
+			String	element;
+
+			if (!field.startsWith("ARRAY") || bracket < 0 || !field.endsWith(">"))
+				return "jsonb";
+
+			element = field.substring(bracket + 1, field.length() - 1).trim();
+			if (IsComplexHiveType(element))
+				return "jsonb";
+			return HiveTypeToPg(element) + "[]";
+		}
+
+		/* The parameters of decimal(10,2), varchar(20) and the like */
+		if (field.indexOf('(') >= 0)
+			field = field.substring(0, field.indexOf('(')).trim();
+
+		if (field.compareTo("TINYINT") == 0 || field.compareTo("SMALLINT") == 0)
+			return "smallint";
+		else if (field.compareTo("INT") == 0)
+			return "int";
+		else if (field.compareTo("BIGINT") == 0)
+			return "bigint";
+		else if (field.compareTo("BOOLEAN") == 0)
+			return "boolean";
+		else if (field.compareTo("FLOAT") == 0)
+			return "float";
+		else if (field.compareTo("DOUBLE") == 0)
+			return "double precision";
+		else if (field.compareTo("STRING") == 0)
+			return "varchar";
+		else if (field.compareTo("BINARY") == 0)
+			return "bytea";
+		else if (field.compareTo("TIMESTAMP") == 0)
+			return "timestamp";
+		else if (field.compareTo("DECIMAL") == 0)
+			return "decimal";
+		else if (field.compareTo("DATE") == 0)
+			return "date";
+		else if (field.compareTo("CHAR") == 0)
+			return "char";
+		else if (field.compareTo("VARCHAR") == 0)
+			return "varchar";
+
+		/* Anything else can at least be read as text */
+		return "text";
+	}
+
+/*
+ * IsComplexHiveType
+ *		True for ARRAY, MAP, STRUCT and UNIONTYPE type names, with or
+ *		without their parameters.
+ */
+	private static boolean
+	IsComplexHiveType(String type_name)
+	{
+		String	head;
+
+		if (type_name == null)
+			return false;
+
+		head = type_name.trim().toLowerCase();
+		if (head.indexOf('<') >= 0)
+			head = head.substring(0, head.indexOf('<')).trim();
+
+		return (head.equals("array") || head.equals("map") ||
+				head.equals("struct") || head.equals("uniontype"));
+	}
+
+/*
+ * QuoteJsonKeys
+ *		Hive prints maps with numeric or boolean keys as {1:"a"}, which
+ *		is not JSON. Puts quotes around such keys and leaves everything
+ *		else alone.
+ */
+	private static String
+	QuoteJsonKeys(String json)
+	{
+		StringBuilder	result = null;
+		char[]		open = new char[json.length()];
+		int			depth = 0;
+		boolean		in_string = false;
+		boolean		expect_key = false;
+
+		if (json.indexOf('{') < 0)
+			return json;
+
+		for (int i = 0; i < json.length(); i++)
+		{
+			char	c = json.charAt(i);
+
+			if (in_string)
+			{
+				if (c == '\\' && i + 1 < json.length())
+				{
+					if (result != null)
+						result.append(c);
+					c = json.charAt(++i);
+				}
+				else if (c == '"')
+					in_string = false;
+			}
+			else if (c == '"')
+			{
+				in_string = true;
+				expect_key = false;
+			}
+			else if (c == '{' || c == '[')
+			{
+				open[depth++] = c;
+				expect_key = (c == '{');
+			}
+			else if (c == '}' || c == ']')
+			{
+				depth--;
+				expect_key = false;
+			}
+			else if (c == ',')
+				expect_key = (depth > 0 && open[depth - 1] == '{');
+			else if (expect_key && !Character.isWhitespace(c))
+			{
+				int		end = json.indexOf(':', i);
+
+				if (end < 0)
+					return json;
+				if (result == null)
+					result = new StringBuilder(json.length() + 16).append(json, 0, i);
+				result.append('"').append(json.substring(i, end).trim()).append('"');
+				i = end - 1;
+				expect_key = false;
+				continue;
+			}
+
+			if (result != null)
+				result.append(c);
+		}
+
+		return (result == null ? json : result.toString());
+	}
+
+/*
+ * EpochMicros
+ *		Microseconds between 1970-01-01 00:00 and the wall-clock time of
+ *		a timestamp. Hive timestamps carry no time zone, so the JVM's
+ *		default zone must not shift them.
+ */
+	private static long
+	EpochMicros(Timestamp value)
+	{
+		LocalDateTime	local = value.toLocalDateTime();
+
+		return (local.toEpochSecond(ZoneOffset.UTC) * 1000000L + local.getNano() / 1000);
+	}
+
+/*
+ * EnsureRowBuffer
+ *		Makes room for "needed" more bytes in RowBuffer.
+ */
+	private void
+	EnsureRowBuffer(int needed)
+	{
+		ByteBuffer	larger;
+		int			size = RowBuffer.capacity();
+
+		if (RowBuffer.remaining() >= needed)
+			return;
+
+		while (size - RowBuffer.position() < needed)
+			size *= 2;
+
+		larger = ByteBuffer.allocate(size);
+		larger.order(ByteOrder.nativeOrder());
+		RowBuffer.flip();
+		larger.put(RowBuffer);
+		RowBuffer = larger;
+	}
+
+/*
+ * GrowBatchBuffer
+ *		Replaces BatchBuffer with a larger one when a single row does not
+ *		fit in it.
+ */
+	private void
+	GrowBatchBuffer(int needed)
+	{
+		int	size = BatchBuffer.capacity();
+
+		while (size < needed)
+			size *= 2;
+
+		BatchBuffer = ByteBuffer.allocateDirect(size);
+		BatchBuffer.order(ByteOrder.nativeOrder());
+		PutBatchHeader();
+	}
+
+/*
+ * Release
+ *		Releases the result set and statement of the last query but keeps
+ *		the connection open so that it can be reused by another query.
+ */
+	public String
+	Release()
+	{
+		exception_stack_trace_string_writer = new StringWriter();
+		exception_stack_trace_print_writer = new PrintWriter(exception_stack_trace_string_writer);
+
+		ActiveQueries.remove(this);
+
+		try
+		{
+			if (result_set != null)
+				result_set.close();
+			if (sql != null)
+				sql.close();
+			result_set = null;
+			sql = null;
+			RowPending = false;
+			NumberOfRows = 0;
+		}
+		catch (Exception release_exception)
+		{
+			/* If an exception occurs,it is returned back to the
+			 * calling C code by returning a Java String object
+			 * that has the exception's stack trace.
+			 * If all goes well,a null String is returned. */
+
+			release_exception.printStackTrace(exception_stack_trace_print_writer);
+			return (new String(exception_stack_trace_string_writer.toString()));
+		}
+		return null;
+	}
+
+/*
+ * Is_Valid
+ *		Returns true if the connection is still usable. Used before a
+ *		pooled connection is handed out for another query.
+ */
+	public boolean
+	Is_Valid()
+	{
+		try
+		{
+			return (conn != null && !conn.isClosed() && conn.isValid(5));
+		}
+		catch (Exception valid_exception)
+		{
+			/* Drivers without isValid are trusted as they are */
+			return (conn != null);
+		}
+	}
+
+/*
+ * Close
+ *		Releases the resources used.
+ */
+	public String
+	Close()
+	{
+
+		ActiveQueries.remove(this);
+
+		try
+		{
+			if (result_set != null)
+				result_set.close();
+			conn.close();
+			result_set = null;
+			conn = null;
+			Iterate = null;
+			RowPending = false;
+		}
+		catch (Exception close_exception)
+		{
+			/* If an exception occurs,it is returned back to the
+			 * calling C code by returning a Java String object
+			 * that has the exception's stack trace.
+			 * If all goes well,a null String is returned. */
+
+			close_exception.printStackTrace(exception_stack_trace_print_writer);
+			return (new String(exception_stack_trace_string_writer.toString()));
+		}
+
+		return null;
+	}
+
+/*
+ * Cancel
+ *		Cancels the query and releases the resources in case query
+ *		cancellation is requested by the user.
+ */
+	public String
+	Cancel()
+	{
+		Statement	stmt = sql;
+
+		ActiveQueries.remove(this);
+
+		try
+		{
+			/* Stop the remote job before letting go of the connection */
+			if (stmt != null && !CancelSent)
+				stmt.cancel();
+			if (result_set != null)
+				result_set.close();
+			conn.close();
+		}
+		catch(Exception cancel_exception)
+		{
+			/* If an exception occurs,it is returned back to the
+			 * calling C code by returning a Java String object
+			 * that has the exception's stack trace.
+			 * If all goes well,a null String is returned. */
+
+			cancel_exception.printStackTrace(exception_stack_trace_print_writer);
+			return (new String(exception_stack_trace_string_writer.toString()));
+		}
+
+		return null;
+	}
+/*
+ **   Collects the columns of the tables of the source schema for
+ **   IMPORT FOREIGN SCHEMA, which builds the CREATE FOREIGN TABLE
+ **   statements from them. list_type is one of the IMPORT_* constants,
+ **   and table_list holds the tables of LIMIT TO or EXCEPT. With a
+ **   parallelism above one the tables are looked up one by one on that
+ **   many connections at once. With import_partitions the partitions
+ **   of every table are listed as well, see ReturnPartitionList.
+**/
+	public String
+	    PrepareDDLStmtList(String schema, String servername, int list_type,
+			       String[] table_list, int parallelism,
+			       boolean import_partitions) throws IOException
+	{
+		DatabaseMetaData	db_metadata;
+
+		exception_stack_trace_string_writer = new StringWriter();
+		exception_stack_trace_print_writer = new PrintWriter(exception_stack_trace_string_writer);
+
+		NumberOfColumns = 0;
+		NumberOfRows = 0;
+		ImportedTables = null;
+		ImportedPartitions = null;
+
+		try
+		{
+			db_metadata = conn.getMetaData();
+
+			if (parallelism > 1)
+				ImportedTables = FetchTablesInParallel(db_metadata, schema,
+								       list_type, table_list,
+								       parallelism);
+			else
+				ImportedTables = FetchTables(db_metadata, schema,
+							     list_type, table_list);
+			NumberOfRows = ImportedTables.length;
+
+			if (import_partitions)
+			{
+				ImportedPartitions = new String[ImportedTables.length][];
+				for (int k = 0; k < ImportedTables.length; k++)
+					ImportedPartitions[k] = FetchPartitionValues(ImportedTables[k][0]);
+			}
+		}
+		catch (Exception initialize_exception)
+		{
+			/* If an exception occurs,it is returned back to the
+			 * calling C code by returning a Java String object
+			 * that has the exception's stack trace.
+			 * If all goes well,a null String is returned. */
+
+			initialize_exception.printStackTrace(exception_stack_trace_print_writer);
+			return (new String(exception_stack_trace_string_writer.toString()));
+		}
+
+		return null;
+	}
+
+/*
+ * FetchTables
+ *		Collect the columns of the imported tables on our connection.
+ *		LIMIT TO only asks the metastore about the named tables.
+ *		Otherwise the columns of the whole schema come from one
+ *		getColumns call, which returns them ordered by table, rather
+ *		than from one call for every table.
+ */
+	private String[][]
+	FetchTables(DatabaseMetaData db_metadata, String schema, int list_type,
+		    String[] table_list) throws SQLException
+	{
+		ArrayList<String[]>	tables = new ArrayList<String[]>();
+		ArrayList<String>	columns = new ArrayList<String>();
+		String[]		patterns;
+
+		if (list_type == IMPORT_LIMIT_TO)
+			patterns = table_list;
+		else
+			patterns = new String[] { "%" };
+
+		for (String pattern : patterns)
+		{
+			String table_name = null;
+			boolean more;
+
+			result_set1 = db_metadata.getColumns(null, schema, pattern, "%");
+			NumberOfColumns = result_set1.getMetaData().getColumnCount();
+
+			do
+			{
+				String next_table = null;
+
+				more = result_set1.next();
+				if (more)
+					next_table = result_set1.getString("TABLE_NAME");
+
+				/* The previous table is complete */
+				if (table_name != null && !table_name.equals(next_table))
+				{
+					if (columns.size() > 0)
+						tables.add(columns.toArray(new String[columns.size()]));
+					columns.clear();
+				}
+
+				if (!more)
+					break;
+				table_name = next_table;
+
+				/* Excluded tables are skipped without looking at their columns */
+				if (!IsImportedTable(table_name, list_type, table_list))
+					continue;
+
+				if (columns.size() == 0)
+					columns.add(table_name);
+				AddImportedColumn(columns,
+						  result_set1.getString("COLUMN_NAME"),
+						  result_set1.getString("TYPE_NAME"),
+						  result_set1.getInt("COLUMN_SIZE"));
+			} while (more);
+
+			result_set1.close();
+			result_set1 = null;
+		}
+
+		return tables.toArray(new String[tables.size()][]);
+	}
+
+/*
+ * FetchTablesInParallel
+ *		Look up the columns of every imported table with a getColumns
+ *		call of its own, spread over parallelism threads that each have
+ *		a connection; the first thread uses ours. The result is in the
+ *		order of the table list whatever order the calls finish in.
+ */
+	private String[][]
+	FetchTablesInParallel(DatabaseMetaData db_metadata, final String schema,
+			      int list_type, String[] table_list,
+			      int parallelism) throws Exception
+	{
+		final ArrayList<String> names = new ArrayList<String>();
+		final String[][]	results;
+		final AtomicInteger	next = new AtomicInteger(0);
+		ArrayList<Connection>	connections = new ArrayList<Connection>();
+		ArrayList<Future<Void>>	workers = new ArrayList<Future<Void>>();
+		ArrayList<String[]>	tables = new ArrayList<String[]>();
+		ExecutorService		pool;
+
+		if (list_type == IMPORT_LIMIT_TO)
+			names.addAll(Arrays.asList(table_list));
+		else
+		{
+			ResultSet	table_set = db_metadata.getTables(null, schema, "%", null);
+
+			while (table_set.next())
+			{
+				String	table_name = table_set.getString("TABLE_NAME");
+
+				if (IsImportedTable(table_name, list_type, table_list))
+					names.add(table_name);
+			}
+			table_set.close();
+		}
+
+		results = new String[names.size()][];
+		parallelism = Math.min(parallelism, Math.max(names.size(), 1));
+
+		pool = Executors.newFixedThreadPool(parallelism, new ThreadFactory()
+		{
+			public Thread newThread(Runnable runnable)
+			{
+				Thread	thread = new Thread(runnable, "hive_fdw import");
+
+				thread.setDaemon(true);
+				return thread;
+			}
+		});
+
+		try
+		{
+			connections.add(conn);
+			for (int k = 1; k < parallelism; k++)
+				connections.add(ConnDriver.connect(ConnUrl, ConnProperties));
+
+			for (final Connection worker_conn : connections)
+			{
+				workers.add(pool.submit(new Callable<Void>()
+				{
+					public Void call() throws Exception
+					{
+						DatabaseMetaData	md = worker_conn.getMetaData();
+						int			k;
+
+						while ((k = next.getAndIncrement()) < names.size())
+							results[k] = FetchTableColumns(md, schema, names.get(k));
+						return null;
+					}
+				}));
+			}
+
+			/* Rethrows the first failure */
+			for (Future<Void> worker : workers)
+			{
+				try
+				{
+					worker.get();
+				}
+				catch (ExecutionException execution_exception)
+				{
+					if (execution_exception.getCause() instanceof Exception)
+						throw (Exception) execution_exception.getCause();
+					throw execution_exception;
+				}
+			}
+		}
+		finally
+		{
+			/* Stop the other workers early if one failed */
+			next.set(names.size());
+			pool.shutdownNow();
+			for (int k = 1; k < connections.size(); k++)
+			{
+				try
+				{
+					connections.get(k).close();
+				}
+				catch (SQLException close_exception)
+				{
+				}
+			}
+		}
+
+		for (String[] table : results)
+		{
+			if (table != null)
+				tables.add(table);
+		}
+		return tables.toArray(new String[tables.size()][]);
+	}
+
+/*
+ * FetchTableColumns
+ *		Entry of one table for ReturnDDLStmtList, or null if it has no
+ *		columns, that is, if it does not exist
+ */
+	private static String[]
+	FetchTableColumns(DatabaseMetaData md, String schema,
+			  String table_name) throws SQLException
+	{
+		ArrayList<String>	columns = new ArrayList<String>();
+		ResultSet		column_set = md.getColumns(null, schema, table_name, "%");
+
+		try
+		{
+			while (column_set.next())
+			{
+				String	name = column_set.getString("TABLE_NAME");
+
+				/* The name is a pattern, in which _ matches any character */
+				if (!name.equalsIgnoreCase(table_name))
+					continue;
+
+				if (columns.size() == 0)
+					columns.add(name);
+				AddImportedColumn(columns,
+						  column_set.getString("COLUMN_NAME"),
+						  column_set.getString("TYPE_NAME"),
+						  column_set.getInt("COLUMN_SIZE"));
+			}
+		}
+		finally
+		{
+			column_set.close();
+		}
+
+		return (columns.size() > 0) ? columns.toArray(new String[columns.size()]) : null;
+	}
+
+/*
+ * FetchPartitionValues
+ *		The first partition key of a Hive table followed by its distinct
+ *		values, in the order SHOW PARTITIONS lists them, with null for
+ *		the default partition. null if the table is not partitioned.
+ */
+	private String[]
+	FetchPartitionValues(String table_name) throws SQLException
+	{
+		Statement		stmt = conn.createStatement();
+		String			quoted = "`" + table_name.replace("`", "``") + "`";
+		LinkedHashSet<String>	values = new LinkedHashSet<String>();
+		ArrayList<String>	entry = new ArrayList<String>();
+		String			key = null;
+		ResultSet		rs;
+
+		try
+		{
+			/* Partition keys follow "# Partition Information" and a
+			 * header line in the output of DESCRIBE */
+			rs = stmt.executeQuery("DESCRIBE " + quoted);
+			boolean		in_partition_info = false;
+
+			while (rs.next())
+			{
+				String	col_name = rs.getString(1);
+
+				if (col_name == null)
+					continue;
+				col_name = col_name.trim();
+				if (col_name.startsWith("# Partition Information"))
+					in_partition_info = true;
+				else if (in_partition_info && col_name.length() > 0 &&
+					 !col_name.startsWith("#"))
+				{
+					key = col_name;
+					break;
+				}
+			}
+			rs.close();
+
+			if (key == null)
+				return null;
+
+			/* Lines like year=2019/month=12, with escaped values */
+			rs = stmt.executeQuery("SHOW PARTITIONS " + quoted);
+			while (rs.next())
+			{
+				String	spec = rs.getString(1);
+				String	first = spec.split("/", 2)[0];
+				String	value = UnescapePartitionValue(first.substring(first.indexOf('=') + 1));
+
+				if (value.equals("__HIVE_DEFAULT_PARTITION__"))
+					value = null;
+				values.add(value);
+			}
+			rs.close();
+		}
+		finally
+		{
+			stmt.close();
+		}
+
+		entry.add(key);
+		entry.addAll(values);
+		return entry.toArray(new String[entry.size()]);
+	}
+
+/*
+ * UnescapePartitionValue
+ *		Undo the %XX escapes Hive applies to partition values in paths
+ */
+	private static String
+	UnescapePartitionValue(String value)
+	{
+		StringBuilder	result = new StringBuilder(value.length());
+
+		for (int k = 0; k < value.length(); k++)
+		{
+			char	c = value.charAt(k);
+
+			if (c == '%' && k + 2 < value.length())
+			{
+				try
+				{
+					result.append((char) Integer.parseInt(value.substring(k + 1, k + 3), 16));
+					k += 2;
+					continue;
+				}
+				catch (NumberFormatException format_exception)
+				{
+				}
+			}
+			result.append(c);
+		}
+
+		return result.toString();
+	}
+
+/*
+ * AddImportedColumn
+ *		Append the name, PostgreSQL type and, for ARRAY, MAP and STRUCT
+ *		columns, the Hive type of a column to the entry of its table
+ */
+	private static void
+	AddImportedColumn(ArrayList<String> columns, String column_name,
+			  String hive_type, int column_size)
+	{
+		String		pg_type = HiveTypeToPg(hive_type);
+		String		head = hive_type.trim().toUpperCase();
+
+		/* STRING maps to varchar too, but without a length */
+		if ((head.startsWith("CHAR") || head.startsWith("VARCHAR")) && column_size > 0)
+			pg_type = new StringBuilder(pg_type).append('(')
+				.append(column_size).append(')').toString();
+
+		columns.add(column_name);
+		columns.add(pg_type);
+		if (IsComplexHiveType(hive_type) && hive_type.indexOf('<') >= 0)
+			columns.add(hive_type.toLowerCase());
+		else
+			columns.add(null);
+	}
+
+/*
+ * IsImportedTable
+ *		Whether LIMIT TO or EXCEPT let a table through. Hive names are
+ *		case-insensitive; PostgreSQL checks the exact names again.
+ */
+	private static boolean
+	IsImportedTable(String table_name, int list_type, String[] table_list)
+	{
+		if (list_type == IMPORT_ALL)
+			return true;
+
+		for (String name : table_list)
+		{
+			if (name.equalsIgnoreCase(table_name))
+				return (list_type == IMPORT_LIMIT_TO);
+		}
+
+		return (list_type == IMPORT_EXCEPT);
+	}
+
+/*
+ * ReturnDDLStmtList
+ *		Tables collected by PrepareDDLStmtList: for every table its name,
+ *		then the name, PostgreSQL type and Hive type (null unless ARRAY,
+ *		MAP or STRUCT) of each of its columns
+ */
+	public String[][]
 	ReturnDDLStmtList()
 	{
-		int i=0;
-		return Iterate;
+		return ImportedTables;
+	}
+
+/*
+ * ReturnPartitionList
+ *		For every table of ReturnDDLStmtList, the result of
+ *		FetchPartitionValues, or null without import_partitions
+ */
+	public String[][]
+	ReturnPartitionList()
+	{
+		return ImportedPartitions;
 	}
 }
@@ -0,0 +1,881 @@
+/*-------------------------------------------------------------------------
+ *
+ *		  mock JDBC driver for benchmarking hive_fdw
+ *
+ * MockHiveDriver answers every query from memory with synthetic rows, so
+ * that the JNI path of hive_fdw can be measured without a Hive cluster.
+ * The shape of a result set is taken from the query:
+ *
+ *   - The first table in the FROM clause is named like
+ *     rows<N>[_width<W>][_mix_<types>], for example
+ *     rows1000000_width16_mix_i2l1s4. N is the number of rows and W the
+ *     length of string values (default 16).
+ *   - For SELECT *, the columns follow <types>: a type letter with an
+ *     optional repeat count. The letters are i (int), l (bigint),
+ *     d (double), n (decimal(18,2)), s (string), b (boolean),
+ *     t (timestamp) and a (date). The default is a single string.
+ *   - For an explicit select list, as sent for pushed-down joins, the
+ *     type of a column is the type letter its name starts with, so name
+ *     the columns of join benchmark tables i1, s2 and so on.
+ *   - A table name with _edge, after the types, makes dates, timestamps
+ *     and decimals cycle through the values of EDGE_DATES,
+ *     EDGE_TIMESTAMPS and EDGE_DECIMALS: dates before 1970 and 2000,
+ *     negative decimals, decimals with more scale than digits and ones
+ *     too wide for a long.
+ *   - A table name with _delay<M> makes executeQuery take M ms, which
+ *     stands in for Hive compiling and scheduling the query.
+ *   - INSERT and LOAD DATA statements are accepted and their rows
+ *     discarded. A _delay<M> in the target table name delays every
+ *     statement, which stands in for the job Hive runs for each INSERT.
+ *   - TRUNCATE TABLE is accepted, except for tables whose name contains
+ *     _fail, which the regression tests use to see whether it was sent.
+ *   - DESCRIBE [FORMATTED] <table> lists the columns of a _mix_<types> in the table
+ *     name, named like the columns of IMPORT FOREIGN SCHEMA: i1, s2 and
+ *     so on.
+ *
+ * For IMPORT FOREIGN SCHEMA the remote schema is named like
+ * tables<T>[_cols<C>][_rows<N>][_width<W>][_mix_<types>], and holds T
+ * tables of C columns each whose names follow the same conventions.
+ *
+ * Connection, Statement and ResultSet objects are dynamic proxies, so
+ * that the driver does not depend on the java.sql interfaces of a
+ * particular JDK.
+ *
+ * IDENTIFICATION
+ *		  hive_fdw/bench/MockHiveDriver.java
+ *
+ *-------------------------------------------------------------------------
+ */
+
+import java.lang.reflect.*;
+import java.math.BigDecimal;
+import java.sql.*;
+import java.util.*;
+import java.util.logging.Logger;
+import java.util.regex.Matcher;
+import java.util.regex.Pattern;
+
+
+public class MockHiveDriver implements Driver
+{
+	/* 2020-01-01 00:00:00 UTC, the first timestamp handed out */
+	private static final long BASE_MILLIS = 1577836800000L;
+
+	/*
+	 * Values of _edge tables. Dates and timestamps are given in local
+	 * time, which is what hive_fdw reads back from them.
+	 */
+	private static final java.sql.Date[] EDGE_DATES = {
+		java.sql.Date.valueOf("1969-12-31"),
+		java.sql.Date.valueOf("1970-01-01"),
+		java.sql.Date.valueOf("1999-12-31"),
+		java.sql.Date.valueOf("2000-01-01"),
+		java.sql.Date.valueOf("1600-02-29"),
+		java.sql.Date.valueOf("2038-01-19")
+	};
+	private static final Timestamp[] EDGE_TIMESTAMPS = {
+		Timestamp.valueOf("1969-12-31 23:59:59.999999"),
+		Timestamp.valueOf("1970-01-01 00:00:00"),
+		Timestamp.valueOf("1999-12-31 23:59:59.5"),
+		Timestamp.valueOf("2000-01-01 00:00:00.000001"),
+		Timestamp.valueOf("1600-02-29 12:00:00"),
+		Timestamp.valueOf("1901-12-13 20:45:52")
+	};
+	private static final BigDecimal[] EDGE_DECIMALS = {
+		new BigDecimal("-12.34"),
+		new BigDecimal("0.005"),
+		new BigDecimal("-0.000001"),
+		new BigDecimal("1E+3"),
+		new BigDecimal("92233720368547758.07"),
+		new BigDecimal("-123456789012345678901234.5")
+	};
+
+	private static final Pattern TABLE_PATTERN = Pattern.compile(
+		"rows(\\d+)(?:_width(\\d+))?(?:_mix_([a-z0-9]+))?(_edge)?(?:_delay(\\d+))?");
+	private static final Pattern SCHEMA_PATTERN = Pattern.compile(
+		"tables(\\d+)(?:_cols(\\d+))?(?:_rows(\\d+))?(?:_width(\\d+))?(?:_mix_([a-z0-9]+))?");
+	private static final Pattern INSERT_PATTERN = Pattern.compile(
+		"^\\s*INSERT\\s+INTO\\s+(?:TABLE\\s+)?\\S*?(?:_delay(\\d+))?[\\s(]",
+		Pattern.CASE_INSENSITIVE);
+	private static final Pattern TRUNCATE_PATTERN = Pattern.compile(
+		"^\\s*TRUNCATE\\s+TABLE\\s+(\\S+)", Pattern.CASE_INSENSITIVE);
+	private static final Pattern DESCRIBE_PATTERN = Pattern.compile(
+		"^\\s*DESCRIBE\\s+(?:FORMATTED\\s+)?(\\S+)", Pattern.CASE_INSENSITIVE);
+	private static final Pattern MIX_PATTERN = Pattern.compile("_mix_([a-z0-9]+)");
+	private static final Pattern LOAD_PATTERN = Pattern.compile(
+		"^\\s*LOAD\\s+DATA\\s.*?\\sINTO\\s+TABLE\\s+\\S*?(?:_delay(\\d+))?(?:\\s|$)",
+		Pattern.CASE_INSENSITIVE | Pattern.DOTALL);
+	private static final Pattern LIMIT_PATTERN = Pattern.compile(
+		"\\bLIMIT\\s+(\\d+)\\s*$", Pattern.CASE_INSENSITIVE);
+
+
+	public Connection
+	connect(String url, Properties info) throws SQLException
+	{
+		if (!acceptsURL(url))
+			return null;
+
+		return (Connection) MakeProxy(Connection.class, new ConnectionHandler());
+	}
+
+	public boolean
+	acceptsURL(String url)
+	{
+		return (url != null &&
+				(url.startsWith("jdbc:hive2:") || url.startsWith("jdbc:mock:")));
+	}
+
+	public DriverPropertyInfo[]
+	getPropertyInfo(String url, Properties info)
+	{
+		return new DriverPropertyInfo[0];
+	}
+
+	public int
+	getMajorVersion()
+	{
+		return 1;
+	}
+
+	public int
+	getMinorVersion()
+	{
+		return 0;
+	}
+
+	public boolean
+	jdbcCompliant()
+	{
+		return false;
+	}
+
+	public Logger
+	getParentLogger() throws SQLFeatureNotSupportedException
+	{
+		throw new SQLFeatureNotSupportedException();
+	}
+
+/*
+ * MakeProxy
+ *		Creates a proxy for a java.sql interface
+ */
+	private static Object
+	MakeProxy(Class<?> iface, InvocationHandler handler)
+	{
+		return Proxy.newProxyInstance(MockHiveDriver.class.getClassLoader(),
+									  new Class<?>[]{iface}, handler);
+	}
+
+/*
+ * DefaultValue
+ *		What a proxy returns for a method it does not implement
+ */
+	private static Object
+	DefaultValue(Method method)
+	{
+		Class<?>	type = method.getReturnType();
+
+		if (type == boolean.class)
+			return Boolean.FALSE;
+		if (type == int.class)
+			return Integer.valueOf(0);
+		if (type == long.class)
+			return Long.valueOf(0);
+		if (type == short.class)
+			return Short.valueOf((short) 0);
+		if (type == byte.class)
+			return Byte.valueOf((byte) 0);
+		if (type == float.class)
+			return Float.valueOf(0);
+		if (type == double.class)
+			return Double.valueOf(0);
+		return null;
+	}
+
+/*
+ * ParseTypes
+ *		Expands a type mix such as i2s4 into one letter per column
+ */
+	private static char[]
+	ParseTypes(String mix, int ncolumns)
+	{
+		StringBuilder	types = new StringBuilder();
+		int			i = 0;
+
+		if (mix == null || mix.isEmpty())
+			mix = "s";
+
+		while (i < mix.length())
+		{
+			char		type = mix.charAt(i++);
+			int			start = i;
+			int			count = 1;
+
+			while (i < mix.length() && Character.isDigit(mix.charAt(i)))
+				i++;
+			if (i > start)
+				count = Integer.parseInt(mix.substring(start, i));
+
+			for (int j = 0; j < count; j++)
+				types.append(type);
+		}
+
+		/* A fixed column count cycles through the mix */
+		if (ncolumns > 0)
+		{
+			StringBuilder	cycled = new StringBuilder();
+
+			for (int j = 0; j < ncolumns; j++)
+				cycled.append(types.charAt(j % types.length()));
+			types = cycled;
+		}
+
+		return types.toString().toCharArray();
+	}
+
+/*
+ * SqlType, TypeName, HiveTypeName
+ *		java.sql.Types code and type names of a type letter
+ */
+	private static int
+	SqlType(char type)
+	{
+		switch (type)
+		{
+			case 'i': return Types.INTEGER;
+			case 'l': return Types.BIGINT;
+			case 'd': return Types.DOUBLE;
+			case 'n': return Types.DECIMAL;
+			case 'b': return Types.BOOLEAN;
+			case 't': return Types.TIMESTAMP;
+			case 'a': return Types.DATE;
+			case '0': return Types.NULL;
+			default: return Types.VARCHAR;
+		}
+	}
+
+	private static String
+	TypeName(char type)
+	{
+		switch (type)
+		{
+			case 'i': return "int";
+			case 'l': return "bigint";
+			case 'd': return "double";
+			case 'n': return "decimal";
+			case 'b': return "boolean";
+			case 't': return "timestamp";
+			case 'a': return "date";
+			case '0': return "void";
+			default: return "string";
+		}
+	}
+
+	private static String
+	HiveTypeName(char type)
+	{
+		return TypeName(type).toUpperCase();
+	}
+
+/*
+ * ConnectionHandler
+ *		Implements java.sql.Connection
+ */
+	private static class ConnectionHandler implements InvocationHandler
+	{
+		private boolean		closed = false;
+
+		public Object
+		invoke(Object proxy, Method method, Object[] args) throws Throwable
+		{
+			String		name = method.getName();
+
+			if (name.equals("createStatement"))
+				return MakeProxy(Statement.class, new StatementHandler());
+			if (name.equals("getMetaData"))
+				return MakeProxy(DatabaseMetaData.class, new MetaDataHandler());
+			if (name.equals("close"))
+			{
+				closed = true;
+				return null;
+			}
+			if (name.equals("isClosed"))
+				return closed;
+			if (name.equals("isValid"))
+				return !closed;
+			if (name.equals("getAutoCommit"))
+				return Boolean.TRUE;
+			if (name.equals("hashCode"))
+				return System.identityHashCode(proxy);
+			if (name.equals("equals"))
+				return proxy == args[0];
+			if (name.equals("toString"))
+				return "MockHiveConnection";
+			return DefaultValue(method);
+		}
+	}
+
+/*
+ * StatementHandler
+ *		Implements java.sql.Statement. cancel() wakes up a delayed
+ *		executeQuery and makes the result set fail on its next row.
+ */
+	private static class StatementHandler implements InvocationHandler
+	{
+		private volatile boolean	cancelled = false;
+		private int			timeout = 0;
+		private ResultSet	result;
+
+		public Object
+		invoke(Object proxy, Method method, Object[] args) throws Throwable
+		{
+			String		name = method.getName();
+
+			if (name.equals("executeQuery"))
+			{
+				result = ExecuteQuery((String) args[0]);
+				return result;
+			}
+			if (name.equals("execute"))
+			{
+				Matcher		insert = INSERT_PATTERN.matcher((String) args[0]);
+				Matcher		load = LOAD_PATTERN.matcher((String) args[0]);
+				Matcher		write = insert.find() ? insert : (load.find() ? load : null);
+				Matcher		truncate = TRUNCATE_PATTERN.matcher((String) args[0]);
+				Matcher		describe = DESCRIBE_PATTERN.matcher((String) args[0]);
+
+				if (write != null)
+				{
+					if (write.group(1) != null)
+						Delay(Long.parseLong(write.group(1)));
+					result = null;
+					return Boolean.FALSE;
+				}
+				if (truncate.find())
+				{
+					if (truncate.group(1).contains("_fail"))
+						throw new SQLException("mock driver: cannot truncate " + truncate.group(1));
+					result = null;
+					return Boolean.FALSE;
+				}
+				if (describe.find())
+				{
+					result = Describe(describe.group(1));
+					return Boolean.TRUE;
+				}
+				result = ExecuteQuery((String) args[0]);
+				return Boolean.TRUE;
+			}
+			if (name.equals("executeUpdate"))
+				return Integer.valueOf(0);
+			if (name.equals("getResultSet"))
+				return result;
+			if (name.equals("setQueryTimeout"))
+			{
+				timeout = (Integer) args[0];
+				return null;
+			}
+			if (name.equals("getQueryTimeout"))
+				return timeout;
+			if (name.equals("cancel"))
+			{
+				synchronized (this)
+				{
+					cancelled = true;
+					notifyAll();
+				}
+				return null;
+			}
+			if (name.equals("close"))
+				return null;
+			if (name.equals("hashCode"))
+				return System.identityHashCode(proxy);
+			if (name.equals("equals"))
+				return proxy == args[0];
+			if (name.equals("toString"))
+				return "MockHiveStatement";
+			return DefaultValue(method);
+		}
+
+		private ResultSet
+		ExecuteQuery(String query) throws SQLException
+		{
+			Matcher		table = TABLE_PATTERN.matcher(FromClause(query));
+			long		nrows;
+			int			width = 16;
+			char[]		types;
+			Matcher		limit;
+
+			if (!table.find())
+				throw new SQLException("mock driver: no rows<N> table in query: " + query);
+
+			nrows = Long.parseLong(table.group(1));
+			if (table.group(2) != null)
+				width = Integer.parseInt(table.group(2));
+			types = SelectListTypes(query, table.group(3));
+
+			limit = LIMIT_PATTERN.matcher(query);
+			if (limit.find())
+				nrows = Math.min(nrows, Long.parseLong(limit.group(1)));
+
+			if (table.group(5) != null)
+				Delay(Long.parseLong(table.group(5)));
+
+			return (ResultSet) MakeProxy(ResultSet.class,
+										 new SyntheticResultSet(this, nrows, width, types,
+																table.group(4) != null));
+		}
+
+		private static ResultSet
+		Describe(String table)
+		{
+			Matcher		mix = MIX_PATTERN.matcher(table);
+			char[]		types = ParseTypes(mix.find() ? mix.group(1) : null, 0);
+			List<Object[]>	rows = new ArrayList<Object[]>();
+
+			for (int c = 0; c < types.length; c++)
+				rows.add(new Object[]{Character.toString(types[c]) + (c + 1),
+						 HiveTypeName(types[c]), ""});
+
+			return ListResultSet.Make(new String[]{"col_name", "data_type", "comment"}, rows);
+		}
+
+		private synchronized void
+		Delay(long millis) throws SQLException
+		{
+			long		deadline = System.currentTimeMillis() + millis;
+			long		now;
+
+			while (!cancelled && (now = System.currentTimeMillis()) < deadline)
+			{
+				try
+				{
+					wait(deadline - now);
+				}
+				catch (InterruptedException delay_exception)
+				{
+					break;
+				}
+			}
+			if (cancelled)
+				throw new SQLException("mock driver: query cancelled");
+		}
+
+		private static String
+		FromClause(String query)
+		{
+			int			from = query.toUpperCase().indexOf(" FROM ");
+
+			return (from < 0 ? query : query.substring(from + 6));
+		}
+
+/*
+ * SelectListTypes
+ *		Column types of a query: the table's mix for SELECT *, otherwise
+ *		the first letter of each selected column name
+ */
+		private static char[]
+		SelectListTypes(String query, String mix)
+		{
+			String		upper = query.toUpperCase();
+			int			select = upper.indexOf("SELECT ");
+			int			from = upper.indexOf(" FROM ");
+			String		list;
+			List<String>	items = new ArrayList<String>();
+			int			depth = 0;
+			int			start = 0;
+			char[]		types;
+
+			if (select < 0 || from < 0)
+				return ParseTypes(mix, 0);
+
+			list = query.substring(select + 7, from).trim();
+			if (list.equals("*"))
+				return ParseTypes(mix, 0);
+
+			for (int i = 0; i < list.length(); i++)
+			{
+				char		c = list.charAt(i);
+
+				if (c == '(')
+					depth++;
+				else if (c == ')')
+					depth--;
+				else if (c == ',' && depth == 0)
+				{
+					items.add(list.substring(start, i).trim());
+					start = i + 1;
+				}
+			}
+			items.add(list.substring(start).trim());
+
+			types = new char[items.size()];
+			for (int i = 0; i < types.length; i++)
+			{
+				String		item = items.get(i);
+				int			dot = item.lastIndexOf('.');
+
+				if (dot >= 0)
+					item = item.substring(dot + 1);
+				item = item.replace("`", "").replace("\"", "");
+
+				if (item.equalsIgnoreCase("NULL") || item.isEmpty())
+					types[i] = '0';
+				else
+					types[i] = Character.toLowerCase(item.charAt(0));
+			}
+			return types;
+		}
+	}
+
+/*
+ * SyntheticResultSet
+ *		Implements java.sql.ResultSet over generated rows. Every value is
+ *		a function of its row and column, so runs are reproducible.
+ */
+	private static class SyntheticResultSet implements InvocationHandler
+	{
+		private final StatementHandler	statement;
+		private final long	nrows;
+		private final char[]	types;
+		private final String[]	padding;
+		private final boolean	edge;
+		private long		row = -1;
+		private boolean		was_null = false;
+
+		SyntheticResultSet(StatementHandler statement, long nrows, int width, char[] types,
+						   boolean edge)
+		{
+			this.statement = statement;
+			this.nrows = nrows;
+			this.types = types;
+			this.edge = edge;
+			this.padding = new String[types.length];
+
+			for (int i = 0; i < types.length; i++)
+			{
+				char[]		fill = new char[width];
+
+				for (int j = 0; j < width; j++)
+					fill[j] = (char) ('a' + (i + j) % 26);
+				padding[i] = new String(fill);
+			}
+		}
+
+		public Object
+		invoke(Object proxy, Method method, Object[] args) throws Throwable
+		{
+			String		name = method.getName();
+
+			if (name.equals("next"))
+			{
+				if (statement.cancelled)
+					throw new SQLException("mock driver: query cancelled");
+				return (++row < nrows);
+			}
+			if (name.equals("getMetaData"))
+				return MakeProxy(ResultSetMetaData.class, new ColumnsHandler(types));
+			if (name.equals("wasNull"))
+				return was_null;
+			if (name.startsWith("get") && args != null && args.length == 1 &&
+				args[0] instanceof Integer)
+				return Get(name, (Integer) args[0] - 1);
+			if (name.equals("close") || name.equals("isClosed"))
+				return DefaultValue(method);
+			if (name.equals("hashCode"))
+				return System.identityHashCode(proxy);
+			if (name.equals("equals"))
+				return proxy == args[0];
+			if (name.equals("toString"))
+				return "MockHiveResultSet";
+			return DefaultValue(method);
+		}
+
+		private Object
+		Get(String getter, int column) throws SQLException
+		{
+			Object		value;
+
+			if (column < 0 || column >= types.length)
+				throw new SQLException("mock driver: invalid column " + (column + 1));
+
+			value = Value(column);
+			was_null = (value == null);
+
+			if (getter.equals("getString"))
+				return (value == null ? null : value.toString());
+			if (getter.equals("getObject"))
+				return value;
+			if (getter.equals("getInt"))
+				return (value == null ? 0 : ((Number) value).intValue());
+			if (getter.equals("getLong"))
+				return (value == null ? 0L : ((Number) value).longValue());
+			if (getter.equals("getShort"))
+				return (value == null ? (short) 0 : ((Number) value).shortValue());
+			if (getter.equals("getFloat"))
+				return (value == null ? 0.0f : ((Number) value).floatValue());
+			if (getter.equals("getDouble"))
+				return (value == null ? 0.0 : ((Number) value).doubleValue());
+			if (getter.equals("getBoolean"))
+				return (value == null ? false : (Boolean) value);
+			if (getter.equals("getBigDecimal"))
+				return (value == null ? null : new BigDecimal(value.toString()));
+			if (getter.equals("getBytes"))
+				return (value == null ? null : value.toString().getBytes());
+			return value;
+		}
+
+		private Object
+		Value(int column)
+		{
+			long		r = row;
+
+			switch (types[column])
+			{
+				case 'i':
+					return Integer.valueOf((int) (r * 31 + column));
+				case 'l':
+					return Long.valueOf(r * 1000003L + column);
+				case 'd':
+					return Double.valueOf(r + column / 8.0);
+				case 'n':
+					if (edge)
+						return EDGE_DECIMALS[(int) (r % EDGE_DECIMALS.length)];
+					return BigDecimal.valueOf(r * 100 + column, 2);
+				case 'b':
+					return Boolean.valueOf((r + column) % 2 == 0);
+				case 't':
+					if (edge)
+						return EDGE_TIMESTAMPS[(int) (r % EDGE_TIMESTAMPS.length)];
+					return new Timestamp(BASE_MILLIS + r * 1000L);
+				case 'a':
+					if (edge)
+						return EDGE_DATES[(int) (r % EDGE_DATES.length)];
+					return new java.sql.Date(BASE_MILLIS + (r % 3650) * 86400000L);
+				case '0':
+					return null;
+				default:
+					{
+						String		digits = Long.toString(r);
+						String		pad = padding[column];
+
+						if (digits.length() >= pad.length())
+							return digits;
+						return digits + pad.substring(digits.length());
+					}
+			}
+		}
+	}
+
+/*
+ * ColumnsHandler
+ *		Implements java.sql.ResultSetMetaData for a list of type letters
+ */
+	private static class ColumnsHandler implements InvocationHandler
+	{
+		private final char[]	types;
+
+		ColumnsHandler(char[] types)
+		{
+			this.types = types;
+		}
+
+		public Object
+		invoke(Object proxy, Method method, Object[] args) throws Throwable
+		{
+			String		name = method.getName();
+			int			column = (args != null && args.length == 1 && args[0] instanceof Integer)
+				? (Integer) args[0] - 1 : -1;
+
+			if (name.equals("getColumnCount"))
+				return types.length;
+			if (column < 0 || column >= types.length)
+				return DefaultValue(method);
+			if (name.equals("getColumnType"))
+				return SqlType(types[column]);
+			if (name.equals("getColumnTypeName"))
+				return TypeName(types[column]);
+			if (name.equals("getColumnName") || name.equals("getColumnLabel"))
+				return Character.toString(types[column]) + (column + 1);
+			if (name.equals("getPrecision"))
+				return (types[column] == 'n' ? 18 : 0);
+			if (name.equals("getScale"))
+				return (types[column] == 'n' ? 2 : 0);
+			if (name.equals("isNullable"))
+				return ResultSetMetaData.columnNullable;
+			return DefaultValue(method);
+		}
+	}
+
+/*
+ * MetaDataHandler
+ *		Implements the parts of java.sql.DatabaseMetaData that IMPORT
+ *		FOREIGN SCHEMA uses
+ */
+	private static class MetaDataHandler implements InvocationHandler
+	{
+		public Object
+		invoke(Object proxy, Method method, Object[] args) throws Throwable
+		{
+			String		name = method.getName();
+
+			if (name.equals("getTables"))
+				return GetTables((String) args[1], (String) args[2]);
+			if (name.equals("getColumns"))
+				return GetColumns((String) args[1], (String) args[2]);
+			if (name.equals("getDatabaseProductName"))
+				return "MockHive";
+			return DefaultValue(method);
+		}
+
+		private static Matcher
+		Schema(String schema) throws SQLException
+		{
+			Matcher		matcher = SCHEMA_PATTERN.matcher(schema == null ? "" : schema);
+
+			if (!matcher.find())
+				throw new SQLException("mock driver: no tables<T> schema: " + schema);
+			return matcher;
+		}
+
+		private static String
+		TableName(Matcher schema, int table)
+		{
+			String		name = "rows" + (schema.group(3) != null ? schema.group(3) : "1000");
+
+			if (schema.group(4) != null)
+				name += "_width" + schema.group(4);
+			return name + "_mix_" + MixOf(schema) + "_t" + table;
+		}
+
+		private static String
+		MixOf(Matcher schema)
+		{
+			int			ncolumns = (schema.group(2) != null ? Integer.parseInt(schema.group(2)) : 8);
+
+			return new String(ParseTypes(schema.group(5), ncolumns));
+		}
+
+		private ResultSet
+		GetTables(String schema, String pattern) throws SQLException
+		{
+			Matcher		matcher = Schema(schema);
+			int			ntables = Integer.parseInt(matcher.group(1));
+			List<Object[]>	rows = new ArrayList<Object[]>();
+
+			for (int t = 0; t < ntables; t++)
+			{
+				String		table = TableName(matcher, t);
+
+				if (Like(table, pattern))
+					rows.add(new Object[]{null, schema, table, "TABLE", null});
+			}
+
+			return ListResultSet.Make(new String[]{"TABLE_CAT", "TABLE_SCHEM", "TABLE_NAME",
+								   "TABLE_TYPE", "REMARKS"}, rows);
+		}
+
+		private ResultSet
+		GetColumns(String schema, String pattern) throws SQLException
+		{
+			Matcher		matcher = Schema(schema);
+			int			ntables = Integer.parseInt(matcher.group(1));
+			char[]		types = MixOf(matcher).toCharArray();
+			int			width = (matcher.group(4) != null ? Integer.parseInt(matcher.group(4)) : 16);
+			List<Object[]>	rows = new ArrayList<Object[]>();
+
+			for (int t = 0; t < ntables; t++)
+			{
+				String		table = TableName(matcher, t);
+
+				if (!Like(table, pattern))
+					continue;
+
+				for (int c = 0; c < types.length; c++)
+					rows.add(new Object[]{null, schema, table,
+							 Character.toString(types[c]) + (c + 1),
+							 SqlType(types[c]), HiveTypeName(types[c]),
+							 (types[c] == 'n' ? 18 : width), (types[c] == 'n' ? 2 : 0),
+							 width, c + 1});
+			}
+
+			return ListResultSet.Make(new String[]{"TABLE_CAT", "TABLE_SCHEM", "TABLE_NAME",
+								   "COLUMN_NAME", "DATA_TYPE", "TYPE_NAME",
+								   "COLUMN_SIZE", "DECIMAL_DIGITS",
+								   "CHAR_OCTET_LENGTH", "ORDINAL_POSITION"}, rows);
+		}
+
+		/* SQL LIKE with % and _, null matching everything */
+		private static boolean
+		Like(String value, String pattern)
+		{
+			if (pattern == null)
+				return true;
+			return value.matches(Pattern.quote(pattern)
+								 .replace("%", "\\E.*\\Q")
+								 .replace("_", "\\E.\\Q"));
+		}
+	}
+
+/*
+ * ListResultSet
+ *		Implements java.sql.ResultSet over a list of rows, for metadata
+ */
+	private static class ListResultSet implements InvocationHandler
+	{
+		private final String[]	columns;
+		private final List<Object[]>	rows;
+		private int			row = -1;
+		private boolean		was_null = false;
+
+		private ListResultSet(String[] columns, List<Object[]> rows)
+		{
+			this.columns = columns;
+			this.rows = rows;
+		}
+
+		static ResultSet
+		Make(String[] columns, List<Object[]> rows)
+		{
+			return (ResultSet) MakeProxy(ResultSet.class, new ListResultSet(columns, rows));
+		}
+
+		public Object
+		invoke(Object proxy, Method method, Object[] args) throws Throwable
+		{
+			String		name = method.getName();
+
+			if (name.equals("next"))
+				return (++row < rows.size());
+			if (name.equals("wasNull"))
+				return was_null;
+			if (name.equals("getMetaData"))
+			{
+				char[]		types = new char[columns.length];
+
+				Arrays.fill(types, 's');
+				return MakeProxy(ResultSetMetaData.class, new ColumnsHandler(types));
+			}
+			if (name.startsWith("get") && args != null && args.length == 1)
+			{
+				int			column = (args[0] instanceof Integer)
+					? (Integer) args[0] - 1 : Arrays.asList(columns).indexOf(args[0]);
+				Object		value;
+
+				if (column < 0 || column >= columns.length)
+					throw new SQLException("mock driver: no column " + args[0]);
+
+				value = rows.get(row)[column];
+				was_null = (value == null);
+				if (name.equals("getString"))
+					return (value == null ? null : value.toString());
+				if (name.equals("getInt"))
+					return (value == null ? 0 : ((Number) value).intValue());
+				if (name.equals("getLong"))
+					return (value == null ? 0L : ((Number) value).longValue());
+				return value;
+			}
+			return DefaultValue(method);
+		}
+	}
+}
@@ -0,0 +1,4 @@
+BEGIN;
+CREATE SCHEMA hive_bench_import_:client_id;
+IMPORT FOREIGN SCHEMA "tables10_cols16_mix_ildnsbta" FROM SERVER hive_bench INTO hive_bench_import_:client_id;
+ROLLBACK;
@@ -0,0 +1 @@
+INSERT INTO hive_bench.insert_row SELECT i, md5(i::text) FROM generate_series(1, 100) i;
@@ -0,0 +1 @@
+INSERT INTO hive_bench.insert_staged SELECT i, md5(i::text) FROM generate_series(1, 10000) i;
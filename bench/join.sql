@@ -0,0 +1 @@
+SELECT count(*) FROM hive_bench.join_outer o JOIN hive_bench.join_inner i ON o.i1 = i.i1;
@@ -0,0 +1,105 @@
+#!/bin/sh
+#
+# run_bench.sh
+#		Benchmark hive_fdw against the mock JDBC driver
+#
+# Builds mock-hive-driver.jar, creates the benchmark objects and runs each
+# pgbench script for DURATION seconds. For every script it reports the
+# throughput and the server CPU time spent per row, read from /proc, so
+# this must run on the database host (Linux only).
+#
+# Settings come from the environment:
+#
+#	ROWS		rows returned by each scan (default 100000)
+#	DURATION	seconds per script (default 30)
+#	CLIENTS		pgbench clients (default 1)
+#	SCRIPTS		scripts to run (default all)
+#	SIMD		on to also run the ASCII scan micro-benchmark (default on)
+#	STAGING_DIR	directory the server stages bulk loads in (default /tmp)
+#
+# Connection settings are the usual libpq ones (PGHOST, PGDATABASE, ...).
+# The server must be started with HIVE_FDW_CLASSPATH pointing at the
+# hive_fdw jar, as for regular use. Whether scans go through the gateway
+# worker follows the server's hive_fdw.gateway setting.
+#
+# IDENTIFICATION
+#		hive_fdw/bench/run_bench.sh
+#
+
+set -e
+
+ROWS=${ROWS:-100000}
+DURATION=${DURATION:-30}
+CLIENTS=${CLIENTS:-1}
+SCRIPTS=${SCRIPTS:-"scan_narrow scan_wide scan_typed join import insert_batch insert_row insert_staged"}
+SIMD=${SIMD:-on}
+STAGING_DIR=${STAGING_DIR:-/tmp}
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+BUILD_DIR="$BENCH_DIR/build"
+JARFILE="$BUILD_DIR/mock-hive-driver.jar"
+
+# Rows handled by one transaction of each script. IMPORT FOREIGN SCHEMA
+# is counted in imported columns: 10 tables of 16 columns. The INSERT
+# scripts write a fixed number of rows.
+rows_per_xact()
+{
+	case "$1" in
+		import) echo 160 ;;
+		insert_batch|insert_staged) echo 10000 ;;
+		insert_row) echo 100 ;;
+		*) echo "$ROWS" ;;
+	esac
+}
+
+# Total CPU ticks of the postmaster and all of its children, including
+# those that have already exited
+server_cpu_ticks()
+{
+	pid=$1
+	ticks=$(awk '{ print $14 + $15 + $16 + $17 }' "/proc/$pid/stat")
+	for child in $(pgrep -P "$pid"); do
+		t=$(awk '{ print $14 + $15 }' "/proc/$child/stat" 2>/dev/null || echo 0)
+		ticks=$((ticks + t))
+	done
+	echo "$ticks"
+}
+
+mkdir -p "$BUILD_DIR"
+javac -d "$BUILD_DIR" "$BENCH_DIR/MockHiveDriver.java"
+(cd "$BUILD_DIR" && jar cf "$JARFILE" *.class)
+
+psql -X -q -v ON_ERROR_STOP=1 -v rows="$ROWS" -v jarfile="$JARFILE" \
+	-v staging="$STAGING_DIR" -f "$BENCH_DIR/setup.sql"
+
+DATA_DIR=$(psql -X -A -t -c "SHOW data_directory")
+POSTMASTER=$(head -n 1 "$DATA_DIR/postmaster.pid")
+CLK_TCK=$(getconf CLK_TCK)
+
+printf "%-12s %8s %14s %14s\n" "script" "tps" "rows/sec" "cpu us/row"
+
+for script in $SCRIPTS; do
+	cpu_before=$(server_cpu_ticks "$POSTMASTER")
+
+	tps=$(pgbench -n -T "$DURATION" -c "$CLIENTS" -j "$CLIENTS" \
+			-f "$BENCH_DIR/$script.sql" 2>/dev/null |
+		  awk '/^tps/ { print $3; exit }')
+
+	cpu_after=$(server_cpu_ticks "$POSTMASTER")
+
+	rows=$(rows_per_xact "$script")
+	echo "$script $tps $rows $DURATION $((cpu_after - cpu_before)) $CLK_TCK" |
+		awk '{
+			rows = $2 * $4 * $3;
+			cpu_us = $5 * 1000000 / $6;
+			printf "%-12s %8.2f %14.0f %14.3f\n", $1, $2, $2 * $3,
+				   (rows > 0 ? cpu_us / rows : 0);
+		}'
+done
+
+if [ "$SIMD" = on ]; then
+	echo
+	${CC:-cc} -O2 -march=native -I"$BENCH_DIR/.." -o "$BUILD_DIR/simd_bench" \
+		"$BENCH_DIR/simd_bench.c"
+	"$BUILD_DIR/simd_bench"
+fi
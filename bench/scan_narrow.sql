@@ -0,0 +1 @@
+SELECT count(t.*) FROM hive_bench.scan_narrow t;
@@ -0,0 +1,54 @@
+--
+-- Objects for the hive_fdw benchmark suite. run_bench.sh sets the psql
+-- variables rows, jarfile and staging before running this script.
+--
+
+DROP SERVER IF EXISTS hive_bench CASCADE;
+DROP SCHEMA IF EXISTS hive_bench CASCADE;
+
+CREATE EXTENSION IF NOT EXISTS hive_fdw;
+
+CREATE SERVER hive_bench FOREIGN DATA WRAPPER hive_fdw
+	OPTIONS (host 'localhost', port '10000',
+			 drivername 'MockHiveDriver', jarfile :'jarfile');
+CREATE USER MAPPING FOR CURRENT_USER SERVER hive_bench
+	OPTIONS (username 'bench', password 'bench');
+
+CREATE SCHEMA hive_bench;
+SET search_path = hive_bench;
+
+-- Two string columns of 16 bytes
+SELECT format('CREATE FOREIGN TABLE scan_narrow (s1 text, s2 text)
+	SERVER hive_bench OPTIONS (table %L)',
+	'rows' || :'rows' || '_width16_mix_s2') \gexec
+
+-- Sixty-four string columns of 32 bytes
+SELECT format('CREATE FOREIGN TABLE scan_wide (%s)
+	SERVER hive_bench OPTIONS (table %L)',
+	(SELECT string_agg('s' || i || ' text', ', ') FROM generate_series(1, 64) i),
+	'rows' || :'rows' || '_width32_mix_s64') \gexec
+
+-- One column of every scalar type the mock driver knows
+SELECT format('CREATE FOREIGN TABLE scan_typed (i1 int, l2 bigint, d3 float8,
+	n4 numeric(18,2), s5 text, b6 bool, t7 timestamp, a8 date)
+	SERVER hive_bench OPTIONS (table %L)',
+	'rows' || :'rows' || '_width16_mix_ildnsbta') \gexec
+
+-- Both sides of the join come from the first table of the pushed-down
+-- query, so only the outer table sets the row count
+SELECT format('CREATE FOREIGN TABLE join_outer (i1 int, s2 text)
+	SERVER hive_bench OPTIONS (table %L)',
+	'rows' || :'rows' || '_width16_mix_i1s1') \gexec
+CREATE FOREIGN TABLE join_inner (i1 int, s2 text)
+	SERVER hive_bench OPTIONS (table 'rows1000_width16_mix_i1s1');
+
+-- INSERT targets. Every remote INSERT takes 20 ms, far less than a Hive
+-- job would; insert_row sends one statement per row, insert_staged a
+-- single LOAD DATA. Its _mix_ gives the mock's DESCRIBE the columns the
+-- staging check expects.
+CREATE FOREIGN TABLE insert_batch (i1 int, s2 text)
+	SERVER hive_bench OPTIONS (table 'sink_delay20');
+CREATE FOREIGN TABLE insert_row (i1 int, s2 text)
+	SERVER hive_bench OPTIONS (table 'sink_delay20', batch_size '1');
+CREATE FOREIGN TABLE insert_staged (i1 int, s2 text)
+	SERVER hive_bench OPTIONS (table 'sink_mix_i1s1_delay20', staging_dir :'staging');
@@ -0,0 +1,99 @@
+/*-------------------------------------------------------------------------
+ *
+ * simd_bench.c
+ *		Micro-benchmark of the ASCII scan in hive_simd.h
+ *
+ * Compares hive_is_ascii with its scalar fallback over text cells of
+ * several lengths, the way hive_batch.c scans a batch before decoding
+ * it, and reports the throughput of each. Built and run by run_bench.sh;
+ * by hand:
+ *
+ *	cc -O2 -march=native -I.. -o simd_bench simd_bench.c && ./simd_bench
+ *
+ * IDENTIFICATION
+ *		hive_fdw/bench/simd_bench.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* The bits of c.h that hive_simd.h relies on */
+typedef size_t Size;
+typedef uint64_t uint64;
+#define UINT64CONST(x) (x##ULL)
+
+#include "hive_simd.h"
+
+/* Bytes of cell data scanned per measurement */
+#define BENCH_BYTES		(64 * 1024 * 1024)
+
+/* Passes over the data per measurement */
+#define BENCH_PASSES	20
+
+typedef bool (*ascii_check) (const char *s, Size len);
+
+static double
+now_seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Scan "data" as cells of "cell_len" bytes and return the throughput in
+ * GB/s. The result of every check is accumulated so that the compiler
+ * cannot drop the calls.
+ */
+static double
+run(ascii_check check, const char *data, Size cell_len, long *sink)
+{
+	double		start = now_seconds();
+	int			pass;
+
+	for (pass = 0; pass < BENCH_PASSES; pass++)
+	{
+		Size		pos;
+
+		for (pos = 0; pos + cell_len <= BENCH_BYTES; pos += cell_len)
+			*sink += check(data + pos, cell_len);
+	}
+
+	return (double) BENCH_BYTES * BENCH_PASSES / (now_seconds() - start) / 1e9;
+}
+
+int
+main(void)
+{
+	static const Size cell_lens[] = {8, 16, 32, 64, 256, 4096, BENCH_BYTES};
+	char	   *data = malloc(BENCH_BYTES);
+	long		sink = 0;
+	Size		i;
+
+	if (data == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	for (i = 0; i < BENCH_BYTES; i++)
+		data[i] = 'a' + i % 26;
+
+	printf("vector width: %s\n", HIVE_SIMD_NAME);
+	printf("%12s %14s %14s %8s\n", "cell bytes", "scalar GB/s", "simd GB/s", "speedup");
+
+	for (i = 0; i < sizeof(cell_lens) / sizeof(cell_lens[0]); i++)
+	{
+		double		scalar = run(hive_is_ascii_scalar, data, cell_lens[i], &sink);
+		double		simd = run(hive_is_ascii, data, cell_lens[i], &sink);
+
+		printf("%12zu %14.2f %14.2f %7.2fx\n", cell_lens[i], scalar, simd, simd / scalar);
+	}
+
+	free(data);
+	return (sink == 0);
+}
@@ -28,11 +28,13 @@
 #include "catalog/pg_type.h"
 #include "catalog/pg_operator.h"
 #include "catalog/pg_proc.h"
+#include "nodes/nodeFuncs.h"
 #include "parser/parsetree.h"
 #include "optimizer/clauses.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
 #include "utils/syscache.h"
+#include "utils/timestamp.h"
 #include "utils/array.h"
 #include "optimizer/tlist.h"
 #if PG_VERSION_NUM < 120000
@@ -41,10 +43,16 @@
         #include "optimizer/optimizer.h"
 #endif
 
+#if PG_VERSION_NUM < 120000
+#define SubscriptingRef ArrayRef
+#define T_SubscriptingRef T_ArrayRef
+#endif
+
 typedef struct foreign_glob_cxt
 {
 	PlannerInfo *root;              /* global planner state */
 	RelOptInfo *foreignrel;         /* the foreign relation we are planning for */
+	int			case_depth;         /* simple CASEs around the current node */
 } foreign_glob_cxt;
 
 typedef struct deparse_expr_cxt
@@ -53,6 +61,7 @@ typedef struct deparse_expr_cxt
 	RelOptInfo	*foreignrel;         /* the foreign relation we are planning for */
 	StringInfo	buf;                 /* output buffer to append to */
 	List		**params_list;       /* exprs that will become remote Params */
+	Expr		*case_arg;           /* argument of the innermost simple CASE */
 } deparse_expr_cxt;
 
 #define REL_ALIAS_PREFIX	"r"
@@ -72,11 +81,25 @@ static void deparseFuncExpr(FuncExpr *node, deparse_expr_cxt *context);
 static void deparseOpExpr(OpExpr *node, deparse_expr_cxt *context);
 static void deparseBoolExpr(BoolExpr *node, deparse_expr_cxt *context);
 static void deparseNullTest(NullTest *node, deparse_expr_cxt *context);
+static void deparseCaseExpr(CaseExpr *node, deparse_expr_cxt *context);
+static void deparseCoalesceExpr(CoalesceExpr *node, deparse_expr_cxt *context);
+static void deparseNullIfExpr(NullIfExpr *node, deparse_expr_cxt *context);
+static void deparseArrayExpr(ArrayExpr *node, deparse_expr_cxt *context);
+static void deparseCast(Expr *arg, Oid type, int32 typmod, deparse_expr_cxt *context);
+static const char *get_hive_cast_type(Oid source, Oid target, int32 typmod);
+static void deparseInsertValue(StringInfo buf, Oid type, const char *extval);
+static const char *get_insert_table_name(Relation rel);
+static const char *get_table_filter(Oid relid);
+static void appendTableFilter(StringInfo buf, Oid relid, bool is_first);
 static void deparseColumnRef(StringInfo buf, int varno, int varattno,
 				 PlannerInfo *root, bool qualify_col);
 static void deparseRelabelType(RelabelType *node, deparse_expr_cxt *context);
 static void deparseScalarArrayOpExpr(ScalarArrayOpExpr *node,
 						 deparse_expr_cxt *context);
+static void deparseSubscriptingRef(SubscriptingRef *node, deparse_expr_cxt *context);
+static void deparseFieldAccess(OpExpr *node, deparse_expr_cxt *context);
+static char *get_column_hive_type(PlannerInfo *root, Var *var);
+static bool is_field_access_safe(OpExpr *oe, foreign_glob_cxt *glob_cxt);
 static void deparseTargetList(StringInfo buf, PlannerInfo *root, Index rtindex,
 							  Relation rel, Bitmapset *attrs_used,
 							  bool qualify_col, List **retrieved_attrs);
@@ -136,6 +159,18 @@ foreign_expr_walker(Node *node, foreign_glob_cxt *glob_cxt)
 		case T_FuncExpr:
 			{
 				FuncExpr   *fe = (FuncExpr *) node;
+				hiveFuncInfo info;
+
+				hive_function_info(glob_cxt->foreignrel->serverid,
+								   fe->funcid, &info);
+
+				/* Declared shippable by the server's options */
+				if (info.extra)
+				{
+					if (!foreign_expr_walker((Node *) fe->args, glob_cxt))
+						return false;
+					break;
+				}
 
 				/*
 				 * If function used by the expression is not built-in, it
@@ -146,19 +181,22 @@ foreign_expr_walker(Node *node, foreign_glob_cxt *glob_cxt)
 					return false;
 
 				/*
-				 * What do to with EXPLICIT cast functions? We return false
-				 * for now
-				 */
-				if (fe->funcformat == COERCE_EXPLICIT_CAST)
-					return false;
-
-				/*
+				 * Explicit casts go out as CAST(... AS type), and only
+				 * those that mean the same in Hive.
+				 *
 				 * Not all builtins can be sent to Hive. Additionally some builtins
 				 * need to be translated as well. We use the logic in hive_funcs.c
 				 * for this
 				 */
-				if (fe->funcformat != COERCE_IMPLICIT_CAST &&
-											!is_hive_builtin(fe))
+				if (fe->funcformat == COERCE_EXPLICIT_CAST)
+				{
+					if (get_hive_cast_type(exprType((Node *) linitial(fe->args)),
+										   fe->funcresulttype,
+										   exprTypmod(node)) == NULL)
+						return false;
+				}
+				else if (fe->funcformat != COERCE_IMPLICIT_CAST &&
+											!is_hive_builtin(fe, &info))
 					return false;
 
 				/*
@@ -172,6 +210,18 @@ foreign_expr_walker(Node *node, foreign_glob_cxt *glob_cxt)
 		case T_OpExpr:
 			{
 				OpExpr	*oe = (OpExpr *) node;
+				hiveFuncInfo info;
+
+				hive_operator_info(glob_cxt->foreignrel->serverid,
+								   oe->opno, &info);
+
+				/* Declared shippable by the server's options */
+				if (info.extra)
+				{
+					if (!foreign_expr_walker((Node *) oe->args, glob_cxt))
+						return false;
+					break;
+				}
 
 				/*
 				 * Similarly, only built-in operators can be sent to remote.
@@ -181,6 +231,13 @@ foreign_expr_walker(Node *node, foreign_glob_cxt *glob_cxt)
 				if (!is_builtin(oe->opno))
 					return false;
 
+				/*
+				 * Hive has no json operators. Only ->> on a MAP or STRUCT
+				 * column has a Hive equivalent.
+				 */
+				if (info.json)
+					return info.json_field_text && is_field_access_safe(oe, glob_cxt);
+
 				/*
 				 * Recurse to input subexpressions.
 				 */
@@ -198,6 +255,21 @@ foreign_expr_walker(Node *node, foreign_glob_cxt *glob_cxt)
 				if (!is_builtin(oe->opno))
 					return false;
 
+				/*
+				 * IN (a, b) with expressions in the list. An ARRAY[] has
+				 * no other use in a Hive condition.
+				 */
+				if (IsA(lsecond(oe->args), ArrayExpr))
+				{
+					ArrayExpr  *ae = (ArrayExpr *) lsecond(oe->args);
+
+					if (ae->multidims ||
+						!foreign_expr_walker((Node *) linitial(oe->args), glob_cxt) ||
+						!foreign_expr_walker((Node *) ae->elements, glob_cxt))
+						return false;
+					break;
+				}
+
 				/*
 				 * Recurse to input subexpressions.
 				 */
@@ -243,15 +315,45 @@ foreign_expr_walker(Node *node, foreign_glob_cxt *glob_cxt)
 				}
 			}
 			break;
+		case T_SubscriptingRef:
+			{
+				SubscriptingRef *sr = (SubscriptingRef *) node;
+
+				/*
+				 * Only fetching a single element of an array, which Hive
+				 * spells the same way but counts from 0. Slices and
+				 * assignments have no Hive equivalent.
+				 */
+				if (sr->refassgnexpr != NULL ||
+					sr->reflowerindexpr != NIL ||
+					list_length(sr->refupperindexpr) != 1 ||
+					!type_is_array(exprType((Node *) sr->refexpr)))
+					return false;
+
+				/* The column must be an ARRAY on the Hive side as well */
+				if (!IsA(sr->refexpr, Var) ||
+					!bms_is_member(((Var *) sr->refexpr)->varno,
+								   glob_cxt->foreignrel->relids) ||
+					hiveTypeKind(get_column_hive_type(glob_cxt->root,
+													  (Var *) sr->refexpr)) != HIVE_TYPE_ARRAY)
+					return false;
+
+				if (!foreign_expr_walker((Node *) sr->refexpr, glob_cxt) ||
+					!foreign_expr_walker((Node *) sr->refupperindexpr, glob_cxt))
+					return false;
+			}
+			break;
 		case T_RelabelType:
 			{
 				RelabelType *r = (RelabelType *) node;
 
 				/*
-				 * Recurse to input subexpression. We only allow
-				 * IMPLICIT casts for now
+				 * Recurse to input subexpression. Explicit casts must mean
+				 * the same in Hive.
 				 */
-				if (r->relabelformat != COERCE_IMPLICIT_CAST)
+				if (r->relabelformat != COERCE_IMPLICIT_CAST &&
+					get_hive_cast_type(exprType((Node *) r->arg), r->resulttype,
+									   r->resulttypmod) == NULL)
 					return false;
 
 				if (!foreign_expr_walker((Node *) r->arg,
@@ -259,6 +361,76 @@ foreign_expr_walker(Node *node, foreign_glob_cxt *glob_cxt)
 					return false;
 			}
 			break;
+		case T_CoerceViaIO:
+			{
+				CoerceViaIO *c = (CoerceViaIO *) node;
+
+				/* Casts through text, such as int to text */
+				if (get_hive_cast_type(exprType((Node *) c->arg),
+									   c->resulttype, -1) == NULL)
+					return false;
+
+				if (!foreign_expr_walker((Node *) c->arg, glob_cxt))
+					return false;
+			}
+			break;
+		case T_CaseExpr:
+			{
+				CaseExpr   *ce = (CaseExpr *) node;
+				ListCell   *lc;
+
+				if (!foreign_expr_walker((Node *) ce->arg, glob_cxt))
+					return false;
+
+				/*
+				 * The WHEN conditions of a simple CASE refer to its argument
+				 * through CaseTestExpr nodes.
+				 */
+				foreach(lc, ce->args)
+				{
+					CaseWhen   *cw = (CaseWhen *) lfirst(lc);
+					bool		ok;
+
+					if (ce->arg != NULL)
+						glob_cxt->case_depth++;
+					ok = foreign_expr_walker((Node *) cw->expr, glob_cxt);
+					if (ce->arg != NULL)
+						glob_cxt->case_depth--;
+
+					if (!ok || !foreign_expr_walker((Node *) cw->result, glob_cxt))
+						return false;
+				}
+
+				if (!foreign_expr_walker((Node *) ce->defresult, glob_cxt))
+					return false;
+			}
+			break;
+		case T_CaseTestExpr:
+			{
+				/* Only as the argument of a simple CASE */
+				if (glob_cxt->case_depth == 0)
+					return false;
+			}
+			break;
+		case T_CoalesceExpr:
+			{
+				CoalesceExpr *ce = (CoalesceExpr *) node;
+
+				if (!foreign_expr_walker((Node *) ce->args, glob_cxt))
+					return false;
+			}
+			break;
+		case T_NullIfExpr:
+			{
+				NullIfExpr *ni = (NullIfExpr *) node;
+
+				if (!is_builtin(ni->opno))
+					return false;
+
+				if (!foreign_expr_walker((Node *) ni->args, glob_cxt))
+					return false;
+			}
+			break;
 		default:
 
 			/*
@@ -414,6 +586,7 @@ is_foreign_expr(PlannerInfo *root, RelOptInfo *baserel, Expr *expr)
 	 */
 	glob_cxt.root = root;
 	glob_cxt.foreignrel = baserel;
+	glob_cxt.case_depth = 0;
 	if (!foreign_expr_walker((Node *) expr, &glob_cxt))
 		return false;
 
@@ -501,6 +674,28 @@ deparseExpr(Expr *node, deparse_expr_cxt *context)
 		case T_RelabelType:
 			deparseRelabelType((RelabelType *) node, context);
 			break;
+		case T_SubscriptingRef:
+			deparseSubscriptingRef((SubscriptingRef *) node, context);
+			break;
+		case T_CoerceViaIO:
+			deparseCast(((CoerceViaIO *) node)->arg,
+						((CoerceViaIO *) node)->resulttype, -1, context);
+			break;
+		case T_CaseExpr:
+			deparseCaseExpr((CaseExpr *) node, context);
+			break;
+		case T_CaseTestExpr:
+			deparseExpr(context->case_arg, context);
+			break;
+		case T_CoalesceExpr:
+			deparseCoalesceExpr((CoalesceExpr *) node, context);
+			break;
+		case T_NullIfExpr:
+			deparseNullIfExpr((NullIfExpr *) node, context);
+			break;
+		case T_ArrayExpr:
+			deparseArrayExpr((ArrayExpr *) node, context);
+			break;
 		default:
 			elog(ERROR, "unsupported expression type for deparse: %d",
 				 (int) nodeTag(node));
@@ -517,19 +712,15 @@ static void
 deparseScalarArrayOpExpr(ScalarArrayOpExpr *node, deparse_expr_cxt *context)
 {
 	StringInfo	buf = context->buf;
-	HeapTuple	tuple;
-	Form_pg_operator form;
+	hiveFuncInfo info;
 	Expr	   *arg1;
 	Expr	   *arg2;
 	char	   *oprname;
 
 	elog(DEBUG4, HIVE_FDW_NAME ": pushdown check for T_ScalarArrayOpExpr");
 
-	/* Retrieve information about the operator from system catalog. */
-	tuple = SearchSysCache1(OPEROID, ObjectIdGetDatum(node->opno));
-	if (!HeapTupleIsValid(tuple))
-		elog(ERROR, "cache lookup failed for operator %u", node->opno);
-	form = (Form_pg_operator) GETSTRUCT(tuple);
+	/* Retrieve information about the operator from the function cache. */
+	hive_operator_info(context->foreignrel->serverid, node->opno, &info);
 
 	/* Sanity check. */
 	Assert(list_length(node->args) == 2);
@@ -543,7 +734,7 @@ deparseScalarArrayOpExpr(ScalarArrayOpExpr *node, deparse_expr_cxt *context)
 	appendStringInfoChar(buf, ' ');
 
 	/* Deparse operator name */
-	oprname = NameStr(form->oprname);
+	oprname = NameStr(info.name);
 
 	if (strcmp(oprname, "=") == 0 && node->useOr)
 		appendStringInfo(buf, "IN (");
@@ -551,7 +742,7 @@ deparseScalarArrayOpExpr(ScalarArrayOpExpr *node, deparse_expr_cxt *context)
 		appendStringInfo(buf, "NOT IN (");
 	else
 	{
-		appendStringInfo(buf, "%s", NameStr(form->oprname));
+		appendStringInfo(buf, "%s", oprname);
 		appendStringInfo(buf, " %s (", node->useOr ? "ANY" : "ALL");
 	}
 
@@ -563,8 +754,6 @@ deparseScalarArrayOpExpr(ScalarArrayOpExpr *node, deparse_expr_cxt *context)
 
 	/* Always parenthesize the expression. */
 	appendStringInfoChar(buf, ')');
-
-	ReleaseSysCache(tuple);
 }
 
 
@@ -576,14 +765,263 @@ deparseRelabelType(RelabelType *node, deparse_expr_cxt *context)
 {
 	elog(DEBUG4, HIVE_FDW_NAME ": pushdown check for T_RelabelType");
 
-	deparseExpr(node->arg, context);
 	if (node->relabelformat != COERCE_IMPLICIT_CAST)
-		appendStringInfo(context->buf, "::%s",
-						 format_type_with_typemod(node->resulttype,
-											  node->resulttypmod));
+		deparseCast(node->arg, node->resulttype, node->resulttypmod, context);
+	else
+		deparseExpr(node->arg, context);
+}
+
+/*
+ * Deparse an explicit cast as CAST(arg AS type). Hive has no :: syntax.
+ */
+static void
+deparseCast(Expr *arg, Oid type, int32 typmod, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+
+	appendStringInfoString(buf, "CAST(");
+	deparseExpr(arg, context);
+	appendStringInfo(buf, " AS %s)",
+					 get_hive_cast_type(exprType((Node *) arg), type, typmod));
+}
+
+/*
+ * Explicit casts that give the same result in Hive: integers to wider
+ * integers, to double precision and to text, real to double precision,
+ * date to timestamp and back, and text and varchar to each other, which
+ * Hive cuts to the length as PostgreSQL does. Casts from float or
+ * numeric to integers round in PostgreSQL but truncate in Hive, and
+ * Hive formats dates, timestamps and floats differently as text, so
+ * those are left to PostgreSQL.
+ */
+static const struct
+{
+	Oid			source;
+	Oid			target;
+}			HiveSafeCasts[] =
+{
+	{INT2OID, INT2OID},
+	{INT2OID, INT4OID},
+	{INT2OID, INT8OID},
+	{INT2OID, FLOAT8OID},
+	{INT2OID, TEXTOID},
+	{INT2OID, VARCHAROID},
+	{INT4OID, INT4OID},
+	{INT4OID, INT8OID},
+	{INT4OID, FLOAT8OID},
+	{INT4OID, TEXTOID},
+	{INT4OID, VARCHAROID},
+	{INT8OID, INT8OID},
+	{INT8OID, TEXTOID},
+	{INT8OID, VARCHAROID},
+	{FLOAT4OID, FLOAT4OID},
+	{FLOAT4OID, FLOAT8OID},
+	{FLOAT8OID, FLOAT8OID},
+	{BOOLOID, BOOLOID},
+	{TEXTOID, TEXTOID},
+	{TEXTOID, VARCHAROID},
+	{VARCHAROID, TEXTOID},
+	{VARCHAROID, VARCHAROID},
+	{DATEOID, DATEOID},
+	{DATEOID, TIMESTAMPOID},
+	{TIMESTAMPOID, DATEOID},
+	{TIMESTAMPOID, TIMESTAMPOID}
+};
+
+/*
+ * The Hive type an explicit cast from source to target can be sent as,
+ * or NULL if the cast is not in HiveSafeCasts.
+ */
+static const char *
+get_hive_cast_type(Oid source, Oid target, int32 typmod)
+{
+	int			i;
+
+	for (i = 0; i < lengthof(HiveSafeCasts); i++)
+	{
+		if (HiveSafeCasts[i].source == source &&
+			HiveSafeCasts[i].target == target)
+			break;
+	}
+	if (i == lengthof(HiveSafeCasts))
+		return NULL;
+
+	switch (target)
+	{
+		case INT2OID:
+			return "SMALLINT";
+		case INT4OID:
+			return "INT";
+		case INT8OID:
+			return "BIGINT";
+		case FLOAT4OID:
+			return "FLOAT";
+		case FLOAT8OID:
+			return "DOUBLE";
+		case BOOLOID:
+			return "BOOLEAN";
+		case TEXTOID:
+			return "STRING";
+		case DATEOID:
+			return "DATE";
+		case TIMESTAMPOID:
+			return "TIMESTAMP";
+		case VARCHAROID:
+			if (typmod < VARHDRSZ)
+				return "STRING";
+			if (typmod - VARHDRSZ > 65535)
+				return NULL;
+			return psprintf("VARCHAR(%d)", typmod - VARHDRSZ);
+		default:
+			return NULL;
+	}
 }
 
 
+/*
+ * Deparse an array element fetch. PostgreSQL arrays built from Hive
+ * arrays start at 1, Hive arrays at 0.
+ */
+static void
+deparseSubscriptingRef(SubscriptingRef *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	Expr	   *subscript = linitial(node->refupperindexpr);
+
+	elog(DEBUG4, HIVE_FDW_NAME ": pushdown check for T_SubscriptingRef");
+
+	deparseExpr(node->refexpr, context);
+	appendStringInfoChar(buf, '[');
+	if (IsA(subscript, Const) && !((Const *) subscript)->constisnull &&
+		((Const *) subscript)->consttype == INT4OID)
+		appendStringInfo(buf, INT64_FORMAT,
+						 (int64) DatumGetInt32(((Const *) subscript)->constvalue) - 1);
+	else
+	{
+		appendStringInfoChar(buf, '(');
+		deparseExpr(subscript, context);
+		appendStringInfoString(buf, " - 1)");
+	}
+	appendStringInfoChar(buf, ']');
+}
+
+/*
+ * Deparse "col ->> 'key'" on a MAP or STRUCT column as a map lookup or a
+ * field reference. The value is cast to STRING because ->> yields text.
+ */
+static void
+deparseFieldAccess(OpExpr *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	Var		   *var = (Var *) linitial(node->args);
+	Const	   *key = (Const *) lsecond(node->args);
+	char	   *field = TextDatumGetCString(key->constvalue);
+
+	elog(DEBUG4, HIVE_FDW_NAME ": pushdown check for jsonb field access");
+
+	appendStringInfoString(buf, "CAST(");
+	deparseVar(var, context);
+	if (hiveTypeKind(get_column_hive_type(context->root, var)) == HIVE_TYPE_MAP)
+	{
+		appendStringInfoChar(buf, '[');
+		deparseStringLiteral(buf, field);
+		appendStringInfoChar(buf, ']');
+	}
+	else
+		appendStringInfo(buf, ".`%s`", field);
+	appendStringInfoString(buf, " AS STRING)");
+}
+
+/*
+ * The hive_type option of a foreign table column, or NULL.
+ */
+static char *
+get_column_hive_type(PlannerInfo *root, Var *var)
+{
+	RangeTblEntry *rte = planner_rt_fetch(var->varno, root);
+	ListCell   *lc;
+
+	if (var->varattno <= 0)
+		return NULL;
+
+	foreach(lc, GetForeignColumnOptions(rte->relid, var->varattno))
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "hive_type") == 0)
+			return defGetString(def);
+	}
+	return NULL;
+}
+
+/*
+ * Can "col ->> 'key'" be shipped? The column must be one of ours, with a
+ * hive_type of MAP with string keys or of STRUCT, the key a constant
+ * naming a field that exists, and the value a string. Other primitives
+ * are left alone because Hive's CAST(... AS STRING) does not format
+ * numbers, booleans and timestamps the way ->> does. Hive folds struct
+ * field names to lower case, so only lower case names are matched.
+ */
+static bool
+is_field_access_safe(OpExpr *oe, foreign_glob_cxt *glob_cxt)
+{
+	Var		   *var = (Var *) linitial(oe->args);
+	Const	   *key = (Const *) lsecond(oe->args);
+	char	   *hive_type;
+	char	   *member;
+	char	   *field;
+
+	if (!IsA(var, Var) || !IsA(key, Const) || key->constisnull ||
+		!bms_is_member(var->varno, glob_cxt->foreignrel->relids) ||
+		var->varlevelsup != 0)
+		return false;
+
+	hive_type = get_column_hive_type(glob_cxt->root, var);
+	if (hive_type == NULL)
+		return false;
+
+	field = TextDatumGetCString(key->constvalue);
+	switch (hiveTypeKind(hive_type))
+	{
+		case HIVE_TYPE_MAP:
+			{
+				char	   *keytype = pstrdup(hive_type);
+				char	   *comma;
+
+				/* map<string,...> and map<varchar(n),...> only */
+				keytype = keytype + strlen("map<");
+				if ((comma = strchr(keytype, ',')) == NULL)
+					return false;
+				*comma = '\0';
+				if (hiveTypeKind(keytype) != HIVE_TYPE_PRIMITIVE ||
+					(pg_strncasecmp(keytype, "string", 6) != 0 &&
+					 pg_strncasecmp(keytype, "varchar", 7) != 0))
+					return false;
+			}
+			break;
+		case HIVE_TYPE_STRUCT:
+			{
+				char	   *c;
+
+				/* Field names go out as `name` */
+				for (c = field; *c; c++)
+				{
+					if (*c == '`' || isupper((unsigned char) *c))
+						return false;
+				}
+			}
+			break;
+		default:
+			return false;
+	}
+
+	member = hiveTypeMember(hive_type, field);
+	return (member != NULL && hiveTypeKind(member) == HIVE_TYPE_PRIMITIVE &&
+			(pg_strcasecmp(member, "string") == 0 ||
+			 pg_strncasecmp(member, "varchar", 7) == 0 ||
+			 pg_strncasecmp(member, "char", 4) == 0));
+}
+
 static void
 deparseVar(Var *node, deparse_expr_cxt *context)
 {
@@ -816,8 +1254,7 @@ static void
 deparseFuncExpr(FuncExpr *node, deparse_expr_cxt *context)
 {
 	StringInfo	buf = context->buf;
-	HeapTuple	proctup;
-	Form_pg_proc procform;
+	hiveFuncInfo info;
 	const char *proname, *fname;
 	bool		first, skip_first_arg = false;
 	ListCell   *arg;
@@ -834,21 +1271,34 @@ deparseFuncExpr(FuncExpr *node, deparse_expr_cxt *context)
 		return;
 	}
 
+	/* An explicit cast, the other arguments are only the length */
+	if (node->funcformat == COERCE_EXPLICIT_CAST)
+	{
+		deparseCast((Expr *) linitial(node->args), node->funcresulttype,
+					exprTypmod((Node *) node), context);
+		return;
+	}
+
 	/*
-	 * Normal function: display as proname(args).
+	 * Normal function: display as proname(args). Functions mapped by the
+	 * server's options keep their arguments as they are.
 	 */
-	proctup = SearchSysCache1(PROCOID, ObjectIdGetDatum(node->funcid));
-	if (!HeapTupleIsValid(proctup))
-		elog(ERROR, "cache lookup failed for function %u", node->funcid);
-	procform = (Form_pg_proc) GETSTRUCT(proctup);
-
-	/* Deparse the function name ... */
-	fname = NameStr(procform->proname);
-	proname = hive_translate_function(node, fname);
-	appendStringInfo(buf, "%s(", quote_identifier(proname));
+	hive_function_info(context->foreignrel->serverid, node->funcid, &info);
+	fname = NameStr(info.name);
+	if (info.extra)
+	{
+		appendStringInfo(buf, "%s(", info.hive_name);
+		proname = fname;
+	}
+	else
+	{
+		/* Deparse the function name ... */
+		proname = hive_translate_function(node, &info);
+		appendStringInfo(buf, "%s(", quote_identifier(proname));
+	}
 	/* ... and all the arguments */
 
-	if (strcmp(fname, "date_part") == 0)
+	if (!info.extra && strcmp(fname, "date_part") == 0)
 		skip_first_arg = true;
 
 	first = true;
@@ -867,14 +1317,13 @@ deparseFuncExpr(FuncExpr *node, deparse_expr_cxt *context)
 	}
 
 	/* append a space if lpad, rpad */
-	if ((strcmp(proname, "lpad") == 0 ||
+	if (!info.extra &&
+		(strcmp(proname, "lpad") == 0 ||
 			strcmp(proname, "rpad") == 0) &&
 				list_length(node->args) == 2)
 		appendStringInfoString(buf, ", ' '");
 
 	appendStringInfoChar(buf, ')');
-
-	ReleaseSysCache(proctup);
 }
 
 /*
@@ -885,20 +1334,23 @@ static void
 deparseOpExpr(OpExpr *node, deparse_expr_cxt *context)
 {
 	StringInfo	buf = context->buf;
-	HeapTuple	tuple;
-	Form_pg_operator form;
+	hiveFuncInfo info;
 	char		oprkind;
 	ListCell   *arg;
-	char	   *oprname;
+	const char *oprname;
 
 	elog(DEBUG4, HIVE_FDW_NAME ": pushdown check for T_OpExpr");
 
-	/* Retrieve information about the operator from system catalog. */
-	tuple = SearchSysCache1(OPEROID, ObjectIdGetDatum(node->opno));
-	if (!HeapTupleIsValid(tuple))
-		elog(ERROR, "cache lookup failed for operator %u", node->opno);
-	form = (Form_pg_operator) GETSTRUCT(tuple);
-	oprkind = form->oprkind;
+	/* Retrieve information about the operator from the function cache. */
+	hive_operator_info(context->foreignrel->serverid, node->opno, &info);
+	oprkind = info.oprkind;
+
+	/* json ->> on a MAP or STRUCT column, unless mapped by the options */
+	if (info.json && !info.extra)
+	{
+		deparseFieldAccess(node, context);
+		return;
+	}
 
 	/* Sanity check. */
 	Assert((oprkind == 'r' && list_length(node->args) == 1) ||
@@ -908,6 +1360,20 @@ deparseOpExpr(OpExpr *node, deparse_expr_cxt *context)
 	/* Always parenthesize the expression. */
 	appendStringInfoChar(buf, '(');
 
+	/* Hive has no ILIKE, compare both sides in lower case instead */
+	oprname = NameStr(info.name);
+	if (!info.extra &&
+		(strcmp(oprname, "~~*") == 0 || strcmp(oprname, "!~~*") == 0))
+	{
+		appendStringInfoString(buf, "lower(");
+		deparseExpr(linitial(node->args), context);
+		appendStringInfo(buf, ") %s lower(",
+						 oprname[0] == '!' ? "NOT LIKE" : "LIKE");
+		deparseExpr(lsecond(node->args), context);
+		appendStringInfoString(buf, "))");
+		return;
+	}
+
 	/* Deparse left operand. */
 	if (oprkind == 'r' || oprkind == 'b')
 	{
@@ -921,11 +1387,13 @@ deparseOpExpr(OpExpr *node, deparse_expr_cxt *context)
 	 * names. Right now the list is small, so "if" checks
 	 * like below are ok.
 	 */
-	oprname = NameStr(form->oprname);
+	oprname = NameStr(info.name);
 	if (strcmp(oprname, "~~") == 0)
 		oprname = "LIKE";
 	if (strcmp(oprname, "!~~") == 0)
 		oprname = "NOT LIKE";
+	if (info.extra)
+		oprname = info.hive_name;
 
 	appendStringInfo(buf, "%s", oprname);
 
@@ -938,8 +1406,6 @@ deparseOpExpr(OpExpr *node, deparse_expr_cxt *context)
 	}
 
 	appendStringInfoChar(buf, ')');
-
-	ReleaseSysCache(tuple);
 }
 
 /*
@@ -1003,6 +1469,108 @@ deparseNullTest(NullTest *node, deparse_expr_cxt *context)
 		appendStringInfoString(buf, " IS NOT NULL)");
 }
 
+/*
+ * Deparse a CASE expression. A simple CASE is sent as a searched one,
+ * with its argument in place of the CaseTestExpr in each condition, as
+ * PostgreSQL may have wrapped the placeholder in implicit casts.
+ */
+static void
+deparseCaseExpr(CaseExpr *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	Expr	   *save_case_arg = context->case_arg;
+	ListCell   *lc;
+
+	elog(DEBUG4, HIVE_FDW_NAME ": pushdown check for T_CaseExpr");
+
+	appendStringInfoString(buf, "(CASE");
+	foreach(lc, node->args)
+	{
+		CaseWhen   *cw = (CaseWhen *) lfirst(lc);
+
+		appendStringInfoString(buf, " WHEN ");
+		if (node->arg != NULL)
+			context->case_arg = node->arg;
+		deparseExpr(cw->expr, context);
+		context->case_arg = save_case_arg;
+
+		appendStringInfoString(buf, " THEN ");
+		deparseExpr(cw->result, context);
+	}
+	if (node->defresult != NULL)
+	{
+		appendStringInfoString(buf, " ELSE ");
+		deparseExpr(node->defresult, context);
+	}
+	appendStringInfoString(buf, " END)");
+}
+
+/*
+ * Deparse COALESCE(args), which Hive spells the same.
+ */
+static void
+deparseCoalesceExpr(CoalesceExpr *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	ListCell   *lc;
+	bool		first = true;
+
+	elog(DEBUG4, HIVE_FDW_NAME ": pushdown check for T_CoalesceExpr");
+
+	appendStringInfoString(buf, "COALESCE(");
+	foreach(lc, node->args)
+	{
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		deparseExpr((Expr *) lfirst(lc), context);
+		first = false;
+	}
+	appendStringInfoChar(buf, ')');
+}
+
+/*
+ * Deparse NULLIF(a, b). Hive only has nullif() from 2.3 on, so it goes
+ * out as the CASE it stands for.
+ */
+static void
+deparseNullIfExpr(NullIfExpr *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+
+	elog(DEBUG4, HIVE_FDW_NAME ": pushdown check for T_NullIfExpr");
+
+	appendStringInfoString(buf, "(CASE WHEN ");
+	deparseExpr(linitial(node->args), context);
+	appendStringInfoString(buf, " = ");
+	deparseExpr(lsecond(node->args), context);
+	appendStringInfoString(buf, " THEN NULL ELSE ");
+	deparseExpr(linitial(node->args), context);
+	appendStringInfoString(buf, " END)");
+}
+
+/*
+ * Deparse the elements of an ARRAY[] that is the list of an IN, like
+ * array constants in deparseConst.
+ */
+static void
+deparseArrayExpr(ArrayExpr *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	ListCell   *lc;
+	bool		first = true;
+
+	elog(DEBUG4, HIVE_FDW_NAME ": pushdown check for T_ArrayExpr");
+
+	foreach(lc, node->elements)
+	{
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		deparseExpr((Expr *) lfirst(lc), context);
+		first = false;
+	}
+}
+
+
 /*
  * Append a SQL string literal representing "val" to buf.
  */
@@ -1035,9 +1603,6 @@ static void
 deparseColumnRef(StringInfo buf, int varno, int varattno, PlannerInfo *root, bool qualify_col)
 {
 	RangeTblEntry *rte;
-	char	   *colname = NULL;
-	List	   *options;
-	ListCell   *lc;
 
 	/* varno must not be any of OUTER_VAR, INNER_VAR and INDEX_VAR. */
 	Assert(!IS_SPECIAL_VARNO(varno));
@@ -1045,37 +1610,44 @@ deparseColumnRef(StringInfo buf, int varno, int varattno, PlannerInfo *root, boo
 	/* Get RangeTblEntry from array in PlannerInfo. */
 	rte = planner_rt_fetch(varno, root);
 
+	if (qualify_col)
+		ADD_REL_QUALIFIER(buf, varno);
+
+	appendStringInfoString(buf, quote_identifier(get_column_name(rte->relid, varattno)));
+}
+
+/*
+ * get_column_name
+ *		Name of a column of a foreign table on the Hive side
+ */
+char *
+get_column_name(Oid relid, int attnum)
+{
+	List	   *options;
+	ListCell   *lc;
+
 	/*
 	 * If it's a column of a foreign table, and it has the column_name FDW
 	 * option, use that value.
 	 */
-	options = GetForeignColumnOptions(rte->relid, varattno);
+	options = GetForeignColumnOptions(relid, attnum);
 	foreach(lc, options)
 	{
 		DefElem    *def = (DefElem *) lfirst(lc);
 
 		if (strcmp(def->defname, "column_name") == 0)
-		{
-			colname = defGetString(def);
-			break;
-		}
+			return defGetString(def);
 	}
 
 	/*
 	 * If it's a column of a regular table or it doesn't have column_name FDW
 	 * option, use attribute name.
 	 */
-	if (colname == NULL)
 #if PG_VERSION_NUM < 110000
-		colname = get_relid_attribute_name(rte->relid, varattno);
+	return get_relid_attribute_name(relid, attnum);
 #else
-		colname = get_attname(rte->relid, varattno, false);
+	return get_attname(relid, attnum, false);
 #endif
-
-		if (qualify_col)
-			ADD_REL_QUALIFIER(buf, varno);
-
-	appendStringInfoString(buf, quote_identifier(colname));
 }
 
 /* Output join name for given join type */
@@ -1143,6 +1715,7 @@ deparseFromExprForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
 			context.foreignrel = foreignrel;
 			context.root = root;
 			context.params_list = params_list;
+			context.case_arg = NULL;
 
 			appendStringInfo(buf, "(");
 			appendConditions(fpinfo->joinclauses, &context);
@@ -1176,7 +1749,15 @@ deparseFromExprForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
 				relname = defGetString(def);
 		}
 
-		appendStringInfo(buf, "%s", relname);
+		/*
+		 * The filter of a table that stands for part of a Hive table goes
+		 * into a subquery, as the WHERE clause belongs to the join
+		 */
+		if (use_alias && get_table_filter(RelationGetRelid(rel)) != NULL)
+			appendStringInfo(buf, "(SELECT * FROM %s WHERE (%s))", relname,
+							 get_table_filter(RelationGetRelid(rel)));
+		else
+			appendStringInfo(buf, "%s", relname);
 
 		/*
 		 * Add a unique alias to avoid any conflict in relation names due to
@@ -1294,6 +1875,7 @@ deparseSelectStmtForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *baserel,
 	context.foreignrel = baserel;
 	context.buf = buf;
 	context.params_list = params_list;
+	context.case_arg = NULL;
 
 	deparseSelectSql(root, baserel, fpinfo->attrs_used,
 					 retrieved_attrs, fdw_scan_tlist, &context);
@@ -1311,4 +1893,345 @@ deparseSelectStmtForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *baserel,
 		appendWhereClause(root, baserel, remote_conds,
 						  true, params_list, &context);
 	}
+
+	if (baserel->reloptkind != RELOPT_JOINREL)
+		appendTableFilter(buf, planner_rt_fetch(baserel->relid, root)->relid,
+						  remote_conds == NIL);
+}
+
+/*
+ * deparseInsertSql
+ *		Build the start of a remote INSERT statement for rel, up to and
+ *		including VALUES. Rows are added by deparseInsertRow, separated
+ *		by commas, so that one statement inserts a whole batch.
+ */
+void
+deparseInsertSql(StringInfo buf, Relation rel, List *targetAttrs)
+{
+	const char *relname = get_insert_table_name(rel);
+	ListCell   *lc;
+	bool		first = true;
+
+	appendStringInfo(buf, "INSERT INTO TABLE %s (", relname);
+
+	foreach(lc, targetAttrs)
+	{
+		int			attnum = lfirst_int(lc);
+
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		appendStringInfoString(buf, quote_identifier(get_column_name(RelationGetRelid(rel), attnum)));
+	}
+
+	appendStringInfoString(buf, ") VALUES ");
+}
+
+/*
+ * deparseLoadSql
+ *		Build the LOAD DATA statement that moves a staged file into rel,
+ *		or into the given partition of it. path is the file as Hive sees
+ *		it; local means HiveServer2 reads it from its own file system.
+ */
+void
+deparseLoadSql(StringInfo buf, Relation rel, const char *path, bool local,
+			   const char *partition)
+{
+	appendStringInfo(buf, "LOAD DATA %sINPATH ", local ? "LOCAL " : "");
+	deparseHiveStringLiteral(buf, path);
+	appendStringInfo(buf, " INTO TABLE %s", get_insert_table_name(rel));
+	if (partition != NULL)
+		appendStringInfo(buf, " PARTITION (%s)", partition);
+}
+
+/*
+ * deparseDirectUpdateSql
+ *		Build an UPDATE statement that runs entirely on the Hive server.
+ *		targetlist holds the new values of the attributes in targetAttrs,
+ *		remote_conds the RestrictInfos of the WHERE clause.
+ */
+void
+deparseDirectUpdateSql(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
+					   Relation rel, List *targetlist, List *targetAttrs,
+					   List *remote_conds, List **params_list)
+{
+	deparse_expr_cxt context;
+	ListCell   *lc;
+	ListCell   *lc2;
+	bool		first = true;
+
+	context.root = root;
+	context.foreignrel = foreignrel;
+	context.buf = buf;
+	context.params_list = params_list;
+	context.case_arg = NULL;
+
+	appendStringInfo(buf, "UPDATE %s SET ", get_insert_table_name(rel));
+
+	forboth(lc, targetlist, lc2, targetAttrs)
+	{
+		TargetEntry *tle = (TargetEntry *) lfirst(lc);
+		int			attnum = lfirst_int(lc2);
+
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		appendStringInfo(buf, "%s = ",
+						 quote_identifier(get_column_name(RelationGetRelid(rel), attnum)));
+		deparseExpr(tle->expr, &context);
+	}
+
+	if (remote_conds)
+		appendWhereClause(root, foreignrel, remote_conds, true, NULL, &context);
+	appendTableFilter(buf, RelationGetRelid(rel), remote_conds == NIL);
+}
+
+/*
+ * deparseDirectDeleteSql
+ *		Build a DELETE statement that runs entirely on the Hive server
+ */
+void
+deparseDirectDeleteSql(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
+					   Relation rel, List *remote_conds, List **params_list)
+{
+	deparse_expr_cxt context;
+
+	context.root = root;
+	context.foreignrel = foreignrel;
+	context.buf = buf;
+	context.params_list = params_list;
+	context.case_arg = NULL;
+
+	appendStringInfo(buf, "DELETE FROM %s", get_insert_table_name(rel));
+
+	if (remote_conds)
+		appendWhereClause(root, foreignrel, remote_conds, true, NULL, &context);
+	appendTableFilter(buf, RelationGetRelid(rel), remote_conds == NIL);
+}
+
+/*
+ * deparseTruncateSql
+ *		Build the TRUNCATE TABLE statement for rel, or for the given
+ *		partition of it
+ */
+void
+deparseTruncateSql(StringInfo buf, Relation rel, const char *partition)
+{
+	/* A filtered table is only part of the Hive table or partition */
+	if (partition == NULL && get_table_filter(RelationGetRelid(rel)) != NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot truncate foreign table \"%s\"",
+						RelationGetRelationName(rel)),
+				 errdetail("Only foreign tables with a partition option can be truncated when they have a filter option.")));
+
+	appendStringInfo(buf, "TRUNCATE TABLE %s", get_insert_table_name(rel));
+	if (partition != NULL)
+		appendStringInfo(buf, " PARTITION (%s)", partition);
+}
+
+/*
+ * get_table_filter
+ *		The filter option of a foreign table, a HiveQL condition that
+ *		limits it to part of its Hive table, or NULL
+ */
+static const char *
+get_table_filter(Oid relid)
+{
+	ForeignTable *table = GetForeignTable(relid);
+	ListCell   *lc;
+
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "filter") == 0)
+			return defGetString(def);
+	}
+
+	return NULL;
+}
+
+/*
+ * appendTableFilter
+ *		Add the filter of a foreign table, if any, to a WHERE clause
+ */
+static void
+appendTableFilter(StringInfo buf, Oid relid, bool is_first)
+{
+	const char *filter = get_table_filter(relid);
+
+	if (filter != NULL)
+		appendStringInfo(buf, " %s (%s)", is_first ? "WHERE" : "AND", filter);
+}
+
+/*
+ * get_insert_table_name
+ *		The Hive table a foreign table writes to, from its table option
+ */
+static const char *
+get_insert_table_name(Relation rel)
+{
+	ForeignTable *table = GetForeignTable(RelationGetRelid(rel));
+	ListCell   *lc;
+
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "table") == 0)
+			return defGetString(def);
+	}
+
+	ereport(ERROR,
+			(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+			 errmsg("cannot modify foreign table \"%s\"",
+					RelationGetRelationName(rel)),
+			 errdetail("It is defined by a query instead of a Hive table.")));
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * deparseInsertRow
+ *		Append the values of targetAttrs in slot as a parenthesized row.
+ *		p_flinfo holds the output function of every attribute.
+ */
+void
+deparseInsertRow(StringInfo buf, TupleTableSlot *slot, List *targetAttrs,
+				 FmgrInfo *p_flinfo)
+{
+	TupleDesc	tupdesc = slot->tts_tupleDescriptor;
+	ListCell   *lc;
+	bool		first = true;
+
+	appendStringInfoChar(buf, '(');
+
+	foreach(lc, targetAttrs)
+	{
+		int			attnum = lfirst_int(lc);
+		Datum		value;
+		bool		isnull;
+
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		value = slot_getattr(slot, attnum, &isnull);
+		if (isnull)
+			appendStringInfoString(buf, "NULL");
+		else if (TupleDescAttr(tupdesc, attnum - 1)->atttypid == BYTEAOID)
+		{
+			/* Sent the way the staged file carries it */
+			appendStringInfoString(buf, "unbase64(");
+			deparseHiveStringLiteral(buf, hiveEncodeBase64(value));
+			appendStringInfoChar(buf, ')');
+		}
+		else
+			deparseInsertValue(buf, TupleDescAttr(tupdesc, attnum - 1)->atttypid,
+							   hiveOutputValue(&p_flinfo[attnum - 1],
+											   TupleDescAttr(tupdesc, attnum - 1)->atttypid,
+											   value));
+	}
+
+	appendStringInfoChar(buf, ')');
+}
+
+/*
+ * deparseInsertValue
+ *		Append the text form of a value as a Hive literal. Unlike the
+ *		constants of a WHERE clause, which are compared as they are,
+ *		inserted strings must arrive unchanged, so they are written with
+ *		Hive's backslash escapes rather than PostgreSQL's E'' syntax.
+ */
+static void
+deparseInsertValue(StringInfo buf, Oid type, const char *extval)
+{
+	switch (type)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case NUMERICOID:
+			/* NaN and Infinity are quoted, as in deparseConst */
+			if (strspn(extval, "0123456789+-eE.") == strlen(extval))
+			{
+				appendStringInfoString(buf, extval);
+				return;
+			}
+			break;
+		case BOOLOID:
+			appendStringInfoString(buf, strcmp(extval, "t") == 0 ? "true" : "false");
+			return;
+		default:
+			break;
+	}
+
+	deparseHiveStringLiteral(buf, extval);
+}
+
+/*
+ * hiveOutputValue
+ *		Text form of a value to be written to Hive. The caller has set the
+ *		transmission GUCs, see hiveSetTransmissionModes. Hive timestamps
+ *		have no zone, so timestamptz is written in the session time zone
+ *		without its offset, the way it is read back.
+ */
+char *
+hiveOutputValue(FmgrInfo *flinfo, Oid type, Datum value)
+{
+	if (type == TIMESTAMPTZOID)
+		return DatumGetCString(DirectFunctionCall1(timestamp_out,
+												   DirectFunctionCall1(timestamptz_timestamp,
+																	   value)));
+
+	return OutputFunctionCall(flinfo, value);
+}
+
+/*
+ * hiveEncodeBase64
+ *		A bytea value in base64, as Hive's unbase64() and binary columns
+ *		of text files read it
+ */
+char *
+hiveEncodeBase64(Datum value)
+{
+	char	   *encoded;
+	char	   *src;
+	char	   *dst;
+
+	encoded = TextDatumGetCString(DirectFunctionCall2(binary_encode, value,
+													  CStringGetTextDatum("base64")));
+
+	/* The encoder wraps lines at 76 characters */
+	for (src = dst = encoded; *src; src++)
+	{
+		if (*src != '\n')
+			*dst++ = *src;
+	}
+	*dst = '\0';
+
+	return encoded;
+}
+
+/*
+ * deparseHiveStringLiteral
+ *		Append val as a Hive string literal, with backslash escapes
+ */
+void
+deparseHiveStringLiteral(StringInfo buf, const char *val)
+{
+	const char *valptr;
+
+	appendStringInfoChar(buf, '\'');
+	for (valptr = val; *valptr; valptr++)
+	{
+		if (*valptr == '\'' || *valptr == '\\')
+			appendStringInfoChar(buf, '\\');
+		appendStringInfoChar(buf, *valptr);
+	}
+	appendStringInfoChar(buf, '\'');
 }
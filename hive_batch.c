@@ -0,0 +1,581 @@
+/*-------------------------------------------------------------------------
+ *
+ * hive_batch.c
+ *                Row batch decoding for hive_fdw
+ *
+ * Rows are not handed over from Java one JNI call at a time. Instead
+ * HiveJDBCUtils.FetchBatch encodes a batch of rows into a direct buffer
+ * that we read in place here. The gateway worker ships exactly the same
+ * bytes over its shared memory queues, so both the in-process scan and
+ * the gateway scan share this decoder.
+ *
+ * Numeric, boolean, date and timestamp columns arrive in binary form and
+ * are turned into Datums directly when the foreign table column has a
+ * matching type. Text and binary cells are copied into text and bytea
+ * varlenas with a single memcpy. Everything else goes through the
+ * column's input function, as text. Hive ARRAY, MAP and STRUCT values
+ * arrive as JSON; arrays are split into their elements for PostgreSQL
+ * array columns, anything else is left to the input function of the
+ * column, typically jsonb.
+ *
+ * Text needs converting from UTF-8 only on databases with another
+ * encoding, and then only if it is not plain ASCII. That is checked for
+ * all text cells of a batch at once before its first row is decoded;
+ * only batches that fail the check convert, and report errors, value by
+ * value.
+ *
+ * Copyright (c) 2012-2020, BigSQL
+ *
+ * IDENTIFICATION
+ *                hive_fdw/src/hive_batch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "hive_fdw.h"
+#include "hive_simd.h"
+
+#include "catalog/pg_type.h"
+#include "datatype/timestamp.h"
+#include "mb/pg_wchar.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/jsonb.h"
+#include "utils/lsyscache.h"
+#include "utils/numeric.h"
+#include "utils/timestamp.h"
+
+#if PG_VERSION_NUM < 110000
+#define DatumGetJsonbP(d)	DatumGetJsonb(d)
+#endif
+
+/* Difference between the Unix and PostgreSQL epochs */
+#define HIVE_EPOCH_SHIFT_DAYS	(POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE)
+#define HIVE_EPOCH_SHIFT_USECS	(HIVE_EPOCH_SHIFT_DAYS * USECS_PER_DAY)
+
+/* Length of a decimal cell in binary form: int32 scale, int64 unscaled */
+#define HIVE_DECIMAL_CELL_LEN	(sizeof(int32) + sizeof(int64))
+
+static int32 hiveBatchReadInt32(hiveRowBatch *batch);
+static bool hiveBatchTextIsAscii(hiveRowBatch *batch);
+static Datum hiveBatchCellDatum(hiveRowBatch *batch, char kind, int32 len,
+								hiveTupleDecoder *decoder, int attnum);
+static Datum hiveBatchJsonArray(hiveRowBatch *batch, const char *data, int32 len,
+								hiveArrayInput *array, int32 typmod);
+static char *hiveBatchCellString(hiveRowBatch *batch, char kind,
+								 const char *data, int32 len);
+static DateADT hiveBatchDate(const char *data);
+static Timestamp hiveBatchTimestamp(const char *data);
+static char *hiveBatchDecimalString(int32 scale, int64 unscaled);
+static Datum hiveBatchVarlena(const char *data, int32 len);
+
+/*
+ * Set up a batch for decoding. The batch does not own the data, which
+ * must stay valid until the last row has been decoded.
+ */
+void
+hiveBatchInit(hiveRowBatch *batch, char *data, Size len)
+{
+	batch->data = data;
+	batch->len = len;
+	batch->pos = 0;
+	batch->row = 0;
+	batch->nrows = 0;
+	batch->ncols = 0;
+	batch->kinds = NULL;
+	batch->verbatim = false;
+
+	if (len > 0)
+	{
+		batch->nrows = hiveBatchReadInt32(batch);
+		batch->ncols = hiveBatchReadInt32(batch);
+		if (batch->ncols < 0 || batch->pos + batch->ncols > batch->len)
+			elog(ERROR, HIVE_FDW_NAME ": malformed row batch");
+
+		batch->kinds = batch->data + batch->pos;
+		batch->pos += TYPEALIGN(sizeof(int32), batch->ncols);
+	}
+}
+
+/*
+ * Set up decoding into tuples described by attinmeta. The decoder lives
+ * in the current memory context and serves all batches of a scan.
+ */
+hiveTupleDecoder *
+hiveBatchPrepare(AttInMetadata *attinmeta)
+{
+	TupleDesc	tupdesc = attinmeta->tupdesc;
+	hiveTupleDecoder *decoder = palloc(sizeof(hiveTupleDecoder));
+	int			i;
+
+	decoder->attinmeta = attinmeta;
+	decoder->arrays = palloc0(sizeof(hiveArrayInput) * Max(tupdesc->natts, 1));
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+		hiveArrayInput *array = &decoder->arrays[i];
+		Oid			elemtype;
+		Oid			infunc;
+
+		if (attr->attisdropped ||
+			(elemtype = get_element_type(attr->atttypid)) == InvalidOid)
+			continue;
+
+		array->elemtype = elemtype;
+		get_typlenbyvalalign(elemtype, &array->elemlen, &array->elembyval,
+							 &array->elemalign);
+		getTypeInputInfo(elemtype, &infunc, &array->elemioparam);
+		fmgr_info(infunc, &array->eleminput);
+	}
+
+	return decoder;
+}
+
+/*
+ * Decode the next row of the batch into "values" and "nulls", which have
+ * one entry per attribute of the decoder's tuple descriptor. By-reference
+ * values are palloc'd in the current memory context. Attributes beyond
+ * the columns of the batch are set to NULL. Returns false once all rows
+ * of the batch have been consumed.
+ */
+bool
+hiveBatchNextRow(hiveRowBatch *batch, hiveTupleDecoder *decoder,
+				 Datum *values, bool *nulls)
+{
+	TupleDesc	tupdesc = decoder->attinmeta->tupdesc;
+	int			i;
+
+	if (batch->row >= batch->nrows)
+		return false;
+
+	/* Java produces valid UTF-8, so only other encodings need a look */
+	if (batch->row == 0)
+		batch->verbatim = (GetDatabaseEncoding() == PG_UTF8 ||
+						   hiveBatchTextIsAscii(batch));
+
+	for (i = 0; i < batch->ncols; i++)
+	{
+		int32		len = hiveBatchReadInt32(batch);
+
+		if (len >= 0 && batch->pos + len > batch->len)
+			elog(ERROR, HIVE_FDW_NAME ": malformed row batch");
+
+		/* Extra remote columns are skipped, dropped ones stay NULL */
+		if (i < tupdesc->natts)
+		{
+			nulls[i] = (len < 0 || TupleDescAttr(tupdesc, i)->attisdropped);
+			values[i] = nulls[i] ? (Datum) 0 :
+				hiveBatchCellDatum(batch, batch->kinds[i], len, decoder, i);
+		}
+
+		if (len > 0)
+			batch->pos += len;
+	}
+
+	for (; i < tupdesc->natts; i++)
+	{
+		values[i] = (Datum) 0;
+		nulls[i] = true;
+	}
+
+	batch->row++;
+	return true;
+}
+
+/*
+ * Check whether every text cell of the batch is plain ASCII, which is
+ * the same in UTF-8 and all server encodings. The batch position is left
+ * unchanged.
+ */
+static bool
+hiveBatchTextIsAscii(hiveRowBatch *batch)
+{
+	Size		pos = batch->pos;
+	int			row;
+	int			i;
+	bool		has_text = false;
+
+	for (i = 0; i < batch->ncols; i++)
+		has_text |= (batch->kinds[i] == HIVE_CELL_TEXT ||
+					 batch->kinds[i] == HIVE_CELL_JSON);
+	if (!has_text)
+		return true;
+
+	for (row = batch->row; row < batch->nrows; row++)
+	{
+		for (i = 0; i < batch->ncols; i++)
+		{
+			int32		len;
+
+			if (pos + sizeof(int32) > batch->len)
+				elog(ERROR, HIVE_FDW_NAME ": malformed row batch");
+			memcpy(&len, batch->data + pos, sizeof(int32));
+			pos += sizeof(int32);
+
+			if (len <= 0)
+				continue;
+			if (pos + len > batch->len)
+				elog(ERROR, HIVE_FDW_NAME ": malformed row batch");
+
+			if ((batch->kinds[i] == HIVE_CELL_TEXT ||
+				 batch->kinds[i] == HIVE_CELL_JSON) &&
+				!hive_is_ascii(batch->data + pos, len))
+				return false;
+			pos += len;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Turn the cell at the current position of the batch into a Datum for
+ * attribute "attnum". Binary cells are used as they are when the column
+ * type matches; otherwise they are formatted as text for the column's
+ * input function, just as text cells are.
+ */
+static Datum
+hiveBatchCellDatum(hiveRowBatch *batch, char kind, int32 len,
+				   hiveTupleDecoder *decoder, int attnum)
+{
+	AttInMetadata *attinmeta = decoder->attinmeta;
+	Oid			typid = TupleDescAttr(attinmeta->tupdesc, attnum)->atttypid;
+	const char *data = batch->data + batch->pos;
+	int32		i32;
+	int64		i64;
+	float4		f4;
+	float8		f8;
+
+	switch (kind)
+	{
+		case HIVE_CELL_INT4:
+			memcpy(&i32, data, sizeof(int32));
+			if (typid == INT4OID)
+				return Int32GetDatum(i32);
+			if (typid == INT8OID)
+				return Int64GetDatum((int64) i32);
+			break;
+		case HIVE_CELL_INT8:
+			memcpy(&i64, data, sizeof(int64));
+			if (typid == INT8OID)
+				return Int64GetDatum(i64);
+			break;
+		case HIVE_CELL_FLOAT4:
+			memcpy(&f4, data, sizeof(float4));
+			if (typid == FLOAT4OID)
+				return Float4GetDatum(f4);
+			if (typid == FLOAT8OID)
+				return Float8GetDatum((float8) f4);
+			break;
+		case HIVE_CELL_FLOAT8:
+			memcpy(&f8, data, sizeof(float8));
+			if (typid == FLOAT8OID)
+				return Float8GetDatum(f8);
+			break;
+		case HIVE_CELL_BOOL:
+			if (typid == BOOLOID)
+				return BoolGetDatum(data[0] != 0);
+			break;
+		case HIVE_CELL_DATE:
+			if (typid == DATEOID)
+				return DateADTGetDatum(hiveBatchDate(data));
+			break;
+		case HIVE_CELL_TIMESTAMP:
+			/* Columns with a precision need rounding, leave that to timestamp_in */
+			if (typid == TIMESTAMPOID && attinmeta->atttypmods[attnum] < 0)
+				return TimestampGetDatum(hiveBatchTimestamp(data));
+			break;
+		case HIVE_CELL_DECIMAL:
+#if PG_VERSION_NUM >= 140000
+			if (typid == NUMERICOID && len == HIVE_DECIMAL_CELL_LEN)
+			{
+				int32		typmod = attinmeta->atttypmods[attnum];
+				Numeric		num;
+
+				memcpy(&i32, data, sizeof(int32));
+				memcpy(&i64, data + sizeof(int32), sizeof(int64));
+				num = int64_div_fast_to_numeric(i64, i32);
+
+				/* Apply the precision and scale of numeric(p,s) columns */
+				if (typmod >= 0)
+					return DirectFunctionCall2(numeric, NumericGetDatum(num),
+											   Int32GetDatum(typmod));
+				return NumericGetDatum(num);
+			}
+#endif
+			break;
+		case HIVE_CELL_JSON:
+			if (decoder->arrays[attnum].elemtype != InvalidOid)
+				return hiveBatchJsonArray(batch, data, len, &decoder->arrays[attnum],
+										  attinmeta->atttypmods[attnum]);
+			/* FALLTHROUGH */
+		case HIVE_CELL_TEXT:
+			if (typid == TEXTOID ||
+				(typid == VARCHAROID && attinmeta->atttypmods[attnum] < 0))
+			{
+				/*
+				 * Take the bytes as they are unless they need converting or
+				 * hold an embedded NUL that textin would have cut them at.
+				 */
+				if (batch->verbatim && memchr(data, '\0', len) == NULL)
+					return hiveBatchVarlena(data, len);
+				return PointerGetDatum(cstring_to_text(hiveBatchCellString(batch, kind,
+																		   data, len)));
+			}
+			break;
+		case HIVE_CELL_BYTES:
+			if (typid == BYTEAOID)
+				return hiveBatchVarlena(data, len);
+			break;
+		default:
+			elog(ERROR, HIVE_FDW_NAME ": unknown cell kind %d in row batch", kind);
+	}
+
+	return InputFunctionCall(&attinmeta->attinfuncs[attnum],
+							 hiveBatchCellString(batch, kind, data, len),
+							 attinmeta->attioparams[attnum],
+							 attinmeta->atttypmods[attnum]);
+}
+
+/*
+ * Build an array from a cell holding a JSON array, as Hive sends ARRAY
+ * values. The JSON is parsed by jsonb_in; each element is then passed to
+ * the input function of the element type. Nested arrays, maps and
+ * structs become JSON text elements.
+ */
+static Datum
+hiveBatchJsonArray(hiveRowBatch *batch, const char *data, int32 len,
+				   hiveArrayInput *array, int32 typmod)
+{
+	char	   *json = hiveBatchCellString(batch, HIVE_CELL_JSON, data, len);
+	Jsonb	   *jb = DatumGetJsonbP(DirectFunctionCall1(jsonb_in, CStringGetDatum(json)));
+	JsonbIterator *it;
+	JsonbValue	v;
+	JsonbIteratorToken tok;
+	Datum	   *elems;
+	bool	   *elemnulls;
+	int			nelems = 0;
+	int			dims[1];
+	int			lbs[1] = {1};
+
+	if (!JB_ROOT_IS_ARRAY(jb) || JB_ROOT_IS_SCALAR(jb))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+				 errmsg("Hive value is not an array: %s", json)));
+
+	elems = palloc(sizeof(Datum) * Max(JB_ROOT_COUNT(jb), 1));
+	elemnulls = palloc(sizeof(bool) * Max(JB_ROOT_COUNT(jb), 1));
+
+	it = JsonbIteratorInit(&jb->root);
+	while ((tok = JsonbIteratorNext(&it, &v, true)) != WJB_DONE)
+	{
+		char	   *elem;
+
+		if (tok != WJB_ELEM)
+			continue;
+
+		switch (v.type)
+		{
+			case jbvNull:
+				elem = NULL;
+				break;
+			case jbvString:
+				elem = pnstrdup(v.val.string.val, v.val.string.len);
+				break;
+			case jbvNumeric:
+				elem = DatumGetCString(DirectFunctionCall1(numeric_out,
+														   NumericGetDatum(v.val.numeric)));
+				break;
+			case jbvBool:
+				elem = pstrdup(v.val.boolean ? "true" : "false");
+				break;
+			default:
+				/* A nested container */
+				elem = JsonbToCString(NULL, v.val.binary.data, v.val.binary.len);
+				break;
+		}
+
+		elemnulls[nelems] = (elem == NULL);
+		elems[nelems] = InputFunctionCall(&array->eleminput, elem,
+										  array->elemioparam, typmod);
+		nelems++;
+	}
+
+	dims[0] = nelems;
+	return PointerGetDatum(construct_md_array(elems, elemnulls, 1, dims, lbs,
+											  array->elemtype, array->elemlen,
+											  array->elembyval, array->elemalign));
+}
+
+/*
+ * Format a cell as a C string in the server encoding, for input
+ * functions. Binary cells are printed the way Hive prints them.
+ */
+static char *
+hiveBatchCellString(hiveRowBatch *batch, char kind, const char *data, int32 len)
+{
+	char		buf[32];
+	int32		i32;
+	int64		i64;
+	float4		f4;
+	float8		f8;
+
+	switch (kind)
+	{
+		case HIVE_CELL_INT4:
+			memcpy(&i32, data, sizeof(int32));
+			pg_ltoa(i32, buf);
+			return pstrdup(buf);
+		case HIVE_CELL_INT8:
+			memcpy(&i64, data, sizeof(int64));
+			pg_lltoa(i64, buf);
+			return pstrdup(buf);
+		case HIVE_CELL_FLOAT4:
+			memcpy(&f4, data, sizeof(float4));
+			return DatumGetCString(DirectFunctionCall1(float4out, Float4GetDatum(f4)));
+		case HIVE_CELL_FLOAT8:
+			memcpy(&f8, data, sizeof(float8));
+			return DatumGetCString(DirectFunctionCall1(float8out, Float8GetDatum(f8)));
+		case HIVE_CELL_BOOL:
+			return pstrdup(data[0] ? "true" : "false");
+		case HIVE_CELL_DATE:
+			return DatumGetCString(DirectFunctionCall1(date_out,
+													   DateADTGetDatum(hiveBatchDate(data))));
+		case HIVE_CELL_TIMESTAMP:
+			return DatumGetCString(DirectFunctionCall1(timestamp_out,
+													   TimestampGetDatum(hiveBatchTimestamp(data))));
+		case HIVE_CELL_DECIMAL:
+			if (len == HIVE_DECIMAL_CELL_LEN)
+			{
+				memcpy(&i32, data, sizeof(int32));
+				memcpy(&i64, data + sizeof(int32), sizeof(int64));
+				return hiveBatchDecimalString(i32, i64);
+			}
+			/* Too large for an int64, Java sent the plain text form */
+			return pnstrdup(data, len);
+		case HIVE_CELL_BYTES:
+			return DatumGetCString(DirectFunctionCall1(byteaout,
+													   hiveBatchVarlena(data, len)));
+		default:
+			if (batch->verbatim)
+				return pnstrdup(data, len);
+			return pg_any_to_server(pnstrdup(data, len), len, PG_UTF8);
+	}
+}
+
+/*
+ * Convert a date cell, in days since the Unix epoch, to a DateADT.
+ */
+static DateADT
+hiveBatchDate(const char *data)
+{
+	int32		days;
+
+	memcpy(&days, data, sizeof(int32));
+	days -= HIVE_EPOCH_SHIFT_DAYS;
+
+	if (!IS_VALID_DATE(days))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+				 errmsg("date out of range")));
+
+	return (DateADT) days;
+}
+
+/*
+ * Convert a timestamp cell, in microseconds since the Unix epoch, to a
+ * Timestamp.
+ */
+static Timestamp
+hiveBatchTimestamp(const char *data)
+{
+	int64		usecs;
+
+	memcpy(&usecs, data, sizeof(int64));
+
+	if (usecs < PG_INT64_MIN + HIVE_EPOCH_SHIFT_USECS)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+				 errmsg("timestamp out of range")));
+	usecs -= HIVE_EPOCH_SHIFT_USECS;
+
+	if (!IS_VALID_TIMESTAMP(usecs))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+				 errmsg("timestamp out of range")));
+
+	return (Timestamp) usecs;
+}
+
+/*
+ * Format unscaled * 10^-scale as plain decimal text.
+ */
+static char *
+hiveBatchDecimalString(int32 scale, int64 unscaled)
+{
+	char		digits[32];
+	uint64		magnitude;
+	int			ndigits;
+	StringInfoData buf;
+
+	/* Negate as unsigned so that PG_INT64_MIN does not overflow */
+	magnitude = (unscaled < 0) ? -((uint64) unscaled) : (uint64) unscaled;
+	ndigits = snprintf(digits, sizeof(digits), UINT64_FORMAT, magnitude);
+
+	initStringInfo(&buf);
+	if (unscaled < 0)
+		appendStringInfoChar(&buf, '-');
+
+	if (scale <= 0)
+		appendStringInfoString(&buf, digits);
+	else if (ndigits > scale)
+	{
+		appendBinaryStringInfo(&buf, digits, ndigits - scale);
+		appendStringInfoChar(&buf, '.');
+		appendStringInfoString(&buf, digits + ndigits - scale);
+	}
+	else
+	{
+		appendStringInfoString(&buf, "0.");
+		for (; scale > ndigits; scale--)
+			appendStringInfoChar(&buf, '0');
+		appendStringInfoString(&buf, digits);
+	}
+
+	return buf.data;
+}
+
+/*
+ * Copy a cell into a new text or bytea varlena.
+ */
+static Datum
+hiveBatchVarlena(const char *data, int32 len)
+{
+	struct varlena *result = (struct varlena *) palloc(len + VARHDRSZ);
+
+	SET_VARSIZE(result, len + VARHDRSZ);
+	memcpy(VARDATA(result), data, len);
+
+	return PointerGetDatum(result);
+}
+
+/*
+ * Read a native-endian int32 at the current position of the batch.
+ */
+static int32
+hiveBatchReadInt32(hiveRowBatch *batch)
+{
+	int32		result;
+
+	if (batch->pos + sizeof(int32) > batch->len)
+		elog(ERROR, HIVE_FDW_NAME ": malformed row batch");
+
+	memcpy(&result, batch->data + batch->pos, sizeof(int32));
+	batch->pos += sizeof(int32);
+
+	return result;
+}
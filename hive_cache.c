@@ -0,0 +1,539 @@
+/*-------------------------------------------------------------------------
+ *
+ * hive_cache.c
+ *                Result cache for hive_fdw
+ *
+ * Dashboards send the same HiveQL again and again, and every time Hive
+ * starts a new job for it. For foreign tables with the result_cache_ttl
+ * option, the row batches of a completed scan are written to a file,
+ * and scans of the same query by the same user within that many seconds
+ * replay the file instead of asking Hive.
+ *
+ * A file holds a header with the query, then every batch as an int32
+ * length followed by the batch exactly as HiveJDBCUtils.FetchBatch
+ * produced it. It is written under a name unique to the backend and
+ * renamed into place once the last batch is in, so readers never see a
+ * partial result, and scans that stop early leave nothing behind. The
+ * file's modification time tells its age.
+ *
+ * Files are named like PostgreSQL's own temporary files, so the server
+ * removes them at startup and base backups skip them. The name holds
+ * the database, server and user and a hash of the query, and the query
+ * in the header guards against hash collisions. Expired files are
+ * removed when a lookup finds them, and the oldest files make room
+ * whenever the cache as a whole would grow beyond
+ * hive_fdw.result_cache_total_size.
+ *
+ * Copyright (c) 2012-2020, BigSQL
+ *
+ * IDENTIFICATION
+ *                hive_fdw/src/hive_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "hive_fdw.h"
+
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "miscadmin.h"
+#include "storage/fd.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+
+/* The temporary file directory of the default tablespace */
+#define HIVE_CACHE_DIR				"base/pgsql_tmp"
+#define HIVE_CACHE_PREFIX			"pgsql_tmphive_fdw_"
+
+#define HIVE_CACHE_MAGIC			0x48524331	/* "HRC1" */
+
+/* GUC variables */
+static int	hive_cache_max_size = 1024 * 1024;	/* in kB */
+static int	hive_cache_total_size = 10 * 1024 * 1024;	/* in kB, -1 for no limit */
+
+/* A file of the cache, as seen by hive_cache_evict */
+typedef struct hiveCacheFile
+{
+	char	   *path;
+	time_t		mtime;
+	off_t		size;
+} hiveCacheFile;
+
+static char *hive_cache_path(Oid serverid, const char *query);
+static uint64 hive_cache_hash(const char *query);
+static bool hive_cache_write_bytes(hiveResultCache *cache, const void *data, Size len);
+static void hive_cache_abandon(hiveResultCache *cache);
+static void hive_cache_remove_tmp(void *arg);
+static bool hive_cache_evict(Size incoming);
+static int	hive_cache_file_cmp(const void *a, const void *b);
+
+PG_FUNCTION_INFO_V1(hive_fdw_result_cache_reset);
+
+/*
+ * hive_cache_init
+ *		Define the result cache GUCs
+ */
+void
+hive_cache_init(void)
+{
+	DefineCustomIntVariable("hive_fdw.result_cache_max_size",
+							"Largest result hive_fdw keeps in its result cache.",
+							"Larger results are not cached. Zero disables the result cache.",
+							&hive_cache_max_size,
+							1024 * 1024, 0, INT_MAX,
+							PGC_SUSET,
+							GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("hive_fdw.result_cache_total_size",
+							"Disk space all results in hive_fdw's result cache may use.",
+							"The oldest results are removed to make room for new ones. -1 means no limit.",
+							&hive_cache_total_size,
+							10 * 1024 * 1024, -1, INT_MAX,
+							PGC_SUSET,
+							GUC_UNIT_KB,
+							NULL, NULL, NULL);
+}
+
+/*
+ * hive_cache_lookup
+ *		Open the cached result of a query if there is one younger than
+ *		ttl seconds. Returns NULL otherwise.
+ */
+hiveResultCache *
+hive_cache_lookup(Oid serverid, const char *query, int ttl, MemoryContext cxt)
+{
+	MemoryContext oldcontext = MemoryContextSwitchTo(cxt);
+	hiveResultCache *cache;
+	char	   *path = hive_cache_path(serverid, query);
+	struct stat st;
+	FILE	   *file;
+	uint32		header[2];
+	char	   *cached_query;
+	size_t		len = strlen(query);
+
+	if (hive_cache_max_size == 0 || stat(path, &st) != 0)
+	{
+		MemoryContextSwitchTo(oldcontext);
+		return NULL;
+	}
+
+	/*
+	 * Nobody asks for it again within its time, so it only takes space.
+	 * Another backend may just have renamed a fresh result into place,
+	 * which merely costs that result.
+	 */
+	if (time(NULL) - st.st_mtime >= ttl)
+	{
+		elog(DEBUG1, HIVE_FDW_NAME ": removing expired result \"%s\"", path);
+		(void) unlink(path);
+		MemoryContextSwitchTo(oldcontext);
+		return NULL;
+	}
+
+	file = AllocateFile(path, PG_BINARY_R);
+	if (file == NULL)
+	{
+		MemoryContextSwitchTo(oldcontext);
+		return NULL;
+	}
+
+	/* The file may belong to another query with the same hash */
+	cached_query = palloc(len);
+	if (fread(header, sizeof(header), 1, file) != 1 ||
+		header[0] != HIVE_CACHE_MAGIC || header[1] != len ||
+		fread(cached_query, 1, len, file) != len ||
+		memcmp(cached_query, query, len) != 0)
+	{
+		FreeFile(file);
+		MemoryContextSwitchTo(oldcontext);
+		return NULL;
+	}
+	pfree(cached_query);
+
+	cache = (hiveResultCache *) palloc0(sizeof(hiveResultCache));
+	cache->cxt = cxt;
+	cache->file = file;
+	cache->path = path;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	elog(DEBUG1, HIVE_FDW_NAME ": replaying cached result \"%s\"", path);
+
+	return cache;
+}
+
+/*
+ * hive_cache_read
+ *		Read the next batch of a cached result into batch. Returns false
+ *		at the end of the result.
+ */
+bool
+hive_cache_read(hiveResultCache *cache, hiveRowBatch *batch)
+{
+	uint32		len;
+
+	if (fread(&len, sizeof(len), 1, cache->file) != 1)
+	{
+		hiveBatchInit(batch, NULL, 0);
+		return false;
+	}
+
+	if (len > cache->bufsize)
+	{
+		cache->buf = cache->buf ?
+			repalloc(cache->buf, len) :
+			MemoryContextAlloc(cache->cxt, len);
+		cache->bufsize = len;
+	}
+
+	if (fread(cache->buf, 1, len, cache->file) != len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read cached result \"%s\"", cache->path)));
+
+	hiveBatchInit(batch, cache->buf, len);
+	return true;
+}
+
+/*
+ * hive_cache_create
+ *		Start writing the result of a query to the cache. Returns NULL if
+ *		the file cannot be created, which only means no caching.
+ */
+hiveResultCache *
+hive_cache_create(Oid serverid, const char *query, MemoryContext cxt)
+{
+	MemoryContext oldcontext;
+	hiveResultCache *cache;
+	MemoryContextCallback *cb;
+	uint32		header[2];
+
+	if (hive_cache_max_size == 0)
+		return NULL;
+
+	oldcontext = MemoryContextSwitchTo(cxt);
+
+	cache = (hiveResultCache *) palloc0(sizeof(hiveResultCache));
+	cache->cxt = cxt;
+	cache->writing = true;
+	cache->path = hive_cache_path(serverid, query);
+	cache->tmp_path = psprintf("%s.%d.tmp", cache->path, MyProcPid);
+
+	/* Don't leave a partial file behind if the query fails */
+	cb = (MemoryContextCallback *) palloc(sizeof(MemoryContextCallback));
+	cb->func = hive_cache_remove_tmp;
+	cb->arg = cache;
+	MemoryContextRegisterResetCallback(cxt, cb);
+
+	MemoryContextSwitchTo(oldcontext);
+
+#if PG_VERSION_NUM >= 110000
+	(void) MakePGDirectory(HIVE_CACHE_DIR);
+#else
+	(void) mkdir(HIVE_CACHE_DIR, S_IRWXU);
+#endif
+
+	cache->file = AllocateFile(cache->tmp_path, PG_BINARY_W);
+	if (cache->file == NULL)
+	{
+		elog(DEBUG1, HIVE_FDW_NAME ": could not create \"%s\": %m", cache->tmp_path);
+		return NULL;
+	}
+
+	header[0] = HIVE_CACHE_MAGIC;
+	header[1] = strlen(query);
+	if (!hive_cache_write_bytes(cache, header, sizeof(header)) ||
+		!hive_cache_write_bytes(cache, query, header[1]))
+		return NULL;
+
+	return cache;
+}
+
+/*
+ * hive_cache_write
+ *		Append a batch fetched from Hive to the result being cached.
+ *		Results that grow beyond hive_fdw.result_cache_max_size, or that
+ *		cannot be written, are given up on quietly.
+ */
+void
+hive_cache_write(hiveResultCache *cache, hiveRowBatch *batch)
+{
+	uint32		len = batch->len;
+
+	if (cache->file == NULL || batch->nrows == 0)
+		return;
+
+	if (cache->written + sizeof(len) + len > (Size) hive_cache_max_size * 1024)
+	{
+		elog(DEBUG1, HIVE_FDW_NAME ": result too large for the cache");
+		hive_cache_abandon(cache);
+		return;
+	}
+
+	if (hive_cache_write_bytes(cache, &len, sizeof(len)))
+		(void) hive_cache_write_bytes(cache, batch->data, len);
+}
+
+/*
+ * hive_cache_finish
+ *		Close a cached result. A result being written is only kept if the
+ *		scan read it to the end.
+ */
+void
+hive_cache_finish(hiveResultCache *cache, bool complete)
+{
+	if (cache->file == NULL)
+		return;
+
+	if (!cache->writing)
+	{
+		FreeFile(cache->file);
+		cache->file = NULL;
+		return;
+	}
+
+	if (!complete)
+	{
+		hive_cache_abandon(cache);
+		return;
+	}
+
+	if (FreeFile(cache->file) != 0)
+	{
+		cache->file = NULL;
+		hive_cache_abandon(cache);
+		return;
+	}
+	cache->file = NULL;
+
+	if (!hive_cache_evict(cache->written))
+	{
+		elog(DEBUG1, HIVE_FDW_NAME ": result too large for the cache");
+		hive_cache_abandon(cache);
+		return;
+	}
+
+	if (rename(cache->tmp_path, cache->path) != 0)
+	{
+		elog(DEBUG1, HIVE_FDW_NAME ": could not rename \"%s\": %m", cache->tmp_path);
+		hive_cache_abandon(cache);
+		return;
+	}
+	cache->tmp_path = NULL;
+
+	elog(DEBUG1, HIVE_FDW_NAME ": cached result \"%s\"", cache->path);
+}
+
+/*
+ * hive_fdw_result_cache_reset
+ *		Remove the cached results of the current database
+ */
+Datum
+hive_fdw_result_cache_reset(PG_FUNCTION_ARGS)
+{
+	char	   *prefix = psprintf(HIVE_CACHE_PREFIX "%u_", MyDatabaseId);
+	DIR		   *dir;
+	struct dirent *de;
+
+	dir = AllocateDir(HIVE_CACHE_DIR);
+	if (dir == NULL)
+		PG_RETURN_VOID();
+
+	while ((de = ReadDir(dir, HIVE_CACHE_DIR)) != NULL)
+	{
+		char	   *path;
+
+		if (strncmp(de->d_name, prefix, strlen(prefix)) != 0)
+			continue;
+
+		path = psprintf("%s/%s", HIVE_CACHE_DIR, de->d_name);
+		if (unlink(path) != 0 && errno != ENOENT)
+			ereport(WARNING,
+					(errcode_for_file_access(),
+					 errmsg("could not remove file \"%s\": %m", path)));
+		pfree(path);
+	}
+
+	FreeDir(dir);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * hive_cache_evict
+ *		Remove the oldest cached results, of all databases, until a new
+ *		one of incoming bytes fits into hive_fdw.result_cache_total_size.
+ *		Results still being written are left alone. Returns false, and
+ *		removes nothing, if the new result alone is too large.
+ */
+static bool
+hive_cache_evict(Size incoming)
+{
+	DIR		   *dir;
+	struct dirent *de;
+	hiveCacheFile *files;
+	int			nfiles = 0;
+	int			maxfiles = 64;
+	uint64		total = incoming;
+	uint64		limit;
+	int			i;
+
+	if (hive_cache_total_size < 0)
+		return true;
+	limit = (uint64) hive_cache_total_size * 1024;
+	if (incoming > limit)
+		return false;
+
+	dir = AllocateDir(HIVE_CACHE_DIR);
+	if (dir == NULL)
+		return true;
+
+	files = (hiveCacheFile *) palloc(sizeof(hiveCacheFile) * maxfiles);
+	while ((de = ReadDir(dir, HIVE_CACHE_DIR)) != NULL)
+	{
+		char	   *path;
+		struct stat st;
+		size_t		namelen = strlen(de->d_name);
+
+		if (strncmp(de->d_name, HIVE_CACHE_PREFIX, strlen(HIVE_CACHE_PREFIX)) != 0 ||
+			(namelen > 4 && strcmp(de->d_name + namelen - 4, ".tmp") == 0))
+			continue;
+
+		path = psprintf("%s/%s", HIVE_CACHE_DIR, de->d_name);
+		if (stat(path, &st) != 0)
+		{
+			pfree(path);
+			continue;
+		}
+
+		if (nfiles == maxfiles)
+		{
+			maxfiles *= 2;
+			files = (hiveCacheFile *) repalloc(files, sizeof(hiveCacheFile) * maxfiles);
+		}
+		files[nfiles].path = path;
+		files[nfiles].mtime = st.st_mtime;
+		files[nfiles].size = st.st_size;
+		nfiles++;
+		total += st.st_size;
+	}
+	FreeDir(dir);
+
+	if (total > limit)
+	{
+		qsort(files, nfiles, sizeof(hiveCacheFile), hive_cache_file_cmp);
+
+		for (i = 0; i < nfiles && total > limit; i++)
+		{
+			elog(DEBUG1, HIVE_FDW_NAME ": evicting cached result \"%s\"", files[i].path);
+			if (unlink(files[i].path) == 0 || errno == ENOENT)
+				total -= files[i].size;
+		}
+	}
+
+	for (i = 0; i < nfiles; i++)
+		pfree(files[i].path);
+	pfree(files);
+
+	return true;
+}
+
+/*
+ * hive_cache_file_cmp
+ *		qsort comparator putting the oldest files first
+ */
+static int
+hive_cache_file_cmp(const void *a, const void *b)
+{
+	const hiveCacheFile *fa = (const hiveCacheFile *) a;
+	const hiveCacheFile *fb = (const hiveCacheFile *) b;
+
+	if (fa->mtime < fb->mtime)
+		return -1;
+	if (fa->mtime > fb->mtime)
+		return 1;
+	return 0;
+}
+
+/*
+ * hive_cache_path
+ *		Name of the cache file of a query run by the current user
+ */
+static char *
+hive_cache_path(Oid serverid, const char *query)
+{
+	return psprintf("%s/" HIVE_CACHE_PREFIX "%u_%u_%u_" UINT64_FORMAT,
+					HIVE_CACHE_DIR, MyDatabaseId, serverid, GetUserId(),
+					hive_cache_hash(query));
+}
+
+/*
+ * hive_cache_hash
+ *		64-bit FNV-1a hash of a query
+ */
+static uint64
+hive_cache_hash(const char *query)
+{
+	uint64		hash = UINT64CONST(0xcbf29ce484222325);
+	const unsigned char *p;
+
+	for (p = (const unsigned char *) query; *p; p++)
+	{
+		hash ^= *p;
+		hash *= UINT64CONST(0x100000001b3);
+	}
+
+	return hash;
+}
+
+static bool
+hive_cache_write_bytes(hiveResultCache *cache, const void *data, Size len)
+{
+	if (fwrite(data, 1, len, cache->file) != len)
+	{
+		elog(DEBUG1, HIVE_FDW_NAME ": could not write \"%s\": %m", cache->tmp_path);
+		hive_cache_abandon(cache);
+		return false;
+	}
+
+	cache->written += len;
+	return true;
+}
+
+/*
+ * hive_cache_abandon
+ *		Stop writing a result and remove what was written
+ */
+static void
+hive_cache_abandon(hiveResultCache *cache)
+{
+	if (cache->file != NULL)
+	{
+		FreeFile(cache->file);
+		cache->file = NULL;
+	}
+	hive_cache_remove_tmp(cache);
+}
+
+/*
+ * hive_cache_remove_tmp
+ *		Remove a result file that was not completed. Also the memory
+ *		context callback for queries that fail; the file itself is closed
+ *		at the end of the transaction.
+ */
+static void
+hive_cache_remove_tmp(void *arg)
+{
+	hiveResultCache *cache = (hiveResultCache *) arg;
+
+	if (cache->tmp_path != NULL)
+	{
+		(void) unlink(cache->tmp_path);
+		cache->tmp_path = NULL;
+	}
+}
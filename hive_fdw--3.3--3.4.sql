@@ -0,0 +1,63 @@
+/* hive_fdw--3.3--3.4.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION hive_fdw UPDATE TO '3.4'" to load this file. \quit
+
+CREATE FUNCTION hive_fdw_stat(
+    OUT dbid oid,
+    OUT serverid oid,
+    OUT relid oid,
+    OUT queries bigint,
+    OUT rows bigint,
+    OUT bytes bigint,
+    OUT batches bigint,
+    OUT conn_opens bigint,
+    OUT conn_reuses bigint,
+    OUT jvm_creations bigint,
+    OUT jvm_create_time double precision,
+    OUT cancels bigint,
+    OUT errors bigint,
+    OUT total_execute_time double precision,
+    OUT total_first_row_time double precision,
+    OUT execute_time_histogram bigint[],
+    OUT first_row_time_histogram bigint[]
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+CREATE FUNCTION hive_fdw_stat_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+REVOKE ALL ON FUNCTION hive_fdw_stat_reset() FROM PUBLIC;
+
+-- Server and table names can only be looked up for the current database
+CREATE VIEW pg_stat_hive_fdw AS
+  SELECT s.dbid,
+         d.datname,
+         s.serverid,
+         fs.srvname,
+         s.relid,
+         c.relname,
+         s.queries,
+         s.rows,
+         s.bytes,
+         s.batches,
+         s.conn_opens,
+         s.conn_reuses,
+         s.jvm_creations,
+         s.jvm_create_time,
+         s.cancels,
+         s.errors,
+         s.total_execute_time,
+         s.total_first_row_time,
+         s.execute_time_histogram,
+         s.first_row_time_histogram
+    FROM hive_fdw_stat() s
+    LEFT JOIN pg_database d ON d.oid = s.dbid
+    LEFT JOIN pg_foreign_server fs ON fs.oid = s.serverid
+         AND d.datname = current_database()
+    LEFT JOIN pg_class c ON c.oid = s.relid
+         AND d.datname = current_database();
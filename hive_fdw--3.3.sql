@@ -1,14 +0,0 @@
-
-CREATE FUNCTION hive_fdw_handler()
-RETURNS fdw_handler
-AS 'MODULE_PATHNAME'
-LANGUAGE C STRICT;
-
-CREATE FUNCTION hive_fdw_validator(text[], oid)
-RETURNS void
-AS 'MODULE_PATHNAME'
-LANGUAGE C STRICT;
-
-CREATE FOREIGN DATA WRAPPER hive_fdw
-  HANDLER hive_fdw_handler
-  VALIDATOR hive_fdw_validator;
@@ -0,0 +1,32 @@
+/* hive_fdw--3.4--3.5.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION hive_fdw UPDATE TO '3.5'" to load this file. \quit
+
+-- Metadata cached by the calling backend for planning
+CREATE FUNCTION hive_fdw_metadata_cache(
+    OUT serverid oid,
+    OUT relid oid,
+    OUT rows double precision,
+    OUT bytes bigint,
+    OUT files bigint,
+    OUT partitions bigint,
+    OUT fetched_at timestamp with time zone,
+    OUT hits bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+CREATE FUNCTION hive_fdw_metadata_cache_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+-- Removes the cached results of the current database
+CREATE FUNCTION hive_fdw_result_cache_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+REVOKE ALL ON FUNCTION hive_fdw_result_cache_reset() FROM PUBLIC;
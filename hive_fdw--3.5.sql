@@ -0,0 +1,101 @@
+
+CREATE FUNCTION hive_fdw_handler()
+RETURNS fdw_handler
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION hive_fdw_validator(text[], oid)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FOREIGN DATA WRAPPER hive_fdw
+  HANDLER hive_fdw_handler
+  VALIDATOR hive_fdw_validator;
+
+CREATE FUNCTION hive_fdw_stat(
+    OUT dbid oid,
+    OUT serverid oid,
+    OUT relid oid,
+    OUT queries bigint,
+    OUT rows bigint,
+    OUT bytes bigint,
+    OUT batches bigint,
+    OUT conn_opens bigint,
+    OUT conn_reuses bigint,
+    OUT jvm_creations bigint,
+    OUT jvm_create_time double precision,
+    OUT cancels bigint,
+    OUT errors bigint,
+    OUT total_execute_time double precision,
+    OUT total_first_row_time double precision,
+    OUT execute_time_histogram bigint[],
+    OUT first_row_time_histogram bigint[]
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+CREATE FUNCTION hive_fdw_stat_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+REVOKE ALL ON FUNCTION hive_fdw_stat_reset() FROM PUBLIC;
+
+-- Server and table names can only be looked up for the current database
+CREATE VIEW pg_stat_hive_fdw AS
+  SELECT s.dbid,
+         d.datname,
+         s.serverid,
+         fs.srvname,
+         s.relid,
+         c.relname,
+         s.queries,
+         s.rows,
+         s.bytes,
+         s.batches,
+         s.conn_opens,
+         s.conn_reuses,
+         s.jvm_creations,
+         s.jvm_create_time,
+         s.cancels,
+         s.errors,
+         s.total_execute_time,
+         s.total_first_row_time,
+         s.execute_time_histogram,
+         s.first_row_time_histogram
+    FROM hive_fdw_stat() s
+    LEFT JOIN pg_database d ON d.oid = s.dbid
+    LEFT JOIN pg_foreign_server fs ON fs.oid = s.serverid
+         AND d.datname = current_database()
+    LEFT JOIN pg_class c ON c.oid = s.relid
+         AND d.datname = current_database();
+
+-- Metadata cached by the calling backend for planning
+CREATE FUNCTION hive_fdw_metadata_cache(
+    OUT serverid oid,
+    OUT relid oid,
+    OUT rows double precision,
+    OUT bytes bigint,
+    OUT files bigint,
+    OUT partitions bigint,
+    OUT fetched_at timestamp with time zone,
+    OUT hits bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+CREATE FUNCTION hive_fdw_metadata_cache_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+-- Removes the cached results of the current database
+CREATE FUNCTION hive_fdw_result_cache_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+REVOKE ALL ON FUNCTION hive_fdw_result_cache_reset() FROM PUBLIC;
@@ -20,7 +20,14 @@
 #include <unistd.h>
 #include <libpq/pqsignal.h>
 #include "funcapi.h"
+#include "access/htup_details.h"
 #include "access/reloptions.h"
+#include "access/sysattr.h"
+#include "access/xact.h"
+#if PG_VERSION_NUM >= 120000
+	#include "access/table.h"
+#endif
+#include "catalog/pg_attribute.h"
 #include "catalog/pg_foreign_server.h"
 #include "catalog/pg_foreign_table.h"
 #include "catalog/pg_user_mapping.h"
@@ -30,19 +37,34 @@
 #else
 	#include "optimizer/optimizer.h"
 #endif
+#if PG_VERSION_NUM >= 140000
+	#include "optimizer/appendinfo.h"
+#endif
 #include "utils/guc.h"
 #include "commands/defrem.h"
 #include "commands/explain.h"
+#include "executor/spi.h"
 #include "foreign/fdwapi.h"
 #include "foreign/foreign.h"
 #include "miscadmin.h"
 #include "mb/pg_wchar.h"
 #include "optimizer/cost.h"
+#include "parser/parsetree.h"
+#include "pgstat.h"
 #include "storage/fd.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
+#if PG_VERSION_NUM >= 120000
+	#include "utils/float.h"
+#endif
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/ps_status.h"
 #include "utils/rel.h"
+#include "utils/syscache.h"
+#include "utils/tuplestore.h"
 #include "storage/ipc.h"
+#include "storage/latch.h"
 
 #include "optimizer/pathnode.h"
 #include "optimizer/restrictinfo.h"
@@ -56,11 +78,26 @@
 
 PG_MODULE_MAGIC;
 
+/* Driver class used unless the server says otherwise */
+#define HIVE_DEFAULT_DRIVER		"org.apache.hive.jdbc.HiveDriver"
+
 static JNIEnv *env;
 static JavaVM *jvm;
 jobject		java_call;
 static bool InterruptFlag;		/* Used for checking for SIGINT interrupt */
 
+/*
+ * Raised by the SIGINT handler and watched by the cancel watcher thread of
+ * HiveJDBCUtils, which cancels the remote statement even while we are
+ * blocked inside a JNI call.
+ */
+static int32 hive_cancel_flag = 0;
+
+#if PG_VERSION_NUM >= 170000
+/* Custom wait event shown while a remote query runs */
+static uint32 hive_wait_event_query = 0;
+#endif
+
 
 /*
  * Describes the valid options for objects that use this wrapper.
@@ -92,6 +129,25 @@ static struct hiveFdwOption valid_options[] =
 	{"host", ForeignServerRelationId},
 	{"port", ForeignServerRelationId},
 	{"schema", ForeignTableRelationId},
+	{"column_name", AttributeRelationId},
+	{"hive_type", AttributeRelationId},
+	{"batch_size", ForeignServerRelationId},
+	{"batch_size", ForeignTableRelationId},
+	{"staging_dir", ForeignServerRelationId},
+	{"staging_dir", ForeignTableRelationId},
+	{"staging_uri", ForeignServerRelationId},
+	{"staging_uri", ForeignTableRelationId},
+	{"partition", ForeignTableRelationId},
+	{"transactional", ForeignTableRelationId},
+	{"filter", ForeignTableRelationId},
+	{"use_remote_estimate", ForeignServerRelationId},
+	{"use_remote_estimate", ForeignTableRelationId},
+	{"result_cache_ttl", ForeignTableRelationId},
+	{"drain_result", ForeignServerRelationId},
+	{"drain_result", ForeignTableRelationId},
+	{"extra_functions", ForeignServerRelationId},
+	{"extra_operators", ForeignServerRelationId},
+	{"extensions", ForeignServerRelationId},
 
 	/* Sentinel */
 	{NULL, InvalidOid}
@@ -107,9 +163,88 @@ typedef struct hiveFdwExecutionState
 	int			NumberOfRows;
 	int			NumberOfColumns;
 	jobject		java_call;
+	int			gateway_cursor; /* cursor in the gateway worker, or -1 */
 	List	   *retrieved_attrs;	/* list of retrieved attribute numbers */
+	hiveRowBatch batch;			/* batch of rows currently being returned */
+	bool		eof;			/* no more batches to fetch */
+	MemoryContext row_cxt;		/* context reset for every returned row */
+	AttInMetadata *attinmeta;
+	hiveTupleDecoder *decoder;	/* turns batch rows into tuple values */
+	Datum	   *values;			/* attribute values of the current row */
+	bool	   *nulls;			/* attribute nulls of the current row */
+	hiveScanMetrics metrics;	/* counters for EXPLAIN ANALYZE */
+	Oid			serverid;		/* for cumulative statistics */
+	Oid			relid;			/* foreign table, InvalidOid for joins */
+	hiveResultCache *cache;		/* result replayed or being cached, or NULL */
+	Tuplestorestate *tuplestore;	/* whole result, with drain_result */
+	TupleTableSlot *drain_slot; /* for reading it, on PostgreSQL 12+ */
+	bool		drained;		/* tuplestore holds the whole result */
+	bool		released;		/* connection given up after draining */
 } hiveFdwExecutionState;
 
+/*
+ * FDW-specific information for ResultRelInfo.ri_FdwState. Hive writes
+ * a new file and may launch a job for every INSERT, so rows are collected
+ * into a multi-row INSERT ... VALUES and sent batch_size at a time.
+ */
+typedef struct hiveFdwModifyState
+{
+	Relation	rel;
+	hiveFdwExecutionState *conn;	/* connection the rows are sent on */
+	char	   *query;			/* INSERT INTO ... VALUES, without rows */
+	List	   *target_attrs;	/* attribute numbers to insert */
+	FmgrInfo   *p_flinfo;		/* output function of every attribute */
+	int			batch_size;		/* rows per remote INSERT */
+	bool		flush_each_row; /* AFTER ROW triggers must see the row */
+	StringInfoData sql;			/* statement being built */
+	int			nrows;			/* rows in sql, or in the staged file */
+	MemoryContext temp_cxt;		/* context for the text of a row */
+
+	/* Bulk load through a staged file, if the staging_dir option is set */
+	FILE	   *staging;		/* staged file, or NULL */
+	char	   *staging_file;	/* its path on this host */
+	char	   *load_query;		/* LOAD DATA statement for it */
+} hiveFdwModifyState;
+
+/*
+ * FDW-specific information for ForeignScanState.fdw_state of an UPDATE or
+ * DELETE that runs entirely on the Hive server
+ */
+typedef struct hiveFdwDirectModifyState
+{
+	hiveFdwExecutionState *conn;	/* connection the statement runs on */
+	char	   *query;			/* UPDATE or DELETE statement */
+	bool		set_processed;	/* count the rows in es_processed */
+	bool		executed;		/* statement has been run */
+	int64		num_tuples;		/* rows changed, 0 if not reported */
+} hiveFdwDirectModifyState;
+
+/* Makes the names of staged files unique within a backend */
+static uint32 hive_staging_counter = 0;
+
+#if PG_VERSION_NUM >= 140000
+/*
+ * A TRUNCATE waiting for the end of its transaction. Hive cannot take a
+ * TRUNCATE back, so it is only sent once PostgreSQL is about to commit.
+ */
+typedef struct hivePendingTruncate
+{
+	Oid			relid;			/* foreign table that was truncated */
+	char	   *query;			/* TRUNCATE TABLE statement for it */
+	int			nestlevel;		/* subtransaction that truncated it */
+} hivePendingTruncate;
+
+/* TRUNCATE statements to send at commit, in TopTransactionContext */
+static List *hive_pending_truncates = NIL;
+#endif
+
+/*
+ * Connections of this backend's own JVM that are open, in TopMemoryContext.
+ * Scans and modifications release theirs when they end; whatever is left
+ * when a transaction aborts belonged to a statement that failed.
+ */
+static List *hive_open_connections = NIL;
+
 
 /*
  * SQL functions
@@ -117,6 +252,8 @@ typedef struct hiveFdwExecutionState
 extern Datum hive_fdw_handler(PG_FUNCTION_ARGS);
 extern Datum hive_fdw_validator(PG_FUNCTION_ARGS);
 
+void		_PG_init(void);
+
 PG_FUNCTION_INFO_V1(hive_fdw_handler);
 PG_FUNCTION_INFO_V1(hive_fdw_validator);
 
@@ -144,12 +281,105 @@ static TupleTableSlot *hiveIterateForeignScan(ForeignScanState *node);
 static void hiveReScanForeignScan(ForeignScanState *node);
 static void hiveEndForeignScan(ForeignScanState *node);
 static List *hiveImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid);
+#if PG_VERSION_NUM >= 110000
+static void hiveImportPartitionedTable(ImportForeignSchemaStmt *stmt, ForeignServer *server,
+						   const char *table_name, List *column_names,
+						   List *column_types, List *hive_types,
+						   jobjectArray java_partition);
+static char *hiveImportPartitionName(const char *table_name, const char *value,
+									 int position);
+static void hiveImportForeignPartition(ImportForeignSchemaStmt *stmt, ForeignServer *server,
+						   const char *parent, const char *child,
+						   const char *table_name, const char *bound,
+						   const char *partition, const char *filter,
+						   List *column_names, List *hive_types);
+static void hiveImportExecute(const char *sql);
+#endif
+static int	hiveIsForeignRelUpdatable(Relation rel);
+static List *hivePlanForeignModify(PlannerInfo *root, ModifyTable *plan,
+					  Index resultRelation, int subplan_index);
+static void hiveBeginForeignModify(ModifyTableState *mtstate, ResultRelInfo *rinfo,
+					   List *fdw_private, int subplan_index, int eflags);
+static TupleTableSlot *hiveExecForeignInsert(EState *estate, ResultRelInfo *rinfo,
+					  TupleTableSlot *slot, TupleTableSlot *planSlot);
+#if PG_VERSION_NUM >= 140000
+static TupleTableSlot **hiveExecForeignBatchInsert(EState *estate, ResultRelInfo *rinfo,
+						   TupleTableSlot **slots, TupleTableSlot **planSlots,
+						   int *numSlots);
+static int	hiveGetForeignModifyBatchSize(ResultRelInfo *rinfo);
+#endif
+static TupleTableSlot *hiveExecForeignUpdate(EState *estate, ResultRelInfo *rinfo,
+					  TupleTableSlot *slot, TupleTableSlot *planSlot);
+static TupleTableSlot *hiveExecForeignDelete(EState *estate, ResultRelInfo *rinfo,
+					  TupleTableSlot *slot, TupleTableSlot *planSlot);
+static void hiveEndForeignModify(EState *estate, ResultRelInfo *rinfo);
+#if PG_VERSION_NUM >= 110000
+static void hiveBeginForeignInsert(ModifyTableState *mtstate, ResultRelInfo *rinfo);
+static void hiveEndForeignInsert(EState *estate, ResultRelInfo *rinfo);
+#endif
+static void hiveExplainForeignModify(ModifyTableState *mtstate, ResultRelInfo *rinfo,
+						 List *fdw_private, int subplan_index,
+						 ExplainState *es);
+static bool hivePlanDirectModify(PlannerInfo *root, ModifyTable *plan,
+					 Index resultRelation, int subplan_index);
+static void hiveBeginDirectModify(ForeignScanState *node, int eflags);
+static TupleTableSlot *hiveIterateDirectModify(ForeignScanState *node);
+static void hiveEndDirectModify(ForeignScanState *node);
+static void hiveExplainDirectModify(ForeignScanState *node, ExplainState *es);
+#if PG_VERSION_NUM >= 140000
+static void hiveExecForeignTruncate(List *rels, DropBehavior behavior,
+						bool restart_seqs);
+static void hiveSendPendingTruncates(void);
+static void hiveXactCallback(XactEvent event, void *arg);
+static void hiveSubXactCallback(SubXactEvent event, SubTransactionId mySubid,
+					SubTransactionId parentSubid, void *arg);
+#endif
+static ForeignScan *hiveFindModifyTableSubplan(PlannerInfo *root, ModifyTable *plan,
+						   Index resultRelation, int subplan_index);
+static bool hiveIsTransactional(Oid foreigntableid);
+static hiveFdwModifyState *hiveCreateModifyState(ResultRelInfo *rinfo, EState *estate,
+					  char *query, List *target_attrs);
+static List *hiveInsertTargetAttrs(Relation rel);
+static int	hiveGetBatchSize(Oid foreigntableid);
+static void hiveGetStagingOptions(Oid foreigntableid, char **staging_dir,
+					  char **staging_uri, char **partition);
+static char *hiveStagingLoadSql(Relation rel, const char *filename);
+static void hiveOpenStagingFile(hiveFdwModifyState *fmstate, MemoryContext cxt);
+static void hiveCheckStagingColumns(hiveFdwModifyState *fmstate);
+static void hiveRemoveStagingFile(void *arg);
+static void hiveAddInsertRow(hiveFdwModifyState *fmstate, TupleTableSlot *slot);
+static void hiveStageRow(hiveFdwModifyState *fmstate, TupleTableSlot *slot);
+static int	hiveSetTransmissionModes(void);
+static void hiveResetTransmissionModes(int nestlevel);
+static void hiveLoadStagingFile(hiveFdwModifyState *fmstate);
+static void hiveFlushInserts(hiveFdwModifyState *fmstate);
+static int64 hiveExecuteModify(hiveFdwExecutionState *conn, const char *sql);
+static hiveFdwExecutionState *hiveOpenConnection(Oid relid);
+static List *hiveQueryTextRows(hiveFdwExecutionState *conn, const char *sql,
+				  int ncols);
+static bool hiveUseRemoteEstimate(Oid foreigntableid);
+static int	hiveGetResultCacheTtl(PlannerInfo *root, RelOptInfo *rel);
+static void hiveReleaseConnection(hiveFdwExecutionState *festate);
+static void hiveTrackConnection(jobject conn);
+static void hiveUntrackConnection(jobject conn);
+static void hiveConnXactCallback(XactEvent event, void *arg);
+static bool hiveFetchNextBatch(hiveFdwExecutionState *festate);
+static bool hiveNextRemoteRow(hiveFdwExecutionState *festate);
+static void hiveDrainResult(hiveFdwExecutionState *festate);
+static bool hiveGetDrainResult(Oid serverid, Oid foreigntableid);
+static void hiveExplainTime(const char *label, instr_time time, ExplainState *es);
+static void hiveExplainCount(const char *label, int64 value, ExplainState *es);
 static hiveFdwExecutionState *hiveGetConnection(
+				Oid serverid,
 				char *svr_username,
 				char *svr_password,
 				char *svr_host,
 				int svr_port,
-				char *svr_schema);
+				char *svr_schema,
+				int svr_querytimeout);
+static char *hiveBuildURL(char *svr_host, int svr_port, char *svr_schema);
+static char *hiveGetJarClasspath(void);
+static void hiveGetDriverOptions(Oid serverid, char **drivername, char **jarfile);
 static bool foreign_join_ok(PlannerInfo *root, RelOptInfo *joinrel,
 				JoinType jointype, RelOptInfo *outerrel, RelOptInfo *innerrel,
 				JoinPathExtraData *extra);
@@ -185,6 +415,10 @@ static void hiveGetTableOptions(
  * Uses a String object's content to create an instance of C String
  */
 static char *ConvertStringToCString(jobject);
+static char *hiveJNIArrayString(jobjectArray array, int index);
+static char *hiveJNICopyString(jstring string);
+static void hiveJNIFrameError(const char *message);
+static void hiveJNICallVoid(jobject java_call, const char *method);
 
 /*
  * JVM Initialization function
@@ -201,18 +435,26 @@ static void DestroyJVM();
  */
 static void SIGINTInterruptHandler(int);
 
-/*
- * SIGINT interrupt check and process function
- */
-static void SIGINTInterruptCheckProcess();
-
 /*
  * SIGINTInterruptCheckProcess
  *		Checks and processes if SIGINT interrupt occurs
  */
-static void
-SIGINTInterruptCheckProcess()
+void
+SIGINTInterruptCheckProcess(void)
 {
+	if (InterruptFlag == true && hive_gateway_enabled())
+	{
+		/*
+		 * The remote statement lives in the gateway worker; dropping our
+		 * session makes the worker release it.
+		 */
+		InterruptFlag = false;
+		hive_gateway_cancel();
+		ereport(ERROR,
+				(errcode(ERRCODE_QUERY_CANCELED),
+				 errmsg("Query has been cancelled")));
+	}
+
 	if (InterruptFlag == true)
 	{
 		jclass		HiveJDBCUtilsClass;
@@ -233,6 +475,7 @@ SIGINTInterruptCheckProcess()
 		}
 
 		cancel_result = (*env)->CallObjectMethod(env, java_call, id_cancel);
+		hive_cancel_flag = 0;
 		if (cancel_result != NULL)
 		{
 			cancel_result_cstring = ConvertStringToCString((jobject) cancel_result);
@@ -240,7 +483,9 @@ SIGINTInterruptCheckProcess()
 		}
 
 		InterruptFlag = false;
-		elog(ERROR, "Query has been cancelled");
+		ereport(ERROR,
+				(errcode(ERRCODE_QUERY_CANCELED),
+				 errmsg("Query has been cancelled")));
 
 		(*env)->ReleaseStringUTFChars(env, cancel_result, cancel_result_cstring);
 		(*env)->DeleteLocalRef(env, cancel_result);
@@ -278,6 +523,61 @@ ConvertStringToCString(jobject java_cstring)
 	return (StringPointer);
 }
 
+/*
+ * hiveJNIArrayString
+ *		Element of a Java String array as a palloc'd C string, or NULL
+ */
+static char *
+hiveJNIArrayString(jobjectArray array, int index)
+{
+	jstring		element = (jstring) (*env)->GetObjectArrayElement(env, array, index);
+	const char *chars;
+	char	   *result;
+
+	if (element == NULL)
+		return NULL;
+
+	chars = (*env)->GetStringUTFChars(env, element, 0);
+	result = pstrdup(chars);
+	(*env)->ReleaseStringUTFChars(env, element, chars);
+	(*env)->DeleteLocalRef(env, element);
+
+	return result;
+}
+
+/*
+ * hiveJNICopyString
+ *		Content of a Java String as a palloc'd C string
+ */
+static char *
+hiveJNICopyString(jstring string)
+{
+	const char *chars = (*env)->GetStringUTFChars(env, string, 0);
+	char	   *result;
+
+	if (chars == NULL)
+		return pstrdup("out of memory in the JVM");
+
+	result = pstrdup(chars);
+	(*env)->ReleaseStringUTFChars(env, string, chars);
+
+	return result;
+}
+
+/*
+ * hiveJNIFrameError
+ *		Pop the local frame of a JNI helper and raise "message", which must
+ *		not live in that frame. Every error between PushLocalFrame and
+ *		PopLocalFrame goes through here, or the frame would never be
+ *		popped.
+ */
+static void
+hiveJNIFrameError(const char *message)
+{
+	(*env)->PopLocalFrame(env, NULL);
+	elog(ERROR, "%s", message);
+}
+
 /*
  * DestroyJVM
  *		Shuts down the JVM.
@@ -297,25 +597,15 @@ DestroyJVM()
 static void
 JVMInitialization(Oid serveroid)
 {
-	jint		res = -5;		/* Initializing the value of res so that we
-								 * can check it later to see whether JVM has
-								 * been correctly created or not */
-	JavaVMInitArgs vm_args;
-	JavaVMOption *options;
-	static bool FunctionCallCheck = false;		/* This flag safeguards
-												 * against multiple calls of
-												 * JVMInitialization(). */
-	char	   *classpath;
 	char	   *svr_username = NULL;
 	char	   *svr_password = NULL;
 	char	   *svr_query = NULL;
 	char	   *svr_host = NULL;
 	int			svr_port = 0;
-	char	   *maxheapsizeoption = NULL;
 	int			svr_querytimeout = 0;
 	int			svr_maxheapsize = 0;
-	char	   *var_CP = NULL;
-	int			cp_len = 0;
+	instr_time	start;
+	instr_time	elapsed;
 
 	hiveGetServerOptions(
 						   serveroid,
@@ -328,9 +618,38 @@ JVMInitialization(Oid serveroid)
 						   &svr_port
 		);
 
+	SIGINTInterruptCheckProcess();
 
+	INSTR_TIME_SET_CURRENT(start);
+	if (hiveCreateJVM(svr_maxheapsize))
+	{
+		INSTR_TIME_SET_CURRENT(elapsed);
+		INSTR_TIME_SUBTRACT(elapsed, start);
+		hive_stats_jvm_created(serveroid, elapsed);
+	}
+}
 
-	SIGINTInterruptCheckProcess();
+/*
+ * hiveCreateJVM
+ *		Create the JVM of this process, once. Used directly by the gateway
+ *		worker, which has no foreign server to take the heap size from.
+ *		Returns true if the JVM was created by this call.
+ */
+bool
+hiveCreateJVM(int maxheapsize)
+{
+	jint		res = -5;		/* Initializing the value of res so that we
+								 * can check it later to see whether JVM has
+								 * been correctly created or not */
+	JavaVMInitArgs vm_args;
+	JavaVMOption *options;
+	static bool FunctionCallCheck = false;		/* This flag safeguards
+												 * against multiple calls of
+												 * JVMInitialization(). */
+	char	   *classpath;
+	char	   *maxheapsizeoption = NULL;
+	char	   *var_CP = NULL;
+	int			cp_len = 0;
 
 	if (FunctionCallCheck == false)
 	{
@@ -352,13 +671,13 @@ JVMInitialization(Oid serveroid)
 #endif /* defined(__MINGW64__) || defined(WIN32) */
 		         var_CP);
 
-		if (svr_maxheapsize != 0)		/* If the user has given a value for
-										 * setting the max heap size of the
-										 * JVM */
+		if (maxheapsize != 0)		/* If the user has given a value for
+									 * setting the max heap size of the
+									 * JVM */
 		{
 			options = (JavaVMOption *) palloc(sizeof(JavaVMOption) * 2);
 			maxheapsizeoption = (char *) palloc(sizeof(int) + 6);
-			snprintf(maxheapsizeoption, sizeof(int) + 6, "-Xmx%dm", svr_maxheapsize);
+			snprintf(maxheapsizeoption, sizeof(int) + 6, "-Xmx%dm", maxheapsize);
 
 			options[0].optionString = classpath;
 			options[1].optionString = maxheapsizeoption;
@@ -388,7 +707,10 @@ JVMInitialization(Oid serveroid)
 		/* Register an on_proc_exit handler that shuts down the JVM. */
 		on_proc_exit(DestroyJVM, 0);
 		FunctionCallCheck = true;
+		return true;
 	}
+
+	return false;
 }
 
 /*
@@ -398,7 +720,42 @@ JVMInitialization(Oid serveroid)
 static void
 SIGINTInterruptHandler(int sig)
 {
+	int			save_errno = errno;
+
 	InterruptFlag = true;
+
+	/* Let the cancel watcher stop the remote statement right away */
+	hive_cancel_flag = 1;
+	hive_gateway_signal_cancel();
+
+	/* Wake up a backend waiting on the gateway worker */
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * Module load callback
+ */
+void
+_PG_init(void)
+{
+	hive_gateway_init();
+	hive_stats_init();
+	hive_meta_init();
+	hive_cache_init();
+
+	RegisterXactCallback(hiveConnXactCallback, NULL);
+#if PG_VERSION_NUM >= 140000
+	RegisterXactCallback(hiveXactCallback, NULL);
+	RegisterSubXactCallback(hiveSubXactCallback, NULL);
+#endif
+
+#if PG_VERSION_NUM >= 150000
+	MarkGUCPrefixReserved("hive_fdw");
+#else
+	EmitWarningsOnPlaceholders("hive_fdw");
+#endif
 }
 
 /*
@@ -419,6 +776,33 @@ hive_fdw_handler(PG_FUNCTION_ARGS)
 	fdwroutine->ReScanForeignScan = hiveReScanForeignScan;
 	fdwroutine->EndForeignScan = hiveEndForeignScan;
 	fdwroutine->ImportForeignSchema = hiveImportForeignSchema;
+	/* Support functions for INSERT */
+	fdwroutine->IsForeignRelUpdatable = hiveIsForeignRelUpdatable;
+	fdwroutine->PlanForeignModify = hivePlanForeignModify;
+	fdwroutine->BeginForeignModify = hiveBeginForeignModify;
+	fdwroutine->ExecForeignInsert = hiveExecForeignInsert;
+#if PG_VERSION_NUM >= 140000
+	fdwroutine->ExecForeignBatchInsert = hiveExecForeignBatchInsert;
+	fdwroutine->GetForeignModifyBatchSize = hiveGetForeignModifyBatchSize;
+#endif
+	fdwroutine->ExecForeignUpdate = hiveExecForeignUpdate;
+	fdwroutine->ExecForeignDelete = hiveExecForeignDelete;
+	fdwroutine->EndForeignModify = hiveEndForeignModify;
+#if PG_VERSION_NUM >= 110000
+	fdwroutine->BeginForeignInsert = hiveBeginForeignInsert;
+	fdwroutine->EndForeignInsert = hiveEndForeignInsert;
+#endif
+	fdwroutine->ExplainForeignModify = hiveExplainForeignModify;
+	/* Support functions for UPDATE and DELETE on ACID tables */
+	fdwroutine->PlanDirectModify = hivePlanDirectModify;
+	fdwroutine->BeginDirectModify = hiveBeginDirectModify;
+	fdwroutine->IterateDirectModify = hiveIterateDirectModify;
+	fdwroutine->EndDirectModify = hiveEndDirectModify;
+	fdwroutine->ExplainDirectModify = hiveExplainDirectModify;
+#if PG_VERSION_NUM >= 140000
+	/* Support functions for TRUNCATE */
+	fdwroutine->ExecForeignTruncate = hiveExecForeignTruncate;
+#endif
 	/* Support functions for join push-down */
 	fdwroutine->GetForeignJoinPaths = hiveGetForeignJoinPaths;
 	pqsignal(SIGINT, SIGINTInterruptHandler);
@@ -613,6 +997,68 @@ hive_fdw_validator(PG_FUNCTION_ARGS)
 
 			svr_schema = defGetString(def);
 		}
+		else if (strcmp(def->defname, "batch_size") == 0)
+		{
+			char	   *endp;
+			long		batch_size = strtol(defGetString(def), &endp, 10);
+
+			if (*endp != '\0' || batch_size <= 0 || batch_size > INT_MAX)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("\"%s\" must be a positive integer", def->defname)));
+		}
+		else if (strcmp(def->defname, "result_cache_ttl") == 0)
+		{
+			char	   *endp;
+			long		ttl = strtol(defGetString(def), &endp, 10);
+
+			if (*endp != '\0' || ttl < 0 || ttl > INT_MAX)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("\"%s\" must be a non-negative integer", def->defname)));
+		}
+		else if (strcmp(def->defname, "drivername") == 0 ||
+				 strcmp(def->defname, "jarfile") == 0)
+		{
+			/* They decide which Java code the backend and the gateway load */
+			if (!superuser())
+				ereport(ERROR,
+						(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+						 errmsg("only superuser can change option \"%s\"", def->defname)));
+		}
+		else if (strcmp(def->defname, "staging_dir") == 0)
+		{
+			/* Files are written there as the server's OS user */
+			if (!superuser())
+				ereport(ERROR,
+						(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+						 errmsg("only superuser can change option \"%s\"", def->defname)));
+
+			if (!is_absolute_path(defGetString(def)))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("\"%s\" must be an absolute path", def->defname)));
+		}
+		else if (strcmp(def->defname, "transactional") == 0 ||
+				 strcmp(def->defname, "use_remote_estimate") == 0 ||
+				 strcmp(def->defname, "drain_result") == 0)
+		{
+			/* Raises an error if it is not a boolean */
+			(void) defGetBoolean(def);
+		}
+		else if (strcmp(def->defname, "extra_functions") == 0 ||
+				 strcmp(def->defname, "extra_operators") == 0 ||
+				 strcmp(def->defname, "extensions") == 0)
+		{
+			hive_validate_extra_option(def->defname, defGetString(def));
+		}
+		else if (strcmp(def->defname, "hive_type") == 0)
+		{
+			if (hiveTypeKind(defGetString(def)) == HIVE_TYPE_INVALID)
+				ereport(ERROR,
+						(errcode(ERRCODE_FDW_INVALID_DATA_TYPE),
+						 errmsg("invalid Hive type \"%s\"", defGetString(def))));
+		}
 
 	}
 
@@ -756,35 +1202,68 @@ hiveGetServerOptions(Oid serveroid, int *querytimeout, int *maxheapsize, char **
 static void
 hiveExplainForeignScan(ForeignScanState *node, ExplainState *es)
 {
-	char	   *svr_username = NULL;
-	char	   *svr_password = NULL;
-	char	   *svr_query = NULL;
-	int			svr_querytimeout = 0;
-	int			svr_maxheapsize = 0;
-	char	   *svr_host = NULL;
-	int			svr_port = 0;
-	ForeignTable *f_table = NULL;
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+	hiveFdwExecutionState *festate = (hiveFdwExecutionState *) node->fdw_state;
 
-	f_table = GetForeignTable(RelationGetRelid(node->ss.ss_currentRelation));
+	if (fsplan->scan.scanrelid > 0)
+		elog(DEBUG3, HIVE_FDW_NAME ": explain foreign scan for relation ID %d",
+			 RelationGetRelid(node->ss.ss_currentRelation));
 
-	elog(DEBUG3, HIVE_FDW_NAME ": explain foreign scan for relation ID %d",
-		 RelationGetRelid(node->ss.ss_currentRelation));
+	ExplainPropertyText("Remote SQL", strVal(list_nth(fsplan->fdw_private, 0)), es);
 
-	/* Fetch options  */
-	hiveGetServerOptions(
-						   f_table->serverid,
-						   &svr_querytimeout,
-						   &svr_maxheapsize,
-						   &svr_username,
-						   &svr_password,
-						   &svr_query,
-						   &svr_host,
-						   &svr_port
-		);
+	if (es->analyze && festate != NULL)
+	{
+		hiveScanMetrics *metrics = &festate->metrics;
+
+		if (metrics->timing)
+		{
+			hiveExplainTime("Hive Execute Time", metrics->execute_time, es);
+			hiveExplainTime("Hive First Row Time", metrics->first_row_time, es);
+			hiveExplainTime("Hive JNI Time", metrics->jni_time, es);
+			hiveExplainTime("Hive Conversion Time", metrics->convert_time, es);
+		}
+		hiveExplainCount("Hive Rows", festate->NumberOfRows, es);
+		hiveExplainCount("Hive Bytes", metrics->bytes, es);
+		hiveExplainCount("Hive Batches", metrics->batches, es);
+		if (metrics->query_id)
+			ExplainPropertyText("Hive Query ID", metrics->query_id, es);
+		if (metrics->job_ids)
+			ExplainPropertyText("Hive Job IDs", metrics->job_ids, es);
+		if (metrics->cache_status)
+			ExplainPropertyText("Hive Result Cache", metrics->cache_status, es);
+	}
 
 	SIGINTInterruptCheckProcess();
 }
 
+/*
+ * hiveExplainTime
+ *		Add a timing in milliseconds to EXPLAIN output
+ */
+static void
+hiveExplainTime(const char *label, instr_time time, ExplainState *es)
+{
+#if PG_VERSION_NUM >= 110000
+	ExplainPropertyFloat(label, "ms", INSTR_TIME_GET_MILLISEC(time), 3, es);
+#else
+	ExplainPropertyFloat(label, INSTR_TIME_GET_MILLISEC(time), 3, es);
+#endif
+}
+
+/*
+ * hiveExplainCount
+ *		Add a counter to EXPLAIN output
+ */
+static void
+hiveExplainCount(const char *label, int64 value, ExplainState *es)
+{
+#if PG_VERSION_NUM >= 110000
+	ExplainPropertyInteger(label, NULL, value, es);
+#else
+	ExplainPropertyLong(label, (long) value, es);
+#endif
+}
+
 /*
  * hiveBeginForeignScan
  *		Initiate access to the database
@@ -801,20 +1280,22 @@ hiveBeginForeignScan(ForeignScanState *node, int eflags)
 	int			svr_maxheapsize = 0;
 	hiveFdwExecutionState *festate;
 	char	   *query;
-	jclass		HiveJDBCUtilsClass;
-	jstring		initialize_result = NULL;
-	jmethodID	id_initialize;
-	jfieldID	id_numberofcolumns;
-	char	   *initialize_result_cstring = NULL;
 	char	   *svr_host = NULL;
 	int			svr_port = 0;
 	Oid			foreigntableid;
-	jstring		name;
 
 	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
 	Oid serverid;
+	Oid			relid;
+	instr_time	now;
+	int			cache_ttl;
+	hiveResultCache *cache = NULL;
 	SIGINTInterruptCheckProcess();
 
+	/* A plain EXPLAIN only needs the remote query, which is in the plan */
+	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
+		return;
+
 	serverid = intVal(list_nth(fsplan->fdw_private, 2));
 	if (fsplan->scan.scanrelid > 0)
 	{
@@ -838,11 +1319,41 @@ hiveBeginForeignScan(ForeignScanState *node, int eflags)
 						   &svr_port
 		);
 
-	festate = hiveGetConnection(svr_username, svr_password, svr_host, svr_port, svr_schema);
+	/* Pushed-down joins are counted for the server only */
+	relid = (fsplan->scan.scanrelid > 0) ? foreigntableid : InvalidOid;
 
 	query = strVal(list_nth(fsplan->fdw_private, 0));
+	cache_ttl = intVal(list_nth(fsplan->fdw_private, 4));
 
-	elog(DEBUG1, "hive_fdw: Starting Query: %s", query);
+	/* A recent result of the same query needs no connection */
+	if (cache_ttl > 0)
+		cache = hive_cache_lookup(serverid, query, cache_ttl,
+								  node->ss.ps.state->es_query_cxt);
+
+	if (cache != NULL)
+	{
+		festate = (hiveFdwExecutionState *) palloc0(sizeof(hiveFdwExecutionState));
+		festate->gateway_cursor = -1;
+	}
+	else
+	{
+		PG_TRY();
+		{
+			festate = hiveGetConnection(serverid, svr_username, svr_password, svr_host, svr_port,
+										svr_schema, svr_querytimeout);
+		}
+		PG_CATCH();
+		{
+			hive_stats_error(serverid, relid);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+
+		hive_stats_connection(serverid, relid, festate->metrics.reused);
+	}
+
+	festate->serverid = serverid;
+	festate->relid = relid;
 
 	node->fdw_state = (void *) festate;
 /*	festate->result = NULL; */
@@ -850,41 +1361,77 @@ hiveBeginForeignScan(ForeignScanState *node, int eflags)
 	festate->retrieved_attrs = (List *) list_nth(fsplan->fdw_private, 1);
 	festate->NumberOfColumns = 0;
 	festate->NumberOfRows = 0;
+	festate->eof = false;
+	hiveBatchInit(&festate->batch, NULL, 0);
+	festate->row_cxt = AllocSetContextCreate(node->ss.ps.state->es_query_cxt,
+											 "hive_fdw row",
+											 ALLOCSET_SMALL_SIZES);
 
-	/* Connect to the server and execute the query */
-	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
-	if (HiveJDBCUtilsClass == NULL)
+	if (fsplan->scan.scanrelid > 0)
+		festate->attinmeta = TupleDescGetAttInMetadata(node->ss.ss_currentRelation->rd_att);
+	else
+		festate->attinmeta = TupleDescGetAttInMetadata(node->ss.ss_ScanTupleSlot->tts_tupleDescriptor);
+	festate->decoder = hiveBatchPrepare(festate->attinmeta);
+	festate->values = (Datum *) palloc(sizeof(Datum) * festate->attinmeta->tupdesc->natts);
+	festate->nulls = (bool *) palloc(sizeof(bool) * festate->attinmeta->tupdesc->natts);
+
+	festate->metrics.timing = (node->ss.ps.instrument != NULL);
+	INSTR_TIME_SET_CURRENT(festate->metrics.start_time);
+
+	if (cache != NULL)
 	{
-		elog(ERROR, "HiveJDBCUtilsClass is NULL");
+		festate->cache = cache;
+		festate->metrics.cache_status = "hit";
+		return;
 	}
 
-	id_initialize = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "Execute_Query", "(Ljava/lang/String;)Ljava/lang/String;");
-	if (id_initialize == NULL)
+	elog(DEBUG1, "hive_fdw: Starting Query: %s", query);
+
+	/* Read the whole result at once if asked to */
+	if (hiveGetDrainResult(serverid, relid))
 	{
-		elog(ERROR, "id_initialize is NULL");
+		festate->tuplestore = tuplestore_begin_heap(false, false, work_mem);
+#if PG_VERSION_NUM >= 120000
+		festate->drain_slot = MakeSingleTupleTableSlot(festate->attinmeta->tupdesc,
+													   &TTSOpsMinimalTuple);
+#endif
 	}
 
-	id_numberofcolumns = (*env)->GetFieldID(env, HiveJDBCUtilsClass, "NumberOfColumns", "I");
-	if (id_numberofcolumns == NULL)
+	/* Keep the result for the next scans of the same query */
+	if (cache_ttl > 0)
 	{
-		elog(ERROR, "id_numberofcolumns is NULL");
+		festate->cache = hive_cache_create(serverid, query,
+										   node->ss.ps.state->es_query_cxt);
+		festate->metrics.cache_status = "miss";
 	}
 
-	if (java_call == NULL)
+	/* Execute the query, either here or in the gateway worker */
+	PG_TRY();
 	{
-		elog(ERROR, "java_call is NULL");
+		if (festate->gateway_cursor >= 0)
+			festate->NumberOfColumns = hive_gateway_execute(festate->gateway_cursor, query,
+															&festate->metrics.query_id,
+															&festate->metrics.job_ids,
+															NULL);
+		else
+		{
+			festate->NumberOfColumns = hiveJNIExecuteQuery(festate->java_call, query);
+			hiveJNIQueryIds(festate->java_call, &festate->metrics.query_id,
+							&festate->metrics.job_ids);
+		}
 	}
-
-	name = (*env)->NewStringUTF(env, query);
-	initialize_result = (*env)->CallObjectMethod(env, java_call, id_initialize, name);
-	if (initialize_result != NULL)
+	PG_CATCH();
 	{
-		initialize_result_cstring = ConvertStringToCString((jobject) initialize_result);
-		elog(ERROR, "%s", initialize_result_cstring);
+		hive_stats_error(serverid, relid);
+		PG_RE_THROW();
 	}
+	PG_END_TRY();
 
-	node->fdw_state = (void *) festate;
-	festate->NumberOfColumns = (*env)->GetIntField(env, java_call, id_numberofcolumns);
+	INSTR_TIME_SET_CURRENT(now);
+	INSTR_TIME_ACCUM_DIFF(festate->metrics.execute_time, now, festate->metrics.start_time);
+	INSTR_TIME_ADD(festate->metrics.jni_time, festate->metrics.execute_time);
+
+	hive_stats_query(serverid, relid, festate->metrics.execute_time);
 }
 
 /*
@@ -895,79 +1442,185 @@ hiveBeginForeignScan(ForeignScanState *node, int eflags)
 static TupleTableSlot *
 hiveIterateForeignScan(ForeignScanState *node)
 {
-	char	  **values;
 	HeapTuple	tuple;
-	jmethodID	id_returnresultset;
-	jclass		HiveJDBCUtilsClass;
-	jobjectArray java_rowarray;
-	int			i = 0;
-	int			j = 0;
-	jstring		tempString;
+	MemoryContext oldcontext;
 	hiveFdwExecutionState *festate = (hiveFdwExecutionState *) node->fdw_state;
 	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
-	jobject		java_call = festate->java_call;
-	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
 
 	/* Cleanup */
 	ExecClearTuple(slot);
+	MemoryContextReset(festate->row_cxt);
 
 	SIGINTInterruptCheckProcess();
 
-	if ((*env)->PushLocalFrame(env, (festate->NumberOfColumns + 10)) < 0)
+	/* With drain_result, the first call reads the whole result */
+	if (festate->tuplestore != NULL)
 	{
-		/* frame not pushed, no PopLocalFrame needed */
-		elog(ERROR, "Error");
-	}
+		if (!festate->drained)
+			hiveDrainResult(festate);
 
-
-	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
-	if (HiveJDBCUtilsClass == NULL)
-	{
-		elog(ERROR, "HiveJDBCUtilsClass is NULL");
+#if PG_VERSION_NUM >= 120000
+		if (tuplestore_gettupleslot(festate->tuplestore, true, false,
+									festate->drain_slot))
+			ExecCopySlot(slot, festate->drain_slot);
+#else
+		(void) tuplestore_gettupleslot(festate->tuplestore, true, false, slot);
+#endif
+		return (slot);
 	}
 
-	id_returnresultset = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "ReturnResultSet", "()[Ljava/lang/String;");
-	if (id_returnresultset == NULL)
+	oldcontext = MemoryContextSwitchTo(festate->row_cxt);
+
+	if (!hiveNextRemoteRow(festate))
 	{
-		elog(ERROR, "id_returnresultset is NULL");
+		MemoryContextSwitchTo(oldcontext);
+		return (slot);
 	}
 
-	values = (char **) palloc(sizeof(char *) * (festate->NumberOfColumns));
+	tuple = heap_form_tuple(festate->attinmeta->tupdesc, festate->values, festate->nulls);
+	MemoryContextSwitchTo(oldcontext);
 
-	java_rowarray = (*env)->CallObjectMethod(env, java_call, id_returnresultset);
+#if PG_VERSION_NUM < 120000
+	ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+#else
+	ExecStoreHeapTuple(tuple, slot, false);
+#endif
 
-	if (java_rowarray != NULL)
+	return (slot);
+}
+
+/*
+ * hiveNextRemoteRow
+ *		Decode the next row of the result into festate->values and
+ *		festate->nulls, fetching batches as needed. Returns false at the
+ *		end of the result.
+ */
+static bool
+hiveNextRemoteRow(hiveFdwExecutionState *festate)
+{
+	hiveScanMetrics *metrics = &festate->metrics;
+	instr_time	start;
+	instr_time	now;
+
+	if (metrics->timing)
+		INSTR_TIME_SET_CURRENT(start);
+
+	/* Move on to the next batch once the current one is used up */
+	while (!hiveBatchNextRow(&festate->batch, festate->decoder,
+							 festate->values, festate->nulls))
 	{
+		if (festate->eof)
+			return false;
 
-		for (i = 0; i < (festate->NumberOfColumns); i++)
+		PG_TRY();
 		{
-			values[i] = ConvertStringToCString((jobject) (*env)->GetObjectArrayElement(env, java_rowarray, i));
+			festate->eof = !hiveFetchNextBatch(festate);
 		}
-
-		if (fsplan->scan.scanrelid > 0)
-			tuple = BuildTupleFromCStrings(TupleDescGetAttInMetadata(node->ss.ss_currentRelation->rd_att), values);
-		else
-			tuple = BuildTupleFromCStrings(TupleDescGetAttInMetadata(node->ss.ss_ScanTupleSlot->tts_tupleDescriptor), values);
-#if PG_VERSION_NUM < 120000
-		ExecStoreTuple(tuple, slot, InvalidBuffer, false);
-#else
-		ExecStoreHeapTuple(tuple, slot, false);
-#endif
-		++(festate->NumberOfRows);
-
-		for (j = 0; j < festate->NumberOfColumns; j++)
+		PG_CATCH();
 		{
-			tempString = (jstring) (*env)->GetObjectArrayElement(env, java_rowarray, j);
-			(*env)->ReleaseStringUTFChars(env, tempString, values[j]);
-			(*env)->DeleteLocalRef(env, tempString);
+			hive_stats_error(festate->serverid, festate->relid);
+			PG_RE_THROW();
 		}
+		PG_END_TRY();
 
-		(*env)->DeleteLocalRef(env, java_rowarray);
+		/* The fetch counts as JNI time, not conversion time */
+		if (metrics->timing)
+			INSTR_TIME_SET_CURRENT(start);
 	}
 
-	(*env)->PopLocalFrame(env, NULL);
+	/* The first row is always timed, for the cumulative statistics */
+	if (metrics->timing || festate->NumberOfRows == 0)
+		INSTR_TIME_SET_CURRENT(now);
+	if (metrics->timing)
+		INSTR_TIME_ACCUM_DIFF(metrics->convert_time, now, start);
+	if (festate->NumberOfRows == 0)
+		INSTR_TIME_ACCUM_DIFF(metrics->first_row_time, now, metrics->start_time);
 
-	return (slot);
+	++(festate->NumberOfRows);
+
+	return true;
+}
+
+/*
+ * hiveDrainResult
+ *		Read the whole remote result into the tuplestore of the scan and
+ *		release the connection, so that Hive and the HiveServer2 session
+ *		are not held while a slow plan consumes the rows. The tuplestore
+ *		spills to disk beyond work_mem.
+ */
+static void
+hiveDrainResult(hiveFdwExecutionState *festate)
+{
+	MemoryContext oldcontext = MemoryContextSwitchTo(festate->row_cxt);
+
+	for (;;)
+	{
+		MemoryContextReset(festate->row_cxt);
+		SIGINTInterruptCheckProcess();
+		CHECK_FOR_INTERRUPTS();
+
+		if (!hiveNextRemoteRow(festate))
+			break;
+
+		tuplestore_putvalues(festate->tuplestore, festate->attinmeta->tupdesc,
+							 festate->values, festate->nulls);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextReset(festate->row_cxt);
+
+	festate->drained = true;
+
+	/* A replayed result has no connection */
+	if (festate->cache == NULL || festate->cache->writing)
+	{
+		hive_stats_scan_end(festate->serverid, festate->relid, &festate->metrics,
+							festate->NumberOfRows);
+		hiveReleaseConnection(festate);
+		festate->released = true;
+	}
+
+	elog(DEBUG1, HIVE_FDW_NAME ": drained " INT64_FORMAT " rows",
+		 (int64) festate->NumberOfRows);
+}
+
+/*
+ * hiveFetchNextBatch
+ *		Fetch the next batch of rows of a scan, either here or from the
+ *		gateway worker. Returns false once the result set is exhausted.
+ */
+static bool
+hiveFetchNextBatch(hiveFdwExecutionState *festate)
+{
+	hiveScanMetrics *metrics = &festate->metrics;
+	instr_time	start;
+	instr_time	now;
+	bool		more;
+
+	if (metrics->timing)
+		INSTR_TIME_SET_CURRENT(start);
+
+	if (festate->cache != NULL && !festate->cache->writing)
+		more = hive_cache_read(festate->cache, &festate->batch);
+	else if (festate->gateway_cursor >= 0)
+		more = hive_gateway_fetch(festate->gateway_cursor, &festate->batch);
+	else
+		more = hiveJNIFetchBatch(festate->java_call, &festate->batch);
+
+	if (festate->cache != NULL && festate->cache->writing)
+		hive_cache_write(festate->cache, &festate->batch);
+
+	if (metrics->timing)
+	{
+		INSTR_TIME_SET_CURRENT(now);
+		INSTR_TIME_ACCUM_DIFF(metrics->jni_time, now, start);
+	}
+
+	metrics->bytes += festate->batch.len;
+	if (more)
+		metrics->batches++;
+
+	return more;
 }
 
 /*
@@ -977,12 +1630,7 @@ hiveIterateForeignScan(ForeignScanState *node)
 static void
 hiveEndForeignScan(ForeignScanState *node)
 {
-	jmethodID	id_close;
-	jclass		HiveJDBCUtilsClass;
-	jstring		close_result = NULL;
-	char	   *close_result_cstring = NULL;
 	hiveFdwExecutionState *festate = (hiveFdwExecutionState *) node->fdw_state;
-	jobject		java_call = festate->java_call;
 	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
 
 	SIGINTInterruptCheckProcess();
@@ -993,34 +1641,37 @@ hiveEndForeignScan(ForeignScanState *node)
 			 RelationGetRelid(node->ss.ss_currentRelation));
 	}
 
+	/* Nothing was started for EXPLAIN without ANALYZE */
+	if (festate == NULL)
+		return;
 
-	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
-	if (HiveJDBCUtilsClass == NULL)
+	/* A result only goes into the cache if it was read to the end */
+	if (festate->cache != NULL)
 	{
-		elog(ERROR, "HiveJDBCUtilsClass is NULL");
-	}
+		bool		replayed = !festate->cache->writing;
 
-	id_close = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "Close", "()Ljava/lang/String;");
-	if (id_close == NULL)
-	{
-		elog(ERROR, "id_close is NULL");
+		hive_cache_finish(festate->cache, festate->eof);
+		if (replayed)
+			return;
 	}
 
-	close_result = (*env)->CallObjectMethod(env, java_call, id_close);
-	if (close_result != NULL)
+	if (festate->tuplestore != NULL)
 	{
-		close_result_cstring = ConvertStringToCString((jobject) close_result);
-		elog(ERROR, "%s", close_result_cstring);
+		tuplestore_end(festate->tuplestore);
+#if PG_VERSION_NUM >= 120000
+		ExecDropSingleTupleTableSlot(festate->drain_slot);
+#endif
 	}
-	if (festate->query)
+
+	/* A drained scan let go of its connection already */
+	if (!festate->released)
 	{
-		pfree(festate->query);
-		festate->query = 0;
+		hive_stats_scan_end(festate->serverid, festate->relid, &festate->metrics,
+							festate->NumberOfRows);
+		hiveReleaseConnection(festate);
 	}
 
-	(*env)->ReleaseStringUTFChars(env, close_result, close_result_cstring);
-	(*env)->DeleteLocalRef(env, close_result);
-	(*env)->DeleteGlobalRef(env, java_call);
+	/* festate->query belongs to the plan, which may be executed again */
 }
 
 /*
@@ -1030,476 +1681,3263 @@ hiveEndForeignScan(ForeignScanState *node)
 static void
 hiveReScanForeignScan(ForeignScanState *node)
 {
+	hiveFdwExecutionState *festate = (hiveFdwExecutionState *) node->fdw_state;
+
 	SIGINTInterruptCheckProcess();
+
+	/* A drained result can simply be read again */
+	if (festate != NULL && festate->drained)
+		tuplestore_rescan(festate->tuplestore);
 }
 
 /*
- * hiveGetForeignPaths
- *		(9.2+) Get the foreign paths
+ * hiveReleaseConnection
+ *		Close the connection of a scan or an INSERT, or give it back to
+ *		the gateway worker
  */
 static void
-hiveGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
+hiveReleaseConnection(hiveFdwExecutionState *festate)
 {
-	Cost		startup_cost = 0;
-	Cost		total_cost = 0;
+	if (festate->gateway_cursor >= 0)
+		hive_gateway_close(festate->gateway_cursor);
+	else
+	{
+		hiveUntrackConnection(festate->java_call);
+		hiveJNIClose(festate->java_call);
+		hiveJNIFree(festate->java_call);
+		if (java_call == festate->java_call)
+			java_call = NULL;
+	}
+}
 
-	SIGINTInterruptCheckProcess();
+/*
+ * hiveTrackConnection
+ *		Remember an open connection of our own JVM until it is released
+ */
+static void
+hiveTrackConnection(jobject conn)
+{
+	MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
 
-	elog(DEBUG3, HIVE_FDW_NAME
-		 ": get foreign paths for relation ID %d", foreigntableid);
+	hive_open_connections = lappend(hive_open_connections, conn);
+	MemoryContextSwitchTo(oldcontext);
+}
 
-	/* Create a ForeignPath node and add it as only possible path */
-	add_path(baserel, (Path *) create_foreignscan_path(root, baserel, NULL, baserel->rows, startup_cost, total_cost, NIL, NULL, NULL, NIL));
+/*
+ * hiveUntrackConnection
+ *		Forget a connection that is being released
+ */
+static void
+hiveUntrackConnection(jobject conn)
+{
+	hive_open_connections = list_delete_ptr(hive_open_connections, conn);
 }
 
 /*
- * hiveGetForeignPlan
- *		(9.2+) Get a foreign scan plan node
+ * hiveConnXactCallback
+ *		Close the connections and gateway cursors left open by a failed
+ *		statement. An error skips the end of the scan or modification, so
+ *		without this every failure would cost a HiveServer2 session until
+ *		the backend exits, and the gateway would run out of cursors for
+ *		it. Nothing here may throw, as the transaction is already being
+ *		aborted.
  */
-static ForeignScan *
-hiveGetForeignPlan(PlannerInfo *root,
-					 RelOptInfo *baserel,
-					 Oid foreigntableid,
-					 ForeignPath *best_path,
-					 List *tlist,
-					 List *scan_clauses,
-					 Plan *outer_plan
-)
+static void
+hiveConnXactCallback(XactEvent event, void *arg)
 {
-	/*
-	 * Create a ForeignScan plan node from the selected foreign access path.
-	 * This is called at the end of query planning. The parameters are as for
-	 * GetForeignRelSize, plus the selected ForeignPath (previously produced
-	 * by GetForeignPaths), the target list to be emitted by the plan node,
-	 * and the restriction clauses to be enforced by the plan node.
-	 *
-	 * This function must create and return a ForeignScan plan node; it's
-	 * recommended to use make_foreignscan to build the ForeignScan node.
-	 *
-	 */
-	List	   *fdw_private;
-	List	   *remote_conds = NIL;
-	List	   *local_exprs = NIL;
-	List	   *params_list = NIL;
-	List	   *retrieved_attrs;
-	StringInfoData sql;
 	ListCell   *lc;
-	List	   *fdw_scan_tlist = NIL;
 
-	Index		scan_relid = baserel->relid;
-	hiveFdwRelationInfo *fpinfo = (hiveFdwRelationInfo *) baserel->fdw_private;
+	if (event != XACT_EVENT_ABORT)
+		return;
 
-	elog(DEBUG3, HIVE_FDW_NAME
-		 ": get foreign plan for relation ID %d", foreigntableid);
+	hive_gateway_abort();
 
-	/*
-	 * For base relations, set scan_relid as the relid of the relation. For
-	 * other kinds of relations set it to 0.
-	 */
-	if (baserel->reloptkind == RELOPT_BASEREL ||
-		baserel->reloptkind == RELOPT_OTHER_MEMBER_REL)
-		scan_relid = baserel->relid;
-	else
-	{
-		scan_relid = 0;
+	foreach(lc, hive_open_connections)
+		hiveJNICloseQuietly((jobject) lfirst(lc));
+	list_free(hive_open_connections);
+	hive_open_connections = NIL;
+	java_call = NULL;
+}
 
-		/*
-		 * create_scan_plan() and create_foreignscan_plan() pass
-		 * rel->baserestrictinfo + parameterization clauses through
-		 * scan_clauses. For a join rel->baserestrictinfo is NIL and we are
-		 * not considering parameterization right now, so there should be no
-		 * scan_clauses for a joinrel.
-		 */
-		Assert(!scan_clauses);
-	}
+/*
+ * hiveIsForeignRelUpdatable
+ *		INSERT is supported into foreign tables that name a Hive table
+ *		rather than a query. UPDATE and DELETE also need the table to be
+ *		transactional on the Hive side, which the transactional option
+ *		declares.
+ */
+static int
+hiveIsForeignRelUpdatable(Relation rel)
+{
+	char	   *svr_table = NULL;
+	char	   *svr_schema = NULL;
 
-	JVMInitialization(baserel->serverid);
-	foreach(lc, scan_clauses)
-	{
-		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+	hiveGetTableOptions(RelationGetRelid(rel), &svr_table, &svr_schema);
 
-		Assert(IsA(rinfo, RestrictInfo));
+	if (svr_table == NULL)
+		return 0;
 
-		/* Ignore any pseudoconstants, they're dealt with elsewhere */
-		if (rinfo->pseudoconstant)
-			continue;
+	if (hiveIsTransactional(RelationGetRelid(rel)))
+		return (1 << CMD_INSERT) | (1 << CMD_UPDATE) | (1 << CMD_DELETE);
 
-		if (list_member_ptr(fpinfo->remote_conds, rinfo))
-		{
-			remote_conds = lappend(remote_conds, rinfo);
-		}
-		else if (list_member_ptr(fpinfo->local_conds, rinfo))
-			local_exprs = lappend(local_exprs, rinfo->clause);
-		else
-		{
-			Assert(is_foreign_expr(root, baserel, rinfo->clause));
-			remote_conds = lappend(remote_conds, rinfo);
-		}
-	}
+	return (1 << CMD_INSERT);
+}
 
-	if (baserel->reloptkind == RELOPT_JOINREL)
-	{
-		/* For a join relation, get the conditions from fdw_private structure */
-		remote_conds = fpinfo->remote_conds;
-		local_exprs = fpinfo->local_conds;
+/*
+ * hiveIsTransactional
+ *		Value of the transactional option of a foreign table
+ */
+static bool
+hiveIsTransactional(Oid foreigntableid)
+{
+	ForeignTable *table = GetForeignTable(foreigntableid);
+	ListCell   *lc;
 
-		/* Build the list of columns to be fetched from the foreign server. */
-		fdw_scan_tlist = build_tlist_to_deparse(baserel);
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
 
-		/*
-		 * Ensure that the outer plan produces a tuple whose descriptor
-		 * matches our scan tuple slot. This is safe because all scans and
-		 * joins support projection, so we never need to insert a Result node.
-		 * Also, remove the local conditions from outer plan's quals, lest
-		 * they will be evaluated twice, once by the local plan and once by
-		 * the scan.
-		 */
+		if (strcmp(def->defname, "transactional") == 0)
+			return defGetBoolean(def);
 	}
-	/*
-	 * Build the query string to be sent for execution, and identify
-	 * expressions to be sent as parameters.
-	 */
-	initStringInfo(&sql);
-	deparseSelectStmtForRel(&sql, root, baserel, remote_conds, &retrieved_attrs, &params_list,
-							fpinfo, fdw_scan_tlist);
-
-	elog(DEBUG1, HIVE_FDW_NAME ": built HiveQL:\n\n%s\n", sql.data);
 
-	/*
-	 * When it is a join relation the foreigntableid passed to hiveGetForeignPlan
-	 * is zero. We cannot obtain the serverid from this relation so we add the serverid
-	 * to the fdw_private here so we can use this in hiveGetForeignPaln. Likewise
-	 * we also need to know the schema to use when we obtain the Hive connection
-	 * we add the foreigntableid as well so that we can get the table options
-	 * from this foreigntableid. Since it is assumed that all the relations
-	 * involved in the joins belong to the same server and to the same schema it is
-	 * irrelevant which of the foreign tables makes it in the fdw_private list.
-	 */
-	fdw_private = list_make4(makeString(sql.data),
-							 retrieved_attrs,
-							 makeInteger(baserel->serverid),
-							 makeInteger(fpinfo->foreigntableid));
-	/* Create the ForeignScan node */
-	return make_foreignscan(tlist, local_exprs, scan_relid, params_list, fdw_private, fdw_scan_tlist, NIL, (Plan *) NIL);
+	return false;
 }
 
 /*
- * hiveGetForeignRelSize
- *		(9.2+) Get a foreign scan plan node
+ * hivePlanForeignModify
+ *		Build the remote INSERT statement, without any rows, and the list
+ *		of attributes it sets
  */
-static void
-hiveGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
+static List *
+hivePlanForeignModify(PlannerInfo *root, ModifyTable *plan,
+					  Index resultRelation, int subplan_index)
 {
-	hiveFdwRelationInfo *fpinfo;
-	ListCell   *lc;
+	RangeTblEntry *rte = planner_rt_fetch(resultRelation, root);
+	Relation	rel;
+	List	   *target_attrs;
+	StringInfoData sql;
 
-	SIGINTInterruptCheckProcess();
+	/*
+	 * Hive tables have no row identity to send changes back by, so UPDATE
+	 * and DELETE only work when hivePlanDirectModify could ship them.
+	 */
+	if (plan->operation == CMD_UPDATE || plan->operation == CMD_DELETE)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("%s on Hive foreign table \"%s\" cannot be run on the Hive server",
+						plan->operation == CMD_UPDATE ? "UPDATE" : "DELETE",
+						get_rel_name(rte->relid)),
+				 errhint("The WHERE clause and new values must be sent to Hive as they are: "
+						 "no RETURNING, no joins, and only expressions Hive can evaluate.")));
+
+	if (plan->operation != CMD_INSERT)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("only INSERT, UPDATE and DELETE are supported on Hive foreign tables")));
 
-	elog(DEBUG3, HIVE_FDW_NAME
-		 ": get foreign rel size for relation ID %d", foreigntableid);
+	if (plan->onConflictAction != ONCONFLICT_NONE)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("ON CONFLICT is not supported on Hive foreign tables")));
 
-	baserel->rows = 1000;
+#if PG_VERSION_NUM >= 120000
+	rel = table_open(rte->relid, NoLock);
+#else
+	rel = heap_open(rte->relid, NoLock);
+#endif
 
-	fpinfo = (hiveFdwRelationInfo *) palloc0(sizeof(hiveFdwRelationInfo));
-	baserel->fdw_private = (void *) fpinfo;
+	target_attrs = hiveInsertTargetAttrs(rel);
 
-	/* Base foreign tables need to be push down always. */
-	fpinfo->pushdown_safe = true;
+	initStringInfo(&sql);
+	deparseInsertSql(&sql, rel, target_attrs);
 
-	/* Look up foreign-table catalog info. */
-	fpinfo->table = GetForeignTable(foreigntableid);
-	fpinfo->server = GetForeignServer(fpinfo->table->serverid);
+#if PG_VERSION_NUM >= 120000
+	table_close(rel, NoLock);
+#else
+	heap_close(rel, NoLock);
+#endif
 
-	foreach(lc, baserel->baserestrictinfo)
+	return list_make2(makeString(sql.data), target_attrs);
+}
+
+/*
+ * hiveInsertTargetAttrs
+ *		All columns are sent on INSERT: Hive has no column defaults to
+ *		fall back on, and missing columns are NULL either way
+ */
+static List *
+hiveInsertTargetAttrs(Relation rel)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	List	   *target_attrs = NIL;
+	int			attnum;
+
+	for (attnum = 1; attnum <= tupdesc->natts; attnum++)
 	{
-		RestrictInfo *ri = (RestrictInfo *) lfirst(lc);
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
 
-		if (is_foreign_expr(root, baserel, ri->clause))
-			fpinfo->remote_conds = lappend(fpinfo->remote_conds, ri);
+		if (!attr->attisdropped)
+			target_attrs = lappend_int(target_attrs, attnum);
+	}
+
+	return target_attrs;
+}
+
+/*
+ * hiveBeginForeignModify
+ *		Connect to Hive for an INSERT
+ */
+static void
+hiveBeginForeignModify(ModifyTableState *mtstate, ResultRelInfo *rinfo,
+					   List *fdw_private, int subplan_index, int eflags)
+{
+	SIGINTInterruptCheckProcess();
+
+	/* A plain EXPLAIN only needs the remote statement, which is in the plan */
+	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
+		return;
+
+	rinfo->ri_FdwState = hiveCreateModifyState(rinfo, mtstate->ps.state,
+											   strVal(list_nth(fdw_private, 0)),
+											   (List *) list_nth(fdw_private, 1));
+}
+
+#if PG_VERSION_NUM >= 110000
+/*
+ * hiveBeginForeignInsert
+ *		Connect to Hive for COPY FROM or rows routed to a partition
+ */
+static void
+hiveBeginForeignInsert(ModifyTableState *mtstate, ResultRelInfo *rinfo)
+{
+	Relation	rel = rinfo->ri_RelationDesc;
+	List	   *target_attrs = hiveInsertTargetAttrs(rel);
+	StringInfoData sql;
+
+	SIGINTInterruptCheckProcess();
+
+	initStringInfo(&sql);
+	deparseInsertSql(&sql, rel, target_attrs);
+
+	rinfo->ri_FdwState = hiveCreateModifyState(rinfo, mtstate->ps.state,
+											   sql.data, target_attrs);
+}
+#endif
+
+/*
+ * hiveCreateModifyState
+ *		Open a connection to Hive and set up the state of an INSERT
+ */
+static hiveFdwModifyState *
+hiveCreateModifyState(ResultRelInfo *rinfo, EState *estate,
+					  char *query, List *target_attrs)
+{
+	Relation	rel = rinfo->ri_RelationDesc;
+	Oid			relid = RelationGetRelid(rel);
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	hiveFdwModifyState *fmstate;
+	ListCell   *lc;
+
+	fmstate = (hiveFdwModifyState *) palloc0(sizeof(hiveFdwModifyState));
+	fmstate->rel = rel;
+	fmstate->query = query;
+	fmstate->target_attrs = target_attrs;
+	fmstate->batch_size = hiveGetBatchSize(relid);
+	fmstate->flush_each_row = (rinfo->ri_TrigDesc != NULL &&
+							   rinfo->ri_TrigDesc->trig_insert_after_row);
+	fmstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
+											  "hive_fdw insert",
+											  ALLOCSET_SMALL_SIZES);
+
+	fmstate->p_flinfo = (FmgrInfo *) palloc0(sizeof(FmgrInfo) * tupdesc->natts);
+	foreach(lc, target_attrs)
+	{
+		int			attnum = lfirst_int(lc);
+		Oid			typoutput;
+		bool		typisvarlena;
+
+		getTypeOutputInfo(TupleDescAttr(tupdesc, attnum - 1)->atttypid,
+						  &typoutput, &typisvarlena);
+		fmgr_info(typoutput, &fmstate->p_flinfo[attnum - 1]);
+	}
+
+	initStringInfo(&fmstate->sql);
+	appendStringInfoString(&fmstate->sql, fmstate->query);
+
+	hiveOpenStagingFile(fmstate, estate->es_query_cxt);
+
+	/*
+	 * Check the columns before connecting: a mismatch throws before
+	 * ri_FdwState is set, and nothing would release the connection.
+	 */
+	if (fmstate->staging != NULL)
+		hiveCheckStagingColumns(fmstate);
+
+	fmstate->conn = hiveOpenConnection(relid);
+
+	return fmstate;
+}
+
+/*
+ * hiveOpenConnection
+ *		Connect to the server of a foreign table in order to change it
+ */
+static hiveFdwExecutionState *
+hiveOpenConnection(Oid relid)
+{
+	Oid			serverid = GetForeignTable(relid)->serverid;
+	hiveFdwExecutionState *conn;
+	char	   *svr_username = NULL;
+	char	   *svr_password = NULL;
+	char	   *svr_query = NULL;
+	char	   *svr_table = NULL;
+	char	   *svr_schema = NULL;
+	char	   *svr_host = NULL;
+	int			svr_port = 0;
+	int			svr_querytimeout = 0;
+	int			svr_maxheapsize = 0;
+
+	hiveGetTableOptions(relid, &svr_table, &svr_schema);
+	hiveGetServerOptions(serverid,
+						 &svr_querytimeout,
+						 &svr_maxheapsize,
+						 &svr_username,
+						 &svr_password,
+						 &svr_query,
+						 &svr_host,
+						 &svr_port);
+
+	if (!hive_gateway_enabled())
+		JVMInitialization(serverid);
+
+	PG_TRY();
+	{
+		conn = hiveGetConnection(serverid, svr_username, svr_password,
+								 svr_host, svr_port, svr_schema,
+								 svr_querytimeout);
+	}
+	PG_CATCH();
+	{
+		hive_stats_error(serverid, relid);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	conn->serverid = serverid;
+	conn->relid = relid;
+	hive_stats_connection(serverid, relid, conn->metrics.reused);
+
+	return conn;
+}
+
+/*
+ * hiveUseRemoteEstimate
+ *		Value of the use_remote_estimate option of a foreign table, or of
+ *		its server if the table does not set it
+ */
+static bool
+hiveUseRemoteEstimate(Oid foreigntableid)
+{
+	ForeignTable *table = GetForeignTable(foreigntableid);
+	ForeignServer *server = GetForeignServer(table->serverid);
+	bool		use_remote_estimate = false;
+	ListCell   *lc;
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "use_remote_estimate") == 0)
+			use_remote_estimate = defGetBoolean(def);
+	}
+
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "use_remote_estimate") == 0)
+			use_remote_estimate = defGetBoolean(def);
+	}
+
+	return use_remote_estimate;
+}
+
+/*
+ * hiveGetDrainResult
+ *		Value of the drain_result option of a foreign table, or of its
+ *		server if the table does not set it. Pushed-down joins, which
+ *		have no table of their own, follow the server.
+ */
+static bool
+hiveGetDrainResult(Oid serverid, Oid foreigntableid)
+{
+	ForeignServer *server = GetForeignServer(serverid);
+	bool		drain_result = false;
+	ListCell   *lc;
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "drain_result") == 0)
+			drain_result = defGetBoolean(def);
+	}
+
+	if (OidIsValid(foreigntableid))
+	{
+		foreach(lc, GetForeignTable(foreigntableid)->options)
+		{
+			DefElem    *def = (DefElem *) lfirst(lc);
+
+			if (strcmp(def->defname, "drain_result") == 0)
+				drain_result = defGetBoolean(def);
+		}
+	}
+
+	return drain_result;
+}
+
+/*
+ * hiveGetResultCacheTtl
+ *		How long the result of a scan may be cached: the result_cache_ttl
+ *		of its foreign table, or the smallest one of the tables of a join.
+ *		0 if one of them does not set it.
+ */
+static int
+hiveGetResultCacheTtl(PlannerInfo *root, RelOptInfo *rel)
+{
+	int			ttl = -1;
+	int			rti = -1;
+
+	while ((rti = bms_next_member(rel->relids, rti)) >= 0)
+	{
+		RangeTblEntry *rte = planner_rt_fetch(rti, root);
+		ForeignTable *table;
+		int			table_ttl = 0;
+		ListCell   *lc;
+
+		if (rte->rtekind != RTE_RELATION)
+			continue;
+
+		table = GetForeignTable(rte->relid);
+		foreach(lc, table->options)
+		{
+			DefElem    *def = (DefElem *) lfirst(lc);
+
+			if (strcmp(def->defname, "result_cache_ttl") == 0)
+				table_ttl = atoi(defGetString(def));
+		}
+
+		if (table_ttl == 0)
+			return 0;
+		if (ttl < 0 || table_ttl < ttl)
+			ttl = table_ttl;
+	}
+
+	return Max(ttl, 0);
+}
+
+/*
+ * hiveFetchTableMetadata
+ *		Ask Hive about the table behind a foreign table: its statistics
+ *		from the table parameters of DESCRIBE FORMATTED, its column names
+ *		with the partition keys last and, if it is partitioned, the number
+ *		of its partitions. Hive keeps no row count for partitioned tables
+ *		as a whole, nor for tables whose statistics were never gathered,
+ *		in which case numRows is 0 while totalSize is not. Foreign tables
+ *		defined by a query have no Hive table, and nothing is known about
+ *		them.
+ */
+void
+hiveFetchTableMetadata(Oid relid, hiveTableMetadata *meta)
+{
+	char	   *svr_table = NULL;
+	char	   *svr_schema = NULL;
+	hiveFdwExecutionState *conn;
+	List	   *rows = NIL;
+	List	   *partition_keys = NIL;
+	ListCell   *lc;
+	bool		partitioned = false;
+	int			section = 0;	/* 0 columns, 1 partition keys, 2 other */
+
+	meta->rows = -1;
+	meta->bytes = -1;
+	meta->files = -1;
+	meta->partitions = -1;
+	meta->columns = NIL;
+	meta->partition_keys = 0;
+
+	hiveGetTableOptions(relid, &svr_table, &svr_schema);
+	if (svr_table == NULL)
+		return;
+
+	elog(DEBUG1, HIVE_FDW_NAME ": fetching metadata of relation ID %u", relid);
+
+	conn = hiveOpenConnection(relid);
+
+	PG_TRY();
+	{
+		rows = hiveQueryTextRows(conn, psprintf("DESCRIBE FORMATTED %s", svr_table), 3);
+
+		foreach(lc, rows)
+		{
+			char	  **row = (char **) lfirst(lc);
+
+			if (row[0] != NULL &&
+				strcmp(hiveTrimSpace(row[0]), "# Partition Information") == 0)
+				partitioned = true;
+		}
+
+		if (partitioned)
+			meta->partitions = list_length(hiveQueryTextRows(conn,
+															 psprintf("SHOW PARTITIONS %s", svr_table),
+															 1));
 		else
-			fpinfo->local_conds = lappend(fpinfo->local_conds, ri);
+			meta->partitions = 0;
+	}
+	PG_CATCH();
+	{
+		hiveReleaseConnection(conn);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	hiveReleaseConnection(conn);
+
+	foreach(lc, rows)
+	{
+		char	  **row = (char **) lfirst(lc);
+		char	   *name = row[0] != NULL ? hiveTrimSpace(row[0]) : "";
+		char	   *value;
+
+		/*
+		 * The columns come first and the partition keys after "# Partition
+		 * Information", each under a "# col_name" heading. Any other
+		 * heading, such as "# Detailed Table Information", ends them.
+		 */
+		if (strcmp(name, "# Partition Information") == 0)
+			section = 1;
+		else if (strncmp(name, "# col_name", 10) == 0)
+			;
+		else if (name[0] == '#')
+			section = 2;
+		else if (name[0] != '\0' && section == 0)
+			meta->columns = lappend(meta->columns, pstrdup(name));
+		else if (name[0] != '\0' && section == 1)
+			partition_keys = lappend(partition_keys, pstrdup(name));
+
+		/* Table parameters are "", name, value */
+		if (row[1] == NULL || row[2] == NULL)
+			continue;
+		name = hiveTrimSpace(row[1]);
+		value = hiveTrimSpace(row[2]);
+
+		if (strcmp(name, "numRows") == 0)
+			meta->rows = strtod(value, NULL);
+		else if (strcmp(name, "totalSize") == 0)
+			meta->bytes = strtoll(value, NULL, 10);
+		else if (strcmp(name, "numFiles") == 0)
+			meta->files = strtoll(value, NULL, 10);
+	}
+
+	if (meta->rows == 0 && meta->bytes > 0)
+		meta->rows = -1;
+
+	meta->partition_keys = list_length(partition_keys);
+	meta->columns = list_concat(meta->columns, partition_keys);
+}
+
+/*
+ * hiveQueryTextRows
+ *		Run a statement with a small result, such as DESCRIBE, on conn
+ *		and return its rows as a list of arrays of ncols strings, with
+ *		NULL for NULL
+ */
+static List *
+hiveQueryTextRows(hiveFdwExecutionState *conn, const char *sql, int ncols)
+{
+	TupleDesc	tupdesc;
+	hiveTupleDecoder *decoder;
+	Datum	   *values = (Datum *) palloc(sizeof(Datum) * ncols);
+	bool	   *nulls = (bool *) palloc(sizeof(bool) * ncols);
+	List	   *rows = NIL;
+	bool		more = true;
+	char	   *query_id = NULL;
+	char	   *job_ids = NULL;
+	instr_time	start;
+	instr_time	elapsed;
+	int			i;
+
+#if PG_VERSION_NUM >= 120000
+	tupdesc = CreateTemplateTupleDesc(ncols);
+#else
+	tupdesc = CreateTemplateTupleDesc(ncols, false);
+#endif
+	for (i = 0; i < ncols; i++)
+		TupleDescInitEntry(tupdesc, (AttrNumber) (i + 1), NULL, TEXTOID, -1, 0);
+	decoder = hiveBatchPrepare(TupleDescGetAttInMetadata(tupdesc));
+
+	hiveBatchInit(&conn->batch, NULL, 0);
+	INSTR_TIME_SET_CURRENT(start);
+
+	PG_TRY();
+	{
+		if (conn->gateway_cursor >= 0)
+			hive_gateway_execute(conn->gateway_cursor, sql, &query_id, &job_ids, NULL);
+		else
+			hiveJNIExecuteQuery(conn->java_call, sql);
+
+		INSTR_TIME_SET_CURRENT(elapsed);
+		INSTR_TIME_SUBTRACT(elapsed, start);
+
+		/* The last fetch may still return rows */
+		for (;;)
+		{
+			while (hiveBatchNextRow(&conn->batch, decoder, values, nulls))
+			{
+				char	  **row = (char **) palloc(sizeof(char *) * ncols);
+
+				for (i = 0; i < ncols; i++)
+					row[i] = nulls[i] ? NULL : TextDatumGetCString(values[i]);
+				rows = lappend(rows, row);
+			}
+			if (!more)
+				break;
+			more = hiveFetchNextBatch(conn);
+		}
+
+		if (conn->gateway_cursor < 0)
+			hiveJNIRelease(conn->java_call);
 	}
+	PG_CATCH();
+	{
+		hive_stats_error(conn->serverid, conn->relid);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	hive_stats_query(conn->serverid, conn->relid, elapsed);
+
+	return rows;
+}
+
+/*
+ * hiveTrimSpace
+ *		Strip leading and trailing white space from str, in place
+ */
+char *
+hiveTrimSpace(char *str)
+{
+	char	   *end;
+
+	while (isspace((unsigned char) *str))
+		str++;
+	end = str + strlen(str);
+	while (end > str && isspace((unsigned char) end[-1]))
+		end--;
+	*end = '\0';
+
+	return str;
+}
+
+/*
+ * hiveExecForeignInsert
+ *		Add one row to the pending INSERT, sending it once batch_size rows
+ *		are collected. Before PostgreSQL 14, and for statements that cannot
+ *		use ExecForeignBatchInsert, this is how rows are still sent in
+ *		batches; whatever is left goes out in hiveEndForeignModify.
+ */
+static TupleTableSlot *
+hiveExecForeignInsert(EState *estate, ResultRelInfo *rinfo,
+					  TupleTableSlot *slot, TupleTableSlot *planSlot)
+{
+	hiveFdwModifyState *fmstate = (hiveFdwModifyState *) rinfo->ri_FdwState;
+
+	SIGINTInterruptCheckProcess();
+
+	hiveAddInsertRow(fmstate, slot);
+
+	if (fmstate->staging == NULL &&
+		(fmstate->nrows >= fmstate->batch_size || fmstate->flush_each_row))
+		hiveFlushInserts(fmstate);
+
+	return slot;
+}
+
+#if PG_VERSION_NUM >= 140000
+/*
+ * hiveExecForeignBatchInsert
+ *		Send the rows the executor collected as one INSERT
+ */
+static TupleTableSlot **
+hiveExecForeignBatchInsert(EState *estate, ResultRelInfo *rinfo,
+						   TupleTableSlot **slots, TupleTableSlot **planSlots,
+						   int *numSlots)
+{
+	hiveFdwModifyState *fmstate = (hiveFdwModifyState *) rinfo->ri_FdwState;
+	int			i;
+
+	SIGINTInterruptCheckProcess();
+
+	for (i = 0; i < *numSlots; i++)
+		hiveAddInsertRow(fmstate, slots[i]);
+
+	if (fmstate->staging == NULL)
+		hiveFlushInserts(fmstate);
+
+	return slots;
+}
+
+/*
+ * hiveGetForeignModifyBatchSize
+ *		Number of rows the executor should collect for
+ *		hiveExecForeignBatchInsert
+ */
+static int
+hiveGetForeignModifyBatchSize(ResultRelInfo *rinfo)
+{
+	hiveFdwModifyState *fmstate = (hiveFdwModifyState *) rinfo->ri_FdwState;
 
 	/*
-	 * Identify which attributes will need to be retrieved from the remote
-	 * server.  These include all attrs needed for joins or final output, plus
-	 * all attrs used in the local_conds.
-	 *
-	 * In cases where there is a small amount of data, and we don't send
-	 * hive a WHERE clause, we should also do a SELECT *. And that happens
-	 * when attrs_used remains NULL for the local execution case below
+	 * RETURNING and row triggers need each row on its own; the executor
+	 * then calls hiveExecForeignInsert, which still batches when it can.
 	 */
-	fpinfo->attrs_used = NULL;
+	if (rinfo->ri_projectReturning != NULL ||
+		(rinfo->ri_TrigDesc &&
+		 (rinfo->ri_TrigDesc->trig_insert_before_row ||
+		  rinfo->ri_TrigDesc->trig_insert_after_row)))
+		return 1;
 
-	pull_varattnos((Node *) baserel->reltarget->exprs, baserel->relid,
-				   &fpinfo->attrs_used);
-	foreach(lc, fpinfo->local_conds)
+	if (fmstate != NULL)
+		return fmstate->batch_size;
+
+	return hiveGetBatchSize(RelationGetRelid(rinfo->ri_RelationDesc));
+}
+#endif
+
+/*
+ * hiveSetTransmissionModes
+ *		Force the GUCs that affect the text form of values to settings
+ *		Hive can read, whatever the session uses. Returns the GUC nest
+ *		level to pass to hiveResetTransmissionModes.
+ */
+static int
+hiveSetTransmissionModes(void)
+{
+	int			nestlevel = NewGUCNestLevel();
+
+	/* Only set what differs, to keep the nest level cheap */
+	if (DateStyle != USE_ISO_DATES)
+		(void) set_config_option("datestyle", "ISO",
+								 PGC_USERSET, PGC_S_SESSION,
+								 GUC_ACTION_SAVE, true, 0, false);
+	if (IntervalStyle != INTSTYLE_POSTGRES)
+		(void) set_config_option("intervalstyle", "postgres",
+								 PGC_USERSET, PGC_S_SESSION,
+								 GUC_ACTION_SAVE, true, 0, false);
+	if (extra_float_digits < 3)
+		(void) set_config_option("extra_float_digits", "3",
+								 PGC_USERSET, PGC_S_SESSION,
+								 GUC_ACTION_SAVE, true, 0, false);
+
+	return nestlevel;
+}
+
+/*
+ * hiveResetTransmissionModes
+ *		Undo hiveSetTransmissionModes
+ */
+static void
+hiveResetTransmissionModes(int nestlevel)
+{
+	AtEOXact_GUC(true, nestlevel);
+}
+
+/*
+ * hiveAddInsertRow
+ *		Add a row to the pending INSERT statement, or to the staged file
+ */
+static void
+hiveAddInsertRow(hiveFdwModifyState *fmstate, TupleTableSlot *slot)
+{
+	MemoryContext oldcontext = MemoryContextSwitchTo(fmstate->temp_cxt);
+	int			nestlevel = hiveSetTransmissionModes();
+
+	if (fmstate->staging != NULL)
+		hiveStageRow(fmstate, slot);
+	else
 	{
-		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		if (fmstate->nrows > 0)
+			appendStringInfoString(&fmstate->sql, ", ");
+		deparseInsertRow(&fmstate->sql, slot, fmstate->target_attrs,
+						 fmstate->p_flinfo);
+	}
+	fmstate->nrows++;
+
+	hiveResetTransmissionModes(nestlevel);
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextReset(fmstate->temp_cxt);
+}
+
+/*
+ * hiveFlushInserts
+ *		Send the pending rows as one INSERT statement
+ */
+static void
+hiveFlushInserts(hiveFdwModifyState *fmstate)
+{
+	if (fmstate->nrows == 0)
+		return;
+
+	elog(DEBUG1, HIVE_FDW_NAME ": inserting %d rows into relation ID %u",
+		 fmstate->nrows, fmstate->conn->relid);
+
+	hiveExecuteModify(fmstate->conn, fmstate->sql.data);
+
+	/* Start the next statement, keeping the buffer */
+	resetStringInfo(&fmstate->sql);
+	appendStringInfoString(&fmstate->sql, fmstate->query);
+	fmstate->nrows = 0;
+}
+
+/*
+ * hiveExecuteModify
+ *		Run a statement that returns no rows on the connection of an
+ *		INSERT, UPDATE or DELETE. Returns the number of rows it changed,
+ *		or -1 if the driver does not report it.
+ */
+static int64
+hiveExecuteModify(hiveFdwExecutionState *conn, const char *sql)
+{
+	instr_time	start;
+	instr_time	elapsed;
+	char	   *query_id = NULL;
+	char	   *job_ids = NULL;
+	int64		update_count = -1;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	PG_TRY();
+	{
+		if (conn->gateway_cursor >= 0)
+			hive_gateway_execute(conn->gateway_cursor, sql, &query_id, &job_ids,
+								 &update_count);
+		else
+		{
+			hiveJNIExecuteQuery(conn->java_call, sql);
+			update_count = hiveJNIUpdateCount(conn->java_call);
+			hiveJNIRelease(conn->java_call);
+		}
+	}
+	PG_CATCH();
+	{
+		hive_stats_error(conn->serverid, conn->relid);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+	hive_stats_query(conn->serverid, conn->relid, elapsed);
+
+	if (query_id)
+		pfree(query_id);
+	if (job_ids)
+		pfree(job_ids);
+
+	return update_count;
+}
+
+/*
+ * hiveOpenStagingFile
+ *		With the staging_dir option set, rows are not sent as INSERT
+ *		statements but written to a file in that directory, which one
+ *		LOAD DATA moves into the Hive table at the end of the statement.
+ *		The file is in the default format of a Hive text table: fields
+ *		separated by \001, NULL as \N and one row per line.
+ */
+static void
+hiveOpenStagingFile(hiveFdwModifyState *fmstate, MemoryContext cxt)
+{
+	MemoryContextCallback *cb;
+	Relation	rel = fmstate->rel;
+	char	   *staging_dir = NULL;
+	char	   *staging_uri = NULL;
+	char	   *partition = NULL;
+	char		filename[64];
+	ListCell   *lc;
+
+	hiveGetStagingOptions(RelationGetRelid(rel), &staging_dir, &staging_uri, &partition);
+	if (staging_dir == NULL)
+		return;
+
+	/* Hive text tables have no way to write these */
+	foreach(lc, fmstate->target_attrs)
+	{
+		int			attnum = lfirst_int(lc);
+		List	   *options = GetForeignColumnOptions(RelationGetRelid(rel), attnum);
+		ListCell   *olc;
+
+		foreach(olc, options)
+		{
+			DefElem    *def = (DefElem *) lfirst(olc);
+
+			if (strcmp(def->defname, "hive_type") == 0 &&
+				hiveTypeKind(defGetString(def)) != HIVE_TYPE_PRIMITIVE)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("cannot stage column \"%s\" of Hive type %s",
+								NameStr(TupleDescAttr(RelationGetDescr(rel), attnum - 1)->attname),
+								defGetString(def))));
+		}
+	}
+
+	snprintf(filename, sizeof(filename), "hive_fdw_%d_%u.txt",
+			 MyProcPid, hive_staging_counter++);
+	fmstate->staging_file = MemoryContextStrdup(cxt, psprintf("%s/%s", staging_dir, filename));
+	fmstate->load_query = hiveStagingLoadSql(rel, filename);
+
+	/* Don't leave the file behind if the statement fails */
+	cb = (MemoryContextCallback *) MemoryContextAlloc(cxt, sizeof(MemoryContextCallback));
+	cb->func = hiveRemoveStagingFile;
+	cb->arg = fmstate->staging_file;
+	MemoryContextRegisterResetCallback(cxt, cb);
+
+	fmstate->staging = AllocateFile(fmstate->staging_file, PG_BINARY_W);
+	if (fmstate->staging == NULL)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\" for writing: %m",
+						fmstate->staging_file)));
+
+	elog(DEBUG1, HIVE_FDW_NAME ": staging rows in \"%s\"", fmstate->staging_file);
+}
+
+/*
+ * hiveRemoveStagingFile
+ *		Memory context callback removing a staged file that was not loaded
+ */
+static void
+hiveRemoveStagingFile(void *arg)
+{
+	(void) unlink((const char *) arg);
+}
+
+/*
+ * hiveCheckStagingColumns
+ *		LOAD DATA reads the staged file by position, so the foreign table
+ *		must list the Hive table's columns in their order under their
+ *		Hive names, ending with the partition columns unless the
+ *		partition option names the partition. The Hive columns come from
+ *		the metadata cache, so repeated loads do not ask Hive each time.
+ */
+static void
+hiveCheckStagingColumns(hiveFdwModifyState *fmstate)
+{
+	Relation	rel = fmstate->rel;
+	Oid			relid = RelationGetRelid(rel);
+	char	   *svr_table = NULL;
+	char	   *svr_schema = NULL;
+	char	   *staging_dir = NULL;
+	char	   *staging_uri = NULL;
+	char	   *partition = NULL;
+	hiveTableMetadata meta;
+	List	   *columns;
+	ListCell   *lc;
+	ListCell   *lc2;
+	int			i = 0;
+
+	hiveGetTableOptions(relid, &svr_table, &svr_schema);
+	hiveGetStagingOptions(relid, &staging_dir, &staging_uri, &partition);
+
+	hive_meta_lookup(relid, &meta);
+	columns = meta.columns;
+
+	/* The partition option provides the values of the partition columns */
+	if (partition != NULL)
+		columns = list_truncate(columns,
+								list_length(columns) - meta.partition_keys);
+
+	forboth(lc, fmstate->target_attrs, lc2, columns)
+	{
+		int			attnum = lfirst_int(lc);
+		char	   *name = get_column_name(relid, attnum);
+
+		i++;
+		if (pg_strcasecmp(name, (char *) lfirst(lc2)) != 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_COLUMN_NAME),
+					 errmsg("cannot stage rows of foreign table \"%s\" for LOAD DATA",
+							RelationGetRelationName(rel)),
+					 errdetail("Column %d is \"%s\" in the foreign table but \"%s\" in Hive table %s.",
+							   i, name,
+							   (char *) lfirst(lc2), svr_table),
+					 errhint("Unset the staging_dir option to send the rows as INSERT statements.")));
+	}
+
+	if (list_length(fmstate->target_attrs) != list_length(columns))
+		ereport(ERROR,
+				(errcode(ERRCODE_FDW_INVALID_COLUMN_NUMBER),
+				 errmsg("cannot stage rows of foreign table \"%s\" for LOAD DATA",
+						RelationGetRelationName(rel)),
+				 errdetail("The foreign table has %d columns but Hive table %s expects %d%s.",
+						   list_length(fmstate->target_attrs), svr_table,
+						   list_length(columns),
+						   partition != NULL ? " besides its partition columns" : ""),
+				 errhint("Unset the staging_dir option to send the rows as INSERT statements.")));
+}
+
+/*
+ * hiveStagingLoadSql
+ *		LOAD DATA statement for a file of the staging directory. Without
+ *		staging_uri, HiveServer2 reads staging_dir from its own file system
+ *		(LOAD DATA LOCAL); otherwise the file is taken from staging_uri,
+ *		the same directory as Hive sees it.
+ */
+static char *
+hiveStagingLoadSql(Relation rel, const char *filename)
+{
+	char	   *staging_dir = NULL;
+	char	   *staging_uri = NULL;
+	char	   *partition = NULL;
+	StringInfoData sql;
+
+	hiveGetStagingOptions(RelationGetRelid(rel), &staging_dir, &staging_uri, &partition);
+
+	initStringInfo(&sql);
+	deparseLoadSql(&sql, rel,
+				   psprintf("%s/%s", staging_uri ? staging_uri : staging_dir, filename),
+				   staging_uri == NULL, partition);
+
+	return sql.data;
+}
+
+/*
+ * hiveStageRow
+ *		Write a row to the staged file. Values are in their text form,
+ *		except for booleans and binary data, which Hive reads as
+ *		true/false and base64. Line breaks and \001 cannot be escaped in
+ *		a default Hive text table, so values holding them are refused.
+ */
+static void
+hiveStageRow(hiveFdwModifyState *fmstate, TupleTableSlot *slot)
+{
+	TupleDesc	tupdesc = slot->tts_tupleDescriptor;
+	StringInfoData line;
+	ListCell   *lc;
+	bool		first = true;
+
+	initStringInfo(&line);
+
+	foreach(lc, fmstate->target_attrs)
+	{
+		int			attnum = lfirst_int(lc);
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
+		Datum		value;
+		bool		isnull;
+		char	   *extval;
+
+		if (!first)
+			appendStringInfoChar(&line, '\001');
+		first = false;
+
+		value = slot_getattr(slot, attnum, &isnull);
+		if (isnull)
+		{
+			appendStringInfoString(&line, "\\N");
+			continue;
+		}
+
+		switch (attr->atttypid)
+		{
+			case BOOLOID:
+				appendStringInfoString(&line, DatumGetBool(value) ? "true" : "false");
+				break;
+			case BYTEAOID:
+				appendStringInfoString(&line, hiveEncodeBase64(value));
+				break;
+			default:
+				extval = hiveOutputValue(&fmstate->p_flinfo[attnum - 1],
+										 attr->atttypid, value);
+				if (strpbrk(extval, "\n\r\001") != NULL)
+					ereport(ERROR,
+							(errcode(ERRCODE_FDW_INVALID_STRING_FORMAT),
+							 errmsg("value of column \"%s\" cannot be staged for LOAD DATA",
+									NameStr(attr->attname)),
+							 errdetail("It contains a line break or the field separator \\001."),
+							 errhint("Unset the staging_dir option to send the rows as INSERT statements.")));
+
+				/* Hive reads text files as UTF-8 */
+				extval = pg_server_to_any(extval, strlen(extval), PG_UTF8);
+				appendStringInfoString(&line, extval);
+				break;
+		}
+	}
+
+	appendStringInfoChar(&line, '\n');
+
+	if (fwrite(line.data, 1, line.len, fmstate->staging) != line.len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s\": %m", fmstate->staging_file)));
+}
+
+/*
+ * hiveLoadStagingFile
+ *		Close the staged file and load it into the Hive table
+ */
+static void
+hiveLoadStagingFile(hiveFdwModifyState *fmstate)
+{
+	int			rc = FreeFile(fmstate->staging);
+
+	fmstate->staging = NULL;
+	if (rc != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m", fmstate->staging_file)));
+
+	if (fmstate->nrows > 0)
+	{
+		elog(DEBUG1, HIVE_FDW_NAME ": loading %d rows into relation ID %u",
+			 fmstate->nrows, fmstate->conn->relid);
+
+		hiveExecuteModify(fmstate->conn, fmstate->load_query);
+	}
+
+	/* LOAD DATA INPATH moves the file away, LOAD DATA LOCAL copies it */
+	if (unlink(fmstate->staging_file) != 0 && errno != ENOENT)
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("could not remove file \"%s\": %m", fmstate->staging_file)));
+}
+
+/*
+ * hiveEndForeignModify
+ *		Send the rows still pending and release the connection
+ */
+static void
+hiveEndForeignModify(EState *estate, ResultRelInfo *rinfo)
+{
+	hiveFdwModifyState *fmstate = (hiveFdwModifyState *) rinfo->ri_FdwState;
+
+	SIGINTInterruptCheckProcess();
+
+	/* Nothing was started for EXPLAIN without ANALYZE */
+	if (fmstate == NULL)
+		return;
+
+	if (fmstate->staging != NULL)
+		hiveLoadStagingFile(fmstate);
+	else
+		hiveFlushInserts(fmstate);
+	hiveReleaseConnection(fmstate->conn);
+
+	rinfo->ri_FdwState = NULL;
+}
+
+#if PG_VERSION_NUM >= 110000
+/*
+ * hiveEndForeignInsert
+ *		Finish COPY FROM or routing rows to a partition
+ */
+static void
+hiveEndForeignInsert(EState *estate, ResultRelInfo *rinfo)
+{
+	hiveEndForeignModify(estate, rinfo);
+}
+#endif
+
+/*
+ * hiveExplainForeignModify
+ *		Show the remote INSERT and how many rows it sends at once
+ */
+static void
+hiveExplainForeignModify(ModifyTableState *mtstate, ResultRelInfo *rinfo,
+						 List *fdw_private, int subplan_index,
+						 ExplainState *es)
+{
+	Relation	rel = rinfo->ri_RelationDesc;
+	char	   *staging_dir = NULL;
+	char	   *staging_uri = NULL;
+	char	   *partition = NULL;
+	StringInfoData sql;
+
+	hiveGetStagingOptions(RelationGetRelid(rel), &staging_dir, &staging_uri, &partition);
+	if (staging_dir != NULL)
+	{
+		ExplainPropertyText("Remote SQL", hiveStagingLoadSql(rel, "..."), es);
+		return;
+	}
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql, "%s(...)", strVal(list_nth(fdw_private, 0)));
+	ExplainPropertyText("Remote SQL", sql.data, es);
+
+	if (es->verbose)
+		hiveExplainCount("Batch Size",
+						 hiveGetBatchSize(RelationGetRelid(rinfo->ri_RelationDesc)),
+						 es);
+}
+
+/*
+ * hiveExecForeignUpdate
+ *		Never called: hivePlanForeignModify rejects UPDATE that is not run
+ *		on the Hive server, but the executor requires the callback
+ */
+static TupleTableSlot *
+hiveExecForeignUpdate(EState *estate, ResultRelInfo *rinfo,
+					  TupleTableSlot *slot, TupleTableSlot *planSlot)
+{
+	elog(ERROR, "UPDATE on Hive foreign tables must run on the Hive server");
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * hiveExecForeignDelete
+ *		Never called, like hiveExecForeignUpdate
+ */
+static TupleTableSlot *
+hiveExecForeignDelete(EState *estate, ResultRelInfo *rinfo,
+					  TupleTableSlot *slot, TupleTableSlot *planSlot)
+{
+	elog(ERROR, "DELETE on Hive foreign tables must run on the Hive server");
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * hivePlanDirectModify
+ *		Replace the scan feeding an UPDATE or DELETE by a single UPDATE or
+ *		DELETE statement run on the Hive server. This is only possible
+ *		when the scan is a plain scan of the target table whose conditions
+ *		all go to Hive, and when Hive can compute the new values itself.
+ */
+static bool
+hivePlanDirectModify(PlannerInfo *root, ModifyTable *plan,
+					 Index resultRelation, int subplan_index)
+{
+	CmdType		operation = plan->operation;
+	RangeTblEntry *rte = planner_rt_fetch(resultRelation, root);
+	RelOptInfo *foreignrel;
+	hiveFdwRelationInfo *fpinfo;
+	ForeignScan *fscan;
+	Relation	rel;
+	List	   *processed_tlist = NIL;
+	List	   *target_attrs = NIL;
+	List	   *remote_conds = NIL;
+	List	   *params_list = NIL;
+	ListCell   *lc;
+	StringInfoData sql;
+
+	if (operation != CMD_UPDATE && operation != CMD_DELETE)
+		return false;
+
+	/* Hive cannot return the rows it changed */
+	if (plan->returningLists)
+		return false;
+
+	fscan = hiveFindModifyTableSubplan(root, plan, resultRelation, subplan_index);
+	if (fscan == NULL)
+		return false;
+
+	/* Conditions evaluated locally would have to see every row */
+	if (fscan->scan.plan.qual != NIL)
+		return false;
+
+	foreignrel = find_base_rel(root, resultRelation);
+	fpinfo = (hiveFdwRelationInfo *) foreignrel->fdw_private;
+
+	if (operation == CMD_UPDATE)
+	{
+#if PG_VERSION_NUM >= 140000
+		ListCell   *lc2;
+
+		get_translated_update_targetlist(root, resultRelation,
+										 &processed_tlist, &target_attrs);
+		forboth(lc, processed_tlist, lc2, target_attrs)
+		{
+			TargetEntry *tle = lfirst_node(TargetEntry, lc);
+			AttrNumber	attno = lfirst_int(lc2);
+
+			if (attno <= InvalidAttrNumber)
+				elog(ERROR, "system-column update is not supported");
+
+			if (!is_foreign_expr(root, foreignrel, (Expr *) tle->expr))
+				return false;
+		}
+#else
+		int			col = -1;
+
+		while ((col = bms_next_member(rte->updatedCols, col)) >= 0)
+		{
+			/* bit numbers are offset by FirstLowInvalidHeapAttributeNumber */
+			AttrNumber	attno = col + FirstLowInvalidHeapAttributeNumber;
+			TargetEntry *tle;
+
+			if (attno <= InvalidAttrNumber)
+				elog(ERROR, "system-column update is not supported");
+
+			tle = get_tle_by_resno(fscan->scan.plan.targetlist, attno);
+			if (tle == NULL)
+				elog(ERROR, "attribute number %d not found in subplan targetlist",
+					 attno);
+
+			if (!is_foreign_expr(root, foreignrel, (Expr *) tle->expr))
+				return false;
+
+			processed_tlist = lappend(processed_tlist, tle);
+			target_attrs = lappend_int(target_attrs, attno);
+		}
+#endif
+	}
+
+	foreach(lc, fpinfo->remote_conds)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		if (!rinfo->pseudoconstant)
+			remote_conds = lappend(remote_conds, rinfo);
+	}
+
+#if PG_VERSION_NUM >= 120000
+	rel = table_open(rte->relid, NoLock);
+#else
+	rel = heap_open(rte->relid, NoLock);
+#endif
+
+	initStringInfo(&sql);
+	if (operation == CMD_UPDATE)
+		deparseDirectUpdateSql(&sql, root, foreignrel, rel, processed_tlist,
+							   target_attrs, remote_conds, &params_list);
+	else
+		deparseDirectDeleteSql(&sql, root, foreignrel, rel, remote_conds,
+							   &params_list);
+
+#if PG_VERSION_NUM >= 120000
+	table_close(rel, NoLock);
+#else
+	heap_close(rel, NoLock);
+#endif
+
+	/* HiveServer2 takes no parameters */
+	if (params_list != NIL)
+		return false;
+
+	elog(DEBUG1, HIVE_FDW_NAME ": built HiveQL:\n\n%s\n", sql.data);
+
+	fscan->operation = operation;
+#if PG_VERSION_NUM >= 140000
+	fscan->resultRelation = resultRelation;
+#endif
+
+	/* Same layout as for a scan, so that the SQL is always the first item */
+	fscan->fdw_private = list_make4(makeString(sql.data),
+									NIL,
+									makeInteger(foreignrel->serverid),
+									makeInteger(rte->relid));
+	fscan->fdw_private = lappend(fscan->fdw_private,
+								 makeInteger(plan->canSetTag));
+
+	return true;
+}
+
+/*
+ * hiveFindModifyTableSubplan
+ *		The ForeignScan of resultRelation feeding a ModifyTable node, or
+ *		NULL if the rows come from something else, such as a join
+ */
+static ForeignScan *
+hiveFindModifyTableSubplan(PlannerInfo *root, ModifyTable *plan,
+						   Index resultRelation, int subplan_index)
+{
+#if PG_VERSION_NUM >= 140000
+	Plan	   *subplan = outerPlan(plan);
+
+	/* Inherited and partitioned tables are scanned by an Append */
+	if (IsA(subplan, Append))
+	{
+		Append	   *appendplan = (Append *) subplan;
+
+		if (subplan_index < list_length(appendplan->appendplans))
+			subplan = (Plan *) list_nth(appendplan->appendplans, subplan_index);
+	}
+#else
+	Plan	   *subplan = (Plan *) list_nth(plan->plans, subplan_index);
+#endif
+
+	if (IsA(subplan, ForeignScan) &&
+		((ForeignScan *) subplan)->scan.scanrelid == resultRelation)
+		return (ForeignScan *) subplan;
+
+	return NULL;
+}
+
+/*
+ * hiveBeginDirectModify
+ *		Connect to Hive for an UPDATE or DELETE
+ */
+static void
+hiveBeginDirectModify(ForeignScanState *node, int eflags)
+{
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+	hiveFdwDirectModifyState *dmstate;
+
+	SIGINTInterruptCheckProcess();
+
+	/* A plain EXPLAIN only needs the remote statement, which is in the plan */
+	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
+		return;
+
+	dmstate = (hiveFdwDirectModifyState *) palloc0(sizeof(hiveFdwDirectModifyState));
+	dmstate->query = strVal(list_nth(fsplan->fdw_private, 0));
+	dmstate->set_processed = intVal(list_nth(fsplan->fdw_private, 4));
+	dmstate->conn = hiveOpenConnection(intVal(list_nth(fsplan->fdw_private, 3)));
+
+	node->fdw_state = (void *) dmstate;
+}
+
+/*
+ * hiveIterateDirectModify
+ *		Run the statement. No rows are returned, as there is no RETURNING.
+ */
+static TupleTableSlot *
+hiveIterateDirectModify(ForeignScanState *node)
+{
+	hiveFdwDirectModifyState *dmstate = (hiveFdwDirectModifyState *) node->fdw_state;
+	EState	   *estate = node->ss.ps.state;
+	Instrumentation *instr = node->ss.ps.instrument;
+
+	SIGINTInterruptCheckProcess();
+
+	if (!dmstate->executed)
+	{
+		int64		update_count;
+
+		elog(DEBUG1, "hive_fdw: Starting Query: %s", dmstate->query);
+
+		update_count = hiveExecuteModify(dmstate->conn, dmstate->query);
+		dmstate->executed = true;
+
+		/* Drivers for Hive before 3.0 do not say how many rows changed */
+		dmstate->num_tuples = Max(update_count, 0);
+
+		if (dmstate->set_processed)
+			estate->es_processed += dmstate->num_tuples;
+		if (instr)
+			instr->tuplecount += dmstate->num_tuples;
+	}
+
+	return ExecClearTuple(node->ss.ss_ScanTupleSlot);
+}
+
+/*
+ * hiveEndDirectModify
+ *		Release the connection of an UPDATE or DELETE
+ */
+static void
+hiveEndDirectModify(ForeignScanState *node)
+{
+	hiveFdwDirectModifyState *dmstate = (hiveFdwDirectModifyState *) node->fdw_state;
+
+	SIGINTInterruptCheckProcess();
+
+	/* Nothing was started for EXPLAIN without ANALYZE */
+	if (dmstate == NULL)
+		return;
+
+	hiveReleaseConnection(dmstate->conn);
+	node->fdw_state = NULL;
+}
+
+/*
+ * hiveExplainDirectModify
+ *		Show the UPDATE or DELETE sent to Hive
+ */
+static void
+hiveExplainDirectModify(ForeignScanState *node, ExplainState *es)
+{
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+
+	ExplainPropertyText("Remote SQL", strVal(list_nth(fsplan->fdw_private, 0)), es);
+}
+
+#if PG_VERSION_NUM >= 140000
+/*
+ * hiveExecForeignTruncate
+ *		Queue a TRUNCATE TABLE for every foreign table. A foreign table
+ *		with the partition option only truncates that Hive partition,
+ *		so truncating a partitioned table whose partitions are such
+ *		foreign tables empties the matching Hive partitions. CASCADE and
+ *		RESTART IDENTITY mean nothing to Hive.
+ */
+static void
+hiveExecForeignTruncate(List *rels, DropBehavior behavior, bool restart_seqs)
+{
+	ListCell   *lc;
+
+	SIGINTInterruptCheckProcess();
+
+	foreach(lc, rels)
+	{
+		Relation	rel = (Relation) lfirst(lc);
+		char	   *staging_dir = NULL;
+		char	   *staging_uri = NULL;
+		char	   *partition = NULL;
+		hivePendingTruncate *pending;
+		StringInfoData sql;
+		MemoryContext oldcontext;
+
+		hiveGetStagingOptions(RelationGetRelid(rel), &staging_dir, &staging_uri,
+							  &partition);
+
+		oldcontext = MemoryContextSwitchTo(TopTransactionContext);
+
+		initStringInfo(&sql);
+		deparseTruncateSql(&sql, rel, partition);
+
+		pending = (hivePendingTruncate *) palloc(sizeof(hivePendingTruncate));
+		pending->relid = RelationGetRelid(rel);
+		pending->query = sql.data;
+		pending->nestlevel = GetCurrentTransactionNestLevel();
+		hive_pending_truncates = lappend(hive_pending_truncates, pending);
+
+		MemoryContextSwitchTo(oldcontext);
+
+		elog(DEBUG1, HIVE_FDW_NAME ": queued for commit: %s", sql.data);
+	}
+}
+
+/*
+ * hiveSendPendingTruncates
+ *		Send the TRUNCATE statements of the committing transaction. If one
+ *		of them fails the transaction aborts, but tables truncated before
+ *		stay empty.
+ */
+static void
+hiveSendPendingTruncates(void)
+{
+	ListCell   *lc;
+
+	foreach(lc, hive_pending_truncates)
+	{
+		hivePendingTruncate *pending = (hivePendingTruncate *) lfirst(lc);
+		hiveFdwExecutionState *conn;
+
+		/* Dropped later in the transaction: its options are gone */
+		if (!SearchSysCacheExists1(FOREIGNTABLEREL, ObjectIdGetDatum(pending->relid)))
+		{
+			ereport(WARNING,
+					(errmsg("Hive table was not truncated because its foreign table was dropped"),
+					 errdetail("The statement was: %s", pending->query)));
+			continue;
+		}
+
+		elog(DEBUG1, HIVE_FDW_NAME ": %s", pending->query);
+
+		conn = hiveOpenConnection(pending->relid);
+		hiveExecuteModify(conn, pending->query);
+		hiveReleaseConnection(conn);
+	}
+
+	hive_pending_truncates = NIL;
+}
+
+/*
+ * hiveXactCallback
+ *		Send queued TRUNCATE statements before the transaction commits,
+ *		and forget them when it ends. Their memory goes away with
+ *		TopTransactionContext.
+ */
+static void
+hiveXactCallback(XactEvent event, void *arg)
+{
+	switch (event)
+	{
+		case XACT_EVENT_PRE_COMMIT:
+			hiveSendPendingTruncates();
+			break;
+		case XACT_EVENT_PRE_PREPARE:
+			if (hive_pending_truncates != NIL)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("cannot PREPARE a transaction that truncated Hive foreign tables")));
+			break;
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PREPARE:
+			hive_pending_truncates = NIL;
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * hiveSubXactCallback
+ *		Drop the TRUNCATE statements of an aborted subtransaction, and of
+ *		the subtransactions it contained. Those of a committed one now
+ *		belong to its parent, so that rolling back to a later savepoint
+ *		keeps them. The list is edited in place, as it lives in
+ *		TopTransactionContext and the current context may not outlive
+ *		the subtransaction.
+ */
+static void
+hiveSubXactCallback(SubXactEvent event, SubTransactionId mySubid,
+					SubTransactionId parentSubid, void *arg)
+{
+	int			nestlevel = GetCurrentTransactionNestLevel();
+	ListCell   *lc;
+
+	if (hive_pending_truncates == NIL)
+		return;
+
+	foreach(lc, hive_pending_truncates)
+	{
+		hivePendingTruncate *pending = (hivePendingTruncate *) lfirst(lc);
+
+		if (pending->nestlevel < nestlevel)
+			continue;
+
+		if (event == SUBXACT_EVENT_ABORT_SUB)
+		{
+			hive_pending_truncates = foreach_delete_current(hive_pending_truncates, lc);
+			pfree(pending->query);
+			pfree(pending);
+		}
+		else if (event == SUBXACT_EVENT_COMMIT_SUB)
+			pending->nestlevel = nestlevel - 1;
+	}
+}
+#endif
+
+/*
+ * hiveGetBatchSize
+ *		Rows per remote INSERT: the batch_size option of the foreign
+ *		table, or else of its server
+ */
+static int
+hiveGetBatchSize(Oid foreigntableid)
+{
+	ForeignTable *table = GetForeignTable(foreigntableid);
+	ForeignServer *server = GetForeignServer(table->serverid);
+	int			batch_size = HIVE_DEFAULT_BATCH_SIZE;
+	ListCell   *lc;
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "batch_size") == 0)
+			batch_size = atoi(defGetString(def));
+	}
+
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "batch_size") == 0)
+			batch_size = atoi(defGetString(def));
+	}
+
+	return batch_size;
+}
+
+/*
+ * hiveGetStagingOptions
+ *		Bulk load options of a foreign table. staging_dir and staging_uri
+ *		of the table take precedence over those of its server.
+ */
+static void
+hiveGetStagingOptions(Oid foreigntableid, char **staging_dir,
+					  char **staging_uri, char **partition)
+{
+	ForeignTable *table = GetForeignTable(foreigntableid);
+	ForeignServer *server = GetForeignServer(table->serverid);
+	List	   *options;
+	ListCell   *lc;
+
+	options = list_concat(list_copy(server->options), table->options);
+
+	foreach(lc, options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "staging_dir") == 0)
+			*staging_dir = defGetString(def);
+		if (strcmp(def->defname, "staging_uri") == 0)
+			*staging_uri = defGetString(def);
+		if (strcmp(def->defname, "partition") == 0)
+			*partition = defGetString(def);
+	}
+}
+
+/*
+ * hiveGetForeignPaths
+ *		(9.2+) Get the foreign paths
+ */
+static void
+hiveGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
+{
+	Cost		startup_cost = 0;
+	Cost		total_cost = 0;
+
+	SIGINTInterruptCheckProcess();
+
+	elog(DEBUG3, HIVE_FDW_NAME
+		 ": get foreign paths for relation ID %d", foreigntableid);
+
+	/* Create a ForeignPath node and add it as only possible path */
+	add_path(baserel, (Path *) create_foreignscan_path(root, baserel, NULL, baserel->rows, startup_cost, total_cost, NIL, NULL, NULL, NIL));
+}
+
+/*
+ * hiveGetForeignPlan
+ *		(9.2+) Get a foreign scan plan node
+ */
+static ForeignScan *
+hiveGetForeignPlan(PlannerInfo *root,
+					 RelOptInfo *baserel,
+					 Oid foreigntableid,
+					 ForeignPath *best_path,
+					 List *tlist,
+					 List *scan_clauses,
+					 Plan *outer_plan
+)
+{
+	/*
+	 * Create a ForeignScan plan node from the selected foreign access path.
+	 * This is called at the end of query planning. The parameters are as for
+	 * GetForeignRelSize, plus the selected ForeignPath (previously produced
+	 * by GetForeignPaths), the target list to be emitted by the plan node,
+	 * and the restriction clauses to be enforced by the plan node.
+	 *
+	 * This function must create and return a ForeignScan plan node; it's
+	 * recommended to use make_foreignscan to build the ForeignScan node.
+	 *
+	 */
+	List	   *fdw_private;
+	List	   *remote_conds = NIL;
+	List	   *local_exprs = NIL;
+	List	   *params_list = NIL;
+	List	   *retrieved_attrs;
+	StringInfoData sql;
+	ListCell   *lc;
+	List	   *fdw_scan_tlist = NIL;
+
+	Index		scan_relid = baserel->relid;
+	hiveFdwRelationInfo *fpinfo = (hiveFdwRelationInfo *) baserel->fdw_private;
+
+	elog(DEBUG3, HIVE_FDW_NAME
+		 ": get foreign plan for relation ID %d", foreigntableid);
+
+	/*
+	 * For base relations, set scan_relid as the relid of the relation. For
+	 * other kinds of relations set it to 0.
+	 */
+	if (baserel->reloptkind == RELOPT_BASEREL ||
+		baserel->reloptkind == RELOPT_OTHER_MEMBER_REL)
+		scan_relid = baserel->relid;
+	else
+	{
+		scan_relid = 0;
+
+		/*
+		 * create_scan_plan() and create_foreignscan_plan() pass
+		 * rel->baserestrictinfo + parameterization clauses through
+		 * scan_clauses. For a join rel->baserestrictinfo is NIL and we are
+		 * not considering parameterization right now, so there should be no
+		 * scan_clauses for a joinrel.
+		 */
+		Assert(!scan_clauses);
+	}
+
+	if (!hive_gateway_enabled())
+		JVMInitialization(baserel->serverid);
+	foreach(lc, scan_clauses)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		Assert(IsA(rinfo, RestrictInfo));
+
+		/* Ignore any pseudoconstants, they're dealt with elsewhere */
+		if (rinfo->pseudoconstant)
+			continue;
+
+		if (list_member_ptr(fpinfo->remote_conds, rinfo))
+		{
+			remote_conds = lappend(remote_conds, rinfo);
+		}
+		else if (list_member_ptr(fpinfo->local_conds, rinfo))
+			local_exprs = lappend(local_exprs, rinfo->clause);
+		else
+		{
+			Assert(is_foreign_expr(root, baserel, rinfo->clause));
+			remote_conds = lappend(remote_conds, rinfo);
+		}
+	}
+
+	if (baserel->reloptkind == RELOPT_JOINREL)
+	{
+		/* For a join relation, get the conditions from fdw_private structure */
+		remote_conds = fpinfo->remote_conds;
+		local_exprs = fpinfo->local_conds;
+
+		/* Build the list of columns to be fetched from the foreign server. */
+		fdw_scan_tlist = build_tlist_to_deparse(baserel);
+
+		/*
+		 * Ensure that the outer plan produces a tuple whose descriptor
+		 * matches our scan tuple slot. This is safe because all scans and
+		 * joins support projection, so we never need to insert a Result node.
+		 * Also, remove the local conditions from outer plan's quals, lest
+		 * they will be evaluated twice, once by the local plan and once by
+		 * the scan.
+		 */
+	}
+	/*
+	 * Build the query string to be sent for execution, and identify
+	 * expressions to be sent as parameters.
+	 */
+	initStringInfo(&sql);
+	deparseSelectStmtForRel(&sql, root, baserel, remote_conds, &retrieved_attrs, &params_list,
+							fpinfo, fdw_scan_tlist);
+
+	elog(DEBUG1, HIVE_FDW_NAME ": built HiveQL:\n\n%s\n", sql.data);
+
+	/*
+	 * When it is a join relation the foreigntableid passed to hiveGetForeignPlan
+	 * is zero. We cannot obtain the serverid from this relation so we add the serverid
+	 * to the fdw_private here so we can use this in hiveGetForeignPaln. Likewise
+	 * we also need to know the schema to use when we obtain the Hive connection
+	 * we add the foreigntableid as well so that we can get the table options
+	 * from this foreigntableid. Since it is assumed that all the relations
+	 * involved in the joins belong to the same server and to the same schema it is
+	 * irrelevant which of the foreign tables makes it in the fdw_private list.
+	 */
+	fdw_private = list_make4(makeString(sql.data),
+							 retrieved_attrs,
+							 makeInteger(baserel->serverid),
+							 makeInteger(fpinfo->foreigntableid));
+
+	/* Parameters would need to be part of the cache key */
+	fdw_private = lappend(fdw_private,
+						  makeInteger(params_list == NIL ?
+									  hiveGetResultCacheTtl(root, baserel) : 0));
+	/* Create the ForeignScan node */
+	return make_foreignscan(tlist, local_exprs, scan_relid, params_list, fdw_private, fdw_scan_tlist, NIL, (Plan *) NIL);
+}
+
+/*
+ * hiveGetForeignRelSize
+ *		(9.2+) Get a foreign scan plan node
+ */
+static void
+hiveGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
+{
+	hiveFdwRelationInfo *fpinfo;
+	ListCell   *lc;
+
+	SIGINTInterruptCheckProcess();
+
+	elog(DEBUG3, HIVE_FDW_NAME
+		 ": get foreign rel size for relation ID %d", foreigntableid);
+
+	baserel->rows = 1000;
+
+	fpinfo = (hiveFdwRelationInfo *) palloc0(sizeof(hiveFdwRelationInfo));
+	baserel->fdw_private = (void *) fpinfo;
+
+	/* Base foreign tables need to be push down always. */
+	fpinfo->pushdown_safe = true;
+
+	/* Look up foreign-table catalog info. */
+	fpinfo->table = GetForeignTable(foreigntableid);
+	fpinfo->server = GetForeignServer(fpinfo->table->serverid);
+
+	foreach(lc, baserel->baserestrictinfo)
+	{
+		RestrictInfo *ri = (RestrictInfo *) lfirst(lc);
+
+		if (is_foreign_expr(root, baserel, ri->clause))
+			fpinfo->remote_conds = lappend(fpinfo->remote_conds, ri);
+		else
+			fpinfo->local_conds = lappend(fpinfo->local_conds, ri);
+	}
+
+	/* Hive's own row count, through the metadata cache */
+	if (hiveUseRemoteEstimate(foreigntableid))
+	{
+		hiveTableMetadata meta;
+
+		hive_meta_lookup(foreigntableid, &meta);
+		if (meta.rows >= 0)
+		{
+			baserel->tuples = meta.rows;
+			baserel->rows = clamp_row_est(meta.rows *
+										  clauselist_selectivity(root,
+																 baserel->baserestrictinfo,
+																 baserel->relid,
+																 JOIN_INNER,
+																 NULL));
+		}
+	}
+
+	/*
+	 * Identify which attributes will need to be retrieved from the remote
+	 * server.  These include all attrs needed for joins or final output, plus
+	 * all attrs used in the local_conds.
+	 *
+	 * In cases where there is a small amount of data, and we don't send
+	 * hive a WHERE clause, we should also do a SELECT *. And that happens
+	 * when attrs_used remains NULL for the local execution case below
+	 */
+	fpinfo->attrs_used = NULL;
+
+	pull_varattnos((Node *) baserel->reltarget->exprs, baserel->relid,
+				   &fpinfo->attrs_used);
+	foreach(lc, fpinfo->local_conds)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		pull_varattnos((Node *) rinfo->clause, baserel->relid,
+					   &fpinfo->attrs_used);
+	}
+
+}
+
+/*
+ ** hiveImportForeignSchema
+ ** Generates CREATE FOREIGN TABLE statements for each of the tables
+ ** in the source schema and returns the list of these statements
+ ** to the caller.
+ **/
+
+static List *
+hiveImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serveroid)
+{
+	ForeignServer *server;
+	List	   *result = NIL;
+	char	   *svr_username = NULL;
+	char	   *svr_password = NULL;
+	char	   *svr_query = NULL;
+	int			svr_querytimeout = 0;
+	int			svr_maxheapsize = 0;
+	jclass		HiveJDBCUtilsClass;
+	jstring		initialize_result = NULL;
+	jmethodID	id_initialize;
+	jfieldID	id_numberofrows;
+	char	   *initialize_result_cstring = NULL;
+	char	   *svr_host = NULL;
+	int			svr_port = 0;
+	char	   *svr_drivername = NULL;
+	char	   *svr_jarfile = NULL;
+	jmethodID	id_returnresultset;
+	jobjectArray java_rowarray;
+	int			i = 0;
+	int			j = 0;
+	int			NumberOfRows = 4;
+	jstring		schemaname;
+	jstring		servername;
+	jobjectArray table_list;
+	jobjectArray java_partitions = NULL;
+	int			parallelism = 1;
+	bool		import_partitions = false;
+	ListCell   *lc;
+
+
+	StringInfoData buf;
+
+	initStringInfo(&buf);
+
+	SIGINTInterruptCheckProcess();
+
+	foreach(lc, stmt->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "parallelism") == 0)
+		{
+			char	   *endp;
+			long		value = strtol(defGetString(def), &endp, 10);
+
+			if (*endp != '\0' || value <= 0 || value > HIVE_MAX_IMPORT_PARALLELISM)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("\"%s\" must be an integer between 1 and %d",
+								def->defname, HIVE_MAX_IMPORT_PARALLELISM)));
+			parallelism = (int) value;
+		}
+		else if (strcmp(def->defname, "import_partitions") == 0)
+		{
+			import_partitions = defGetBoolean(def);
+#if PG_VERSION_NUM < 110000
+			if (import_partitions)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("\"%s\" requires PostgreSQL 11 or later", def->defname)));
+#endif
+		}
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_OPTION_NAME),
+					 errmsg("invalid option \"%s\"", def->defname),
+					 errhint("Valid options in this context are: parallelism, import_partitions")));
+	}
+
+	JVMInitialization(serveroid);
+
+	hiveGetServerOptions(
+						   serveroid,
+						   &svr_querytimeout,
+						   &svr_maxheapsize,
+						   &svr_username,
+						   &svr_password,
+						   &svr_query,
+						   &svr_host,
+						   &svr_port
+		);
+
+	server = GetForeignServer(serveroid);
+	hiveGetDriverOptions(serveroid, &svr_drivername, &svr_jarfile);
+
+	/* Schema import always runs in this backend's own JVM */
+	java_call = hiveJNIConnect(svr_drivername,
+							   hiveBuildURL(svr_host, svr_port, stmt->remote_schema),
+							   svr_username, svr_password,
+							   svr_jarfile, svr_querytimeout);
+	hiveTrackConnection(java_call);
+
+	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+	if (HiveJDBCUtilsClass == NULL)
+	{
+		elog(ERROR, "HiveJDBCUtilsClass is NULL");
+	}
+
+	id_initialize = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "PrepareDDLStmtList", "(Ljava/lang/String;Ljava/lang/String;I[Ljava/lang/String;IZ)Ljava/lang/String;");
+
+	if (id_initialize == NULL)
+	{
+		elog(ERROR, "id_initialize is NULL");
+	}
+
+	id_numberofrows = (*env)->GetFieldID(env, HiveJDBCUtilsClass, "NumberOfRows", "I");
+	if (id_numberofrows == NULL)
+	{
+		elog(ERROR, "id_numberofrows is NULL");
+	}
+
+	schemaname = (*env)->NewStringUTF(env, stmt->remote_schema);
+	servername = (*env)->NewStringUTF(env, server->servername);
+
+	/*
+	 * Hand LIMIT TO and EXCEPT to Java so that the metastore is only asked
+	 * about the tables imported. The list type is passed as is; Java's
+	 * IMPORT_* constants match ImportForeignSchemaType.
+	 */
+	table_list = (*env)->NewObjectArray(env, list_length(stmt->table_list),
+										(*env)->FindClass(env, "java/lang/String"),
+										NULL);
+	i = 0;
+	foreach(lc, stmt->table_list)
+	{
+		RangeVar   *rv = (RangeVar *) lfirst(lc);
+
+		(*env)->SetObjectArrayElement(env, table_list, i++,
+									  (*env)->NewStringUTF(env, rv->relname));
+	}
+
+	initialize_result = (*env)->CallObjectMethod(env, java_call, id_initialize, schemaname, servername,
+												 (jint) stmt->list_type, table_list,
+												 (jint) parallelism, (jboolean) import_partitions);
+
+
+	if (initialize_result != NULL)
+	{
+		initialize_result_cstring = ConvertStringToCString((jobject) initialize_result);
+		elog(ERROR, "%s", initialize_result_cstring);
+	}
+
+	NumberOfRows = (*env)->GetIntField(env, java_call, id_numberofrows);
+
+	id_returnresultset = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "ReturnDDLStmtList", "()[[Ljava/lang/String;");
+	if (id_returnresultset == NULL)
+	{
+		elog(ERROR, "id_returnresultset is NULL");
+	}
+
+	java_rowarray = (*env)->CallObjectMethod(env, java_call, id_returnresultset);
+
+	if (import_partitions)
+	{
+		jmethodID	id_returnpartitions;
+
+		id_returnpartitions = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "ReturnPartitionList", "()[[Ljava/lang/String;");
+		if (id_returnpartitions == NULL)
+		{
+			elog(ERROR, "id_returnpartitions is NULL");
+		}
+		java_partitions = (*env)->CallObjectMethod(env, java_call, id_returnpartitions);
+	}
+
+	if (java_rowarray != NULL)
+	{
+		for (i = 0; i < NumberOfRows; i++)
+		{
+			jobjectArray java_table = (jobjectArray) (*env)->GetObjectArrayElement(env, java_rowarray, i);
+			jobjectArray java_partition = NULL;
+			int			nfields = (*env)->GetArrayLength(env, java_table);
+			char	   *table_name;
+			List	   *column_names = NIL;
+			List	   *column_types = NIL;
+			List	   *hive_types = NIL;
+			ListCell   *lc2;
+			ListCell   *lc3;
+
+			/* The table name, then name, type and Hive type of each column */
+			table_name = hiveJNIArrayString(java_table, 0);
+			for (j = 1; j + 2 < nfields; j += 3)
+			{
+				column_names = lappend(column_names, hiveJNIArrayString(java_table, j));
+				column_types = lappend(column_types, hiveJNIArrayString(java_table, j + 1));
+				hive_types = lappend(hive_types, hiveJNIArrayString(java_table, j + 2));
+			}
+
+			if (java_partitions != NULL)
+				java_partition = (jobjectArray) (*env)->GetObjectArrayElement(env, java_partitions, i);
+
+#if PG_VERSION_NUM >= 110000
+			/* Partitioned Hive tables become partitioned tables */
+			if (java_partition != NULL)
+			{
+				hiveImportPartitionedTable(stmt, server, table_name, column_names,
+										   column_types, hive_types, java_partition);
+				(*env)->DeleteLocalRef(env, java_partition);
+				(*env)->DeleteLocalRef(env, java_table);
+				continue;
+			}
+#endif
+
+			resetStringInfo(&buf);
+			appendStringInfo(&buf, "CREATE FOREIGN TABLE %s (",
+							 quote_identifier(table_name));
+
+			forthree(lc, column_names, lc2, column_types, lc3, hive_types)
+			{
+				char	   *hive_type = (char *) lfirst(lc3);
+
+				if (lc != list_head(column_names))
+					appendStringInfoString(&buf, ", ");
+				appendStringInfo(&buf, "%s %s", quote_identifier((char *) lfirst(lc)),
+								 (char *) lfirst(lc2));
+				if (hive_type != NULL)
+					appendStringInfo(&buf, " OPTIONS (hive_type %s)",
+									 quote_literal_cstr(hive_type));
+			}
+
+			appendStringInfo(&buf, ") SERVER %s OPTIONS (table %s, schema %s)",
+							 quote_identifier(server->servername),
+							 quote_literal_cstr(table_name),
+							 quote_literal_cstr(stmt->remote_schema));
+
+			result = lappend(result, pstrdup(buf.data));
+
+			elog(DEBUG1, HIVE_FDW_NAME " DDL: %s", buf.data);
+
+			(*env)->DeleteLocalRef(env, java_table);
+		}
+
+		(*env)->DeleteLocalRef(env, java_rowarray);
+	}
+
+
+	(*env)->ReleaseStringUTFChars(env, initialize_result, initialize_result_cstring);
+	(*env)->DeleteLocalRef(env, initialize_result);
+
+	(*env)->PopLocalFrame(env, NULL);
+
+	hiveUntrackConnection(java_call);
+	hiveJNIClose(java_call);
+	hiveJNIFree(java_call);
+	java_call = NULL;
+
+	return result;
+}
+
+#if PG_VERSION_NUM >= 110000
+/*
+ * hiveImportPartitionedTable
+ *		Create a table LIST partitioned on the first partition key of a
+ *		Hive table, with a foreign partition for every value of the key
+ *		and a DEFAULT partition for values added to Hive later. Every
+ *		foreign partition has a filter option that limits its queries to
+ *		its own Hive partitions, so partitions pruned by PostgreSQL are
+ *		never queried at all.
+ *
+ *		IMPORT FOREIGN SCHEMA only runs the CREATE FOREIGN TABLE
+ *		statements it gets back, so these tables are created here. They
+ *		are not subject to the checks of LIMIT TO and EXCEPT by table
+ *		name, which PrepareDDLStmtList has already applied.
+ */
+static void
+hiveImportPartitionedTable(ImportForeignSchemaStmt *stmt, ForeignServer *server,
+						   const char *table_name, List *column_names,
+						   List *column_types, List *hive_types,
+						   jobjectArray java_partition)
+{
+	int			nvalues = (*env)->GetArrayLength(env, java_partition) - 1;
+	char	   *key = hiveJNIArrayString(java_partition, 0);
+	const char *parent = quote_qualified_identifier(stmt->local_schema, table_name);
+	StringInfoData sql;
+	StringInfoData hive_key;
+	StringInfoData values;
+	bool		has_null = false;
+	ListCell   *lc;
+	ListCell   *lc2;
+	int			k;
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql, "CREATE TABLE %s (", parent);
+	forboth(lc, column_names, lc2, column_types)
+	{
+		if (lc != list_head(column_names))
+			appendStringInfoString(&sql, ", ");
+		appendStringInfo(&sql, "%s %s", quote_identifier((char *) lfirst(lc)),
+						 (char *) lfirst(lc2));
+	}
+	appendStringInfo(&sql, ") PARTITION BY LIST (%s)", quote_identifier(key));
+	hiveImportExecute(sql.data);
+
+	initStringInfo(&hive_key);
+	appendStringInfo(&hive_key, "`%s`", key);
+	initStringInfo(&values);
+
+	for (k = 1; k <= nvalues; k++)
+	{
+		char	   *value = hiveJNIArrayString(java_partition, k);
+		StringInfoData literal;
+		StringInfoData partition;
+		StringInfoData filter;
+
+		/* Rows with a NULL key are in Hive's default partition */
+		if (value == NULL)
+		{
+			has_null = true;
+			resetStringInfo(&sql);
+			appendStringInfo(&sql, "%s IS NULL", hive_key.data);
+			hiveImportForeignPartition(stmt, server, parent,
+									   hiveImportPartitionName(table_name, "null", 0),
+									   table_name,
+									   "FOR VALUES IN (NULL)", NULL, sql.data,
+									   column_names, hive_types);
+			continue;
+		}
+
+		initStringInfo(&literal);
+		deparseHiveStringLiteral(&literal, value);
+		if (values.len > 0)
+			appendStringInfoString(&values, ", ");
+		appendStringInfoString(&values, literal.data);
+
+		initStringInfo(&partition);
+		appendStringInfo(&partition, "%s=%s", key, literal.data);
+		initStringInfo(&filter);
+		appendStringInfo(&filter, "%s = %s", hive_key.data, literal.data);
+		resetStringInfo(&sql);
+		appendStringInfo(&sql, "FOR VALUES IN (%s)", quote_literal_cstr(value));
+
+		hiveImportForeignPartition(stmt, server, parent,
+								   hiveImportPartitionName(table_name, value, k),
+								   table_name, sql.data, partition.data, filter.data,
+								   column_names, hive_types);
+	}
+
+	/* The DEFAULT partition gets whatever the others do not cover */
+	resetStringInfo(&sql);
+	if (values.len > 0 && has_null)
+		appendStringInfo(&sql, "%s NOT IN (%s)", hive_key.data, values.data);
+	else if (values.len > 0)
+		appendStringInfo(&sql, "%s IS NULL OR %s NOT IN (%s)",
+						 hive_key.data, hive_key.data, values.data);
+	else if (has_null)
+		appendStringInfo(&sql, "%s IS NOT NULL", hive_key.data);
+	hiveImportForeignPartition(stmt, server, parent,
+							   hiveImportPartitionName(table_name, "default", 0),
+							   table_name, "DEFAULT", NULL, sql.len > 0 ? sql.data : NULL,
+							   column_names, hive_types);
+
+	SPI_finish();
+}
+
+/*
+ * hiveImportPartitionName
+ *		Name of a foreign partition: the Hive table name and the partition
+ *		value, followed by the value's position for all but the NULL and
+ *		DEFAULT partitions, which pass 0. The position keeps names unique
+ *		when a value spells null or default, or when values only differ
+ *		past NAMEDATALEN. The name is cut off explicitly so that the
+ *		position, or the _null and _default suffix, always survives.
+ */
+static char *
+hiveImportPartitionName(const char *table_name, const char *value, int position)
+{
+	char	   *name;
+	char	   *suffix;
+	int			len;
+
+	if (position > 0)
+	{
+		name = psprintf("%s_%s", table_name, value);
+		suffix = psprintf("_%d", position);
+	}
+	else
+	{
+		name = pstrdup(table_name);
+		suffix = psprintf("_%s", value);
+	}
+	len = strlen(name);
+
+	if (len + strlen(suffix) > NAMEDATALEN - 1)
+		len = pg_mbcliplen(name, len, NAMEDATALEN - 1 - strlen(suffix));
+
+	return psprintf("%.*s%s", len, name, suffix);
+}
+
+/*
+ * hiveImportForeignPartition
+ *		Create the foreign partition child of an imported partitioned
+ *		table
+ */
+static void
+hiveImportForeignPartition(ImportForeignSchemaStmt *stmt, ForeignServer *server,
+						   const char *parent, const char *child,
+						   const char *table_name, const char *bound,
+						   const char *partition, const char *filter,
+						   List *column_names, List *hive_types)
+{
+	const char *qualified = quote_qualified_identifier(stmt->local_schema, child);
+	StringInfoData sql;
+	ListCell   *lc;
+	ListCell   *lc2;
+	bool		first = true;
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql, "CREATE FOREIGN TABLE %s PARTITION OF %s %s SERVER %s "
+					 "OPTIONS (table %s, schema %s",
+					 qualified, parent, bound, quote_identifier(server->servername),
+					 quote_literal_cstr(table_name),
+					 quote_literal_cstr(stmt->remote_schema));
+	if (partition != NULL)
+		appendStringInfo(&sql, ", partition %s", quote_literal_cstr(partition));
+	if (filter != NULL)
+		appendStringInfo(&sql, ", filter %s", quote_literal_cstr(filter));
+	appendStringInfoChar(&sql, ')');
+	hiveImportExecute(sql.data);
+
+	/* Column options cannot be given in PARTITION OF */
+	resetStringInfo(&sql);
+	appendStringInfo(&sql, "ALTER FOREIGN TABLE %s ", qualified);
+	forboth(lc, column_names, lc2, hive_types)
+	{
+		if (lfirst(lc2) == NULL)
+			continue;
+		appendStringInfo(&sql, "%sALTER COLUMN %s OPTIONS (ADD hive_type %s)",
+						 first ? "" : ", ",
+						 quote_identifier((char *) lfirst(lc)),
+						 quote_literal_cstr((char *) lfirst(lc2)));
+		first = false;
+	}
+	if (!first)
+		hiveImportExecute(sql.data);
+}
+
+/*
+ * hiveImportExecute
+ *		Run a DDL statement of IMPORT FOREIGN SCHEMA through SPI
+ */
+static void
+hiveImportExecute(const char *sql)
+{
+	elog(DEBUG1, HIVE_FDW_NAME " DDL: %s", sql);
+
+	if (SPI_execute(sql, false, 0) != SPI_OK_UTILITY)
+		elog(ERROR, "could not run \"%s\"", sql);
+}
+#endif
+
+/*
+ * hiveGetConnection
+ *		Initiate access to the database
+ */
+static hiveFdwExecutionState *
+hiveGetConnection(Oid serverid, char *svr_username, char *svr_password, char *svr_host, int svr_port,
+				  char *svr_schema, int svr_querytimeout)
+{
+	char	   *svr_url = NULL;
+	char	   *svr_drivername = NULL;
+	char	   *svr_jarfile = NULL;
+	hiveFdwExecutionState *festate = NULL;
+
+	SIGINTInterruptCheckProcess();
+
+	svr_url = hiveBuildURL(svr_host, svr_port, svr_schema);
+	hiveGetDriverOptions(serverid, &svr_drivername, &svr_jarfile);
+
+	/* Stash away the state info we have already */
+	festate = (hiveFdwExecutionState *) palloc0(sizeof(hiveFdwExecutionState));
+	festate->gateway_cursor = -1;
+
+	if (hive_gateway_enabled())
+	{
+		/* The gateway worker connects on our behalf, no local JVM needed */
+		festate->gateway_cursor = hive_gateway_open(svr_drivername,
+													svr_url,
+													svr_username,
+													svr_password,
+													svr_jarfile,
+													svr_querytimeout,
+													&festate->metrics.reused);
+		return festate;
+	}
+
+	java_call = hiveJNIConnect(svr_drivername, svr_url,
+							   svr_username, svr_password,
+							   svr_jarfile, svr_querytimeout);
+	hiveTrackConnection(java_call);
+	hiveJNISetCancelFlag(java_call, &hive_cancel_flag);
+	festate->java_call = java_call;
+
+	return festate;
+}
+
+/*
+ * hiveBuildURL
+ *		Build the HiveServer2 JDBC URL for the given host, port and schema
+ */
+static char *
+hiveBuildURL(char *svr_host, int svr_port, char *svr_schema)
+{
+	char	   *svr_url = NULL;
+	int			cp_len = 0;
+
+	if (svr_schema)
+	{
+		cp_len = strlen(svr_schema) + strlen(svr_host) + sizeof(int) + 30;
+		svr_url = (char *) palloc(cp_len);
+		snprintf(svr_url, cp_len, "jdbc:hive2://%s:%d/%s", svr_host, svr_port, svr_schema);
+	}
+	else
+	{
+		cp_len = strlen(svr_host) + sizeof(int) + 30;
+		svr_url = (char *) palloc(cp_len);
+		snprintf(svr_url, cp_len, "jdbc:hive2://%s:%d/default", svr_host, svr_port);
+	}
+
+	elog(DEBUG3, HIVE_FDW_NAME ": connection url is %s", svr_url);
+
+	return svr_url;
+}
+
+/*
+ * hiveGetJarClasspath
+ *		Classpath handed to HiveJDBCLoader to find the driver jar
+ */
+static char *
+hiveGetJarClasspath(void)
+{
+	char	   *jar_classpath;
+	char	   *var_CP = NULL;
+
+	/* Set the options for JNI */
+	var_CP = getenv("HIVE_FDW_CLASSPATH");
+	if (!var_CP)
+	{
+		elog(ERROR, "Please set the environment variable HIVE_FDW_CLASSPATH");
+	}
+	jar_classpath = pstrdup(var_CP);
+	elog(DEBUG3, HIVE_FDW_NAME ": classpath for the dependency jars is %s", jar_classpath);
+
+	return jar_classpath;
+}
+
+/*
+ * hiveGetDriverOptions
+ *		Get the JDBC driver class and the jar to load it from. Both can be
+ *		overridden per server, for instance to use a different driver or
+ *		the mock driver of the benchmark suite. Only a superuser can set
+ *		them, see hive_fdw_validator.
+ */
+static void
+hiveGetDriverOptions(Oid serverid, char **drivername, char **jarfile)
+{
+	ForeignServer *f_server = GetForeignServer(serverid);
+	ListCell   *lc;
+
+	*drivername = NULL;
+	*jarfile = NULL;
+
+	foreach(lc, f_server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "drivername") == 0)
+			*drivername = defGetString(def);
+
+		if (strcmp(def->defname, "jarfile") == 0)
+			*jarfile = defGetString(def);
+	}
+
+	if (*drivername == NULL)
+		*drivername = HIVE_DEFAULT_DRIVER;
+	if (*jarfile == NULL)
+		*jarfile = hiveGetJarClasspath();
+}
+
+/*
+ * hiveJNIConnect
+ *		Create a HiveJDBCUtils object connected to the given URL. The
+ *		object is returned as a global reference owned by the caller.
+ */
+jobject
+hiveJNIConnect(const char *drivername, const char *url,
+			   const char *username, const char *password,
+			   const char *jarfile, int querytimeout)
+{
+	jclass		HiveJDBCUtilsClass;
+	jclass		JavaString;
+	jstring		StringArray[6];
+	char		timeoutstr[12];
+	jstring		initialize_result = NULL;
+	jmethodID	id_initialize;
+	jobjectArray arg_array;
+	jobject		local_call;
+	jobject		global_call;
+	int			counter = 0;
+	int			referencedeletecounter = 0;
+
+	if ((*env)->PushLocalFrame(env, 16) < 0)
+	{
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
+	}
+
+	/* Connect to the server and execute the query */
+	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+	if (HiveJDBCUtilsClass == NULL)
+	{
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
+	}
+
+	id_initialize = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "ConnInitialize", "([Ljava/lang/String;)Ljava/lang/String;");
+	if (id_initialize == NULL)
+	{
+		hiveJNIFrameError("id_ConnInitialize is NULL");
+	}
+
+	if (username == NULL)
+	{
+		username = "";
+	}
+
+	if (password == NULL)
+	{
+		password = "";
+	}
+
+	StringArray[0] = (*env)->NewStringUTF(env, drivername);
+	StringArray[1] = (*env)->NewStringUTF(env, url);
+	StringArray[2] = (*env)->NewStringUTF(env, username);
+	StringArray[3] = (*env)->NewStringUTF(env, password);
+	StringArray[4] = (*env)->NewStringUTF(env, jarfile);
+	snprintf(timeoutstr, sizeof(timeoutstr), "%d", querytimeout);
+	StringArray[5] = (*env)->NewStringUTF(env, timeoutstr);
+
+	JavaString = (*env)->FindClass(env, "java/lang/String");
+
+	arg_array = (*env)->NewObjectArray(env, 6, JavaString, StringArray[0]);
+	if (arg_array == NULL)
+	{
+		hiveJNIFrameError("arg_array is NULL");
+	}
+
+	for (counter = 1; counter < 6; counter++)
+	{
+		(*env)->SetObjectArrayElement(env, arg_array, counter, StringArray[counter]);
+	}
+
+	local_call = (*env)->AllocObject(env, HiveJDBCUtilsClass);
+	if (local_call == NULL)
+	{
+		hiveJNIFrameError("java_call is NULL");
+	}
+
+	initialize_result = (*env)->CallObjectMethod(env, local_call, id_initialize, arg_array);
+	if (initialize_result != NULL)
+	{
+		hiveJNIFrameError(hiveJNICopyString(initialize_result));
+	}
+
+	for (referencedeletecounter = 0; referencedeletecounter < 6; referencedeletecounter++)
+	{
+		(*env)->DeleteLocalRef(env, StringArray[referencedeletecounter]);
+	}
+
+	(*env)->DeleteLocalRef(env, arg_array);
+
+	global_call = (*env)->NewGlobalRef(env, local_call);
+	(*env)->PopLocalFrame(env, NULL);
+
+	return global_call;
+}
+
+/*
+ * hiveJNISetCancelFlag
+ *		Point the object's cancel watcher at "flag". A nonzero value asks
+ *		for the running statement to be cancelled.
+ */
+void
+hiveJNISetCancelFlag(jobject java_call, int32 *flag)
+{
+	jclass		HiveJDBCUtilsClass;
+	jmethodID	id_setcancelflag;
+	jobject		buffer;
+
+	if ((*env)->PushLocalFrame(env, 16) < 0)
+	{
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
+	}
+
+	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+	if (HiveJDBCUtilsClass == NULL)
+	{
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
+	}
+
+	id_setcancelflag = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "SetCancelFlag", "(Ljava/nio/ByteBuffer;)V");
+	if (id_setcancelflag == NULL)
+	{
+		hiveJNIFrameError("id_setcancelflag is NULL");
+	}
+
+	buffer = (*env)->NewDirectByteBuffer(env, (void *) flag, sizeof(int32));
+	if (buffer == NULL)
+	{
+		hiveJNIFrameError("cancel flag buffer is NULL");
+	}
+
+	(*env)->CallVoidMethod(env, java_call, id_setcancelflag, buffer);
+	(*env)->PopLocalFrame(env, NULL);
+}
+
+/*
+ * hiveWaitEventQuery
+ *		Wait event to report while waiting for a remote query
+ */
+uint32
+hiveWaitEventQuery(void)
+{
+#if PG_VERSION_NUM >= 170000
+	if (hive_wait_event_query == 0)
+		hive_wait_event_query = WaitEventExtensionNew("HiveRemoteQuery");
+	return hive_wait_event_query;
+#else
+	return PG_WAIT_EXTENSION;
+#endif
+}
+
+/*
+ * hiveSetPsDisplay
+ *		Show "activity" in the process title
+ */
+static void
+hiveSetPsDisplay(const char *activity)
+{
+#if PG_VERSION_NUM >= 130000
+	set_ps_display(activity);
+#else
+	set_ps_display(activity, false);
+#endif
+}
+
+/*
+ * hiveJNIExecuteQuery
+ *		Run a query and return its number of columns. The query runs on
+ *		a Java thread while we sleep on our latch, so that cancel
+ *		requests and termination are serviced and the backend shows a
+ *		wait event. Hive's progress messages go to the process title.
+ */
+int
+hiveJNIExecuteQuery(jobject java_call, const char *query)
+{
+	char	   *saved_activity = NULL;
+	int			ncolumns;
+
+	/* Any cancel request left over from a previous query is stale */
+	hive_cancel_flag = 0;
+
+	hiveJNISubmitQuery(java_call, query);
+
+	while (!hiveJNIPollQuery(java_call))
+	{
+		char	   *progress;
+		int			rc;
+
+		rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   HIVE_POLL_INTERVAL_MS, hiveWaitEventQuery());
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+		ResetLatch(MyLatch);
+
+		SIGINTInterruptCheckProcess();
+		CHECK_FOR_INTERRUPTS();
+
+		progress = hiveJNIQueryProgress(java_call);
+		if (progress != NULL)
+		{
+			StringInfoData activity;
+
+			if (saved_activity == NULL)
+			{
+				int			len;
+				const char *current = get_ps_display(&len);
+
+				saved_activity = pnstrdup(current, len);
+			}
+
+			elog(DEBUG1, HIVE_FDW_NAME ": %s", progress);
+
+			initStringInfo(&activity);
+			appendStringInfo(&activity, "%s hive: %s", saved_activity, progress);
+			hiveSetPsDisplay(activity.data);
+			pfree(activity.data);
+			pfree(progress);
+		}
+	}
+
+	if (saved_activity != NULL)
+	{
+		hiveSetPsDisplay(saved_activity);
+		pfree(saved_activity);
+	}
+
+	ncolumns = hiveJNIFinishQuery(java_call);
+
+	return ncolumns;
+}
+
+/*
+ * hiveJNISubmitQuery
+ *		Start running a query on a Java thread and return at once
+ */
+void
+hiveJNISubmitQuery(jobject java_call, const char *query)
+{
+	jclass		HiveJDBCUtilsClass;
+	jstring		submit_result = NULL;
+	jmethodID	id_submit;
+	jstring		name;
+
+	if ((*env)->PushLocalFrame(env, 16) < 0)
+	{
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
+	}
+
+	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+	if (HiveJDBCUtilsClass == NULL)
+	{
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
+	}
+
+	id_submit = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "Submit_Query", "(Ljava/lang/String;)Ljava/lang/String;");
+	if (id_submit == NULL)
+	{
+		hiveJNIFrameError("id_submit is NULL");
+	}
+
+	if (java_call == NULL)
+	{
+		hiveJNIFrameError("java_call is NULL");
+	}
+
+	name = (*env)->NewStringUTF(env, query);
+	submit_result = (*env)->CallObjectMethod(env, java_call, id_submit, name);
+	if (submit_result != NULL)
+	{
+		hiveJNIFrameError(hiveJNICopyString(submit_result));
+	}
+
+	(*env)->PopLocalFrame(env, NULL);
+}
+
+/*
+ * hiveJNIPollQuery
+ *		Returns true once the submitted query has finished
+ */
+bool
+hiveJNIPollQuery(jobject java_call)
+{
+	jclass		HiveJDBCUtilsClass;
+	jmethodID	id_poll;
+	jboolean	done;
+
+	if ((*env)->PushLocalFrame(env, 16) < 0)
+	{
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
+	}
+
+	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+	if (HiveJDBCUtilsClass == NULL)
+	{
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
+	}
+
+	id_poll = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "Poll_Query", "()Z");
+	if (id_poll == NULL)
+	{
+		hiveJNIFrameError("id_poll is NULL");
+	}
+
+	done = (*env)->CallBooleanMethod(env, java_call, id_poll);
+	(*env)->PopLocalFrame(env, NULL);
+
+	return (done == JNI_TRUE);
+}
+
+/*
+ * hiveJNIFinishQuery
+ *		Collect the outcome of a finished query and return its number of
+ *		columns. Errors of the query are raised here.
+ */
+int
+hiveJNIFinishQuery(jobject java_call)
+{
+	jclass		HiveJDBCUtilsClass;
+	jstring		finish_result = NULL;
+	jmethodID	id_finish;
+	jfieldID	id_numberofcolumns;
+	int			ncolumns;
+
+	if ((*env)->PushLocalFrame(env, 16) < 0)
+	{
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
+	}
+
+	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+	if (HiveJDBCUtilsClass == NULL)
+	{
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
+	}
+
+	id_finish = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "Finish_Query", "()Ljava/lang/String;");
+	if (id_finish == NULL)
+	{
+		hiveJNIFrameError("id_finish is NULL");
+	}
+
+	id_numberofcolumns = (*env)->GetFieldID(env, HiveJDBCUtilsClass, "NumberOfColumns", "I");
+	if (id_numberofcolumns == NULL)
+	{
+		hiveJNIFrameError("id_numberofcolumns is NULL");
+	}
 
-		pull_varattnos((Node *) rinfo->clause, baserel->relid,
-					   &fpinfo->attrs_used);
+	finish_result = (*env)->CallObjectMethod(env, java_call, id_finish);
+	if (finish_result != NULL)
+	{
+		hiveJNIFrameError(hiveJNICopyString(finish_result));
 	}
 
+	ncolumns = (*env)->GetIntField(env, java_call, id_numberofcolumns);
+	(*env)->PopLocalFrame(env, NULL);
+
+	return ncolumns;
 }
 
 /*
- ** hiveImportForeignSchema
- ** Generates CREATE FOREIGN TABLE statements for each of the tables
- ** in the source schema and returns the list of these statements
- ** to the caller.
- **/
-
-static List *
-hiveImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serveroid)
+ * hiveJNIUpdateCount
+ *		Number of rows the last statement changed, or -1 when the driver
+ *		does not report it
+ */
+int64
+hiveJNIUpdateCount(jobject java_call)
 {
-	ForeignServer *server;
-	List	   *result = NIL;
-	char	   *svr_username = NULL;
-	char	   *svr_password = NULL;
-	char	   *svr_query = NULL;
-	int			svr_querytimeout = 0;
-	int			svr_maxheapsize = 0;
 	jclass		HiveJDBCUtilsClass;
-	jstring		initialize_result = NULL;
-	jmethodID	id_initialize;
-	jfieldID	id_numberofrows;
-	char	   *initialize_result_cstring = NULL;
-	char	   *svr_host = NULL;
-	int			svr_port = 0;
-	char	  **values;
-	jmethodID	id_returnresultset;
-	jobjectArray java_rowarray;
-	int			i = 0;
-	int			j = 0;
-	jstring		tempString;
-	int			NumberOfRows = 4;
-	jstring		schemaname;
-	jstring		servername;
-
+	jfieldID	id_updatecount;
+	int64		update_count;
 
-	StringInfoData buf;
-
-	initStringInfo(&buf);
+	if ((*env)->PushLocalFrame(env, 16) < 0)
+	{
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
+	}
 
-	SIGINTInterruptCheckProcess();
+	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+	if (HiveJDBCUtilsClass == NULL)
+	{
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
+	}
 
+	id_updatecount = (*env)->GetFieldID(env, HiveJDBCUtilsClass, "UpdateCount", "J");
+	if (id_updatecount == NULL)
+	{
+		hiveJNIFrameError("id_updatecount is NULL");
+	}
 
-	JVMInitialization(serveroid);
+	update_count = (*env)->GetLongField(env, java_call, id_updatecount);
+	(*env)->PopLocalFrame(env, NULL);
 
-	hiveGetServerOptions(
-						   serveroid,
-						   &svr_querytimeout,
-						   &svr_maxheapsize,
-						   &svr_username,
-						   &svr_password,
-						   &svr_query,
-						   &svr_host,
-						   &svr_port
-		);
+	return update_count;
+}
 
-	server = GetForeignServer(serveroid);
+/*
+ * hiveJNIQueryProgress
+ *		Returns a palloc'd progress message if Hive reported progress
+ *		since the last call, or NULL
+ */
+char *
+hiveJNIQueryProgress(jobject java_call)
+{
+	jclass		HiveJDBCUtilsClass;
+	jmethodID	id_progress;
+	jstring		progress_result;
+	char	   *progress = NULL;
 
-	hiveGetConnection(svr_username, svr_password, svr_host, svr_port, stmt->remote_schema);
+	if ((*env)->PushLocalFrame(env, 16) < 0)
+	{
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
+	}
 
 	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
 	if (HiveJDBCUtilsClass == NULL)
 	{
-		elog(ERROR, "HiveJDBCUtilsClass is NULL");
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
 	}
 
-	id_initialize = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "PrepareDDLStmtList", "(Ljava/lang/String;Ljava/lang/String;)Ljava/lang/String;");
-
-	if (id_initialize == NULL)
+	id_progress = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "Query_Progress", "()Ljava/lang/String;");
+	if (id_progress == NULL)
 	{
-		elog(ERROR, "id_initialize is NULL");
+		hiveJNIFrameError("id_progress is NULL");
 	}
 
-	id_numberofrows = (*env)->GetFieldID(env, HiveJDBCUtilsClass, "NumberOfRows", "I");
-	if (id_numberofrows == NULL)
+	progress_result = (*env)->CallObjectMethod(env, java_call, id_progress);
+	if (progress_result != NULL)
 	{
-		elog(ERROR, "id_numberofrows is NULL");
+		const char *chars = (*env)->GetStringUTFChars(env, progress_result, 0);
+
+		progress = pstrdup(chars);
+		(*env)->ReleaseStringUTFChars(env, progress_result, chars);
 	}
 
-	schemaname = (*env)->NewStringUTF(env, stmt->remote_schema);
-	servername = (*env)->NewStringUTF(env, server->servername);
-	initialize_result = (*env)->CallObjectMethod(env, java_call, id_initialize, schemaname, servername);
+	(*env)->PopLocalFrame(env, NULL);
 
+	return progress;
+}
 
-	if (initialize_result != NULL)
+/*
+ * hiveJNIQueryIds
+ *		Get the Hive query ID and job IDs of the last query, as palloc'd
+ *		strings, or NULL when the driver does not report them
+ */
+void
+hiveJNIQueryIds(jobject java_call, char **query_id, char **job_ids)
+{
+	jclass		HiveJDBCUtilsClass;
+	jmethodID	id_queryids;
+	jobjectArray ids;
+	char	  **results[2];
+	int			i;
+
+	results[0] = query_id;
+	results[1] = job_ids;
+	*query_id = NULL;
+	*job_ids = NULL;
+
+	if ((*env)->PushLocalFrame(env, 16) < 0)
 	{
-		initialize_result_cstring = ConvertStringToCString((jobject) initialize_result);
-		elog(ERROR, "%s", initialize_result_cstring);
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
 	}
 
-	NumberOfRows = (*env)->GetIntField(env, java_call, id_numberofrows);
+	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+	if (HiveJDBCUtilsClass == NULL)
+	{
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
+	}
 
-	id_returnresultset = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "ReturnDDLStmtList", "()[Ljava/lang/String;");
-	if (id_returnresultset == NULL)
+	id_queryids = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "Query_Ids", "()[Ljava/lang/String;");
+	if (id_queryids == NULL)
 	{
-		elog(ERROR, "id_returnresultset is NULL");
+		hiveJNIFrameError("id_queryids is NULL");
 	}
 
-	values = (char **) palloc(sizeof(char *) * NumberOfRows);
+	ids = (jobjectArray) (*env)->CallObjectMethod(env, java_call, id_queryids);
+	for (i = 0; ids != NULL && i < 2; i++)
+	{
+		jstring		id = (jstring) (*env)->GetObjectArrayElement(env, ids, i);
+		const char *chars;
 
-	java_rowarray = (*env)->CallObjectMethod(env, java_call, id_returnresultset);
+		if (id == NULL)
+			continue;
 
-	if (java_rowarray != NULL)
-	{
+		chars = (*env)->GetStringUTFChars(env, id, 0);
+		*results[i] = pstrdup(chars);
+		(*env)->ReleaseStringUTFChars(env, id, chars);
+	}
 
-		for (i = 0; i < NumberOfRows; i++)
-		{
-			resetStringInfo(&buf);
-			values[i] = ConvertStringToCString((jobject) (*env)->GetObjectArrayElement(env, java_rowarray, i));
-			appendStringInfo(&buf, "%s", values[i]);
-			result = lappend(result, pstrdup(buf.data));
+	(*env)->PopLocalFrame(env, NULL);
+}
 
-			elog(DEBUG1, HIVE_FDW_NAME "DDL: %.*s\n", (int) buf.len, buf.data);
+/*
+ * hiveJNIFetchBatch
+ *		Have HiveJDBCUtils encode the next batch of rows and point "batch"
+ *		at it. The data stays valid until the next call for this object.
+ *		Returns false once the result set is exhausted.
+ */
+bool
+hiveJNIFetchBatch(jobject java_call, hiveRowBatch *batch)
+{
+	hiveJNICallVoid(java_call, "FetchBatch");
 
-		}
+	return hiveJNIGetBatch(java_call, batch);
+}
 
-		for (j = 0; j < NumberOfRows; j++)
-		{
-			tempString = (jstring) (*env)->GetObjectArrayElement(env, java_rowarray, j);
-			(*env)->ReleaseStringUTFChars(env, tempString, values[j]);
-			(*env)->DeleteLocalRef(env, tempString);
-		}
+/*
+ * hiveJNISubmitFetch
+ *		Start encoding the next batch of rows on a Java thread and return
+ *		at once. Once hiveJNIPollQuery says it is done, hiveJNIFinishQuery
+ *		raises its errors and hiveJNIGetBatch returns the batch.
+ */
+void
+hiveJNISubmitFetch(jobject java_call)
+{
+	hiveJNICallVoid(java_call, "Submit_Fetch");
+}
 
-		(*env)->DeleteLocalRef(env, java_rowarray);
+/*
+ * hiveJNIGetBatch
+ *		Point "batch" at the batch of rows HiveJDBCUtils encoded last, and
+ *		return false if it is empty
+ */
+bool
+hiveJNIGetBatch(jobject java_call, hiveRowBatch *batch)
+{
+	jclass		HiveJDBCUtilsClass;
+	jfieldID	id_batchbuffer;
+	jfieldID	id_batchlength;
+	jobject		buffer;
+	char	   *data;
+	jint		len;
+
+	if ((*env)->PushLocalFrame(env, 16) < 0)
+	{
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
+	}
+
+	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+	if (HiveJDBCUtilsClass == NULL)
+	{
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
 	}
 
+	id_batchbuffer = (*env)->GetFieldID(env, HiveJDBCUtilsClass, "BatchBuffer", "Ljava/nio/ByteBuffer;");
+	if (id_batchbuffer == NULL)
+	{
+		hiveJNIFrameError("id_batchbuffer is NULL");
+	}
 
-	(*env)->ReleaseStringUTFChars(env, initialize_result, initialize_result_cstring);
-	(*env)->DeleteLocalRef(env, initialize_result);
+	id_batchlength = (*env)->GetFieldID(env, HiveJDBCUtilsClass, "BatchLength", "I");
+	if (id_batchlength == NULL)
+	{
+		hiveJNIFrameError("id_batchlength is NULL");
+	}
 
+	buffer = (*env)->GetObjectField(env, java_call, id_batchbuffer);
+	len = (*env)->GetIntField(env, java_call, id_batchlength);
+	data = (char *) (*env)->GetDirectBufferAddress(env, buffer);
 	(*env)->PopLocalFrame(env, NULL);
-	return result;
+	if (data == NULL)
+	{
+		elog(ERROR, "batch buffer is not a direct buffer");
+	}
+
+	hiveBatchInit(batch, data, len);
+
+	return (batch->nrows > 0);
 }
 
 /*
- * hiveGetConnection
- *		Initiate access to the database
+ * hiveJNIAwaitCompletion
+ *		Sleep until a query or fetch submitted to a Java thread finishes,
+ *		for at most "millis" ms
  */
-static hiveFdwExecutionState *
-hiveGetConnection(char *svr_username, char *svr_password, char *svr_host, int svr_port, char *svr_schema)
+void
+hiveJNIAwaitCompletion(int millis)
 {
-	char	   *svr_url = NULL;
-	hiveFdwExecutionState *festate = NULL;
 	jclass		HiveJDBCUtilsClass;
-	jclass		JavaString;
-	jstring		StringArray[7];
-	jstring		initialize_result = NULL;
-	jmethodID	id_initialize;
-	jobjectArray arg_array;
-	int			counter = 0;
-	int			referencedeletecounter = 0;
-	char	   *jar_classpath;
-	char	   *initialize_result_cstring = NULL;
-	char	   *var_CP = NULL;
-	int			cp_len = 0;
-	char	   *portstr = NULL;
-
-	SIGINTInterruptCheckProcess();
+	jmethodID	id_await;
 
-	/* Set the options for JNI */
-	var_CP = getenv("HIVE_FDW_CLASSPATH");
-	if (!var_CP)
+	if ((*env)->PushLocalFrame(env, 16) < 0)
 	{
-		elog(ERROR, "Please set the environment variable HIVE_FDW_CLASSPATH");
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
 	}
-	cp_len = strlen(var_CP) + 2;
-	jar_classpath = (char *) palloc(cp_len);
-	snprintf(jar_classpath, (cp_len + 1), "%s", var_CP);
-	elog(DEBUG3, HIVE_FDW_NAME ": classpath for the dependency jars is %s", jar_classpath);
 
-	portstr = (char *) palloc(sizeof(int));
-	snprintf(portstr, sizeof(int), "%d", svr_port);
-
-	if (svr_schema)
+	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+	if (HiveJDBCUtilsClass == NULL)
 	{
-		cp_len = strlen(svr_schema) + strlen(svr_host) + sizeof(int) + 30;
-		svr_url = (char *) palloc(cp_len);
-		snprintf(svr_url, cp_len, "jdbc:hive2://%s:%d/%s", svr_host, svr_port, svr_schema);
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
 	}
-	else
+
+	id_await = (*env)->GetStaticMethodID(env, HiveJDBCUtilsClass, "Await_Completion", "(J)V");
+	if (id_await == NULL)
 	{
-		cp_len = strlen(svr_host) + sizeof(int) + 30;
-		svr_url = (char *) palloc(cp_len);
-		snprintf(svr_url, cp_len, "jdbc:hive2://%s:%d/default", svr_host, svr_port);
+		hiveJNIFrameError("id_await is NULL");
 	}
 
-	elog(DEBUG3, HIVE_FDW_NAME ": connection url is %s", svr_url);
+	(*env)->CallStaticVoidMethod(env, HiveJDBCUtilsClass, id_await, (jlong) millis);
+	(*env)->PopLocalFrame(env, NULL);
+}
 
+/*
+ * hiveJNICallVoid
+ *		Call a no-argument HiveJDBCUtils method that reports failure by
+ *		returning the exception's stack trace
+ */
+static void
+hiveJNICallVoid(jobject java_call, const char *method)
+{
+	jmethodID	id_method;
+	jclass		HiveJDBCUtilsClass;
+	jstring		call_result = NULL;
 
-	/* Stash away the state info we have already */
-	festate = (hiveFdwExecutionState *) palloc(sizeof(hiveFdwExecutionState));
+	if ((*env)->PushLocalFrame(env, 16) < 0)
+	{
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
+	}
 
-	/* Connect to the server and execute the query */
 	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
 	if (HiveJDBCUtilsClass == NULL)
 	{
-		elog(ERROR, "HiveJDBCUtilsClass is NULL");
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
 	}
 
-	id_initialize = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "ConnInitialize", "([Ljava/lang/String;)Ljava/lang/String;");
-	if (id_initialize == NULL)
+	id_method = (*env)->GetMethodID(env, HiveJDBCUtilsClass, method, "()Ljava/lang/String;");
+	if (id_method == NULL)
 	{
-		elog(ERROR, "id_ConnInitialize is NULL");
+		hiveJNIFrameError(psprintf("id_%s is NULL", method));
 	}
 
-	if (svr_username == NULL)
+	call_result = (*env)->CallObjectMethod(env, java_call, id_method);
+	if (call_result != NULL)
 	{
-		svr_username = "";
+		hiveJNIFrameError(hiveJNICopyString(call_result));
 	}
 
-	if (svr_password == NULL)
-	{
-		svr_password = "";
-	}
+	(*env)->PopLocalFrame(env, NULL);
+}
 
-	StringArray[0] = (*env)->NewStringUTF(env, "org.apache.hive.jdbc.HiveDriver");
-	StringArray[1] = (*env)->NewStringUTF(env, svr_url);
-	StringArray[2] = (*env)->NewStringUTF(env, svr_username);
-	StringArray[3] = (*env)->NewStringUTF(env, svr_password);
-	StringArray[4] = (*env)->NewStringUTF(env, jar_classpath);
+/*
+ * hiveJNIRelease
+ *		Release the result of the last query, keeping the connection
+ */
+void
+hiveJNIRelease(jobject java_call)
+{
+	hiveJNICallVoid(java_call, "Release");
+}
 
-	JavaString = (*env)->FindClass(env, "java/lang/String");
+/*
+ * hiveJNIIsValid
+ *		Returns true if the connection behind java_call is still usable
+ */
+bool
+hiveJNIIsValid(jobject java_call)
+{
+	jclass		HiveJDBCUtilsClass;
+	jmethodID	id_valid;
+	jboolean	valid;
 
-	arg_array = (*env)->NewObjectArray(env, 5, JavaString, StringArray[0]);
-	if (arg_array == NULL)
+	if ((*env)->PushLocalFrame(env, 16) < 0)
 	{
-		elog(ERROR, "arg_array is NULL");
+		/* frame not pushed, no PopLocalFrame needed */
+		elog(ERROR, "Error");
 	}
 
-	for (counter = 1; counter < 5; counter++)
+	HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+	if (HiveJDBCUtilsClass == NULL)
 	{
-		(*env)->SetObjectArrayElement(env, arg_array, counter, StringArray[counter]);
+		hiveJNIFrameError("HiveJDBCUtilsClass is NULL");
 	}
 
-	java_call = (*env)->AllocObject(env, HiveJDBCUtilsClass);
-	if (java_call == NULL)
+	id_valid = (*env)->GetMethodID(env, HiveJDBCUtilsClass, "Is_Valid", "()Z");
+	if (id_valid == NULL)
 	{
-		elog(ERROR, "java_call is NULL");
+		hiveJNIFrameError("id_valid is NULL");
 	}
 
-	festate->java_call = java_call;
+	valid = (*env)->CallBooleanMethod(env, java_call, id_valid);
+	(*env)->PopLocalFrame(env, NULL);
 
-	initialize_result = (*env)->CallObjectMethod(env, java_call, id_initialize, arg_array);
-	if (initialize_result != NULL)
-	{
-		initialize_result_cstring = ConvertStringToCString((jobject) initialize_result);
-		elog(ERROR, "%s", initialize_result_cstring);
-	}
+	return (valid == JNI_TRUE);
+}
+
+/*
+ * hiveJNIClose
+ *		Release the result of the last query and close the connection
+ */
+void
+hiveJNIClose(jobject java_call)
+{
+	hiveJNICallVoid(java_call, "Close");
+}
+
+/*
+ * hiveJNICloseQuietly
+ *		Close the connection and drop the global reference, ignoring any
+ *		failure. For use while aborting, where raising an error is not an
+ *		option.
+ */
+void
+hiveJNICloseQuietly(jobject java_call)
+{
+	jclass		HiveJDBCUtilsClass;
+	jmethodID	id_close;
 
-	for (referencedeletecounter = 0; referencedeletecounter < 5; referencedeletecounter++)
+	/* A failed call may have left an exception pending */
+	(*env)->ExceptionClear(env);
+
+	if ((*env)->PushLocalFrame(env, 16) == 0)
 	{
-		(*env)->DeleteLocalRef(env, StringArray[referencedeletecounter]);
+		HiveJDBCUtilsClass = (*env)->FindClass(env, "HiveJDBCUtils");
+		id_close = HiveJDBCUtilsClass == NULL ? NULL :
+			(*env)->GetMethodID(env, HiveJDBCUtilsClass, "Close", "()Ljava/lang/String;");
+		if (id_close != NULL)
+			(void) (*env)->CallObjectMethod(env, java_call, id_close);
+		(*env)->ExceptionClear(env);
+		(*env)->PopLocalFrame(env, NULL);
 	}
 
-	(*env)->DeleteLocalRef(env, arg_array);
-	(*env)->ReleaseStringUTFChars(env, initialize_result, initialize_result_cstring);
-	(*env)->DeleteLocalRef(env, initialize_result);
-	return festate;
+	(*env)->DeleteGlobalRef(env, java_call);
+}
+
+/*
+ * hiveJNIFree
+ *		Drop the global reference returned by hiveJNIConnect
+ */
+void
+hiveJNIFree(jobject java_call)
+{
+	(*env)->DeleteGlobalRef(env, java_call);
 }
 
 /*
@@ -16,13 +16,26 @@
 
 #include "commands/defrem.h"
 #include "foreign/foreign.h"
+#include "funcapi.h"
 #include "lib/stringinfo.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/planmain.h"
+#include "portability/instr_time.h"
 #include "utils/rel.h"
 
+#include "jni.h"
+
 #define HIVE_FDW_NAME				"hive_fdw"
 
+/* How often a running remote query is polled for completion, in ms */
+#define HIVE_POLL_INTERVAL_MS		100
+
+/* Rows per remote INSERT unless the batch_size option says otherwise */
+#define HIVE_DEFAULT_BATCH_SIZE		1000
+
+/* Most connections IMPORT FOREIGN SCHEMA may open to read metadata */
+#define HIVE_MAX_IMPORT_PARALLELISM	64
+
 typedef struct hiveFdwRelationInfo
 {
 	/*
@@ -50,15 +63,241 @@ typedef struct hiveFdwRelationInfo
 	Oid			foreigntableid;
 } hiveFdwRelationInfo;
 
+/*
+ * A batch of rows as encoded by HiveJDBCUtils.FetchBatch: an int32 row
+ * count, an int32 column count and one byte per column giving the kind
+ * of its cells, padded to a multiple of four bytes. Then, for every
+ * column of every row, an int32 length (-1 for NULL) and that many bytes
+ * of cell data. Numbers are in native byte order. The same bytes are
+ * shipped verbatim by the gateway worker.
+ */
+typedef struct hiveRowBatch
+{
+	char	   *data;			/* start of the batch; not owned */
+	Size		len;			/* total length of the batch */
+	int			nrows;			/* number of rows in the batch */
+	int			ncols;			/* number of columns of every row */
+	char	   *kinds;			/* HIVE_CELL_* kind of every column */
+	bool		verbatim;		/* text cells need no encoding conversion */
+	int			row;			/* number of rows decoded so far */
+	Size		pos;			/* read offset of the next row */
+} hiveRowBatch;
+
+/*
+ * Cell kinds of a row batch. They must match the constants of the same
+ * name in HiveJDBCUtils.java.
+ */
+#define HIVE_CELL_TEXT			0	/* UTF-8 text */
+#define HIVE_CELL_INT4			1	/* int32 */
+#define HIVE_CELL_INT8			2	/* int64 */
+#define HIVE_CELL_FLOAT4		3	/* float */
+#define HIVE_CELL_FLOAT8		4	/* double */
+#define HIVE_CELL_BOOL			5	/* one byte, 0 or 1 */
+#define HIVE_CELL_DATE			6	/* int32 days since 1970-01-01 */
+#define HIVE_CELL_TIMESTAMP		7	/* int64 microseconds since 1970-01-01 */
+#define HIVE_CELL_DECIMAL		8	/* int32 scale and int64 unscaled value,
+									 * or UTF-8 text if that overflows */
+#define HIVE_CELL_BYTES			9	/* raw bytes */
+#define HIVE_CELL_JSON			10	/* ARRAY, MAP or STRUCT as UTF-8 JSON */
+
+/*
+ * Per-attribute information hive_batch.c needs beyond AttInMetadata, set
+ * up once per scan by hiveBatchPrepare: how to build array columns from
+ * the elements of a JSON array.
+ */
+typedef struct hiveArrayInput
+{
+	Oid			elemtype;		/* InvalidOid if the attribute is no array */
+	int16		elemlen;
+	bool		elembyval;
+	char		elemalign;
+	Oid			elemioparam;
+	FmgrInfo	eleminput;
+} hiveArrayInput;
+
+typedef struct hiveTupleDecoder
+{
+	AttInMetadata *attinmeta;
+	hiveArrayInput *arrays;		/* one per attribute */
+} hiveTupleDecoder;
+
+/* Kinds of Hive type names, see hiveTypeKind */
+#define HIVE_TYPE_INVALID		'\0'
+#define HIVE_TYPE_PRIMITIVE		'p'
+#define HIVE_TYPE_ARRAY			'a'
+#define HIVE_TYPE_MAP			'm'
+#define HIVE_TYPE_STRUCT		's'
+#define HIVE_TYPE_UNION			'u'
+
+/*
+ * Per-scan counters, shown by EXPLAIN ANALYZE. Timings are only taken
+ * when the scan is instrumented.
+ */
+typedef struct hiveScanMetrics
+{
+	bool		timing;			/* collect the timings below */
+	instr_time	start_time;		/* when the remote query was started */
+	instr_time	execute_time;	/* time spent in executeQuery */
+	instr_time	first_row_time; /* start of the query until the first row */
+	instr_time	jni_time;		/* time in calls to Java or the gateway */
+	instr_time	convert_time;	/* time turning batches into tuples */
+	int64		bytes;			/* size of the batches fetched */
+	int64		batches;		/* number of batches fetched */
+	bool		reused;			/* connection came from the gateway pool */
+	char	   *query_id;		/* Hive query ID, or NULL */
+	char	   *job_ids;		/* Hive job IDs, or NULL */
+	const char *cache_status;	/* "hit" or "miss" with result_cache_ttl */
+} hiveScanMetrics;
+
+/*
+ * A result of the result cache being replayed or written, see
+ * hive_cache.c
+ */
+typedef struct hiveResultCache
+{
+	MemoryContext cxt;			/* context of the scan */
+	FILE	   *file;			/* open file, NULL once closed */
+	char	   *path;			/* the cached result */
+	char	   *tmp_path;		/* file being written, until it is renamed */
+	bool		writing;		/* writing a new result, not replaying */
+	Size		written;		/* bytes written so far */
+	char	   *buf;			/* batch being replayed */
+	Size		bufsize;
+} hiveResultCache;
+
+/*
+ * What Hive knows about the table behind a foreign table, as kept by the
+ * metadata cache. Values Hive does not report are -1.
+ */
+typedef struct hiveTableMetadata
+{
+	double		rows;			/* numRows of the table parameters */
+	int64		bytes;			/* totalSize */
+	int64		files;			/* numFiles */
+	int64		partitions;		/* number of partitions, 0 if unpartitioned */
+	List	   *columns;		/* column names, partition keys last */
+	int			partition_keys; /* number of partition keys among them */
+} hiveTableMetadata;
+
+/*
+ * What the deparser needs to know about a function or operator, as kept
+ * by the function cache of hive_funcs.c for each server.
+ */
+typedef struct hiveFuncInfo
+{
+	NameData	name;			/* name in PostgreSQL */
+	char		hive_name[NAMEDATALEN];	/* name to send, "" if none */
+	bool		extra;			/* hive_name is from the server's options */
+	char		oprkind;		/* operators only */
+	bool		json;			/* operator on json or jsonb */
+	bool		json_field_text;	/* the json ->> text operator */
+} hiveFuncInfo;
+
+/* hive_batch.c */
+extern void hiveBatchInit(hiveRowBatch *batch, char *data, Size len);
+extern hiveTupleDecoder *hiveBatchPrepare(AttInMetadata *attinmeta);
+extern bool hiveBatchNextRow(hiveRowBatch *batch, hiveTupleDecoder *decoder,
+							 Datum *values, bool *nulls);
+
+/* hive_types.c */
+extern char hiveTypeKind(const char *hive_type);
+extern char *hiveTypeMember(const char *hive_type, const char *field);
+
+/* hive_fdw.c: JNI entry points shared with the gateway worker */
+extern void SIGINTInterruptCheckProcess(void);
+extern bool hiveCreateJVM(int maxheapsize);
+extern jobject hiveJNIConnect(const char *drivername, const char *url,
+			   const char *username, const char *password,
+			   const char *jarfile, int querytimeout);
+extern void hiveJNISetCancelFlag(jobject java_call, int32 *flag);
+extern uint32 hiveWaitEventQuery(void);
+extern int	hiveJNIExecuteQuery(jobject java_call, const char *query);
+extern void hiveJNISubmitQuery(jobject java_call, const char *query);
+extern bool hiveJNIPollQuery(jobject java_call);
+extern int	hiveJNIFinishQuery(jobject java_call);
+extern int64 hiveJNIUpdateCount(jobject java_call);
+extern char *hiveJNIQueryProgress(jobject java_call);
+extern void hiveJNIQueryIds(jobject java_call, char **query_id, char **job_ids);
+extern bool hiveJNIFetchBatch(jobject java_call, hiveRowBatch *batch);
+extern void hiveJNISubmitFetch(jobject java_call);
+extern bool hiveJNIGetBatch(jobject java_call, hiveRowBatch *batch);
+extern void hiveJNIAwaitCompletion(int millis);
+extern void hiveJNIRelease(jobject java_call);
+extern bool hiveJNIIsValid(jobject java_call);
+extern void hiveJNIClose(jobject java_call);
+extern void hiveJNICloseQuietly(jobject java_call);
+extern void hiveJNIFree(jobject java_call);
+extern void hiveFetchTableMetadata(Oid relid, hiveTableMetadata *meta);
+extern char *hiveTrimSpace(char *str);
+
+/* hive_gateway.c */
+extern void hive_gateway_init(void);
+extern bool hive_gateway_enabled(void);
+extern int	hive_gateway_open(const char *drivername, const char *url,
+				  const char *username, const char *password,
+				  const char *jarfile, int querytimeout,
+				  bool *reused);
+extern int	hive_gateway_execute(int cursor, const char *query,
+					 char **query_id, char **job_ids, int64 *update_count);
+extern bool hive_gateway_fetch(int cursor, hiveRowBatch *batch);
+extern void hive_gateway_close(int cursor);
+extern void hive_gateway_cancel(void);
+extern void hive_gateway_abort(void);
+extern void hive_gateway_signal_cancel(void);
+
+/* hive_cache.c */
+extern void hive_cache_init(void);
+extern hiveResultCache *hive_cache_lookup(Oid serverid, const char *query,
+				  int ttl, MemoryContext cxt);
+extern hiveResultCache *hive_cache_create(Oid serverid, const char *query,
+				  MemoryContext cxt);
+extern bool hive_cache_read(hiveResultCache *cache, hiveRowBatch *batch);
+extern void hive_cache_write(hiveResultCache *cache, hiveRowBatch *batch);
+extern void hive_cache_finish(hiveResultCache *cache, bool complete);
+
+/* hive_meta.c */
+extern void hive_meta_init(void);
+extern void hive_meta_lookup(Oid relid, hiveTableMetadata *meta);
+
+/* hive_stats.c */
+extern void hive_stats_init(void);
+extern void hive_stats_jvm_created(Oid serverid, instr_time elapsed);
+extern void hive_stats_connection(Oid serverid, Oid relid, bool reused);
+extern void hive_stats_query(Oid serverid, Oid relid, instr_time execute_time);
+extern void hive_stats_scan_end(Oid serverid, Oid relid,
+					hiveScanMetrics *metrics, int64 rows);
+extern void hive_stats_error(Oid serverid, Oid relid);
+
 extern bool is_foreign_expr(PlannerInfo *root, RelOptInfo *baserel, Expr *expr);
 
-extern const char *hive_translate_function(FuncExpr *fe, const char *fname);
-extern bool is_hive_builtin(FuncExpr *fe);
+extern const char *hive_translate_function(FuncExpr *fe, hiveFuncInfo *info);
+extern bool is_hive_builtin(FuncExpr *fe, hiveFuncInfo *info);
+extern void hive_function_info(Oid serverid, Oid funcid, hiveFuncInfo *info);
+extern void hive_operator_info(Oid serverid, Oid opno, hiveFuncInfo *info);
+extern void hive_validate_extra_option(const char *option, const char *value);
 extern const char *get_jointype_name(JoinType jointype);
+extern char *get_column_name(Oid relid, int attnum);
 extern List *build_tlist_to_deparse(RelOptInfo *foreign_rel);
 
 extern void
 deparseSelectStmtForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *baserel,
 						List *remote_conds, List **retrieved_attrs, List **params_list,
 						hiveFdwRelationInfo *fpinfo, List *fdw_scan_tlist);
+extern void deparseInsertSql(StringInfo buf, Relation rel, List *targetAttrs);
+extern void deparseLoadSql(StringInfo buf, Relation rel, const char *path,
+						   bool local, const char *partition);
+extern void deparseInsertRow(StringInfo buf, TupleTableSlot *slot,
+							 List *targetAttrs, FmgrInfo *p_flinfo);
+extern void deparseDirectUpdateSql(StringInfo buf, PlannerInfo *root,
+								   RelOptInfo *foreignrel, Relation rel,
+								   List *targetlist, List *targetAttrs,
+								   List *remote_conds, List **params_list);
+extern void deparseHiveStringLiteral(StringInfo buf, const char *val);
+extern char *hiveOutputValue(FmgrInfo *flinfo, Oid type, Datum value);
+extern char *hiveEncodeBase64(Datum value);
+extern void deparseTruncateSql(StringInfo buf, Relation rel,
+							   const char *partition);
+extern void deparseDirectDeleteSql(StringInfo buf, PlannerInfo *root,
+								   RelOptInfo *foreignrel, Relation rel,
+								   List *remote_conds, List **params_list);
 #endif   /* HIVE_FDW_H */
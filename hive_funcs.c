@@ -21,8 +21,15 @@
 #include "hive_fdw.h"
 
 #include "access/htup_details.h"
+#include "catalog/dependency.h"
+#include "catalog/pg_operator.h"
 #include "catalog/pg_proc.h"
+#include "catalog/pg_type.h"
+#include "commands/extension.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/syscache.h"
 
 /*
@@ -144,42 +151,29 @@ static int	hive_func_name_compare(const char *namea, const char *nameb);
 
 
 /*
- * Provided a function expression and the name of that function, use
- * the HiveFunctionMap structure to come up with a proper name. In many
- * cases the translation is straightforward.
+ * Provided a function expression and what hive_function_info found out
+ * about the function, use the HiveFunctionMap entry to come up with a
+ * proper name. In many cases the translation is straightforward.
  *
  * However in some cases, the hive fname "hive_translate" means that due
  * to polymorphism some additional translations will have to be carried
  * out
  */
 const char *
-hive_translate_function(FuncExpr *fe, const char *fname)
+hive_translate_function(FuncExpr *fe, hiveFuncInfo *info)
 {
-	struct			hive_func_mapping	key;
-	struct			hive_func_mapping  *res;
-	int				num_functions;
-
-	num_functions = sizeof(HiveFunctionMap)/
-						sizeof(struct hive_func_mapping);
-
-	key.fname = fname;
-	key.hive_fname = NULL;
-	res = (struct hive_func_mapping *) bsearch(&key,
-											 HiveFunctionMap,
-											 num_functions,
-											 sizeof(struct hive_func_mapping),
-											 hive_func_compare);
+	const char *fname = NameStr(info->name);
 
 	/* This should never happen.. */
-	if (res == NULL)
+	if (info->hive_name[0] == '\0')
 		ereport(ERROR,
 				(errcode(ERRCODE_FDW_ERROR),
 				 errmsg("unable to map function: %s", fname)
 				));
 
-	elog(DEBUG2, "translated %s to %s", fname, res->hive_fname);
-	if (strcmp(res->hive_fname, "hive_translate") != 0)
-		return res->hive_fname;
+	elog(DEBUG2, "translated %s to %s", fname, info->hive_name);
+	if (strcmp(info->hive_name, "hive_translate") != 0)
+		return info->hive_name;
 
 
 	/* Single argument is log base 10 */
@@ -245,44 +239,19 @@ hive_translate_function(FuncExpr *fe, const char *fname)
 
 /*
  * Check if the incoming function can be sent to Hive. We consult the
- * HiveFunctionMap table for this. For performance we use bsearch to
- * quickly find if the function is shippable or not. This is just the
- * lookup function.
+ * HiveFunctionMap table for this, through the function cache, so this
+ * is only a few string comparisons.
  */
 bool
-is_hive_builtin(FuncExpr *fe)
+is_hive_builtin(FuncExpr *fe, hiveFuncInfo *info)
 {
-	struct			hive_func_mapping	key;
-	struct			hive_func_mapping  *res;
-	int				num_functions;
-	HeapTuple		proctup;
-	Form_pg_proc	procform;
-	const char	   *proname;
-
-	proctup = SearchSysCache1(PROCOID, ObjectIdGetDatum(fe->funcid));
-	if (!HeapTupleIsValid(proctup))
-		elog(ERROR, "cache lookup failed for function %u", fe->funcid);
-	procform = (Form_pg_proc) GETSTRUCT(proctup);
-
-	/* Deparse the function name ... */
-	proname = NameStr(procform->proname);
-	ReleaseSysCache(proctup);
-
-	num_functions = sizeof(HiveFunctionMap)/
-						sizeof(struct hive_func_mapping);
-
-	key.fname = proname;
-	key.hive_fname = NULL;
-	res = (struct hive_func_mapping *) bsearch(&key,
-											 HiveFunctionMap,
-											 num_functions,
-											 sizeof(struct hive_func_mapping),
-											 hive_func_compare);
-	if (res == NULL)
+	const char *proname = NameStr(info->name);
+
+	if (info->hive_name[0] == '\0')
 		return false;
 
 	/* if it's a standard mapping return immediately */
-	if (strcmp(res->hive_fname, "hive_translate") != 0)
+	if (strcmp(info->hive_name, "hive_translate") != 0)
 		return true;
 
 	/* Only 1 argument ltrim function supported */
@@ -309,6 +278,381 @@ is_hive_builtin(FuncExpr *fe)
 	return true;
 }
 
+/*
+ * Functions and operators beyond HiveFunctionMap can be declared
+ * shippable per server:
+ *
+ *	extra_functions	 '[schema.]name[:hive_name], ...'
+ *	extra_operators	 '[schema.]name[:hive_name], ...'
+ *	extensions		 'extension, ...'
+ *
+ * A mapping without hive_name keeps the PostgreSQL name, and one without
+ * a schema matches the name in every schema. Members of the listed
+ * extensions are sent under their own names. This is how SQL stubs such
+ * as hive.get_json_object(text, text) reach the Hive UDFs they stand for.
+ *
+ * The walker and the deparser look at every function and operator of a
+ * query, often the same ones many times. Instead of a catalog lookup, a
+ * bsearch of HiveFunctionMap and a match against the options each time,
+ * what they need is kept as a hiveFuncInfo in a hash table per backend,
+ * keyed by server and object. Any change to a foreign server, function,
+ * operator or schema empties it, as names and options may then mean
+ * something else.
+ */
+typedef struct HiveFuncKey
+{
+	Oid			serverid;
+	Oid			classid;		/* ProcedureRelationId or OperatorRelationId */
+	Oid			objid;
+} HiveFuncKey;
+
+typedef struct HiveFuncEntry
+{
+	HiveFuncKey key;			/* hash key, must be first */
+	hiveFuncInfo info;
+} HiveFuncEntry;
+
+typedef struct HiveExtraMapping
+{
+	char	   *schema;			/* NULL matches any schema */
+	char	   *name;
+	char	   *hive_name;
+} HiveExtraMapping;
+
+static HTAB *func_hash = NULL;
+
+static void hive_func_lookup(Oid serverid, Oid classid, Oid objid,
+							 hiveFuncInfo *info);
+static void hive_func_fill(Oid serverid, Oid classid, Oid objid,
+						   hiveFuncInfo *info);
+static bool hive_extra_match(Oid serverid, Oid classid, Oid objid,
+							 const char *name, Oid namespace,
+							 char *hive_name);
+static List *hive_parse_extra_mappings(const char *option, const char *value);
+static List *hive_parse_name_list(const char *option, const char *value);
+static void hive_func_invalidate(Datum arg, int cacheid, uint32 hashvalue);
+
+/*
+ * hive_function_info
+ *		What the deparser needs to know about a function used in a query
+ *		on the server
+ */
+void
+hive_function_info(Oid serverid, Oid funcid, hiveFuncInfo *info)
+{
+	hive_func_lookup(serverid, ProcedureRelationId, funcid, info);
+}
+
+/*
+ * hive_operator_info
+ *		What the deparser needs to know about an operator used in a query
+ *		on the server
+ */
+void
+hive_operator_info(Oid serverid, Oid opno, hiveFuncInfo *info)
+{
+	hive_func_lookup(serverid, OperatorRelationId, opno, info);
+}
+
+/*
+ * hive_validate_extra_option
+ *		Check the syntax of an extra_functions, extra_operators or
+ *		extensions option. The objects need not exist yet.
+ */
+void
+hive_validate_extra_option(const char *option, const char *value)
+{
+	if (strcmp(option, "extensions") == 0)
+		(void) hive_parse_name_list(option, value);
+	else
+		(void) hive_parse_extra_mappings(option, value);
+}
+
+/*
+ * hive_func_lookup
+ *		Copy the cached information about a function or operator to info,
+ *		filling the cache entry first if there is none. A copy, as
+ *		invalidations may remove the entry at any time.
+ */
+static void
+hive_func_lookup(Oid serverid, Oid classid, Oid objid, hiveFuncInfo *info)
+{
+	HiveFuncKey key;
+	HiveFuncEntry *entry;
+
+	if (func_hash == NULL)
+	{
+		HASHCTL		ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(HiveFuncKey);
+		ctl.entrysize = sizeof(HiveFuncEntry);
+		ctl.hcxt = CacheMemoryContext;
+
+		func_hash = hash_create("hive_fdw function cache", 256, &ctl,
+								HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+		CacheRegisterSyscacheCallback(FOREIGNSERVEROID, hive_func_invalidate, (Datum) 0);
+		CacheRegisterSyscacheCallback(PROCOID, hive_func_invalidate, (Datum) 0);
+		CacheRegisterSyscacheCallback(OPEROID, hive_func_invalidate, (Datum) 0);
+		CacheRegisterSyscacheCallback(NAMESPACEOID, hive_func_invalidate, (Datum) 0);
+	}
+
+	memset(&key, 0, sizeof(key));
+	key.serverid = serverid;
+	key.classid = classid;
+	key.objid = objid;
+
+	entry = (HiveFuncEntry *) hash_search(func_hash, &key, HASH_FIND, NULL);
+	if (entry != NULL)
+	{
+		*info = entry->info;
+		return;
+	}
+
+	/* Filling runs catalog lookups, which may flush the hash table */
+	hive_func_fill(serverid, classid, objid, info);
+
+	entry = (HiveFuncEntry *) hash_search(func_hash, &key, HASH_ENTER, NULL);
+	entry->info = *info;
+}
+
+/*
+ * hive_func_fill
+ *		Work out what hiveFuncInfo holds for a function or operator
+ */
+static void
+hive_func_fill(Oid serverid, Oid classid, Oid objid, hiveFuncInfo *info)
+{
+	HeapTuple	tuple;
+	Oid			namespace;
+
+	memset(info, 0, sizeof(hiveFuncInfo));
+
+	if (classid == ProcedureRelationId)
+	{
+		Form_pg_proc procform;
+
+		tuple = SearchSysCache1(PROCOID, ObjectIdGetDatum(objid));
+		if (!HeapTupleIsValid(tuple))
+			elog(ERROR, "cache lookup failed for function %u", objid);
+		procform = (Form_pg_proc) GETSTRUCT(tuple);
+
+		namestrcpy(&info->name, NameStr(procform->proname));
+		namespace = procform->pronamespace;
+	}
+	else
+	{
+		Form_pg_operator form;
+
+		tuple = SearchSysCache1(OPEROID, ObjectIdGetDatum(objid));
+		if (!HeapTupleIsValid(tuple))
+			elog(ERROR, "cache lookup failed for operator %u", objid);
+		form = (Form_pg_operator) GETSTRUCT(tuple);
+
+		namestrcpy(&info->name, NameStr(form->oprname));
+		namespace = form->oprnamespace;
+		info->oprkind = form->oprkind;
+		info->json = (form->oprleft == JSONBOID || form->oprleft == JSONOID ||
+					  form->oprright == JSONBOID || form->oprright == JSONOID);
+		info->json_field_text = (info->json &&
+								 strcmp(NameStr(form->oprname), "->>") == 0 &&
+								 form->oprright == TEXTOID);
+	}
+	ReleaseSysCache(tuple);
+
+	if (hive_extra_match(serverid, classid, objid, NameStr(info->name),
+						 namespace, info->hive_name))
+		info->extra = true;
+	else if (classid == ProcedureRelationId)
+	{
+		struct hive_func_mapping key;
+		struct hive_func_mapping *res;
+
+		key.fname = NameStr(info->name);
+		key.hive_fname = NULL;
+		res = (struct hive_func_mapping *) bsearch(&key,
+												   HiveFunctionMap,
+												   lengthof(HiveFunctionMap),
+												   sizeof(struct hive_func_mapping),
+												   hive_func_compare);
+		if (res != NULL)
+			strlcpy(info->hive_name, res->hive_fname, NAMEDATALEN);
+	}
+}
+
+/*
+ * hive_extra_match
+ *		Look an object up in the server's options, setting hive_name if it
+ *		is shippable
+ */
+static bool
+hive_extra_match(Oid serverid, Oid classid, Oid objid, const char *name,
+				 Oid namespace, char *hive_name)
+{
+	ForeignServer *server = GetForeignServer(serverid);
+	const char *option = (classid == ProcedureRelationId) ?
+		"extra_functions" : "extra_operators";
+	char	   *schema = get_namespace_name(namespace);
+	ListCell   *lc;
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+		ListCell   *lc2;
+
+		if (strcmp(def->defname, option) == 0)
+		{
+			foreach(lc2, hive_parse_extra_mappings(option, defGetString(def)))
+			{
+				HiveExtraMapping *m = (HiveExtraMapping *) lfirst(lc2);
+
+				if (strcmp(m->name, name) == 0 &&
+					(m->schema == NULL || strcmp(m->schema, schema) == 0))
+				{
+					strlcpy(hive_name, m->hive_name, NAMEDATALEN);
+					return true;
+				}
+			}
+		}
+		else if (strcmp(def->defname, "extensions") == 0)
+		{
+			Oid			extension = getExtensionOfObject(classid, objid);
+			char	   *extname;
+
+			if (!OidIsValid(extension))
+				continue;
+
+			extname = get_extension_name(extension);
+			foreach(lc2, hive_parse_name_list("extensions", defGetString(def)))
+			{
+				if (strcmp((char *) lfirst(lc2), extname) == 0)
+				{
+					strlcpy(hive_name, name, NAMEDATALEN);
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+/*
+ * hive_parse_extra_mappings
+ *		Split an extra_functions or extra_operators option into
+ *		HiveExtraMappings. The Hive names end up in the query text, so
+ *		only characters that make up a name or an operator are allowed.
+ */
+static List *
+hive_parse_extra_mappings(const char *option, const char *value)
+{
+	bool		operators = (strcmp(option, "extra_operators") == 0);
+	List	   *result = NIL;
+	ListCell   *lc;
+
+	foreach(lc, hive_parse_name_list(option, value))
+	{
+		char	   *item = (char *) lfirst(lc);
+		char	   *entry = pstrdup(item);
+		HiveExtraMapping *m = (HiveExtraMapping *) palloc0(sizeof(HiveExtraMapping));
+		char	   *colon = strchr(item, ':');
+		char	   *dot;
+		const char *p;
+
+		if (colon != NULL)
+		{
+			*colon = '\0';
+			m->hive_name = hiveTrimSpace(colon + 1);
+			item = hiveTrimSpace(item);
+		}
+
+		dot = strrchr(item, '.');
+		if (dot != NULL)
+		{
+			*dot = '\0';
+			m->schema = item;
+			m->name = dot + 1;
+		}
+		else
+			m->name = item;
+
+		if (m->hive_name == NULL)
+			m->hive_name = m->name;
+
+		if ((m->schema != NULL && *m->schema == '\0') ||
+			*m->name == '\0' || *m->hive_name == '\0' ||
+			strlen(m->hive_name) >= NAMEDATALEN)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("invalid entry \"%s\" in option \"%s\"", entry, option)));
+
+		for (p = m->hive_name; *p; p++)
+		{
+			if (!isalnum((unsigned char) *p) && *p != '_' &&
+				!(operators ? strchr(" +-*/<>=~!@#%^&|?", *p) != NULL : *p == '.'))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("invalid Hive name \"%s\" in option \"%s\"",
+								m->hive_name, option)));
+		}
+		if (strstr(m->hive_name, "--") != NULL || strstr(m->hive_name, "/*") != NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("invalid Hive name \"%s\" in option \"%s\"",
+							m->hive_name, option)));
+
+		result = lappend(result, m);
+	}
+
+	return result;
+}
+
+/*
+ * hive_parse_name_list
+ *		Split a comma-separated option value into trimmed items
+ */
+static List *
+hive_parse_name_list(const char *option, const char *value)
+{
+	List	   *result = NIL;
+	char	   *next = pstrdup(value);
+
+	while (next != NULL)
+	{
+		char	   *item = next;
+
+		next = strchr(item, ',');
+		if (next != NULL)
+			*next++ = '\0';
+
+		item = hiveTrimSpace(item);
+		if (*item == '\0')
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("empty entry in option \"%s\"", option)));
+
+		result = lappend(result, item);
+	}
+
+	return result;
+}
+
+/*
+ * hive_func_invalidate
+ *		Syscache callback emptying the function cache
+ */
+static void
+hive_func_invalidate(Datum arg, int cacheid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS status;
+	HiveFuncEntry *entry;
+
+	hash_seq_init(&status, func_hash);
+	while ((entry = (HiveFuncEntry *) hash_seq_search(&status)) != NULL)
+		hash_search(func_hash, &entry->key, HASH_REMOVE, NULL);
+}
+
 /*
  * Comparator for bsearching HiveFunctionMap array
  */
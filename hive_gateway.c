@@ -0,0 +1,1440 @@
+/*-------------------------------------------------------------------------
+ *
+ * hive_gateway.c
+ *                Shared JDBC gateway for hive_fdw
+ *
+ * By default every backend that touches a Hive table starts a JVM of its
+ * own and opens its own HiveServer2 connections. When hive_fdw is listed
+ * in shared_preload_libraries and hive_fdw.gateway is on, a single
+ * background worker hosts the JVM and a pool of HiveServer2 connections
+ * instead, and backends talk to it over shared memory queues.
+ *
+ * Each backend creates a small DSM segment holding a pair of shm_mq
+ * queues, one for requests and one for responses, and advertises it in a
+ * slot of the gateway's shared memory area. The worker polls all slots
+ * and serves one request at a time, but queries and fetches run on Java
+ * threads and responses are sent without blocking, so a slow HiveServer2
+ * or a backend that is slow to read holds up nobody else. Result rows
+ * travel in the batch format produced by HiveJDBCUtils.FetchBatch, so
+ * the worker forwards batches without looking at them and the backend
+ * decodes them with the same code as an in-process scan.
+ *
+ * Only the worker frees slots: when it notices that a backend detached
+ * from its queues, or when it starts up and discards whatever a previous
+ * incarnation left behind.
+ *
+ * Copyright (c) 2012-2020, BigSQL
+ *
+ * IDENTIFICATION
+ *                hive_fdw/src/hive_gateway.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "hive_fdw.h"
+
+#include <signal.h>
+
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
+#include "storage/shmem.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+/* Size of each of the two queues of a backend */
+#define HIVE_GATEWAY_QUEUE_SIZE		(64 * 1024)
+
+/* Remote cursors a single backend may have open at the same time */
+#define HIVE_GATEWAY_MAX_CURSORS	16
+
+/* How long an aborting backend waits for the worker to close a cursor */
+#define HIVE_GATEWAY_ABORT_TIMEOUT_MS	10000
+
+/* How long the worker waits for a fetch before looking for new requests */
+#define HIVE_GATEWAY_FETCH_WAIT_MS	10
+
+/*
+ * Every message starts with a type byte and an int32 argument (a cursor
+ * number, a column count, ...), followed by a type-specific payload.
+ */
+#define GW_HEADER_SIZE			(1 + sizeof(int32))
+
+/* Requests, backend to worker */
+#define GW_MSG_OPEN				'C'		/* NUL-separated connection strings */
+#define GW_MSG_EXECUTE			'Q'		/* query text */
+#define GW_MSG_FETCH			'F'		/* no payload */
+#define GW_MSG_CLOSE			'X'		/* no payload */
+
+/* Responses, worker to backend */
+#define GW_MSG_OK				'K'		/* argument is the result */
+#define GW_MSG_BATCH			'B'		/* payload is a row batch */
+#define GW_MSG_ERROR			'E'		/* payload is the error message */
+
+#if PG_VERSION_NUM >= 150000
+#define gw_shm_mq_send(mqh, len, data, nowait) \
+	shm_mq_send(mqh, len, data, nowait, true)
+#define gw_shm_mq_sendv(mqh, iov, cnt, nowait) \
+	shm_mq_sendv(mqh, iov, cnt, nowait, true)
+#else
+#define gw_shm_mq_send(mqh, len, data, nowait) \
+	shm_mq_send(mqh, len, data, nowait)
+#define gw_shm_mq_sendv(mqh, iov, cnt, nowait) \
+	shm_mq_sendv(mqh, iov, cnt, nowait)
+#endif
+
+/*
+ * A backend's entry in the gateway's shared memory area.
+ */
+typedef struct HiveGatewaySlot
+{
+	bool		in_use;			/* claimed by a backend */
+	pid_t		backend_pid;	/* for diagnostics only */
+	dsm_handle	handle;			/* segment holding the queue pair */
+	int32		cancel_pending; /* set by the backend on query cancel */
+} HiveGatewaySlot;
+
+typedef struct HiveGatewayShared
+{
+	LWLock	   *lock;			/* protects everything below */
+	PGPROC	   *worker;			/* gateway worker, NULL if not running */
+	int			nslots;
+	HiveGatewaySlot slots[FLEXIBLE_ARRAY_MEMBER];
+} HiveGatewayShared;
+
+/*
+ * Backend side: the queues to the worker and one receive buffer per
+ * cursor, since the worker's responses for different scans interleave.
+ */
+typedef struct HiveGatewaySession
+{
+	dsm_segment *seg;
+	shm_mq_handle *outq;		/* requests */
+	shm_mq_handle *inq;			/* responses */
+	int			slotno;
+	dsm_handle	handle;
+	char	   *buffers[HIVE_GATEWAY_MAX_CURSORS];
+	Size		buffer_sizes[HIVE_GATEWAY_MAX_CURSORS];
+	bool		open[HIVE_GATEWAY_MAX_CURSORS];	/* cursors not yet closed */
+	bool		busy;			/* a request awaits its response */
+} HiveGatewaySession;
+
+/*
+ * Worker side: one entry per slot, and the pool of idle connections.
+ */
+typedef struct HiveGatewayClient
+{
+	dsm_segment *seg;			/* NULL if the slot is not attached */
+	shm_mq_handle *inq;			/* requests */
+	shm_mq_handle *outq;		/* responses */
+	jobject		cursors[HIVE_GATEWAY_MAX_CURSORS];
+	char	   *cursor_keys[HIVE_GATEWAY_MAX_CURSORS];
+	int			cursor_key_lens[HIVE_GATEWAY_MAX_CURSORS];
+	bool		executing[HIVE_GATEWAY_MAX_CURSORS];	/* reply pending */
+	bool		fetching[HIVE_GATEWAY_MAX_CURSORS]; /* reply pending */
+	StringInfoData reply;		/* response the queue had no room for */
+	bool		reply_pending;
+} HiveGatewayClient;
+
+typedef struct HiveGatewayPooledConn
+{
+	char	   *key;			/* connection strings the object was made for */
+	int			key_len;		/* key holds NULs, so its length is kept */
+	jobject		java_call;
+} HiveGatewayPooledConn;
+
+/* GUC variables */
+static bool hive_gateway_enable = false;
+static int	hive_gateway_slots = 64;
+static int	hive_gateway_pool_size = 8;
+static int	hive_gateway_maxheapsize = 0;
+
+static HiveGatewayShared *gw = NULL;
+static HiveGatewaySession *session = NULL;
+
+static HiveGatewayClient *clients = NULL;
+static List *idle_pool = NIL;
+static MemoryContext gateway_cxt = NULL;
+static volatile sig_atomic_t got_sigterm = false;
+static volatile sig_atomic_t got_sighup = false;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+PGDLLEXPORT void hive_gateway_main(Datum main_arg);
+
+static Size hive_gateway_shmem_size(void);
+static void hive_gateway_shmem_request(void);
+static void hive_gateway_shmem_startup(void);
+
+static void gateway_connect(void);
+static void gateway_lost(void);
+static void gateway_wait(void);
+static char *gateway_request(char type, int32 arg, const char *payload,
+				Size payload_len, Size *resp_len);
+static bool gateway_wait_quietly(TimestampTz deadline);
+static bool gateway_request_quietly(char type, int32 arg);
+
+static void gateway_sigterm(SIGNAL_ARGS);
+static void gateway_sighup(SIGNAL_ARGS);
+static void gateway_worker_exit(int code, Datum arg);
+static void gateway_attach_clients(void);
+static bool gateway_serve_client(int slotno);
+static void gateway_drop_client(int slotno);
+static void gateway_reply(HiveGatewayClient *client, char type, int32 arg,
+			  const char *payload, Size payload_len);
+static bool gateway_flush_reply(HiveGatewayClient *client);
+static void gateway_handle_message(HiveGatewayClient *client,
+					   char *msg, Size len);
+static void gateway_release_cursor(HiveGatewayClient *client, int cursor);
+static void gateway_close_connection(jobject java_call);
+static bool gateway_poll_queries(bool *fetching);
+
+/*
+ * hive_gateway_init
+ *		Define the gateway GUCs and, when preloaded with the gateway
+ *		enabled, reserve shared memory and register the worker.
+ */
+void
+hive_gateway_init(void)
+{
+	BackgroundWorker worker;
+
+	DefineCustomBoolVariable("hive_fdw.gateway",
+							 "Serve all backends from a shared JDBC gateway worker.",
+							 "Requires hive_fdw in shared_preload_libraries.",
+							 &hive_gateway_enable,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomIntVariable("hive_fdw.gateway_slots",
+							"Maximum number of backends using the gateway at once.",
+							NULL,
+							&hive_gateway_slots,
+							64, 1, MAX_BACKENDS,
+							PGC_POSTMASTER,
+							0,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("hive_fdw.gateway_pool_size",
+							"Maximum number of idle HiveServer2 connections kept by the gateway.",
+							NULL,
+							&hive_gateway_pool_size,
+							8, 0, 1000,
+							PGC_SIGHUP,
+							0,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("hive_fdw.gateway_maxheapsize",
+							"Maximum heap size of the gateway worker's JVM.",
+							"Zero uses the JVM's default.",
+							&hive_gateway_maxheapsize,
+							0, 0, INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_MB,
+							NULL, NULL, NULL);
+
+	if (!process_shared_preload_libraries_in_progress || !hive_gateway_enable)
+		return;
+
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = hive_gateway_shmem_request;
+#else
+	hive_gateway_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = hive_gateway_shmem_startup;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = 10;
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "hive_fdw");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN, "hive_gateway_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "hive_fdw gateway");
+#if PG_VERSION_NUM >= 110000
+	snprintf(worker.bgw_type, BGW_MAXLEN, "hive_fdw gateway");
+#endif
+	RegisterBackgroundWorker(&worker);
+}
+
+/*
+ * hive_gateway_enabled
+ *		Should this backend use the gateway instead of its own JVM?
+ */
+bool
+hive_gateway_enabled(void)
+{
+	return (hive_gateway_enable && gw != NULL);
+}
+
+static Size
+hive_gateway_shmem_size(void)
+{
+	return add_size(offsetof(HiveGatewayShared, slots),
+					mul_size(hive_gateway_slots, sizeof(HiveGatewaySlot)));
+}
+
+static void
+hive_gateway_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(hive_gateway_shmem_size());
+	RequestNamedLWLockTranche("hive_fdw gateway", 1);
+}
+
+static void
+hive_gateway_shmem_startup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	gw = ShmemInitStruct("hive_fdw gateway", hive_gateway_shmem_size(), &found);
+	if (!found)
+	{
+		memset(gw, 0, hive_gateway_shmem_size());
+		gw->lock = &(GetNamedLWLockTranche("hive_fdw gateway"))->lock;
+		gw->worker = NULL;
+		gw->nslots = hive_gateway_slots;
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/* ----------------------------------------------------------------
+ *		Backend side
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * hive_gateway_open
+ *		Open a remote cursor in the gateway, connected to the given URL.
+ *		The gateway reuses a pooled connection when it has one, and tells
+ *		so through "reused".
+ */
+int
+hive_gateway_open(const char *drivername, const char *url,
+				  const char *username, const char *password,
+				  const char *jarfile, int querytimeout,
+				  bool *reused)
+{
+	StringInfoData payload;
+	Size		len;
+	char	   *resp;
+	int32		cursor;
+	char		timeoutstr[12];
+
+	if (session == NULL)
+		gateway_connect();
+
+	initStringInfo(&payload);
+	appendBinaryStringInfo(&payload, drivername, strlen(drivername) + 1);
+	appendBinaryStringInfo(&payload, url, strlen(url) + 1);
+	appendBinaryStringInfo(&payload, username ? username : "",
+						   strlen(username ? username : "") + 1);
+	appendBinaryStringInfo(&payload, password ? password : "",
+						   strlen(password ? password : "") + 1);
+	appendBinaryStringInfo(&payload, jarfile, strlen(jarfile) + 1);
+	snprintf(timeoutstr, sizeof(timeoutstr), "%d", querytimeout);
+	appendBinaryStringInfo(&payload, timeoutstr, strlen(timeoutstr) + 1);
+
+	resp = gateway_request(GW_MSG_OPEN, 0, payload.data, payload.len, &len);
+	memcpy(&cursor, resp + 1, sizeof(int32));
+	*reused = (len > GW_HEADER_SIZE && resp[GW_HEADER_SIZE] != 0);
+	session->open[cursor] = true;
+	pfree(payload.data);
+
+	elog(DEBUG2, HIVE_FDW_NAME ": opened gateway cursor %d", cursor);
+
+	return cursor;
+}
+
+/*
+ * hive_gateway_execute
+ *		Run a query on a gateway cursor and return its number of columns.
+ *		The Hive query and job IDs are returned as well, NULL if unknown,
+ *		and, unless update_count is NULL, the number of rows the statement
+ *		changed, -1 if unknown.
+ */
+int
+hive_gateway_execute(int cursor, const char *query,
+					 char **query_id, char **job_ids, int64 *update_count)
+{
+	Size		len;
+	char	   *resp;
+	int32		ncolumns;
+	char	   *ids;
+
+	/*
+	 * Any cancel request left over from a previous query is stale. It is
+	 * cleared here rather than by the worker, so that a cancel arriving
+	 * while the request is on its way is not lost.
+	 */
+	gw->slots[session->slotno].cancel_pending = 0;
+
+	resp = gateway_request(GW_MSG_EXECUTE, cursor, query, strlen(query) + 1, &len);
+	memcpy(&ncolumns, resp + 1, sizeof(int32));
+
+	/* The payload holds both IDs as NUL-terminated strings, empty if unknown */
+	ids = resp + GW_HEADER_SIZE;
+	*query_id = NULL;
+	*job_ids = NULL;
+	if (len > GW_HEADER_SIZE && ids[0] != '\0')
+		*query_id = pstrdup(ids);
+	ids += strlen(ids) + 1;
+	if (len > ids - resp && ids[0] != '\0')
+		*job_ids = pstrdup(ids);
+	ids += strlen(ids) + 1;
+	if (update_count != NULL)
+	{
+		*update_count = -1;
+		if (len >= (ids - resp) + sizeof(int64))
+			memcpy(update_count, ids, sizeof(int64));
+	}
+
+	return ncolumns;
+}
+
+/*
+ * hive_gateway_fetch
+ *		Fetch the next batch of rows of a gateway cursor into "batch".
+ *		Returns false once the result set is exhausted.
+ */
+bool
+hive_gateway_fetch(int cursor, hiveRowBatch *batch)
+{
+	Size		len;
+	char	   *resp;
+
+	resp = gateway_request(GW_MSG_FETCH, cursor, NULL, 0, &len);
+	len -= GW_HEADER_SIZE;
+
+	/*
+	 * The response lives in the queue until the next receive, which may be
+	 * on behalf of another scan, so keep a copy per cursor.
+	 */
+	if (session->buffer_sizes[cursor] < len)
+	{
+		if (session->buffers[cursor])
+			pfree(session->buffers[cursor]);
+		session->buffers[cursor] = MemoryContextAlloc(TopMemoryContext, len);
+		session->buffer_sizes[cursor] = len;
+	}
+	memcpy(session->buffers[cursor], resp + GW_HEADER_SIZE, len);
+
+	hiveBatchInit(batch, session->buffers[cursor], len);
+
+	return (batch->nrows > 0);
+}
+
+/*
+ * hive_gateway_close
+ *		Give a cursor back to the gateway, which keeps its connection in
+ *		the pool
+ */
+void
+hive_gateway_close(int cursor)
+{
+	Size		len;
+
+	/* Nothing to do if the session went away since the cursor was opened */
+	if (session == NULL)
+		return;
+
+	session->open[cursor] = false;
+	(void) gateway_request(GW_MSG_CLOSE, cursor, NULL, 0, &len);
+
+	if (session->buffers[cursor])
+	{
+		pfree(session->buffers[cursor]);
+		session->buffers[cursor] = NULL;
+		session->buffer_sizes[cursor] = 0;
+	}
+}
+
+/*
+ * hive_gateway_signal_cancel
+ *		Ask the gateway to cancel the statement running for this backend.
+ *		Called from the SIGINT handler, so it only stores a flag that the
+ *		cancel watcher thread in the worker's JVM polls.
+ */
+void
+hive_gateway_signal_cancel(void)
+{
+	if (session == NULL || gw == NULL)
+		return;
+
+	gw->slots[session->slotno].cancel_pending = 1;
+}
+
+/*
+ * hive_gateway_cancel
+ *		Drop the session after a query cancel. The worker notices the
+ *		detach and releases every cursor of this backend.
+ */
+void
+hive_gateway_cancel(void)
+{
+	int			i;
+
+	if (session == NULL)
+		return;
+
+	dsm_detach(session->seg);
+
+	for (i = 0; i < HIVE_GATEWAY_MAX_CURSORS; i++)
+	{
+		if (session->buffers[i])
+			pfree(session->buffers[i]);
+	}
+	pfree(session);
+	session = NULL;
+}
+
+/*
+ * hive_gateway_abort
+ *		Close the cursors that a failed transaction left open, so that the
+ *		worker can pool their connections again. If the error interrupted
+ *		a request, its response is still on its way and the queues cannot
+ *		be trusted, so the whole session is dropped instead, and the
+ *		worker closes every cursor of this backend. Never throws.
+ */
+void
+hive_gateway_abort(void)
+{
+	int			i;
+
+	if (session == NULL)
+		return;
+
+	if (session->busy)
+	{
+		hive_gateway_cancel();
+		return;
+	}
+
+	for (i = 0; i < HIVE_GATEWAY_MAX_CURSORS; i++)
+	{
+		if (!session->open[i])
+			continue;
+
+		session->open[i] = false;
+		if (!gateway_request_quietly(GW_MSG_CLOSE, i))
+		{
+			hive_gateway_cancel();
+			return;
+		}
+
+		if (session->buffers[i])
+		{
+			pfree(session->buffers[i]);
+			session->buffers[i] = NULL;
+			session->buffer_sizes[i] = 0;
+		}
+	}
+}
+
+/*
+ * gateway_connect
+ *		Create our queue pair and hand it to the gateway worker
+ */
+static void
+gateway_connect(void)
+{
+	MemoryContext oldcontext;
+	dsm_segment *seg;
+	shm_mq	   *reqq;
+	shm_mq	   *respq;
+	PGPROC	   *worker;
+	int			slotno = -1;
+	int			i;
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	seg = dsm_create(2 * HIVE_GATEWAY_QUEUE_SIZE, 0);
+	dsm_pin_mapping(seg);
+
+	reqq = shm_mq_create(dsm_segment_address(seg), HIVE_GATEWAY_QUEUE_SIZE);
+	respq = shm_mq_create((char *) dsm_segment_address(seg) + HIVE_GATEWAY_QUEUE_SIZE,
+						  HIVE_GATEWAY_QUEUE_SIZE);
+	shm_mq_set_sender(reqq, MyProc);
+	shm_mq_set_receiver(respq, MyProc);
+
+	session = (HiveGatewaySession *) palloc0(sizeof(HiveGatewaySession));
+	session->seg = seg;
+	session->handle = dsm_segment_handle(seg);
+	session->outq = shm_mq_attach(reqq, seg, NULL);
+	session->inq = shm_mq_attach(respq, seg, NULL);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	LWLockAcquire(gw->lock, LW_EXCLUSIVE);
+	worker = gw->worker;
+	if (worker != NULL)
+	{
+		for (i = 0; i < gw->nslots; i++)
+		{
+			if (!gw->slots[i].in_use)
+			{
+				slotno = i;
+				gw->slots[i].in_use = true;
+				gw->slots[i].backend_pid = MyProcPid;
+				gw->slots[i].handle = session->handle;
+				gw->slots[i].cancel_pending = 0;
+				break;
+			}
+		}
+	}
+	LWLockRelease(gw->lock);
+
+	if (worker == NULL || slotno < 0)
+	{
+		hive_gateway_cancel();
+		ereport(ERROR,
+				(errcode(ERRCODE_FDW_UNABLE_TO_ESTABLISH_CONNECTION),
+				 errmsg(worker == NULL ?
+						"hive_fdw gateway worker is not running" :
+						"too many backends connected to the hive_fdw gateway"),
+				 errhint("Consider raising hive_fdw.gateway_slots.")));
+	}
+
+	session->slotno = slotno;
+	SetLatch(&worker->procLatch);
+
+	elog(DEBUG2, HIVE_FDW_NAME ": attached to gateway slot %d", slotno);
+}
+
+/*
+ * gateway_lost
+ *		The worker went away while we were talking to it
+ */
+static void
+gateway_lost(void)
+{
+	hive_gateway_cancel();
+	ereport(ERROR,
+			(errcode(ERRCODE_FDW_UNABLE_TO_ESTABLISH_CONNECTION),
+			 errmsg("lost connection to the hive_fdw gateway worker")));
+}
+
+/*
+ * gateway_wait
+ *		Sleep until the worker signals us, servicing interrupts
+ */
+static void
+gateway_wait(void)
+{
+	int			rc;
+	bool		lost;
+
+	rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+				   1000L, hiveWaitEventQuery());
+	if (rc & WL_POSTMASTER_DEATH)
+		proc_exit(1);
+	ResetLatch(MyLatch);
+
+	SIGINTInterruptCheckProcess();
+	CHECK_FOR_INTERRUPTS();
+
+	/* A restarted worker discards all slots, including ours */
+	LWLockAcquire(gw->lock, LW_SHARED);
+	lost = (!gw->slots[session->slotno].in_use ||
+			gw->slots[session->slotno].handle != session->handle);
+	LWLockRelease(gw->lock);
+
+	if (lost)
+		gateway_lost();
+}
+
+/*
+ * gateway_request
+ *		Send one request and wait for its response. Errors reported by the
+ *		worker are rethrown here. Returns the whole response message.
+ */
+static char *
+gateway_request(char type, int32 arg, const char *payload, Size payload_len,
+				Size *resp_len)
+{
+	char		header[GW_HEADER_SIZE];
+	shm_mq_iovec iov[2];
+	shm_mq_result res;
+	void	   *data;
+
+	header[0] = type;
+	memcpy(header + 1, &arg, sizeof(int32));
+	iov[0].data = header;
+	iov[0].len = GW_HEADER_SIZE;
+	iov[1].data = payload;
+	iov[1].len = payload_len;
+
+	/*
+	 * Use non-blocking calls so that we wait in our own loop, where our
+	 * SIGINT handling is honored.
+	 */
+	session->busy = true;
+	for (;;)
+	{
+		res = gw_shm_mq_sendv(session->outq, iov, 2, true);
+		if (res == SHM_MQ_SUCCESS)
+			break;
+		if (res == SHM_MQ_DETACHED)
+			gateway_lost();
+		gateway_wait();
+	}
+
+	for (;;)
+	{
+		res = shm_mq_receive(session->inq, resp_len, &data, true);
+		if (res == SHM_MQ_SUCCESS)
+			break;
+		if (res == SHM_MQ_DETACHED)
+			gateway_lost();
+		gateway_wait();
+	}
+	session->busy = false;
+
+	if (*resp_len < GW_HEADER_SIZE)
+		elog(ERROR, HIVE_FDW_NAME ": malformed gateway response");
+
+	if (((char *) data)[0] == GW_MSG_ERROR)
+		ereport(ERROR,
+				(errcode(ERRCODE_FDW_ERROR),
+				 errmsg("%s", (char *) data + GW_HEADER_SIZE)));
+
+	return (char *) data;
+}
+
+/*
+ * gateway_wait_quietly
+ *		Like gateway_wait, for use while aborting: interrupts are not
+ *		serviced and nothing is thrown. Returns false once the worker is
+ *		gone or "deadline" has passed.
+ */
+static bool
+gateway_wait_quietly(TimestampTz deadline)
+{
+	int			rc;
+	bool		lost;
+
+	if (GetCurrentTimestamp() >= deadline)
+		return false;
+
+	rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+				   100L, hiveWaitEventQuery());
+	if (rc & WL_POSTMASTER_DEATH)
+		proc_exit(1);
+	ResetLatch(MyLatch);
+
+	LWLockAcquire(gw->lock, LW_SHARED);
+	lost = (!gw->slots[session->slotno].in_use ||
+			gw->slots[session->slotno].handle != session->handle);
+	LWLockRelease(gw->lock);
+
+	return !lost;
+}
+
+/*
+ * gateway_request_quietly
+ *		Send a request without payload and wait for its response, which is
+ *		discarded. Returns false if the worker did not answer in time, in
+ *		which case the queues are out of step.
+ */
+static bool
+gateway_request_quietly(char type, int32 arg)
+{
+	char		header[GW_HEADER_SIZE];
+	TimestampTz deadline;
+	shm_mq_result res;
+	Size		len;
+	void	   *data;
+
+	header[0] = type;
+	memcpy(header + 1, &arg, sizeof(int32));
+	deadline = TimestampTzPlusMilliseconds(GetCurrentTimestamp(),
+										   HIVE_GATEWAY_ABORT_TIMEOUT_MS);
+
+	while ((res = gw_shm_mq_send(session->outq, GW_HEADER_SIZE, header, true)) != SHM_MQ_SUCCESS)
+	{
+		if (res == SHM_MQ_DETACHED || !gateway_wait_quietly(deadline))
+			return false;
+	}
+
+	while ((res = shm_mq_receive(session->inq, &len, &data, true)) != SHM_MQ_SUCCESS)
+	{
+		if (res == SHM_MQ_DETACHED || !gateway_wait_quietly(deadline))
+			return false;
+	}
+
+	return true;
+}
+
+/* ----------------------------------------------------------------
+ *		Worker side
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * hive_gateway_main
+ *		Entry point of the gateway background worker
+ */
+void
+hive_gateway_main(Datum main_arg)
+{
+	int			i;
+	instr_time	start;
+	instr_time	elapsed;
+
+	pqsignal(SIGTERM, gateway_sigterm);
+	pqsignal(SIGHUP, gateway_sighup);
+	BackgroundWorkerUnblockSignals();
+
+	gateway_cxt = AllocSetContextCreate(TopMemoryContext,
+										"hive_fdw gateway",
+										ALLOCSET_DEFAULT_SIZES);
+	clients = (HiveGatewayClient *)
+		MemoryContextAllocZero(TopMemoryContext,
+							   sizeof(HiveGatewayClient) * gw->nslots);
+
+	INSTR_TIME_SET_CURRENT(start);
+	if (hiveCreateJVM(hive_gateway_maxheapsize))
+	{
+		INSTR_TIME_SET_CURRENT(elapsed);
+		INSTR_TIME_SUBTRACT(elapsed, start);
+		hive_stats_jvm_created(InvalidOid, elapsed);
+	}
+
+	/* Forget whatever a previous incarnation of the worker left behind */
+	LWLockAcquire(gw->lock, LW_EXCLUSIVE);
+	for (i = 0; i < gw->nslots; i++)
+		gw->slots[i].in_use = false;
+	gw->worker = MyProc;
+	LWLockRelease(gw->lock);
+
+	on_shmem_exit(gateway_worker_exit, 0);
+
+	elog(LOG, HIVE_FDW_NAME ": gateway worker started with %d slots", gw->nslots);
+
+	while (!got_sigterm)
+	{
+		bool		did_work;
+		bool		executing;
+		bool		fetching;
+		long		timeout;
+		int			rc;
+
+		ResetLatch(MyLatch);
+
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		gateway_attach_clients();
+
+		do
+		{
+			did_work = false;
+			for (i = 0; i < gw->nslots && !got_sigterm; i++)
+			{
+				if (clients[i].seg != NULL && gateway_serve_client(i))
+					did_work = true;
+			}
+		} while (did_work && !got_sigterm);
+
+		/* Running queries are polled, so keep the sleep short meanwhile */
+		executing = gateway_poll_queries(&fetching);
+
+		/*
+		 * A scan waits for every fetch, so rather than polling them on the
+		 * latch, wait for a Java thread to finish one and only glance at
+		 * the latch for new requests.
+		 */
+		if (fetching)
+		{
+			hiveJNIAwaitCompletion(HIVE_GATEWAY_FETCH_WAIT_MS);
+			timeout = 0;
+		}
+		else
+			timeout = executing ? HIVE_POLL_INTERVAL_MS : 1000L;
+
+		rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   timeout, PG_WAIT_EXTENSION);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+	}
+
+	proc_exit(0);
+}
+
+static void
+gateway_sigterm(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sigterm = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+static void
+gateway_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sighup = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+static void
+gateway_worker_exit(int code, Datum arg)
+{
+	LWLockAcquire(gw->lock, LW_EXCLUSIVE);
+	if (gw->worker == MyProc)
+		gw->worker = NULL;
+	LWLockRelease(gw->lock);
+}
+
+/*
+ * gateway_attach_clients
+ *		Attach to the queues of backends that claimed a slot since the
+ *		last round
+ */
+static void
+gateway_attach_clients(void)
+{
+	int			i;
+
+	for (i = 0; i < gw->nslots; i++)
+	{
+		HiveGatewayClient *client = &clients[i];
+		dsm_handle	handle;
+		bool		in_use;
+		char	   *addr;
+		MemoryContext oldcontext;
+
+		if (client->seg != NULL)
+			continue;
+
+		LWLockAcquire(gw->lock, LW_SHARED);
+		in_use = gw->slots[i].in_use;
+		handle = gw->slots[i].handle;
+		LWLockRelease(gw->lock);
+
+		if (!in_use)
+			continue;
+
+		oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+		client->seg = dsm_attach(handle);
+		if (client->seg == NULL)
+		{
+			/* The backend gave up before we got to it */
+			MemoryContextSwitchTo(oldcontext);
+			gateway_drop_client(i);
+			continue;
+		}
+		dsm_pin_mapping(client->seg);
+
+		addr = dsm_segment_address(client->seg);
+		shm_mq_set_receiver((shm_mq *) addr, MyProc);
+		shm_mq_set_sender((shm_mq *) (addr + HIVE_GATEWAY_QUEUE_SIZE), MyProc);
+		client->inq = shm_mq_attach((shm_mq *) addr, client->seg, NULL);
+		client->outq = shm_mq_attach((shm_mq *) (addr + HIVE_GATEWAY_QUEUE_SIZE),
+									 client->seg, NULL);
+
+		MemoryContextSwitchTo(oldcontext);
+
+		elog(DEBUG2, HIVE_FDW_NAME ": gateway attached slot %d", i);
+	}
+}
+
+/*
+ * gateway_serve_client
+ *		Handle one pending request of a client, if there is one. Returns
+ *		true if a request was handled.
+ */
+static bool
+gateway_serve_client(int slotno)
+{
+	HiveGatewayClient *client = &clients[slotno];
+	shm_mq_result res;
+	Size		len;
+	void	   *data;
+
+	/* Finish the last response before taking the next request */
+	if (!gateway_flush_reply(client))
+		return false;
+
+	res = shm_mq_receive(client->inq, &len, &data, true);
+	if (res == SHM_MQ_WOULD_BLOCK)
+		return false;
+	if (res == SHM_MQ_DETACHED || len < GW_HEADER_SIZE)
+	{
+		gateway_drop_client(slotno);
+		return false;
+	}
+
+	MemoryContextReset(gateway_cxt);
+	MemoryContextSwitchTo(gateway_cxt);
+
+	PG_TRY();
+	{
+		gateway_handle_message(client, (char *) data, len);
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		/* Hand the error to the backend instead of dying */
+		MemoryContextSwitchTo(gateway_cxt);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		gateway_reply(client, GW_MSG_ERROR, 0,
+					  edata->message, strlen(edata->message) + 1);
+	}
+	PG_END_TRY();
+
+	MemoryContextSwitchTo(TopMemoryContext);
+
+	return true;
+}
+
+/*
+ * gateway_handle_message
+ *		Execute one request on behalf of a client and send the response
+ */
+static void
+gateway_handle_message(HiveGatewayClient *client, char *msg, Size len)
+{
+	char		type = msg[0];
+	int32		arg;
+	char	   *payload = msg + GW_HEADER_SIZE;
+
+	memcpy(&arg, msg + 1, sizeof(int32));
+
+	if (type != GW_MSG_OPEN &&
+		(arg < 0 || arg >= HIVE_GATEWAY_MAX_CURSORS || client->cursors[arg] == NULL))
+		elog(ERROR, HIVE_FDW_NAME ": invalid gateway cursor %d", arg);
+
+	switch (type)
+	{
+		case GW_MSG_OPEN:
+			{
+				const char *drivername = payload;
+				const char *url = drivername + strlen(drivername) + 1;
+				const char *username = url + strlen(url) + 1;
+				const char *password = username + strlen(username) + 1;
+				const char *jarfile = password + strlen(password) + 1;
+				const char *timeoutstr = jarfile + strlen(jarfile) + 1;
+				StringInfoData key;
+				HiveGatewayPooledConn *pooled = NULL;
+				jobject		java_call = NULL;
+				ListCell   *lc;
+				int			cursor;
+				char		reused;
+
+				for (cursor = 0; cursor < HIVE_GATEWAY_MAX_CURSORS; cursor++)
+				{
+					if (client->cursors[cursor] == NULL)
+						break;
+				}
+				if (cursor == HIVE_GATEWAY_MAX_CURSORS)
+					elog(ERROR, HIVE_FDW_NAME ": too many open gateway cursors");
+
+				/* All connection strings together identify a pooled connection */
+				initStringInfo(&key);
+				appendBinaryStringInfo(&key, payload, (timeoutstr + strlen(timeoutstr)) - payload);
+
+				foreach(lc, idle_pool)
+				{
+					HiveGatewayPooledConn *conn = (HiveGatewayPooledConn *) lfirst(lc);
+
+					if (conn->key_len == key.len &&
+						memcmp(conn->key, key.data, key.len) == 0)
+					{
+						pooled = conn;
+						break;
+					}
+				}
+
+				reused = (pooled != NULL);
+				if (pooled != NULL)
+				{
+					java_call = pooled->java_call;
+					idle_pool = list_delete_ptr(idle_pool, pooled);
+					pfree(pooled->key);
+					pfree(pooled);
+
+					/*
+					 * The server may have dropped the connection while it
+					 * sat idle; open a fresh one instead of failing the
+					 * query on it.
+					 */
+					if (!hiveJNIIsValid(java_call))
+					{
+						gateway_close_connection(java_call);
+						java_call = NULL;
+						reused = false;
+					}
+				}
+				if (java_call == NULL)
+					java_call = hiveJNIConnect(drivername, url, username, password, jarfile,
+											   atoi(timeoutstr));
+
+				/* A pooled connection may have watched another slot's flag */
+				hiveJNISetCancelFlag(java_call, &gw->slots[client - clients].cancel_pending);
+
+				client->cursors[cursor] = java_call;
+				client->cursor_keys[cursor] = MemoryContextAlloc(TopMemoryContext, key.len + 1);
+				memcpy(client->cursor_keys[cursor], key.data, key.len + 1);
+				client->cursor_key_lens[cursor] = key.len;
+
+				gateway_reply(client, GW_MSG_OK, cursor, &reused, 1);
+			}
+			break;
+
+		case GW_MSG_EXECUTE:
+
+			/*
+			 * The query runs on a Java thread; gateway_poll_queries sends
+			 * the reply once it is done, and other backends are served in
+			 * the meantime.
+			 */
+			hiveJNISubmitQuery(client->cursors[arg], payload);
+			client->executing[arg] = true;
+			break;
+
+		case GW_MSG_FETCH:
+
+			/* Likewise, HiveServer2 may take its time sending the rows */
+			hiveJNISubmitFetch(client->cursors[arg]);
+			client->fetching[arg] = true;
+			break;
+
+		case GW_MSG_CLOSE:
+			gateway_release_cursor(client, arg);
+			gateway_reply(client, GW_MSG_OK, 0, NULL, 0);
+			break;
+
+		default:
+			elog(ERROR, HIVE_FDW_NAME ": unexpected gateway message type %c", type);
+	}
+}
+
+/*
+ * gateway_reply
+ *		Send a response to a client, as far as its queue has room. A batch
+ *		can be larger than the queue, and the client reads it only as fast
+ *		as it goes, so the response is kept with the client and the rest
+ *		is sent by gateway_flush_reply as room frees up.
+ */
+static void
+gateway_reply(HiveGatewayClient *client, char type, int32 arg,
+			  const char *payload, Size payload_len)
+{
+	char		header[GW_HEADER_SIZE];
+
+	Assert(!client->reply_pending);
+
+	header[0] = type;
+	memcpy(header + 1, &arg, sizeof(int32));
+
+	if (client->reply.data == NULL)
+	{
+		MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+		initStringInfo(&client->reply);
+		MemoryContextSwitchTo(oldcontext);
+	}
+	resetStringInfo(&client->reply);
+	appendBinaryStringInfo(&client->reply, header, GW_HEADER_SIZE);
+	appendBinaryStringInfo(&client->reply, payload, payload_len);
+	client->reply_pending = true;
+
+	(void) gateway_flush_reply(client);
+}
+
+/*
+ * gateway_flush_reply
+ *		Send more of a client's pending response. Returns true once none
+ *		is left; a client that went away gets nothing.
+ */
+static bool
+gateway_flush_reply(HiveGatewayClient *client)
+{
+	shm_mq_result res;
+
+	if (!client->reply_pending)
+		return true;
+
+	/* Retried with the same arguments, shm_mq carries on where it stopped */
+	res = gw_shm_mq_send(client->outq, client->reply.len, client->reply.data, true);
+	if (res == SHM_MQ_WOULD_BLOCK)
+		return false;
+
+	client->reply_pending = false;
+	return true;
+}
+
+/*
+ * gateway_release_cursor
+ *		Give a cursor's connection back to the pool, or close it if the
+ *		pool is full
+ */
+static void
+gateway_release_cursor(HiveGatewayClient *client, int cursor)
+{
+	jobject		java_call = client->cursors[cursor];
+	char	   *key = client->cursor_keys[cursor];
+	int			key_len = client->cursor_key_lens[cursor];
+
+	client->cursors[cursor] = NULL;
+	client->cursor_keys[cursor] = NULL;
+
+	/* A connection still busy on a Java thread is in no state to be reused */
+	if (client->executing[cursor] || client->fetching[cursor])
+	{
+		client->executing[cursor] = false;
+		client->fetching[cursor] = false;
+		pfree(key);
+		gateway_close_connection(java_call);
+		return;
+	}
+
+	if (list_length(idle_pool) < hive_gateway_pool_size)
+	{
+		HiveGatewayPooledConn *conn;
+		MemoryContext oldcontext;
+
+		hiveJNIRelease(java_call);
+
+		oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+		conn = palloc(sizeof(HiveGatewayPooledConn));
+		conn->key = key;
+		conn->key_len = key_len;
+		conn->java_call = java_call;
+		idle_pool = lappend(idle_pool, conn);
+		MemoryContextSwitchTo(oldcontext);
+		return;
+	}
+
+	pfree(key);
+	gateway_close_connection(java_call);
+}
+
+/*
+ * gateway_close_connection
+ *		Close a connection and drop its reference. Errors are only logged,
+ *		the connection is gone either way.
+ */
+static void
+gateway_close_connection(jobject java_call)
+{
+	PG_TRY();
+	{
+		hiveJNIClose(java_call);
+	}
+	PG_CATCH();
+	{
+		MemoryContextSwitchTo(gateway_cxt);
+		EmitErrorReport();
+		FlushErrorState();
+	}
+	PG_END_TRY();
+	hiveJNIFree(java_call);
+}
+
+/*
+ * gateway_poll_queries
+ *		Reply to the clients whose queries or fetches finished since the
+ *		last round. Returns true if some query is still running, and sets
+ *		"fetching" if some fetch is.
+ */
+static bool
+gateway_poll_queries(bool *fetching)
+{
+	static TimestampTz last_progress = 0;
+	volatile bool running = false;
+	volatile bool still_fetching = false;
+	bool		report_progress;
+	int			i;
+	int			cursor;
+
+	/* Fetches make for short rounds, so ask Hive for progress less often */
+	report_progress = TimestampDifferenceExceeds(last_progress, GetCurrentTimestamp(),
+												 HIVE_POLL_INTERVAL_MS);
+	if (report_progress)
+		last_progress = GetCurrentTimestamp();
+
+	for (i = 0; i < gw->nslots && !got_sigterm; i++)
+	{
+		HiveGatewayClient *client = &clients[i];
+
+		if (client->seg == NULL)
+			continue;
+
+		for (cursor = 0; cursor < HIVE_GATEWAY_MAX_CURSORS; cursor++)
+		{
+			jobject		java_call = client->cursors[cursor];
+
+			if (!client->executing[cursor] && !client->fetching[cursor])
+				continue;
+
+			MemoryContextReset(gateway_cxt);
+			MemoryContextSwitchTo(gateway_cxt);
+
+			PG_TRY();
+			{
+				char	   *progress;
+
+				if (client->fetching[cursor])
+				{
+					hiveRowBatch batch;
+
+					if (hiveJNIPollQuery(java_call))
+					{
+						client->fetching[cursor] = false;
+						(void) hiveJNIFinishQuery(java_call);
+						(void) hiveJNIGetBatch(java_call, &batch);
+						gateway_reply(client, GW_MSG_BATCH, cursor, batch.data, batch.len);
+					}
+					else
+						still_fetching = true;
+				}
+				else if (hiveJNIPollQuery(java_call))
+				{
+					int			ncolumns;
+					int64		update_count;
+					char	   *query_id;
+					char	   *job_ids;
+					StringInfoData ids;
+
+					client->executing[cursor] = false;
+					ncolumns = hiveJNIFinishQuery(java_call);
+					update_count = hiveJNIUpdateCount(java_call);
+
+					/*
+					 * Ship the query and job IDs for EXPLAIN ANALYZE, and
+					 * the number of rows an UPDATE or DELETE changed
+					 */
+					hiveJNIQueryIds(java_call, &query_id, &job_ids);
+					initStringInfo(&ids);
+					appendStringInfoString(&ids, query_id ? query_id : "");
+					appendStringInfoChar(&ids, '\0');
+					appendStringInfoString(&ids, job_ids ? job_ids : "");
+					appendStringInfoChar(&ids, '\0');
+					appendBinaryStringInfo(&ids, (char *) &update_count, sizeof(int64));
+
+					gateway_reply(client, GW_MSG_OK, ncolumns, ids.data, ids.len);
+				}
+				else
+				{
+					running = true;
+					progress = report_progress ? hiveJNIQueryProgress(java_call) : NULL;
+					if (progress != NULL)
+						elog(DEBUG1, HIVE_FDW_NAME ": slot %d: %s", i, progress);
+				}
+			}
+			PG_CATCH();
+			{
+				ErrorData  *edata;
+
+				MemoryContextSwitchTo(gateway_cxt);
+				edata = CopyErrorData();
+				FlushErrorState();
+
+				client->executing[cursor] = false;
+				client->fetching[cursor] = false;
+				gateway_reply(client, GW_MSG_ERROR, 0,
+							  edata->message, strlen(edata->message) + 1);
+			}
+			PG_END_TRY();
+
+			MemoryContextSwitchTo(TopMemoryContext);
+		}
+	}
+
+	*fetching = still_fetching;
+	return running;
+}
+
+/*
+ * gateway_drop_client
+ *		Forget a backend that detached from its queues and free its slot.
+ *		Its connections may be in the middle of a result, so they are
+ *		closed rather than pooled.
+ */
+static void
+gateway_drop_client(int slotno)
+{
+	HiveGatewayClient *client = &clients[slotno];
+	int			cursor;
+
+	for (cursor = 0; cursor < HIVE_GATEWAY_MAX_CURSORS; cursor++)
+	{
+		jobject		java_call = client->cursors[cursor];
+
+		if (java_call == NULL)
+			continue;
+
+		PG_TRY();
+		{
+			hiveJNIClose(java_call);
+		}
+		PG_CATCH();
+		{
+			MemoryContextSwitchTo(gateway_cxt);
+			EmitErrorReport();
+			FlushErrorState();
+		}
+		PG_END_TRY();
+		hiveJNIFree(java_call);
+
+		pfree(client->cursor_keys[cursor]);
+		client->cursors[cursor] = NULL;
+		client->cursor_keys[cursor] = NULL;
+		client->executing[cursor] = false;
+		client->fetching[cursor] = false;
+	}
+	client->reply_pending = false;
+
+	if (client->seg != NULL)
+		dsm_detach(client->seg);
+	client->seg = NULL;
+	client->inq = NULL;
+	client->outq = NULL;
+
+	LWLockAcquire(gw->lock, LW_EXCLUSIVE);
+	gw->slots[slotno].in_use = false;
+	gw->slots[slotno].cancel_pending = 0;
+	LWLockRelease(gw->lock);
+
+	elog(DEBUG2, HIVE_FDW_NAME ": gateway released slot %d", slotno);
+}
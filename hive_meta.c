@@ -0,0 +1,281 @@
+/*-------------------------------------------------------------------------
+ *
+ * hive_meta.c
+ *                Metadata cache for hive_fdw
+ *
+ * With use_remote_estimate, the planner asks Hive for the row count of
+ * foreign tables, and bulk loads check the column names of the Hive
+ * table. Every such question costs a round trip to HiveServer2
+ * and its metastore, which can take longer than the query itself, so
+ * the answers are kept in a hash table local to the backend for
+ * hive_fdw.metadata_cache_ttl seconds.
+ *
+ * Entries are dropped when their foreign table or its server changes,
+ * through syscache invalidation callbacks, so ALTER FOREIGN TABLE and
+ * ALTER SERVER take effect on the next query. Changes on the Hive side
+ * are only seen once an entry expires or hive_fdw_metadata_cache_reset()
+ * is called. hive_fdw_metadata_cache() shows what is cached.
+ *
+ * Copyright (c) 2012-2020, BigSQL
+ *
+ * IDENTIFICATION
+ *                hive_fdw/src/hive_meta.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "hive_fdw.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+#define HIVE_META_COLS				8
+
+typedef struct HiveMetaEntry
+{
+	Oid			relid;			/* foreign table, hash key */
+	Oid			serverid;
+	uint32		table_hash;		/* syscache hash values of the foreign */
+	uint32		server_hash;	/* table and of its server */
+	TimestampTz fetched_at;		/* when Hive was asked */
+	int64		hits;			/* lookups answered from the entry */
+	hiveTableMetadata meta;
+} HiveMetaEntry;
+
+/* GUC variables */
+static int	hive_meta_cache_ttl = 300;
+
+static HTAB *meta_hash = NULL;
+
+PG_FUNCTION_INFO_V1(hive_fdw_metadata_cache);
+PG_FUNCTION_INFO_V1(hive_fdw_metadata_cache_reset);
+
+static void hive_meta_invalidate(Datum arg, int cacheid, uint32 hashvalue);
+static List *hive_meta_copy_columns(List *columns);
+static void hive_meta_create_hash(void);
+
+/*
+ * hive_meta_init
+ *		Define the cache GUC and watch foreign tables and servers for
+ *		changes
+ */
+void
+hive_meta_init(void)
+{
+	DefineCustomIntVariable("hive_fdw.metadata_cache_ttl",
+							"Time Hive table metadata is cached for planning.",
+							"Zero disables the cache, -1 keeps entries until they are invalidated.",
+							&hive_meta_cache_ttl,
+							300, -1, INT_MAX / 1000,
+							PGC_USERSET,
+							GUC_UNIT_S,
+							NULL, NULL, NULL);
+
+	CacheRegisterSyscacheCallback(FOREIGNTABLEREL, hive_meta_invalidate, (Datum) 0);
+	CacheRegisterSyscacheCallback(FOREIGNSERVEROID, hive_meta_invalidate, (Datum) 0);
+}
+
+/*
+ * hive_meta_lookup
+ *		Metadata of the Hive table behind a foreign table, from the cache
+ *		if it has a recent enough entry and from Hive otherwise. The
+ *		column list is the caller's own copy.
+ */
+void
+hive_meta_lookup(Oid relid, hiveTableMetadata *meta)
+{
+	HiveMetaEntry *entry = NULL;
+	Oid			serverid;
+	bool		found;
+	MemoryContext oldcontext;
+
+	if (meta_hash != NULL)
+		entry = (HiveMetaEntry *) hash_search(meta_hash, &relid, HASH_FIND, NULL);
+
+	if (entry != NULL &&
+		(hive_meta_cache_ttl < 0 ||
+		 !TimestampDifferenceExceeds(entry->fetched_at, GetCurrentTimestamp(),
+									 hive_meta_cache_ttl * 1000)))
+	{
+		entry->hits++;
+		*meta = entry->meta;
+		meta->columns = hive_meta_copy_columns(entry->meta.columns);
+		return;
+	}
+
+	/* Only enter the table once Hive has answered */
+	hiveFetchTableMetadata(relid, meta);
+
+	if (hive_meta_cache_ttl == 0)
+		return;
+
+	if (meta_hash == NULL)
+		hive_meta_create_hash();
+
+	serverid = GetForeignTable(relid)->serverid;
+
+	entry = (HiveMetaEntry *) hash_search(meta_hash, &relid, HASH_ENTER, &found);
+	if (found)
+		list_free_deep(entry->meta.columns);
+	entry->serverid = serverid;
+	entry->table_hash = GetSysCacheHashValue1(FOREIGNTABLEREL, ObjectIdGetDatum(relid));
+	entry->server_hash = GetSysCacheHashValue1(FOREIGNSERVEROID, ObjectIdGetDatum(serverid));
+	entry->fetched_at = GetCurrentTimestamp();
+	entry->hits = 0;
+	entry->meta = *meta;
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	entry->meta.columns = hive_meta_copy_columns(meta->columns);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * hive_meta_copy_columns
+ *		Copy a list of column names into the current memory context
+ */
+static List *
+hive_meta_copy_columns(List *columns)
+{
+	List	   *copy = NIL;
+	ListCell   *lc;
+
+	foreach(lc, columns)
+		copy = lappend(copy, pstrdup((char *) lfirst(lc)));
+
+	return copy;
+}
+
+/*
+ * hive_meta_invalidate
+ *		Syscache callback dropping the entries of a changed foreign table
+ *		or server. A hash value of 0 means that everything may have
+ *		changed.
+ */
+static void
+hive_meta_invalidate(Datum arg, int cacheid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS hash_seq;
+	HiveMetaEntry *entry;
+
+	if (meta_hash == NULL)
+		return;
+
+	hash_seq_init(&hash_seq, meta_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		uint32		entry_hash = (cacheid == FOREIGNTABLEREL) ?
+			entry->table_hash : entry->server_hash;
+
+		if (hashvalue == 0 || entry_hash == hashvalue)
+		{
+			list_free_deep(entry->meta.columns);
+			hash_search(meta_hash, &entry->relid, HASH_REMOVE, NULL);
+		}
+	}
+}
+
+static void
+hive_meta_create_hash(void)
+{
+	HASHCTL		ctl;
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(HiveMetaEntry);
+	ctl.hcxt = TopMemoryContext;
+
+	meta_hash = hash_create("hive_fdw metadata cache", 64, &ctl,
+							HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+}
+
+/*
+ * hive_fdw_metadata_cache
+ *		Return the metadata cached by the current backend. Values Hive did
+ *		not report are NULL.
+ */
+Datum
+hive_fdw_metadata_cache(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	HASH_SEQ_STATUS hash_seq;
+	HiveMetaEntry *entry;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (meta_hash == NULL)
+		return (Datum) 0;
+
+	hash_seq_init(&hash_seq, meta_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		Datum		values[HIVE_META_COLS];
+		bool		nulls[HIVE_META_COLS];
+		int			i = 0;
+
+		memset(nulls, 0, sizeof(nulls));
+
+		values[i++] = ObjectIdGetDatum(entry->serverid);
+		values[i++] = ObjectIdGetDatum(entry->relid);
+		nulls[i] = (entry->meta.rows < 0);
+		values[i++] = Float8GetDatum(entry->meta.rows);
+		nulls[i] = (entry->meta.bytes < 0);
+		values[i++] = Int64GetDatum(entry->meta.bytes);
+		nulls[i] = (entry->meta.files < 0);
+		values[i++] = Int64GetDatum(entry->meta.files);
+		nulls[i] = (entry->meta.partitions < 0);
+		values[i++] = Int64GetDatum(entry->meta.partitions);
+		values[i++] = TimestampTzGetDatum(entry->fetched_at);
+		values[i++] = Int64GetDatum(entry->hits);
+
+		Assert(i == HIVE_META_COLS);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * hive_fdw_metadata_cache_reset
+ *		Discard the metadata cached by the current backend
+ */
+Datum
+hive_fdw_metadata_cache_reset(PG_FUNCTION_ARGS)
+{
+	hive_meta_invalidate((Datum) 0, FOREIGNTABLEREL, 0);
+
+	PG_RETURN_VOID();
+}
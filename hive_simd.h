@@ -0,0 +1,117 @@
+/*-------------------------------------------------------------------------
+ *
+ * hive_simd.h
+ *                Vectorized byte scans for hive_fdw
+ *
+ * Text arrives from Java as UTF-8. On a database with another encoding
+ * every value used to be converted on its own, although most Hive data
+ * is plain ASCII, which every server encoding shares with UTF-8. These
+ * helpers check a whole batch for non-ASCII bytes a vector at a time so
+ * that conversion is only paid for when it is needed.
+ *
+ * The vector width is picked at compile time: AVX2 when the compiler
+ * targets it, otherwise SSE2, which every x86-64 CPU has, or NEON on
+ * ARM64. Other platforms use a scalar loop over 8-byte words.
+ *
+ * Only bool, Size, uint64 and UINT64CONST from c.h are needed, so that
+ * bench/simd_bench.c can include this header outside the server.
+ *
+ * Copyright (c) 2012-2020, BigSQL
+ *
+ * IDENTIFICATION
+ *                hive_fdw/src/hive_simd.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef HIVE_SIMD_H
+#define HIVE_SIMD_H
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HIVE_SIMD_NAME		"avx2"
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HIVE_SIMD_SSE2
+#define HIVE_SIMD_NAME		"sse2"
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HIVE_SIMD_NEON
+#define HIVE_SIMD_NAME		"neon"
+#else
+#define HIVE_SIMD_NAME		"scalar"
+#endif
+
+/*
+ * hive_is_ascii_scalar
+ *		True if no byte of s[0..len) has its high bit set, eight bytes at
+ *		a time.
+ */
+static inline bool
+hive_is_ascii_scalar(const char *s, Size len)
+{
+	uint64		highbits = 0;
+	Size		i = 0;
+
+	for (; i + sizeof(uint64) <= len; i += sizeof(uint64))
+	{
+		uint64		chunk;
+
+		memcpy(&chunk, s + i, sizeof(uint64));
+		highbits |= chunk;
+	}
+	for (; i < len; i++)
+		highbits |= (unsigned char) s[i];
+
+	return (highbits & UINT64CONST(0x8080808080808080)) == 0;
+}
+
+/*
+ * hive_is_ascii
+ *		Vectorized version of hive_is_ascii_scalar. The high bits of all
+ *		vectors are OR'ed together and tested once at the end, which keeps
+ *		the loop free of branches.
+ */
+static inline bool
+hive_is_ascii(const char *s, Size len)
+{
+	Size		i = 0;
+
+#if defined(__AVX2__)
+	__m256i		acc = _mm256_setzero_si256();
+
+	/* Short cells, the common case, are cheaper in the scalar loop */
+	if (len < sizeof(__m256i))
+		return hive_is_ascii_scalar(s, len);
+
+	for (; i + sizeof(__m256i) <= len; i += sizeof(__m256i))
+		acc = _mm256_or_si256(acc, _mm256_loadu_si256((const __m256i *) (s + i)));
+	if (_mm256_movemask_epi8(acc) != 0)
+		return false;
+#elif defined(HIVE_SIMD_SSE2)
+	__m128i		acc = _mm_setzero_si128();
+
+	if (len < sizeof(__m128i))
+		return hive_is_ascii_scalar(s, len);
+
+	for (; i + sizeof(__m128i) <= len; i += sizeof(__m128i))
+		acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *) (s + i)));
+	if (_mm_movemask_epi8(acc) != 0)
+		return false;
+#elif defined(HIVE_SIMD_NEON)
+	uint8x16_t	acc = vdupq_n_u8(0);
+
+	if (len < sizeof(uint8x16_t))
+		return hive_is_ascii_scalar(s, len);
+
+	for (; i + sizeof(uint8x16_t) <= len; i += sizeof(uint8x16_t))
+		acc = vorrq_u8(acc, vld1q_u8((const uint8_t *) (s + i)));
+	if (vmaxvq_u8(acc) & 0x80)
+		return false;
+#endif
+
+	return hive_is_ascii_scalar(s + i, len - i);
+}
+
+#endif							/* HIVE_SIMD_H */
@@ -0,0 +1,494 @@
+/*-------------------------------------------------------------------------
+ *
+ * hive_stats.c
+ *                Cumulative statistics for hive_fdw
+ *
+ * Counters are kept in a shared memory hash table with one entry per
+ * database, foreign server and foreign table, and are exposed through
+ * hive_fdw_stat() and the pg_stat_hive_fdw view. Events that do not
+ * belong to a table, such as the creation of a JVM, are counted in an
+ * entry with relid 0. Pushed-down joins are counted the same way.
+ *
+ * Like pg_stat_statements, the hash table is protected by an LWLock and
+ * every entry by a spinlock, so that concurrent updates of existing
+ * entries only need the LWLock in shared mode. Once hive_fdw.stats_max
+ * entries exist, events for new keys are not counted.
+ *
+ * Statistics are only collected when hive_fdw is listed in
+ * shared_preload_libraries.
+ *
+ * Copyright (c) 2012-2020, BigSQL
+ *
+ * IDENTIFICATION
+ *                hive_fdw/src/hive_stats.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "hive_fdw.h"
+
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/tuplestore.h"
+
+/*
+ * Latency histograms have log2 buckets in milliseconds: bucket 0 counts
+ * latencies below 1 ms, bucket i those in [2^(i-1), 2^i) ms, and the last
+ * bucket everything above, which is about two hours.
+ */
+#define HIVE_STATS_BUCKETS			24
+
+#define HIVE_STAT_COLS				17
+
+typedef struct HiveStatsKey
+{
+	Oid			dbid;
+	Oid			serverid;
+	Oid			relid;			/* foreign table, or InvalidOid */
+} HiveStatsKey;
+
+typedef struct HiveStatsCounters
+{
+	int64		queries;		/* remote queries executed */
+	int64		rows;			/* rows fetched */
+	int64		bytes;			/* size of the row batches fetched */
+	int64		batches;		/* row batches fetched */
+	int64		conn_opens;		/* new HiveServer2 connections */
+	int64		conn_reuses;	/* connections taken from the gateway pool */
+	int64		jvm_creations;	/* JVMs created */
+	int64		cancels;		/* queries cancelled */
+	int64		errors;			/* queries that failed otherwise */
+	double		jvm_create_time;	/* in ms */
+	double		execute_time;	/* in ms */
+	double		first_row_time; /* in ms */
+	int64		execute_hist[HIVE_STATS_BUCKETS];
+	int64		first_row_hist[HIVE_STATS_BUCKETS];
+} HiveStatsCounters;
+
+typedef struct HiveStatsEntry
+{
+	HiveStatsKey key;			/* hash key, must be first */
+	slock_t		mutex;			/* protects the counters */
+	HiveStatsCounters counters;
+} HiveStatsEntry;
+
+typedef struct HiveStatsShared
+{
+	LWLock	   *lock;			/* protects the hash table */
+} HiveStatsShared;
+
+/* GUC variables */
+static int	hive_stats_max = 1000;
+
+static HiveStatsShared *stats = NULL;
+static HTAB *stats_hash = NULL;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+PG_FUNCTION_INFO_V1(hive_fdw_stat);
+PG_FUNCTION_INFO_V1(hive_fdw_stat_reset);
+
+static Size hive_stats_shmem_size(void);
+static void hive_stats_shmem_request(void);
+static void hive_stats_shmem_startup(void);
+static void hive_stats_accum(Oid serverid, Oid relid, HiveStatsCounters *delta);
+static int	hive_stats_bucket(double msec);
+static Datum hive_stats_histogram(int64 *hist);
+
+/*
+ * hive_stats_init
+ *		Define the statistics GUCs and, when preloaded, reserve shared
+ *		memory for the counters
+ */
+void
+hive_stats_init(void)
+{
+	DefineCustomIntVariable("hive_fdw.stats_max",
+							"Maximum number of servers and tables hive_fdw keeps statistics for.",
+							"Zero disables the statistics.",
+							&hive_stats_max,
+							1000, 0, INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL, NULL, NULL);
+
+	if (!process_shared_preload_libraries_in_progress || hive_stats_max == 0)
+		return;
+
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = hive_stats_shmem_request;
+#else
+	hive_stats_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = hive_stats_shmem_startup;
+}
+
+static Size
+hive_stats_shmem_size(void)
+{
+	return add_size(MAXALIGN(sizeof(HiveStatsShared)),
+					hash_estimate_size(hive_stats_max, sizeof(HiveStatsEntry)));
+}
+
+static void
+hive_stats_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(hive_stats_shmem_size());
+	RequestNamedLWLockTranche("hive_fdw stats", 1);
+}
+
+static void
+hive_stats_shmem_startup(void)
+{
+	bool		found;
+	HASHCTL		info;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	stats = ShmemInitStruct("hive_fdw stats", sizeof(HiveStatsShared), &found);
+	if (!found)
+		stats->lock = &(GetNamedLWLockTranche("hive_fdw stats"))->lock;
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(HiveStatsKey);
+	info.entrysize = sizeof(HiveStatsEntry);
+	stats_hash = ShmemInitHash("hive_fdw stats hash",
+							   hive_stats_max, hive_stats_max,
+							   &info,
+							   HASH_ELEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * hive_stats_jvm_created
+ *		Count the creation of this process's JVM, which took "elapsed"
+ */
+void
+hive_stats_jvm_created(Oid serverid, instr_time elapsed)
+{
+	HiveStatsCounters delta;
+
+	memset(&delta, 0, sizeof(delta));
+	delta.jvm_creations = 1;
+	delta.jvm_create_time = INSTR_TIME_GET_MILLISEC(elapsed);
+	hive_stats_accum(serverid, InvalidOid, &delta);
+}
+
+/*
+ * hive_stats_connection
+ *		Count a connection opened for a scan, or reused from the pool
+ */
+void
+hive_stats_connection(Oid serverid, Oid relid, bool reused)
+{
+	HiveStatsCounters delta;
+
+	memset(&delta, 0, sizeof(delta));
+	if (reused)
+		delta.conn_reuses = 1;
+	else
+		delta.conn_opens = 1;
+	hive_stats_accum(serverid, relid, &delta);
+}
+
+/*
+ * hive_stats_query
+ *		Count a remote query that executed successfully
+ */
+void
+hive_stats_query(Oid serverid, Oid relid, instr_time execute_time)
+{
+	HiveStatsCounters delta;
+	double		msec = INSTR_TIME_GET_MILLISEC(execute_time);
+
+	memset(&delta, 0, sizeof(delta));
+	delta.queries = 1;
+	delta.execute_time = msec;
+	delta.execute_hist[hive_stats_bucket(msec)] = 1;
+	hive_stats_accum(serverid, relid, &delta);
+}
+
+/*
+ * hive_stats_scan_end
+ *		Count what a finished scan fetched
+ */
+void
+hive_stats_scan_end(Oid serverid, Oid relid, hiveScanMetrics *metrics, int64 rows)
+{
+	HiveStatsCounters delta;
+
+	memset(&delta, 0, sizeof(delta));
+	delta.rows = rows;
+	delta.bytes = metrics->bytes;
+	delta.batches = metrics->batches;
+	if (rows > 0)
+	{
+		double		msec = INSTR_TIME_GET_MILLISEC(metrics->first_row_time);
+
+		delta.first_row_time = msec;
+		delta.first_row_hist[hive_stats_bucket(msec)] = 1;
+	}
+	hive_stats_accum(serverid, relid, &delta);
+}
+
+/*
+ * hive_stats_error
+ *		Count a failed scan. Meant to be called from a PG_CATCH block,
+ *		where the error is still current.
+ */
+void
+hive_stats_error(Oid serverid, Oid relid)
+{
+	HiveStatsCounters delta;
+
+	memset(&delta, 0, sizeof(delta));
+	if (geterrcode() == ERRCODE_QUERY_CANCELED)
+		delta.cancels = 1;
+	else
+		delta.errors = 1;
+	hive_stats_accum(serverid, relid, &delta);
+}
+
+/*
+ * hive_stats_accum
+ *		Add "delta" to the counters of the given server and table
+ */
+static void
+hive_stats_accum(Oid serverid, Oid relid, HiveStatsCounters *delta)
+{
+	HiveStatsKey key;
+	HiveStatsEntry *entry;
+	HiveStatsCounters *counters;
+	int			i;
+
+	if (stats == NULL || stats_hash == NULL)
+		return;
+
+	memset(&key, 0, sizeof(key));
+	key.dbid = MyDatabaseId;
+	key.serverid = serverid;
+	key.relid = relid;
+
+	LWLockAcquire(stats->lock, LW_SHARED);
+
+	entry = (HiveStatsEntry *) hash_search(stats_hash, &key, HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		bool		found;
+
+		/* Need exclusive lock to make a new entry */
+		LWLockRelease(stats->lock);
+		LWLockAcquire(stats->lock, LW_EXCLUSIVE);
+
+		if (hash_get_num_entries(stats_hash) >= hive_stats_max)
+		{
+			LWLockRelease(stats->lock);
+			return;
+		}
+
+		entry = (HiveStatsEntry *) hash_search(stats_hash, &key, HASH_ENTER, &found);
+		if (!found)
+		{
+			SpinLockInit(&entry->mutex);
+			memset(&entry->counters, 0, sizeof(HiveStatsCounters));
+		}
+	}
+
+	SpinLockAcquire(&entry->mutex);
+	counters = &entry->counters;
+	counters->queries += delta->queries;
+	counters->rows += delta->rows;
+	counters->bytes += delta->bytes;
+	counters->batches += delta->batches;
+	counters->conn_opens += delta->conn_opens;
+	counters->conn_reuses += delta->conn_reuses;
+	counters->jvm_creations += delta->jvm_creations;
+	counters->cancels += delta->cancels;
+	counters->errors += delta->errors;
+	counters->jvm_create_time += delta->jvm_create_time;
+	counters->execute_time += delta->execute_time;
+	counters->first_row_time += delta->first_row_time;
+	for (i = 0; i < HIVE_STATS_BUCKETS; i++)
+	{
+		counters->execute_hist[i] += delta->execute_hist[i];
+		counters->first_row_hist[i] += delta->first_row_hist[i];
+	}
+	SpinLockRelease(&entry->mutex);
+
+	LWLockRelease(stats->lock);
+}
+
+/*
+ * hive_stats_bucket
+ *		Histogram bucket for a latency of "msec" milliseconds
+ */
+static int
+hive_stats_bucket(double msec)
+{
+	int			bucket = 0;
+
+	while (msec >= 1.0 && bucket < HIVE_STATS_BUCKETS - 1)
+	{
+		msec /= 2.0;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+/*
+ * hive_stats_histogram
+ *		Turn a histogram into a bigint[] Datum
+ */
+static Datum
+hive_stats_histogram(int64 *hist)
+{
+	Datum		elems[HIVE_STATS_BUCKETS];
+	int			i;
+
+	for (i = 0; i < HIVE_STATS_BUCKETS; i++)
+		elems[i] = Int64GetDatum(hist[i]);
+
+	return PointerGetDatum(construct_array(elems, HIVE_STATS_BUCKETS,
+										   INT8OID, sizeof(int64),
+										   FLOAT8PASSBYVAL, 'd'));
+}
+
+/*
+ * hive_fdw_stat
+ *		Return the statistics of all servers and tables
+ */
+Datum
+hive_fdw_stat(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	HASH_SEQ_STATUS hash_seq;
+	HiveStatsEntry *entry;
+
+	if (stats == NULL || stats_hash == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("hive_fdw statistics are not available"),
+				 errhint("Add hive_fdw to shared_preload_libraries and set hive_fdw.stats_max above zero.")));
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	LWLockAcquire(stats->lock, LW_SHARED);
+
+	hash_seq_init(&hash_seq, stats_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		Datum		values[HIVE_STAT_COLS];
+		bool		nulls[HIVE_STAT_COLS];
+		HiveStatsCounters counters;
+		int			i = 0;
+
+		SpinLockAcquire(&entry->mutex);
+		counters = entry->counters;
+		SpinLockRelease(&entry->mutex);
+
+		memset(nulls, 0, sizeof(nulls));
+
+		values[i++] = ObjectIdGetDatum(entry->key.dbid);
+		values[i++] = ObjectIdGetDatum(entry->key.serverid);
+		values[i++] = ObjectIdGetDatum(entry->key.relid);
+		values[i++] = Int64GetDatum(counters.queries);
+		values[i++] = Int64GetDatum(counters.rows);
+		values[i++] = Int64GetDatum(counters.bytes);
+		values[i++] = Int64GetDatum(counters.batches);
+		values[i++] = Int64GetDatum(counters.conn_opens);
+		values[i++] = Int64GetDatum(counters.conn_reuses);
+		values[i++] = Int64GetDatum(counters.jvm_creations);
+		values[i++] = Float8GetDatum(counters.jvm_create_time);
+		values[i++] = Int64GetDatum(counters.cancels);
+		values[i++] = Int64GetDatum(counters.errors);
+		values[i++] = Float8GetDatum(counters.execute_time);
+		values[i++] = Float8GetDatum(counters.first_row_time);
+		values[i++] = hive_stats_histogram(counters.execute_hist);
+		values[i++] = hive_stats_histogram(counters.first_row_hist);
+
+		Assert(i == HIVE_STAT_COLS);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	LWLockRelease(stats->lock);
+
+	return (Datum) 0;
+}
+
+/*
+ * hive_fdw_stat_reset
+ *		Discard all statistics
+ */
+Datum
+hive_fdw_stat_reset(PG_FUNCTION_ARGS)
+{
+	HASH_SEQ_STATUS hash_seq;
+	HiveStatsEntry *entry;
+
+	if (stats == NULL || stats_hash == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("hive_fdw statistics are not available"),
+				 errhint("Add hive_fdw to shared_preload_libraries and set hive_fdw.stats_max above zero.")));
+
+	LWLockAcquire(stats->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&hash_seq, stats_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+		hash_search(stats_hash, &entry->key, HASH_REMOVE, NULL);
+
+	LWLockRelease(stats->lock);
+
+	PG_RETURN_VOID();
+}
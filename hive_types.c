@@ -0,0 +1,260 @@
+/*-------------------------------------------------------------------------
+ *
+ * hive_types.c
+ *                Hive type names for hive_fdw
+ *
+ * IMPORT FOREIGN SCHEMA records the Hive type of ARRAY, MAP and STRUCT
+ * columns in the hive_type column option, for instance
+ * "map<string,int>". The validator checks such type names, and the
+ * deparser uses them to tell whether "col ->> 'key'" on a jsonb column
+ * means a map lookup or a struct field, and whether the value is a
+ * primitive that can be compared as a string.
+ *
+ * Copyright (c) 2012-2020, BigSQL
+ *
+ * IDENTIFICATION
+ *                hive_fdw/src/hive_types.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "hive_fdw.h"
+
+#include "utils/builtins.h"
+
+/* Hive primitive type names, some of which take (...) parameters */
+static const char *const hive_primitive_types[] = {
+	"tinyint", "smallint", "int", "integer", "bigint", "float", "double",
+	"decimal", "numeric", "boolean", "string", "char", "varchar", "binary",
+	"timestamp", "date", "interval_year_month", "interval_day_time", "void",
+	NULL
+};
+
+static const char *hiveTypeSkipSpace(const char *p);
+static bool hiveTypeHead(const char **p, char *head, int headlen);
+static const char *hiveTypeParse(const char *p);
+static List *hiveTypeMembers(const char *hive_type, char *kind);
+
+/*
+ * hiveTypeKind
+ *		Classify a Hive type name as HIVE_TYPE_PRIMITIVE, HIVE_TYPE_ARRAY,
+ *		HIVE_TYPE_MAP, HIVE_TYPE_STRUCT or HIVE_TYPE_UNION. Returns
+ *		HIVE_TYPE_INVALID if it is not a well-formed type name.
+ */
+char
+hiveTypeKind(const char *hive_type)
+{
+	const char *p = hiveTypeParse(hive_type);
+	char		head[32];
+
+	if (p == NULL || *hiveTypeSkipSpace(p) != '\0')
+		return HIVE_TYPE_INVALID;
+
+	p = hive_type;
+	hiveTypeHead(&p, head, sizeof(head));
+
+	if (strcmp(head, "array") == 0)
+		return HIVE_TYPE_ARRAY;
+	if (strcmp(head, "map") == 0)
+		return HIVE_TYPE_MAP;
+	if (strcmp(head, "struct") == 0)
+		return HIVE_TYPE_STRUCT;
+	if (strcmp(head, "uniontype") == 0)
+		return HIVE_TYPE_UNION;
+	return HIVE_TYPE_PRIMITIVE;
+}
+
+/*
+ * hiveTypeMember
+ *		Type of a part of a complex Hive type: the element type of an
+ *		array, the value type of a map, or the type of the named field of
+ *		a struct. Field names are matched exactly, as they appear in the
+ *		JSON Hive returns. Returns a palloc'd type name, or NULL if there
+ *		is no such part.
+ */
+char *
+hiveTypeMember(const char *hive_type, const char *field)
+{
+	char		kind;
+	List	   *members = hiveTypeMembers(hive_type, &kind);
+	ListCell   *lc;
+
+	switch (kind)
+	{
+		case HIVE_TYPE_ARRAY:
+			return linitial(members);
+		case HIVE_TYPE_MAP:
+			return lsecond(members);
+		case HIVE_TYPE_STRUCT:
+			foreach(lc, members)
+			{
+				char	   *member = (char *) lfirst(lc);
+				char	   *colon = strchr(member, ':');
+
+				if (field != NULL &&
+					strncmp(member, field, colon - member) == 0 &&
+					strlen(field) == colon - member)
+					return pstrdup(hiveTypeSkipSpace(colon + 1));
+			}
+			return NULL;
+		default:
+			return NULL;
+	}
+}
+
+/*
+ * hiveTypeMembers
+ *		Split the parameters of a complex type at its top-level commas.
+ *		Struct members keep their "name:" prefix.
+ */
+static List *
+hiveTypeMembers(const char *hive_type, char *kind)
+{
+	List	   *members = NIL;
+	const char *p;
+	const char *start;
+	int			depth = 0;
+
+	*kind = hiveTypeKind(hive_type);
+	if (*kind != HIVE_TYPE_ARRAY && *kind != HIVE_TYPE_MAP &&
+		*kind != HIVE_TYPE_STRUCT && *kind != HIVE_TYPE_UNION)
+		return NIL;
+
+	p = strchr(hive_type, '<') + 1;
+	start = p;
+	for (; *p; p++)
+	{
+		if (*p == '<' || *p == '(')
+			depth++;
+		else if ((*p == '>' || *p == ')') && depth > 0)
+			depth--;
+		else if ((*p == ',' || *p == '>') && depth == 0)
+		{
+			members = lappend(members,
+							  pnstrdup(hiveTypeSkipSpace(start),
+									   p - hiveTypeSkipSpace(start)));
+			start = p + 1;
+			if (*p == '>')
+				break;
+		}
+	}
+
+	return members;
+}
+
+/*
+ * hiveTypeParse
+ *		Parse one type name at p and return the position just past it, or
+ *		NULL if it is malformed.
+ */
+static const char *
+hiveTypeParse(const char *p)
+{
+	char		head[32];
+	int			i;
+
+	if (p == NULL || !hiveTypeHead(&p, head, sizeof(head)))
+		return NULL;
+
+	if (strcmp(head, "array") == 0 || strcmp(head, "map") == 0 ||
+		strcmp(head, "struct") == 0 || strcmp(head, "uniontype") == 0)
+	{
+		bool		is_struct = (strcmp(head, "struct") == 0);
+		int			nmembers = 0;
+
+		p = hiveTypeSkipSpace(p);
+		if (*p++ != '<')
+			return NULL;
+
+		for (;;)
+		{
+			p = hiveTypeSkipSpace(p);
+
+			/* Struct members are name:type */
+			if (is_struct)
+			{
+				if (!isalnum((unsigned char) *p) && *p != '_' && *p != '`')
+					return NULL;
+				while (*p && *p != ':' && *p != '>' && *p != ',')
+					p++;
+				if (*p++ != ':')
+					return NULL;
+			}
+
+			if ((p = hiveTypeParse(p)) == NULL)
+				return NULL;
+			nmembers++;
+
+			p = hiveTypeSkipSpace(p);
+			if (*p == '>')
+				break;
+			if (*p++ != ',')
+				return NULL;
+		}
+		p++;
+
+		if (strcmp(head, "array") == 0 && nmembers != 1)
+			return NULL;
+		if (strcmp(head, "map") == 0 && nmembers != 2)
+			return NULL;
+		return p;
+	}
+
+	for (i = 0; hive_primitive_types[i] != NULL; i++)
+	{
+		if (strcmp(head, hive_primitive_types[i]) == 0)
+			break;
+	}
+	if (hive_primitive_types[i] == NULL)
+		return NULL;
+
+	/* decimal(10,2), varchar(20) and the like */
+	p = hiveTypeSkipSpace(p);
+	if (*p == '(')
+	{
+		while (*p && *p != ')')
+			p++;
+		if (*p++ != ')')
+			return NULL;
+	}
+
+	return p;
+}
+
+/*
+ * hiveTypeHead
+ *		Read the keyword at *p into head, lower-cased, and advance *p
+ *		past it. Returns false if there is no keyword.
+ */
+static bool
+hiveTypeHead(const char **p, char *head, int headlen)
+{
+	const char *s = hiveTypeSkipSpace(*p);
+	int			len = 0;
+	int			i;
+
+	while (isalpha((unsigned char) s[len]) || s[len] == '_')
+		len++;
+	if (len == 0 || len >= headlen)
+	{
+		head[0] = '\0';
+		return false;
+	}
+
+	for (i = 0; i < len; i++)
+		head[i] = pg_ascii_tolower((unsigned char) s[i]);
+	head[len] = '\0';
+
+	*p = s + len;
+	return true;
+}
+
+static const char *
+hiveTypeSkipSpace(const char *p)
+{
+	while (isspace((unsigned char) *p))
+		p++;
+	return p;
+}
@@ -0,0 +1,104 @@
+--
+-- Regression tests for hive_fdw. They run against the mock JDBC driver
+-- of the benchmark suite instead of a Hive server; see the Makefile.
+--
+CREATE EXTENSION hive_fdw;
+
+CREATE SERVER hive_mock FOREIGN DATA WRAPPER hive_fdw
+	OPTIONS (host 'localhost', port '10000', drivername 'MockHiveDriver');
+CREATE USER MAPPING FOR CURRENT_USER SERVER hive_mock
+	OPTIONS (username 'test', password 'test');
+
+-- The mock driver refuses to truncate tables named *_fail*
+CREATE FOREIGN TABLE ft_ok (i1 int) SERVER hive_mock OPTIONS (table 'truncate_ok');
+CREATE FOREIGN TABLE ft_fail (i1 int) SERVER hive_mock OPTIONS (table 'truncate_fail');
+
+-- Remote errors carry a Java stack trace
+\set VERBOSITY sqlstate
+
+--
+-- TRUNCATE is sent at commit, and only if its subtransaction survived
+--
+BEGIN;
+TRUNCATE ft_ok;
+SAVEPOINT s;
+TRUNCATE ft_fail;
+ROLLBACK TO s;
+COMMIT;
+
+-- Rolling back to an outer savepoint drops nested subtransactions
+BEGIN;
+SAVEPOINT a;
+SAVEPOINT b;
+TRUNCATE ft_fail;
+ROLLBACK TO a;
+TRUNCATE ft_ok;
+COMMIT;
+
+-- A released savepoint hands its TRUNCATE to the parent, so rolling
+-- back a later savepoint keeps it
+BEGIN;
+SAVEPOINT a;
+TRUNCATE ft_fail;
+RELEASE a;
+SAVEPOINT b;
+ROLLBACK TO b;
+COMMIT;
+
+-- Nothing is sent for an aborted transaction
+BEGIN;
+TRUNCATE ft_fail;
+ROLLBACK;
+
+\set VERBOSITY default
+
+--
+-- Conditions shipped to Hive, and those left to PostgreSQL
+--
+CREATE FOREIGN TABLE ft_expr (i1 int, d2 float8, s3 text, a4 date, t5 timestamp, n6 numeric)
+	SERVER hive_mock OPTIONS (table 'rows10_mix_i1d1s1a1t1n1');
+
+-- A searched CASE
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE CASE WHEN i1 > 5 THEN s3 ELSE 'x' END = 'x';
+
+-- A simple CASE goes out as a searched one
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE CASE i1 WHEN 1 THEN 'one' WHEN 2 THEN 'two' ELSE 'many' END = 'one';
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE COALESCE(s3, 'none') = 'none';
+
+-- NULLIF becomes the CASE it stands for
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE NULLIF(i1, 0) IS NULL;
+
+-- An ARRAY[] of expressions is shipped as an IN list, and nowhere else
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE 10 = ANY (ARRAY[i1, i1 * 2]);
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE ARRAY[i1] = ARRAY[1];
+
+-- Hive has no ILIKE
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE s3 ILIKE 'A%';
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE s3 NOT ILIKE 'A%';
+
+-- Casts that mean the same in Hive
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE i1::bigint = 5;
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE i1::text = '5';
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE s3::varchar(4) = 'abcd';
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE a4::timestamp = t5;
+
+-- Casts that round or format differently in Hive are left to PostgreSQL
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE d2::int = 1;
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE n6::int > 0;
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE a4::text = '2020-01-01';
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft_expr WHERE i1::bigint = 5 AND d2::int = 1;
+
+--
+-- Dates, timestamps and decimals decoded from binary cells. Decimals
+-- too wide for a long arrive as text; numeric(p,s) columns are rounded.
+--
+CREATE FOREIGN TABLE ft_edge (a1 date, t2 timestamp, n3 numeric, n4 numeric(30,2))
+	SERVER hive_mock OPTIONS (table 'rows6_mix_a1t1n2_edge');
+SET datestyle = 'ISO, YMD';
+SELECT * FROM ft_edge;
+RESET datestyle;
+
+DROP FOREIGN TABLE ft_ok, ft_fail, ft_expr, ft_edge;
+DROP USER MAPPING FOR CURRENT_USER SERVER hive_mock;
+DROP SERVER hive_mock;
+DROP EXTENSION hive_fdw;